@@ -0,0 +1,117 @@
+#pragma once
+
+#include "loguru.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+// 基准测试的最小支撑：计时，以及（glibc下）统计测量期间的堆分配次数和字节数
+// 每个基准测试是一个独立可执行文件，本头文件只能被其中一个源文件包含
+namespace BenchSupport {
+
+inline std::atomic<bool>& counting() {
+    static std::atomic<bool> flag(false);
+    return flag;
+}
+
+inline std::atomic<size_t>& allocatedBytes() {
+    static std::atomic<size_t> bytes(0);
+    return bytes;
+}
+
+inline std::atomic<size_t>& allocationCount() {
+    static std::atomic<size_t> count(0);
+    return count;
+}
+
+inline void noteAllocation(size_t bytes) {
+    if (counting().load(std::memory_order_relaxed)) {
+        allocatedBytes().fetch_add(bytes, std::memory_order_relaxed);
+        allocationCount().fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+#ifdef __GLIBC__
+inline bool countsAllocations() { return true; }
+#else
+inline bool countsAllocations() { return false; }
+#endif
+
+struct Result {
+    double us_per_op;
+    double bytes_per_op;
+    double allocs_per_op;
+    double ops_per_second;
+};
+
+// 预热后执行iterations次f，返回平均耗时和分配量
+template <typename F>
+Result measure(int iterations, F&& f) {
+    for (int i = 0; i < iterations / 100 + 1; i++) {
+        f();
+    }
+    allocatedBytes() = 0;
+    allocationCount() = 0;
+    counting() = true;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        f();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    counting() = false;
+    return Result{seconds * 1e6 / iterations, static_cast<double>(allocatedBytes().load()) / iterations,
+                  static_cast<double>(allocationCount().load()) / iterations, iterations / seconds};
+}
+
+inline void print(const std::string& name, const Result& result) {
+    if (countsAllocations()) {
+        std::printf("%-36s %10.2f us/op %12.0f B/op %8.1f allocs/op\n", name.c_str(), result.us_per_op,
+                    result.bytes_per_op, result.allocs_per_op);
+    } else {
+        std::printf("%-36s %10.2f us/op\n", name.c_str(), result.us_per_op);
+    }
+}
+
+// 说明测量环境：并发相关的数字只有在多核机器上才能体现扩展性
+inline void printHeader(const char* title) {
+    std::printf("== %s ==\n", title);
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+}
+
+inline void quietLogs() {
+    loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+}
+
+inline std::string freshPath(const std::string& name) {
+    std::remove(name.c_str());
+    std::remove((name + "-wal").c_str());
+    std::remove((name + "-shm").c_str());
+    return name;
+}
+
+} // namespace BenchSupport
+
+#ifdef __GLIBC__
+// 包装malloc系列函数以统计分配（rapidjson直接使用malloc，operator new最终也调用malloc）
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* pointer, size_t size);
+
+extern "C" void* malloc(size_t size) {
+    BenchSupport::noteAllocation(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    BenchSupport::noteAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size) {
+    BenchSupport::noteAllocation(size);
+    return __libc_realloc(pointer, size);
+}
+#endif
@@ -0,0 +1,77 @@
+// 数据库读吞吐：单连接（原来的方式）vs WAL+只读连接池，读线程数递增，同时有一个写线程持续写入
+// 读操作直接查询dishes表（绕过菜单快照），写操作更新餐桌状态
+#include "BenchSupport.h"
+#include "db/RestaurantDb.h"
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace WisdomRestaurant;
+
+struct RunResult {
+    double reads_per_second;
+    double writes_per_second;
+};
+
+static RunResult run(RestaurantDb& db, int readers, std::chrono::milliseconds duration) {
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> reads(0);
+    std::atomic<uint64_t> writes(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < readers; t++) {
+        threads.emplace_back([&] {
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (!db.queryRows<Dish>("SELECT * FROM dishes WHERE is_available = 1").empty()) {
+                    reads.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+    threads.emplace_back([&] {
+        int i = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (db.updateTableStatus(1 + i % 5, i % 2 ? "occupied" : "available")) {
+                writes.fetch_add(1, std::memory_order_relaxed);
+            }
+            i++;
+        }
+    });
+
+    auto begin = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return RunResult{reads.load() / seconds, writes.load() / seconds};
+}
+
+int main(int argc, char** argv) {
+    BenchSupport::quietLogs();
+    BenchSupport::printHeader("database reads with one concurrent writer");
+    std::chrono::milliseconds duration(argc > 1 ? std::atoi(argv[1]) : 2000);
+
+    struct Config {
+        const char* name;
+        bool wal_mode;
+        size_t read_pool_size;
+    };
+    for (const Config& config : {Config{"single connection", false, 0}, Config{"WAL + 4 readers", true, 4}}) {
+        DbOptions options;
+        options.wal_mode = config.wal_mode;
+        options.read_pool_size = config.read_pool_size;
+        RestaurantDb db;
+        if (!db.initialize(BenchSupport::freshPath("db_read_bench.db"), options)) {
+            std::fprintf(stderr, "数据库初始化失败\n");
+            return 1;
+        }
+        for (int readers : {1, 2, 4, 8}) {
+            RunResult result = run(db, readers, duration);
+            std::printf("%-18s readers=%d %10.0f reads/s %8.0f writes/s\n", config.name, readers,
+                        result.reads_per_second, result.writes_per_second);
+        }
+    }
+    return 0;
+}
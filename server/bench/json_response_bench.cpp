@@ -0,0 +1,170 @@
+// JSON响应的构造：原来先序列化data、解析回DOM再整体序列化 vs JsonResponse一次写入复用的缓冲区
+// 前两组对比同一份39道推荐菜和错误响应；最后两行是菜单接口处理函数的实际开销
+#include "BenchSupport.h"
+#include "httplib.h"
+#include "api/RecommendationController.h"
+#include "common/JsonResponse.h"
+#include "db/MenuCache.h"
+#include "db/RestaurantDb.h"
+#include "sqlite3.h"
+
+using namespace WisdomRestaurant;
+
+// 原来的信封构造方式
+static std::string buildJsonResponseWithDom(int code, const std::string& message, const std::string& data = "{}") {
+    rapidjson::Document doc;
+    doc.SetObject();
+    auto& alloc = doc.GetAllocator();
+    doc.AddMember("code", code, alloc);
+    doc.AddMember("message", rapidjson::Value(message.c_str(), alloc), alloc);
+    rapidjson::Document data_doc;
+    data_doc.Parse(data.c_str());
+    doc.AddMember("data", data_doc, alloc);
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    doc.Accept(writer);
+    return buffer.GetString();
+}
+
+// 原来的菜单data：先构建DOM再序列化为字符串
+static std::string buildDishesDataWithDom(const MenuSnapshot& snapshot) {
+    rapidjson::Document doc;
+    doc.SetObject();
+    auto& alloc = doc.GetAllocator();
+    rapidjson::Value dishes(rapidjson::kArrayType);
+    for (size_t index : snapshot.recommended) {
+        const Dish& dish = snapshot.dishes[index];
+        rapidjson::Value value(rapidjson::kObjectType);
+        value.AddMember("id", dish.id, alloc);
+        value.AddMember("dish_code", rapidjson::Value(dish.dish_code.c_str(), alloc), alloc);
+        value.AddMember("dish_name", rapidjson::Value(dish.dish_name.c_str(), alloc), alloc);
+        value.AddMember("category_id", dish.category_id, alloc);
+        value.AddMember("price", dish.price, alloc);
+        value.AddMember("description", rapidjson::Value(dish.description.c_str(), alloc), alloc);
+        value.AddMember("taste_tags", rapidjson::Value(dish.taste_tags.c_str(), alloc), alloc);
+        value.AddMember("image_url", rapidjson::Value(dish.image_url.c_str(), alloc), alloc);
+        value.AddMember("is_signature", dish.is_signature, alloc);
+        value.AddMember("is_recommended", dish.is_recommended, alloc);
+        value.AddMember("rating", dish.rating, alloc);
+        value.AddMember("sales_count", dish.sales_count, alloc);
+        value.AddMember("stock_count", dish.stock_count, alloc);
+        value.AddMember("sold_out", dish.stock_count <= 0, alloc);
+        dishes.PushBack(value, alloc);
+    }
+    doc.AddMember("total", static_cast<int>(snapshot.recommended.size()), alloc);
+    doc.AddMember("dishes", dishes, alloc);
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    doc.Accept(writer);
+    return buffer.GetString();
+}
+
+static std::string buildDishesWithWriter(const MenuSnapshot& snapshot) {
+    return JsonResponse::build(200, "获取推荐菜品成功", [&snapshot](JsonResponse::JsonWriter& writer) {
+        writer.StartObject();
+        writer.Key("dishes");
+        writer.StartArray();
+        for (size_t index : snapshot.recommended) {
+            const Dish& dish = snapshot.dishes[index];
+            writer.StartObject();
+            writer.Key("id");
+            writer.Int(dish.id);
+            writer.Key("dish_code");
+            writer.String(dish.dish_code.c_str(), static_cast<rapidjson::SizeType>(dish.dish_code.size()));
+            writer.Key("dish_name");
+            writer.String(dish.dish_name.c_str(), static_cast<rapidjson::SizeType>(dish.dish_name.size()));
+            writer.Key("category_id");
+            writer.Int(dish.category_id);
+            writer.Key("price");
+            writer.Double(dish.price);
+            writer.Key("description");
+            writer.String(dish.description.c_str(), static_cast<rapidjson::SizeType>(dish.description.size()));
+            writer.Key("taste_tags");
+            writer.String(dish.taste_tags.c_str(), static_cast<rapidjson::SizeType>(dish.taste_tags.size()));
+            writer.Key("image_url");
+            writer.String(dish.image_url.c_str(), static_cast<rapidjson::SizeType>(dish.image_url.size()));
+            writer.Key("is_signature");
+            writer.Bool(dish.is_signature);
+            writer.Key("is_recommended");
+            writer.Bool(dish.is_recommended);
+            writer.Key("rating");
+            writer.Double(dish.rating);
+            writer.Key("sales_count");
+            writer.Int(dish.sales_count);
+            writer.Key("stock_count");
+            writer.Int(dish.stock_count);
+            writer.Key("sold_out");
+            writer.Bool(dish.stock_count <= 0);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.Key("total");
+        writer.Int(static_cast<int>(snapshot.recommended.size()));
+        writer.EndObject();
+    });
+}
+
+// 在示例数据之外再插入35道推荐菜，共39道在售推荐菜
+static bool seedDishes(const std::string& path) {
+    sqlite3* connection = nullptr;
+    if (sqlite3_open(path.c_str(), &connection) != SQLITE_OK) {
+        return false;
+    }
+    bool ok = sqlite3_exec(connection, "BEGIN", nullptr, nullptr, nullptr) == SQLITE_OK;
+    for (int i = 0; ok && i < 35; i++) {
+        std::string sql = "INSERT INTO dishes (dish_code, dish_name, category_id, price, original_price, description, "
+                          "taste_tags, image_url, is_recommended, rating, sales_count) VALUES ('R" +
+                          std::to_string(i) + "', '招牌红烧肉" + std::to_string(i) + "', " + std::to_string(1 + i % 5) +
+                          ", " + std::to_string(38.5 + i) + ", 45.0, '精选五花肉，慢火炖煮，肥而不腻，入口即化', "
+                          "'咸鲜,微甜', '/images/dish_" + std::to_string(i) + ".jpg', 1, 4.5, " +
+                          std::to_string(100 + i) + ")";
+        ok = sqlite3_exec(connection, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+    }
+    ok = ok && sqlite3_exec(connection, "COMMIT", nullptr, nullptr, nullptr) == SQLITE_OK;
+    sqlite3_close(connection);
+    return ok;
+}
+
+int main() {
+    BenchSupport::quietLogs();
+    BenchSupport::printHeader("JSON responses");
+
+    std::string path = BenchSupport::freshPath("json_response_bench.db");
+    auto db = std::make_shared<RestaurantDb>();
+    if (!db->initialize(path) || !seedDishes(path) || !db->reloadMenu()) {
+        std::fprintf(stderr, "数据库初始化失败\n");
+        return 1;
+    }
+    auto snapshot = db->getMenuSnapshot();
+    std::printf("recommended dishes: %zu\n", snapshot->recommended.size());
+
+    const int iterations = 20000;
+    size_t bytes = 0;
+    BenchSupport::print("menu, DOM round trip", BenchSupport::measure(iterations, [&] {
+        bytes = buildJsonResponseWithDom(200, "获取推荐菜品成功", buildDishesDataWithDom(*snapshot)).size();
+    }));
+    BenchSupport::print("menu, JsonResponse writer", BenchSupport::measure(iterations, [&] {
+        bytes = buildDishesWithWriter(*snapshot).size();
+    }));
+    std::printf("  body %zu bytes\n", bytes);
+    BenchSupport::print("error, DOM round trip", BenchSupport::measure(iterations, [&] {
+        bytes = buildJsonResponseWithDom(404, "餐桌不存在").size();
+    }));
+    BenchSupport::print("error, JsonResponse", BenchSupport::measure(iterations, [&] {
+        bytes = JsonResponse::build(404, "餐桌不存在").size();
+    }));
+
+    RecommendationController controller(nullptr, db);
+    httplib::Request changes_request;
+    changes_request.params.emplace("since", "0");
+    BenchSupport::print("GET dishes/changes?since=0 (full)", BenchSupport::measure(iterations, [&] {
+        httplib::Response response;
+        controller.handleGetDishChanges(changes_request, response);
+    }));
+    httplib::Request recommended_request;
+    BenchSupport::print("GET dishes/recommended (cached body)", BenchSupport::measure(iterations, [&] {
+        httplib::Response response;
+        controller.handleGetRecommendedDishes(recommended_request, response);
+    }));
+    return 0;
+}
@@ -0,0 +1,145 @@
+// 下单吞吐：原来createOrder+getOrderByNo+逐项addOrderItem（每条语句一个隐式事务）vs placeOrder单事务写入
+// 每个配置使用新数据库，菜品库存预先设为足够大，避免库存不足的拒绝；菜单分别为示例的5道菜和另加500道菜
+#include "BenchSupport.h"
+#include "db/MenuCache.h"
+#include "db/RestaurantDb.h"
+#include "sqlite3.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace WisdomRestaurant;
+
+static const int kOrders = 1500;
+
+static Order makeOrder() {
+    Order order{};
+    order.table_id = 1;
+    order.user_id = "bench";
+    order.order_type = "dine_in";
+    order.people_count = 2;
+    return order;
+}
+
+static std::vector<OrderItem> makeItems(int count) {
+    std::vector<OrderItem> items;
+    for (int i = 0; i < count; i++) {
+        OrderItem item{};
+        item.dish_id = 1 + i % 5;
+        item.quantity = 1;
+        items.push_back(item);
+    }
+    return items;
+}
+
+// 在示例数据之外再插入count道菜，下单只点示例中的5道
+static bool seedDishes(const std::string& path, int count) {
+    sqlite3* connection = nullptr;
+    if (sqlite3_open(path.c_str(), &connection) != SQLITE_OK) {
+        return false;
+    }
+    bool ok = sqlite3_exec(connection, "BEGIN", nullptr, nullptr, nullptr) == SQLITE_OK;
+    sqlite3_stmt* stmt = nullptr;
+    ok = ok && sqlite3_prepare_v2(connection, "INSERT INTO dishes (dish_code, dish_name, category_id, price, "
+                                  "description, taste_tags, image_url) VALUES (?, ?, ?, ?, ?, ?, ?)",
+                                  -1, &stmt, nullptr) == SQLITE_OK;
+    for (int i = 0; ok && i < count; i++) {
+        std::string code = "B" + std::to_string(1000 + i);
+        std::string name = "招牌红烧肉" + std::to_string(i);
+        std::string image = "/images/dishes/" + code + ".jpg";
+        sqlite3_bind_text(stmt, 1, code.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 3, 1 + i % 6);
+        sqlite3_bind_double(stmt, 4, 28.0 + i % 40);
+        sqlite3_bind_text(stmt, 5, "精选五花肉，慢火炖煮两小时，肥而不腻，入口即化", -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 6, "咸鲜,微甜", -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 7, image.c_str(), -1, SQLITE_TRANSIENT);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    ok = ok && sqlite3_exec(connection, "COMMIT", nullptr, nullptr, nullptr) == SQLITE_OK;
+    sqlite3_close(connection);
+    return ok;
+}
+
+// 原来OrderController的做法
+static bool placeOrderPerStatement(RestaurantDb& db, int item_count) {
+    std::string order_no = db.createOrder(makeOrder());
+    auto order = db.getOrderByNo(order_no);
+    if (!order) {
+        return false;
+    }
+    auto snapshot = db.getMenuSnapshot();
+    for (auto& item : makeItems(item_count)) {
+        const Dish* dish = snapshot->findById(item.dish_id);
+        item.order_id = order->id;
+        item.dish_name = dish->dish_name;
+        item.dish_price = dish->price;
+        item.subtotal = dish->price * item.quantity;
+        item.item_status = "pending";
+        if (!db.addOrderItem(item)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 在新数据库上下kOrders单，返回每秒下单数；失败时返回负数
+static double run(int extra_dishes, int threads, int item_count, bool single_transaction, int& failures_out) {
+    std::string path = BenchSupport::freshPath("place_order_bench.db");
+    RestaurantDb db;
+    if (!db.initialize(path) || !seedDishes(path, extra_dishes) || !db.reloadMenu()) {
+        return -1;
+    }
+    for (int dish_id = 1; dish_id <= 5; dish_id++) {
+        db.updateDishStock(dish_id, 100000000);
+    }
+
+    std::atomic<int> failures(0);
+    std::vector<std::thread> workers;
+    const int per_thread = kOrders / threads;
+    auto begin = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            for (int i = 0; i < per_thread; i++) {
+                bool ok = single_transaction ? db.placeOrder(makeOrder(), makeItems(item_count)).has_value()
+                                             : placeOrderPerStatement(db, item_count);
+                if (!ok) {
+                    failures++;
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    failures_out = failures.load();
+    return per_thread * threads / seconds;
+}
+
+int main() {
+    BenchSupport::quietLogs();
+    BenchSupport::printHeader("order placement");
+
+    for (int extra_dishes : {0, 500}) {
+        for (int threads : {1, 4}) {
+            for (int item_count : {4, 16}) {
+                for (bool single_transaction : {false, true}) {
+                    int failures = 0;
+                    double orders_per_second = run(extra_dishes, threads, item_count, single_transaction, failures);
+                    if (orders_per_second < 0) {
+                        std::fprintf(stderr, "数据库初始化失败\n");
+                        return 1;
+                    }
+                    std::printf("dishes=%-3d threads=%d items=%-2d %-26s %8.0f orders/s (failures %d)\n",
+                                5 + extra_dishes, threads, item_count,
+                                single_transaction ? "placeOrder" : "createOrder+addOrderItem",
+                                orders_per_second, failures);
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+// 读取整张菜品表（505道菜）：原来的字符串矩阵再按位置stoi/stod解析 vs RowMapper直接读入Dish
+#include "BenchSupport.h"
+#include "db/RestaurantDb.h"
+#include "sqlite3.h"
+#include <vector>
+
+using namespace WisdomRestaurant;
+
+static const char* kSelectDishes = "SELECT * FROM dishes";
+
+// 原来executeQuery的做法：每列转为std::string收集成矩阵，调用方再解析
+static std::vector<std::vector<std::string>> queryStrings(sqlite3_stmt* stmt) {
+    std::vector<std::vector<std::string>> rows;
+    sqlite3_reset(stmt);
+    int columns = sqlite3_column_count(stmt);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        std::vector<std::string> row;
+        for (int i = 0; i < columns; i++) {
+            const unsigned char* text = sqlite3_column_text(stmt, i);
+            row.push_back(text ? reinterpret_cast<const char*>(text) : "");
+        }
+        rows.push_back(row);
+    }
+    return rows;
+}
+
+static std::vector<Dish> loadDishesFromStrings(sqlite3_stmt* stmt) {
+    std::vector<Dish> dishes;
+    for (const auto& row : queryStrings(stmt)) {
+        Dish dish;
+        dish.id = std::stoi(row[0]);
+        dish.dish_code = row[1];
+        dish.dish_name = row[2];
+        dish.category_id = std::stoi(row[3]);
+        dish.price = std::stod(row[4]);
+        dish.original_price = std::stod(row[5]);
+        dish.description = row[6];
+        dish.ingredients = row[7];
+        dish.nutrition_info = row[8];
+        dish.taste_tags = row[9];
+        dish.allergen_info = row[10];
+        dish.cooking_time = std::stoi(row[11]);
+        dish.difficulty_level = row[12];
+        dish.image_url = row[13];
+        dish.images = row[14];
+        dish.is_recommended = (row[15] == "1");
+        dish.is_signature = (row[16] == "1");
+        dish.is_available = (row[17] == "1");
+        dish.stock_count = std::stoi(row[18]);
+        dish.sales_count = std::stoi(row[19]);
+        dish.rating = std::stod(row[20]);
+        dish.rating_count = std::stoi(row[21]);
+        dish.created_at = row[22];
+        dish.updated_at = row[23];
+        dishes.push_back(dish);
+    }
+    return dishes;
+}
+
+// 在示例数据的5道菜之外再插入500道，字段长度与真实菜单相近
+static bool seedDishes(sqlite3* connection) {
+    if (sqlite3_exec(connection, "BEGIN", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_prepare_v2(connection,
+        "INSERT INTO dishes (dish_code, dish_name, category_id, price, original_price, description, ingredients, "
+        "nutrition_info, taste_tags, allergen_info, cooking_time, difficulty_level, image_url, images, "
+        "is_recommended, is_signature) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)", -1, &stmt, nullptr);
+    for (int i = 0; i < 500; i++) {
+        std::string code = "B" + std::to_string(1000 + i);
+        std::string name = "招牌红烧肉" + std::to_string(i);
+        std::string image = "/images/dishes/" + code + ".jpg";
+        sqlite3_bind_text(stmt, 1, code.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 3, 1 + i % 6);
+        sqlite3_bind_double(stmt, 4, 28.0 + i % 40);
+        sqlite3_bind_double(stmt, 5, 32.0 + i % 40);
+        sqlite3_bind_text(stmt, 6, "精选五花肉，慢火炖煮两小时，肥而不腻，入口即化", -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 7, "五花肉、冰糖、生抽、老抽、八角", -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 8, "{\"calories\":520,\"protein\":18}", -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 9, "咸鲜,微甜", -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 10, "大豆", -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 11, 25);
+        sqlite3_bind_text(stmt, 12, "medium", -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 13, image.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 14, "[]", -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 15, i % 3 == 0);
+        sqlite3_bind_int(stmt, 16, i % 10 == 0);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            sqlite3_finalize(stmt);
+            return false;
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return sqlite3_exec(connection, "COMMIT", nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+int main() {
+    BenchSupport::quietLogs();
+    BenchSupport::printHeader("load the dishes table");
+
+    std::string path = BenchSupport::freshPath("row_mapping_bench.db");
+    RestaurantDb db;
+    if (!db.initialize(path)) {
+        std::fprintf(stderr, "数据库初始化失败\n");
+        return 1;
+    }
+    sqlite3* connection = nullptr;
+    if (sqlite3_open(path.c_str(), &connection) != SQLITE_OK || !seedDishes(connection)) {
+        std::fprintf(stderr, "写入测试菜品失败\n");
+        return 1;
+    }
+    sqlite3_stmt* select = nullptr;
+    sqlite3_prepare_v2(connection, kSelectDishes, -1, &select, nullptr);
+
+    const int iterations = 300;
+    size_t rows = 0;
+    BenchSupport::print("string matrix + stoi/stod", BenchSupport::measure(iterations, [&] {
+        rows = loadDishesFromStrings(select).size();
+    }));
+    std::printf("  %zu rows\n", rows);
+    BenchSupport::print("queryRows<Dish>", BenchSupport::measure(iterations, [&] {
+        rows = db.queryRows<Dish>(kSelectDishes).size();
+    }));
+    uint64_t total_sales = 0;
+    BenchSupport::print("forEachRow<Dish> (reused row)", BenchSupport::measure(iterations, [&] {
+        db.forEachRow<Dish>(kSelectDishes, {}, [&total_sales](const Dish& dish) {
+            total_sales += static_cast<uint64_t>(dish.sales_count);
+            return true;
+        });
+    }));
+
+    sqlite3_finalize(select);
+    sqlite3_close(connection);
+    return 0;
+}
@@ -0,0 +1,129 @@
+// 视觉请求体的构造和读取：原来拼接完整JSON字符串的方式 vs UploadBody按块读取
+// 图片为3MB原始二进制（multipart直传）或其base64文本，每次迭代相当于一次上游请求
+#include "BenchSupport.h"
+#include "ai/UploadBody.h"
+#include "common/Base64.h"
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include <curl/curl.h>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace WisdomRestaurant;
+
+// 原来的构造方式：图片拷贝进data URL，再进rapidjson Value，再序列化为完整的请求体字符串
+static std::string buildConcatenatedBody(const std::string& prompt, const std::string& image, bool is_base64) {
+    rapidjson::Document d;
+    d.SetObject();
+    auto& alloc = d.GetAllocator();
+    d.AddMember("model", "qwen-vl-max", alloc);
+    rapidjson::Value messages(rapidjson::kArrayType);
+    rapidjson::Value user(rapidjson::kObjectType);
+    user.AddMember("role", "user", alloc);
+    rapidjson::Value content(rapidjson::kArrayType);
+    rapidjson::Value text_part(rapidjson::kObjectType);
+    text_part.AddMember("type", "text", alloc);
+    text_part.AddMember("text", rapidjson::Value(prompt.c_str(), alloc), alloc);
+    content.PushBack(text_part, alloc);
+
+    rapidjson::Value image_part(rapidjson::kObjectType);
+    image_part.AddMember("type", "image_url", alloc);
+    rapidjson::Value image_url(rapidjson::kObjectType);
+    std::string data_url = "data:image/jpeg;base64,";
+    data_url.reserve(data_url.size() + (is_base64 ? image.size() : Base64::encodedLength(image.size())));
+    if (is_base64) {
+        data_url += image;
+    } else {
+        Base64::encodeAppend(image.data(), image.size(), data_url);
+    }
+    image_url.AddMember("url", rapidjson::Value(data_url.c_str(), alloc), alloc);
+    image_part.AddMember("image_url", image_url, alloc);
+    content.PushBack(image_part, alloc);
+    user.AddMember("content", content, alloc);
+    messages.PushBack(user, alloc);
+    d.AddMember("messages", messages, alloc);
+    d.AddMember("max_tokens", 2048, alloc);
+    d.AddMember("temperature", 0.7, alloc);
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    d.Accept(writer);
+    return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+// 与AiService相同：图片之前和之后的JSON预先序列化，图片部分留给UploadBody
+static void buildPrefixSuffix(const std::string& prompt, std::string& prefix, std::string& suffix) {
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("model");
+    writer.String("qwen-vl-max");
+    writer.Key("messages");
+    writer.StartArray();
+    writer.StartObject();
+    writer.Key("role");
+    writer.String("user");
+    writer.Key("content");
+    writer.StartArray();
+    writer.StartObject();
+    writer.Key("type");
+    writer.String("text");
+    writer.Key("text");
+    writer.String(prompt.c_str(), static_cast<rapidjson::SizeType>(prompt.size()));
+    writer.EndObject();
+    writer.Flush();
+    prefix.assign(buffer.GetString(), buffer.GetSize());
+    prefix += ",{\"type\":\"image_url\",\"image_url\":{\"url\":\"data:image/jpeg;base64,";
+    suffix = "\"}}]}],\"max_tokens\":2048,\"temperature\":0.7}";
+}
+
+int main() {
+    BenchSupport::quietLogs();
+    BenchSupport::printHeader("vision upload body");
+
+    std::string prompt;
+    while (prompt.size() < 1200) {
+        prompt += "请分析图片中顾客的人数、年龄段、性别和体型，以JSON格式返回。";
+    }
+    std::string raw(3 * 1024 * 1024, '\0');
+    std::mt19937 random(7);
+    for (char& c : raw) {
+        c = static_cast<char>(random());
+    }
+    std::string base64 = Base64::encode(raw);
+    std::vector<char> curl_buffer(CURL_MAX_WRITE_SIZE);   // libcurl每次读取的块大小
+
+    const int iterations = 40;
+    for (bool is_base64 : {false, true}) {
+        const std::string& image = is_base64 ? base64 : raw;
+        const char* kind = is_base64 ? "base64 4MB" : "binary 3MB";
+        size_t sent = 0;
+
+        BenchSupport::Result concatenated = BenchSupport::measure(iterations, [&] {
+            std::string body = buildConcatenatedBody(prompt, image, is_base64);
+            for (size_t offset = 0; offset < body.size(); offset += curl_buffer.size()) {
+                size_t n = std::min(curl_buffer.size(), body.size() - offset);
+                std::memcpy(curl_buffer.data(), body.data() + offset, n);
+            }
+            sent = body.size();
+        });
+        BenchSupport::print(std::string("concatenated body, ") + kind, concatenated);
+
+        size_t buffered = 0;
+        BenchSupport::Result streamed = BenchSupport::measure(iterations, [&] {
+            std::string prefix, suffix;
+            buildPrefixSuffix(prompt, prefix, suffix);
+            UploadBody body(std::move(prefix), &image, is_base64, std::move(suffix));
+            while (UploadBody::ReadCallback(curl_buffer.data(), 1, curl_buffer.size(), &body) > 0) {
+            }
+            sent = body.size();
+            buffered = body.bufferedBytes();
+        });
+        BenchSupport::print(std::string("UploadBody, ") + kind, streamed);
+        std::printf("  request body %zu bytes, UploadBody buffers %zu bytes besides the image\n", sent, buffered);
+    }
+    return 0;
+}
@@ -3,10 +3,14 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <functional>
 #include <curl/curl.h>
 #include <rapidjson/document.h>
 #include <rapidjson/writer.h>
 #include <rapidjson/stringbuffer.h>
+#include "ai/CurlHandlePool.h"
+#include "ai/UploadBody.h"
+#include <atomic>
 
 namespace WisdomRestaurant {
 
@@ -17,6 +21,15 @@ struct CustomerPortrait {
     std::string body_type;     // 体型：瘦、标准、胖
 };
 
+// 顾客图片：base64文本或原始二进制（multipart/图片直传），原始二进制只在构造上游请求时编码一次
+struct CustomerImage {
+    std::string data;
+    bool is_base64 = true;
+    std::string mime_type = "image/png";
+
+    bool empty() const { return data.empty(); }
+};
+
 // 视觉识别结果
 struct VisionResult {
     int people_num;
@@ -42,6 +55,34 @@ struct RecommendationResult {
     std::string error_message;
 };
 
+// 视觉识别+推荐的结果（合并模式一次请求同时返回两者）
+struct CombinedResult {
+    VisionResult vision;
+    RecommendationResult recommendation;
+};
+
+// 推荐流程执行模式
+enum class PipelineMode {
+    TwoStage,   // 先调用视觉模型识别画像，再调用文本模型推荐
+    Combined    // 一次视觉模型请求同时返回画像和推荐
+};
+
+// 解析执行模式名称（two_stage/combined），无法识别时返回false
+bool parsePipelineMode(const std::string& name, PipelineMode& mode);
+
+// 执行模式名称
+const char* pipelineModeName(PipelineMode mode);
+
+// 上游请求体统计信息
+struct UploadStats {
+    uint64_t requests;         // 上游请求数
+    uint64_t bytes_sent;       // 发送的请求体总字节数
+    uint64_t bytes_buffered;   // 为组装请求体额外分配的字节数
+};
+
+class RecommendationCache;
+struct RecommendationCacheStats;
+
 class AiService {
 public:
     AiService();
@@ -51,42 +92,154 @@ public:
     bool initialize();
 
     // 第一阶段：视觉理解 - 分析图片获取客户画像
-    VisionResult analyzeCustomerImage(const std::string& image_base64);
+    // base64字符串按右值接收并移入CustomerImage，不复制图片
+    VisionResult analyzeCustomerImage(std::string&& image_base64);
+    VisionResult analyzeCustomerImage(const CustomerImage& image);
 
     // 第二阶段：智能推荐 - 基于客户画像推荐菜品
     RecommendationResult recommendDishes(const VisionResult& vision_result, 
                                        const std::string& season = "春季",
                                        const std::string& meal_time = "午餐");
 
+    // 合并模式：一次视觉大模型请求同时完成客户画像识别和菜品推荐
+    CombinedResult analyzeAndRecommend(const CustomerImage& image,
+                                       const std::string& season,
+                                       const std::string& meal_time);
+
+    // 流式推荐：以stream模式调用文本大模型，每解析出一道完整的菜品就回调一次
+    // 回调返回false时中止上游请求（例如客户端已断开）
+    RecommendationResult recommendDishesStream(const VisionResult& vision_result,
+                                               const std::string& season,
+                                               const std::string& meal_time,
+                                               const std::function<bool(const DishRecommendation&)>& on_dish);
+
+    // 获取CURL连接池统计信息
+    CurlPoolStats getCurlPoolStats() const;
+
+    // 获取上游请求体统计信息
+    UploadStats getUploadStats() const;
+
+    // 菜单变更时递增版本号，旧版本的推荐缓存随之失效
+    void setMenuVersion(uint64_t version);
+
+    // 获取推荐结果缓存统计信息
+    RecommendationCacheStats getRecommendationCacheStats() const;
+
+    // 热销菜品来源：按季节和用餐时段返回近期热销的菜名，写入推荐提示词供模型参考（需在开始服务前设置）
+    using PopularDishesProvider = std::function<std::vector<std::string>(const std::string& season,
+                                                                         const std::string& meal_time)>;
+    void setPopularDishesProvider(PopularDishesProvider provider) { popular_dishes_provider_ = std::move(provider); }
+
+    // 售罄版本来源：有菜品售罄或恢复可售时返回值变化，旧版本的推荐缓存随之失效（需在开始服务前设置）
+    using SoldOutVersionProvider = std::function<uint64_t()>;
+    void setSoldOutVersionProvider(SoldOutVersionProvider provider) { sold_out_version_provider_ = std::move(provider); }
+
 private:
-    // 调用大模型API的通用方法
-    std::string callLLMAPI(const std::string& prompt, const std::string& image_base64 = "");
+    // 不经缓存直接调用文本大模型生成推荐
+    RecommendationResult generateRecommendation(const VisionResult& vision_result,
+                                                const std::string& season,
+                                                const std::string& meal_time,
+                                                const std::string& popular_line);
+
+    // 调用大模型API的通用方法，call为指标中的调用类型
+    std::string callLLMAPI(const std::string& prompt, const CustomerImage& image, const char* call);
     
     // 调用纯文本大模型API
     std::string callTextLLMAPI(const std::string& prompt);
 
+    // 构建纯文本大模型请求体
+    std::string buildTextRequestBody(const std::string& prompt, bool stream);
+
+    // 构建视觉大模型请求体：图片数据不复制，由UploadBody在发送时直接读取
+    UploadBody buildVisionRequestBody(const std::string& prompt, const CustomerImage& image);
+
+    // 通过连接池发送请求，返回原始响应体；耗时和状态码按call记录到指标
+    std::string performRequest(UploadBody& body, const char* call);
+
+    // 设置请求头、请求体等通用CURL选项，返回需由调用方释放的请求头
+    struct curl_slist* prepareRequest(CURL* curl, UploadBody& body, bool stream);
+
+    // 流式响应的解析状态
+    struct StreamState {
+        std::string line_buffer;    // 尚未遇到换行符的SSE数据
+        std::string content;        // 已累计的模型输出文本
+        size_t scan_pos = 0;        // content中已扫描到的位置
+        int depth = 0;              // 当前JSON嵌套深度
+        bool in_string = false;
+        bool escaped = false;
+        size_t object_start = std::string::npos;
+        bool finished = false;      // 收到[DONE]
+        bool aborted = false;       // 回调要求中止
+        std::vector<DishRecommendation> dishes;
+        const std::function<bool(const DishRecommendation&)>* on_dish = nullptr;
+    };
+
+    // 以SSE流式方式发送请求，返回是否成功
+    bool performStreamingRequest(UploadBody& body, StreamState& state, const char* call);
+
+    // 处理一行SSE数据
+    static void handleStreamLine(const std::string& line, StreamState& state);
+
+    // 增量扫描模型输出，提取已完整的菜品对象
+    static void scanStreamContent(StreamState& state);
+
+    // 解析单个菜品对象
+    static bool parseDishRecommendation(const rapidjson::Value& dish, DishRecommendation& dr);
+
+    // 从响应中提取choices[0].message.content
+    std::string extractAnswer(const std::string& response);
+
     // 解析视觉识别结果
     VisionResult parseVisionResult(const std::string& response);
 
+    // 从JSON对象中读取人数和客户画像
+    static void parseVisionFields(const rapidjson::Value& doc, VisionResult& result);
+
     // 解析推荐结果
     RecommendationResult parseRecommendationResult(const std::string& response);
 
+    // 解析合并模式的结果
+    CombinedResult parseCombinedResult(const std::string& response);
+
+    // 当前菜单版本和售罄版本下的推荐缓存key
+    std::string makeCacheKey(const VisionResult& vision_result, const std::string& season,
+                             const std::string& meal_time, const std::string& popular_line) const;
+
+    // 提示词中的热销菜品行，没有数据时为空
+    std::string buildPopularDishesLine(const std::string& season, const std::string& meal_time);
+
     // 构建视觉识别提示词
     std::string buildVisionPrompt();
 
-    // 构建推荐提示词
+    // 构建合并模式提示词，popular_line为buildPopularDishesLine的结果
+    std::string buildCombinedPrompt(const std::string& season, const std::string& meal_time,
+                                    const std::string& popular_line);
+
+    // 构建推荐提示词，popular_line为buildPopularDishesLine的结果
     std::string buildRecommendationPrompt(const VisionResult& vision_result,
                                         const std::string& season,
-                                        const std::string& meal_time);
+                                        const std::string& meal_time,
+                                        const std::string& popular_line);
 
     // CURL写回调函数
     static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp);
 
+    // CURL流式写回调函数
+    static size_t StreamWriteCallback(void* contents, size_t size, size_t nmemb, void* userp);
+
 private:
     std::string api_key_;
     std::string vision_model_;     // 视觉模型名称
     std::string text_model_;       // 文本模型名称
     std::string api_endpoint_;     // API端点
+    std::unique_ptr<CurlHandlePool> curl_pool_;  // 复用的CURL句柄池
+    std::atomic<uint64_t> upload_requests_;
+    std::atomic<uint64_t> upload_bytes_sent_;
+    std::atomic<uint64_t> upload_bytes_buffered_;
+    std::unique_ptr<RecommendationCache> rec_cache_;  // 推荐结果缓存，为空表示禁用
+    std::atomic<uint64_t> menu_version_;
+    PopularDishesProvider popular_dishes_provider_;
+    SoldOutVersionProvider sold_out_version_provider_;
     bool initialized_;
 };
 
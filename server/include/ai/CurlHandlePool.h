@@ -0,0 +1,88 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace WisdomRestaurant {
+
+// CURL连接池统计信息
+struct CurlPoolStats {
+    uint64_t hits;                 // 复用空闲句柄次数
+    uint64_t misses;               // 新建句柄次数
+    uint64_t new_connections;      // 新建TCP连接次数
+    uint64_t reused_connections;   // 复用已有连接的请求次数
+    double handshake_ms_total;     // TCP+TLS握手累计耗时（毫秒）
+    size_t idle_handles;           // 当前空闲句柄数
+};
+
+// 可复用的CURL easy句柄池
+// 句柄归还时只做curl_easy_reset，保留各自的连接缓存；DNS缓存和TLS会话通过CURLSH在句柄间共享
+class CurlHandlePool {
+public:
+    // 借出的句柄，析构时自动归还到池中
+    class Lease {
+    public:
+        Lease(CurlHandlePool* pool, CURL* handle);
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&&) = delete;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease();
+
+        CURL* get() const { return handle_; }
+        explicit operator bool() const { return handle_ != nullptr; }
+
+    private:
+        CurlHandlePool* pool_;
+        CURL* handle_;
+    };
+
+    explicit CurlHandlePool(size_t max_idle_handles = 8);
+    ~CurlHandlePool();
+
+    // 创建共享缓存（需在curl_global_init之后调用）
+    bool initialize();
+
+    // 借出一个句柄，已绑定共享缓存
+    Lease acquire();
+
+    // 预建立到目标地址的连接，返回成功预热的句柄数
+    // 所有句柄共用budget作为总时限，遇到第一次失败即停止，端点不可达时不会拖慢启动
+    size_t warmup(const std::string& url, size_t count,
+                  std::chrono::milliseconds budget = std::chrono::milliseconds(3000));
+
+    // 请求完成后记录连接复用与握手耗时
+    void recordTransfer(CURL* handle);
+
+    CurlPoolStats getStats() const;
+
+private:
+    static constexpr std::chrono::milliseconds kWarmupConnectTimeout{1500};
+
+    void release(CURL* handle);
+    void configureHandle(CURL* handle);
+
+    static void lockCallback(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr);
+    static void unlockCallback(CURL* handle, curl_lock_data data, void* userptr);
+
+private:
+    size_t max_idle_handles_;
+    CURLSH* share_;
+    std::mutex share_mutexes_[CURL_LOCK_DATA_LAST];
+
+    mutable std::mutex pool_mutex_;
+    std::vector<CURL*> idle_handles_;
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> new_connections_;
+    std::atomic<uint64_t> reused_connections_;
+    std::atomic<uint64_t> handshake_us_total_;
+};
+
+} // namespace WisdomRestaurant
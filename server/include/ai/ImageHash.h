@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ai/AiService.h"
+#include <cstdint>
+
+namespace WisdomRestaurant {
+namespace ImageHash {
+
+// 计算图片的64位差值哈希(dHash)：缩小为9x8灰度图，比较相邻像素的明暗
+// 目前只支持JPEG（编译时未找到libjpeg或图片无法解码时返回false）
+bool computeDHash(const CustomerImage& image, uint64_t& hash);
+
+// 两个哈希之间不同的位数
+inline int hammingDistance(uint64_t a, uint64_t b) {
+    return __builtin_popcountll(a ^ b);
+}
+
+} // namespace ImageHash
+} // namespace WisdomRestaurant
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "ai/AiService.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace WisdomRestaurant {
+
+// 推荐结果缓存统计信息
+struct RecommendationCacheStats {
+    uint64_t hits;          // 命中次数
+    uint64_t misses;        // 未命中并调用大模型的次数
+    uint64_t coalesced;     // 并发未命中时合并等待的次数
+    uint64_t evictions;     // LRU淘汰次数
+    uint64_t expirations;   // 过期淘汰次数
+    size_t entries;         // 当前缓存条目数
+};
+
+// 推荐结果缓存
+// 推荐提示词只取决于客户画像、季节、用餐时间等少量分类参数，相同参数的结果在TTL内复用；
+// 容量满时按LRU淘汰，同一key的并发未命中只调用一次大模型
+class RecommendationCache {
+public:
+    RecommendationCache(size_t max_entries, std::chrono::seconds ttl);
+
+    // 由推荐提示词的输入参数生成规范化的缓存key；popular_line是提示词中的热销菜品行，
+    // 热销排行、菜单或售罄情况变化后不再命中旧结果
+    static std::string makeKey(const VisionResult& vision_result,
+                               const std::string& season,
+                               const std::string& meal_time,
+                               uint64_t menu_version,
+                               uint64_t sold_out_version,
+                               const std::string& popular_line);
+
+    // 命中时直接返回；未命中时由第一个调用方执行loader，其他并发调用方等待同一结果
+    // 只有成功且推荐列表非空的结果会被缓存
+    RecommendationResult getOrLoad(const std::string& key,
+                                   const std::function<RecommendationResult()>& loader);
+
+    // 只查询不加载
+    std::optional<RecommendationResult> lookup(const std::string& key);
+
+    // 写入缓存，失败或推荐列表为空的结果不缓存
+    void put(const std::string& key, const RecommendationResult& result);
+
+    // 清空缓存
+    void clear();
+
+    RecommendationCacheStats getStats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        RecommendationResult result;
+        std::chrono::steady_clock::time_point expires_at;
+    };
+    using EntryList = std::list<Entry>;
+
+    // 调用方需持有mutex_
+    std::optional<RecommendationResult> lookupLocked(const std::string& key);
+    void putLocked(const std::string& key, const RecommendationResult& result);
+
+private:
+    size_t max_entries_;
+    std::chrono::seconds ttl_;
+
+    mutable std::mutex mutex_;
+    EntryList lru_;                                             // 头部为最近使用
+    std::unordered_map<std::string, EntryList::iterator> index_;
+    std::unordered_map<std::string, std::shared_future<RecommendationResult>> in_flight_;
+
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t coalesced_;
+    uint64_t evictions_;
+    uint64_t expirations_;
+};
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <cstddef>
+#include <string>
+
+namespace WisdomRestaurant {
+
+// 上游请求体：预先序列化的JSON前缀 + 图片数据 + JSON后缀
+// 图片直接从请求缓冲区读取，不再拼接成完整的请求体；原始二进制在读取时按块编码为base64
+class UploadBody {
+public:
+    // 不含图片的普通请求体
+    explicit UploadBody(std::string body);
+
+    // 含图片的请求体，image必须在上传结束前保持有效
+    UploadBody(std::string prefix, const std::string* image, bool image_is_base64, std::string suffix);
+
+    // 请求体总长度
+    size_t size() const;
+
+    // 本请求额外分配的字节数（前缀与后缀）
+    size_t bufferedBytes() const { return prefix_.size() + suffix_.size(); }
+
+    // 读取下一段数据，返回写入的字节数，0表示结束
+    size_t read(char* buffer, size_t length);
+
+    // 回到开头（CURL重发请求时使用）
+    void rewind();
+
+    // CURL读/定位回调
+    static size_t ReadCallback(char* buffer, size_t size, size_t nitems, void* userp);
+    static int SeekCallback(void* userp, curl_off_t offset, int origin);
+
+private:
+    size_t readImage(char* buffer, size_t length);
+
+private:
+    std::string prefix_;
+    const std::string* image_;
+    bool image_is_base64_;
+    std::string suffix_;
+
+    size_t position_;          // 已输出的总字节数
+    size_t image_offset_;      // 已读取的图片原始字节数
+    char pending_[4];          // 缓冲区不足4字节时暂存的编码结果
+    size_t pending_size_;
+    size_t pending_offset_;
+};
+
+} // namespace WisdomRestaurant
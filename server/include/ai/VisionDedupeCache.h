@@ -0,0 +1,63 @@
+#pragma once
+
+#include "ai/AiService.h"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace WisdomRestaurant {
+
+// 画面去重统计信息
+struct VisionDedupeStats {
+    uint64_t lookups;           // 可计算哈希的查询次数
+    uint64_t hits;              // 命中次数（跳过视觉大模型）
+    uint64_t misses;            // 未命中次数
+    uint64_t unhashable;        // 无法计算哈希的图片数（非JPEG或解码失败）
+    double saved_ms_total;      // 命中时省下的视觉大模型耗时累计（毫秒）
+    size_t entries;             // 当前缓存条目数
+};
+
+// 按餐桌缓存最近画面的感知哈希和视觉识别结果
+// 同一桌摄像头反复上传几乎相同的画面时，汉明距离不超过阈值即复用上次的识别结果
+class VisionDedupeCache {
+public:
+    VisionDedupeCache(int max_distance, std::chrono::seconds ttl, size_t max_per_table);
+
+    // 查找与hash足够接近且未过期的识别结果
+    std::optional<VisionResult> find(const std::string& table_number, uint64_t hash);
+
+    // 保存识别结果，elapsed_ms为本次视觉大模型的耗时，后续命中时计入节省时间
+    void store(const std::string& table_number, uint64_t hash, const VisionResult& result, double elapsed_ms);
+
+    // 记录一次无法计算哈希的图片
+    void recordUnhashable();
+
+    VisionDedupeStats getStats() const;
+
+private:
+    struct Entry {
+        uint64_t hash;
+        VisionResult result;
+        double elapsed_ms;
+        std::chrono::steady_clock::time_point expires_at;
+    };
+
+    int max_distance_;
+    std::chrono::seconds ttl_;
+    size_t max_per_table_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::deque<Entry>> tables_;  // 每桌最新的在队头
+
+    uint64_t lookups_;
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t unhashable_;
+    double saved_ms_total_;
+};
+
+} // namespace WisdomRestaurant
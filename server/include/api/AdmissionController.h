@@ -0,0 +1,113 @@
+#pragma once
+
+#include "httplib.h"
+#include "common/JobExecutor.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace WisdomRestaurant {
+
+// 请求优先级：服务员操作和健康检查优先于摄像头推荐
+enum class RequestPriority {
+    Critical = 0,   // 健康检查、服务呼叫、餐桌状态、心跳，始终可以使用保留线程
+    Normal = 1,     // 菜单查询、推荐结果查询等
+    Bulk = 2        // 摄像头图片上传和推荐
+};
+
+const char* requestPriorityName(RequestPriority priority);
+
+// HTTP工作线程池和准入控制配置
+struct AdmissionOptions {
+    size_t workers = 8;               // 处理连接的工作线程数
+    size_t max_queued = 64;           // 等待工作线程的连接数上限，超出后进入快速拒绝通道
+    size_t reserved_workers = 2;      // 只留给Critical请求的线程数
+    size_t bulk_max_inflight = 0;     // 同时处理的Bulk请求上限，0表示工作线程数的一半
+    size_t shed_workers = 2;          // 快速拒绝通道的线程数
+    size_t shed_queue_size = 256;     // 快速拒绝通道的排队上限，再超出直接断开连接
+    int retry_after_seconds = 2;      // 503响应的Retry-After
+};
+
+// 准入控制统计信息
+struct AdmissionStats {
+    size_t workers;
+    size_t queue_depth;               // 正在等待工作线程的连接数
+    size_t max_queue_depth;           // 历史最大排队数
+    size_t max_queued;
+    uint64_t connections_accepted;    // 进入工作线程池的连接数
+    uint64_t connections_shed;        // 队列满时转入快速拒绝通道的连接数
+    uint64_t connections_dropped;     // 快速拒绝通道也满时直接断开的连接数
+    std::array<size_t, 3> inflight;   // 各优先级正在处理的请求数
+    std::array<uint64_t, 3> admitted; // 各优先级已放行的请求数
+    std::array<uint64_t, 3> shed;     // 各优先级被503拒绝的请求数
+};
+
+// HTTP准入控制
+// 连接先进入有界的工作线程池；池满时连接转给快速拒绝通道，只处理Critical请求，其余读完请求头即返回503。
+// 快速拒绝通道同样按连接占用线程，迟迟不发请求的空闲连接最多占用keep-alive超时时长。
+// 进入工作线程后按路由优先级限制并发：Bulk请求最多占用bulk_max_inflight个线程，
+// Normal和Bulk合计最多占用workers - reserved_workers个线程，剩余线程留给Critical请求
+class AdmissionController {
+public:
+    explicit AdmissionController(const AdmissionOptions& options);
+    ~AdmissionController();
+
+    // 设置路由优先级，按路径前缀匹配，最长前缀优先；method为空表示匹配所有方法
+    // 未匹配的路由为Normal，OPTIONS预检请求始终为Critical
+    void setRoutePriority(const std::string& method, const std::string& path_prefix, RequestPriority priority);
+
+    RequestPriority classify(const httplib::Request& request) const;
+
+    // 供httplib::Server::new_task_queue使用，返回的队列由httplib负责释放
+    httplib::TaskQueue* newTaskQueue();
+
+    // 在pre-routing中调用：放行时返回true，拒绝时已写好503响应并返回false
+    bool admit(const httplib::Request& request, httplib::Response& response);
+
+    // 响应写完后调用，释放当前请求占用的并发额度
+    void release();
+
+    AdmissionStats getStats() const;
+
+    const AdmissionOptions& options() const { return options_; }
+
+    // 实际生效的Bulk并发上限
+    size_t bulkLimit() const { return bulk_limit_; }
+
+private:
+    class TaskQueue;
+
+    struct RouteRule {
+        std::string method;
+        std::string path_prefix;
+        RequestPriority priority;
+    };
+
+    bool tryAcquire(RequestPriority priority);
+    void reject(RequestPriority priority, httplib::Response& response);
+
+private:
+    AdmissionOptions options_;
+    size_t normal_limit_;
+    size_t bulk_limit_;
+
+    std::vector<RouteRule> routes_;
+
+    std::atomic<size_t> normal_and_bulk_inflight_;
+    std::array<std::atomic<size_t>, 3> inflight_;
+    std::array<std::atomic<uint64_t>, 3> admitted_;
+    std::array<std::atomic<uint64_t>, 3> shed_;
+
+    // 当前监听使用的线程池，由newTaskQueue创建
+    mutable std::mutex lanes_mutex_;
+    std::shared_ptr<JobExecutor> workers_;
+    std::shared_ptr<JobExecutor> shed_lane_;
+    std::atomic<uint64_t> connections_shed_;
+    std::atomic<uint64_t> connections_dropped_;
+};
+
+} // namespace WisdomRestaurant
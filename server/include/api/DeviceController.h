@@ -0,0 +1,62 @@
+#pragma once
+
+#include "httplib.h"
+#include "rapidjson/document.h"
+#include "db/RestaurantDb.h"
+#include "db/HeartbeatStore.h"
+#include "db/EnvironmentSeries.h"
+#include "common/JsonResponse.h"
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace WisdomRestaurant {
+
+// 餐桌终端相关接口：心跳上报、活跃客户端查询和环境数据
+class DeviceController {
+public:
+    DeviceController(std::shared_ptr<RestaurantDb> db, std::shared_ptr<HeartbeatStore> heartbeats);
+
+    // 处理客户端心跳，只更新内存中的心跳状态表
+    void handleHeartbeat(const httplib::Request& request, httplib::Response& response);
+
+    // 处理活跃客户端查询（支持timeout和table_number参数）
+    void handleGetActiveClients(const httplib::Request& request, httplib::Response& response);
+
+    // 处理环境数据上报（单个样本或samples数组）
+    void handleEnvironmentReport(const httplib::Request& request, httplib::Response& response);
+
+    // 处理环境数据范围查询（支持hours或from/to、resolution、metrics参数）
+    void handleGetEnvironment(const httplib::Request& request, httplib::Response& response);
+
+    // 设置环境时序存储，为空时心跳中的传感器数据只保留最新值
+    void setEnvironmentSeries(std::shared_ptr<EnvironmentSeries> series) { environment_ = series; }
+
+    // 建议终端的心跳间隔（秒），随心跳响应下发
+    void setHeartbeatInterval(int seconds) { heartbeat_interval_ = seconds; }
+
+private:
+    // 从JSON对象读取传感器数据，没有任何传感器字段时返回false
+    static bool readEnvironmentSample(const rapidjson::Value& value, int64_t default_timestamp,
+                                      EnvironmentSample& sample);
+
+    // 餐桌号转换为餐桌ID；餐桌很少变动，查到后缓存，心跳不再每次查库
+    std::optional<int> resolveTableId(const std::string& table_number);
+
+    // 餐桌ID转换为餐桌号，同样缓存
+    std::string tableNumberOf(int table_id);
+
+private:
+    std::shared_ptr<RestaurantDb> db_;
+    std::shared_ptr<HeartbeatStore> heartbeats_;
+    std::shared_ptr<EnvironmentSeries> environment_;
+    int heartbeat_interval_;
+
+    mutable std::mutex tables_mutex_;
+    std::unordered_map<std::string, int> table_ids_;       // 餐桌号 -> 餐桌ID
+    std::unordered_map<int, std::string> table_numbers_;   // 餐桌ID -> 餐桌号
+};
+
+} // namespace WisdomRestaurant
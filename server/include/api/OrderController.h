@@ -0,0 +1,47 @@
+#pragma once
+
+#include "httplib.h"
+#include "rapidjson/document.h"
+#include "db/RestaurantDb.h"
+#include "db/InventoryManager.h"
+#include "common/JsonResponse.h"
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace WisdomRestaurant {
+
+// 下单和库存接口：库存由InventoryManager在内存中预留和扣减，不逐次访问数据库
+class OrderController {
+public:
+    OrderController(std::shared_ptr<RestaurantDb> db, std::shared_ptr<InventoryManager> inventory);
+
+    // 处理下单请求（可带reservation_id结算购物车预留）
+    void handleCreateOrder(const httplib::Request& request, httplib::Response& response);
+
+    // 处理实时库存查询
+    void handleGetInventory(const httplib::Request& request, httplib::Response& response);
+
+    // 处理库存设置
+    void handleSetStock(const httplib::Request& request, httplib::Response& response);
+
+    // 处理库存预留（购物车占用库存）
+    void handleReserve(const httplib::Request& request, httplib::Response& response);
+
+    // 处理预留释放
+    void handleRelease(const httplib::Request& request, httplib::Response& response);
+
+private:
+    // 读取items数组中的(dish_id, quantity)，格式不正确时返回false
+    static bool readQuantities(const rapidjson::Value& items, std::vector<std::pair<int, int>>& quantities);
+
+    // 库存预留或下单失败时的响应
+    void sendInventoryError(httplib::Response& response, const InventoryResult& result);
+
+private:
+    std::shared_ptr<RestaurantDb> db_;
+    std::shared_ptr<InventoryManager> inventory_;
+};
+
+} // namespace WisdomRestaurant
@@ -5,20 +5,78 @@
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
 #include "ai/AiService.h"
+#include "ai/VisionDedupeCache.h"
 #include "db/RestaurantDb.h"
+#include "db/RecommendationWriter.h"
+#include "db/PopularityTracker.h"
+#include "db/InventoryManager.h"
+#include "common/JobExecutor.h"
+#include "common/JsonResponse.h"
+#include "common/LatencyHistogram.h"
+#include "common/Metrics.h"
+#include "common/RequestTrace.h"
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 namespace WisdomRestaurant {
 
+// 推荐请求参数
+struct RecommendationRequest {
+    CustomerImage image;       // JSON请求为base64，multipart/图片直传为原始二进制
+    std::string table_number;
+    std::string user_id;
+    std::string season;
+    std::string meal_time;
+    bool async = false;        // 是否异步执行，立即返回session_id
+    std::string pipeline_mode; // two_stage或combined，为空时使用服务端默认模式
+    PipelineMode pipeline = PipelineMode::TwoStage;  // 解析后的执行模式
+};
+
+// 推荐流程的执行结果（HTTP状态码和响应体）
+struct RecommendationOutcome {
+    int status;
+    std::string body;
+};
+
+// 异步推荐任务
+struct RecommendationJob {
+    enum class State { Pending, Running, Done };
+
+    std::string session_id;
+    State state = State::Pending;
+    RecommendationOutcome outcome;
+    std::chrono::steady_clock::time_point finished_at;
+};
+
+// 异步推荐结果长轮询统计
+struct LongPollStats {
+    int waiting;          // 正在等待的长轮询数
+    int max_waiting;      // 同时等待的上限
+    uint64_t rejected;    // 因达到上限而立即返回的长轮询数
+};
+
 class RecommendationController {
 public:
+    // job_executor为空时不支持异步推荐，所有请求同步执行
     RecommendationController(std::shared_ptr<AiService> ai_service, 
-                           std::shared_ptr<RestaurantDb> db);
+                           std::shared_ptr<RestaurantDb> db,
+                           std::shared_ptr<JobExecutor> job_executor = nullptr);
     ~RecommendationController();
 
-    // 处理智能推荐请求
-    void handleRecommendation(const httplib::Request& request, httplib::Response& response);
+    // 处理智能推荐请求（支持JSON、multipart/form-data和图片直传三种请求体）
+    void handleRecommendation(const httplib::Request& request, httplib::Response& response,
+                              const httplib::ContentReader& content_reader);
+
+    // 处理流式推荐请求，以Server-Sent Events逐道推送菜品
+    void handleRecommendationStream(const httplib::Request& request, httplib::Response& response,
+                                    const httplib::ContentReader& content_reader);
+
+    // 处理获取异步推荐结果请求（支持wait参数长轮询）
+    void handleGetRecommendationResult(const httplib::Request& request, httplib::Response& response);
     
     // 处理获取推荐历史请求
     void handleGetRecommendationHistory(const httplib::Request& request, httplib::Response& response);
@@ -26,36 +84,134 @@ public:
     // 处理推荐反馈请求
     void handleRecommendationFeedback(const httplib::Request& request, httplib::Response& response);
     
-    // 处理获取推荐菜品请求
+    // 处理获取推荐菜品请求（支持ETag/If-None-Match条件请求）
     void handleGetRecommendedDishes(const httplib::Request& request, httplib::Response& response);
 
+    // 处理菜单增量同步请求，返回since版本之后新增、变化和下架的菜品
+    void handleGetDishChanges(const httplib::Request& request, httplib::Response& response);
+
+    // 处理热销菜品查询（支持window、meal_time、season和limit参数）
+    void handleGetPopularDishes(const httplib::Request& request, httplib::Response& response);
+
+    // 设置上传图片的大小上限（字节），接收过程中超出即拒绝
+    void setMaxImageSize(size_t max_image_size) { max_image_size_ = max_image_size; }
+
+    // 设置画面去重缓存，为空时每帧都调用视觉大模型
+    void setVisionDedupeCache(std::shared_ptr<VisionDedupeCache> cache) { vision_dedupe_ = cache; }
+
+    // 设置推荐记录写入队列，为空时在请求线程同步写入
+    void setRecommendationWriter(std::shared_ptr<RecommendationWriter> writer) { rec_writer_ = writer; }
+
+    // 设置热销统计，为空时热销菜品接口不可用
+    void setPopularityTracker(std::shared_ptr<PopularityTracker> tracker) { popularity_ = tracker; }
+
+    // 设置库存管理，菜单响应中的库存和售罄状态取实时值
+    void setInventory(std::shared_ptr<InventoryManager> inventory) { inventory_ = inventory; }
+
+    // 获取画面去重统计信息
+    VisionDedupeStats getVisionDedupeStats() const;
+
+    // 设置默认的推荐执行模式
+    void setDefaultPipelineMode(PipelineMode mode) { default_pipeline_mode_ = mode; }
+
+    // 设置同时等待的长轮询上限，超出时立即返回当前状态
+    void setMaxWaitingPolls(int max_waiting_polls);
+
+    LongPollStats getLongPollStats() const;
+
+    // 获取指定执行模式的视觉识别+推荐耗时分布
+    LatencySummary getPipelineLatency(PipelineMode mode) const;
+
 private:
+    // 边接收边校验大小地读取请求体，失败时返回false并给出HTTP状态码和错误信息
+    bool readRecommendationRequest(const httplib::Request& request, const httplib::ContentReader& content_reader,
+                                   RecommendationRequest& rec_request, int& error_status, std::string& error_message);
+
     // 解析推荐请求参数
-    bool parseRecommendationRequest(const std::string& body, std::string& image_base64, 
-                                   std::string& table_number, std::string& user_id, 
-                                   std::string& season, std::string& meal_time);
+    bool parseRecommendationRequest(const std::string& body, RecommendationRequest& rec_request);
+
+    // 视觉识别：同桌画面与近期画面足够相似时复用上次结果
+    // 合并模式下同一次请求一并生成推荐并写入recommendation，否则recommendation.success为false
+    VisionResult analyzeCustomer(const RecommendationRequest& rec_request, RecommendationResult& recommendation);
+
+    // 执行视觉识别、推荐和保存记录，返回完整响应
+    RecommendationOutcome runRecommendation(const RecommendationRequest& rec_request,
+                                            const Table& table, const std::string& session_id);
+
+    // 解析、校验请求并查询餐桌；失败时已写好错误响应并返回false
+    bool prepareRecommendation(const httplib::Request& request, const httplib::ContentReader& content_reader,
+                               httplib::Response& response, RecommendationRequest& rec_request, Table& table);
+
+    // 保存推荐记录到数据库
+    void saveRecommendationRecord(const RecommendationRequest& rec_request, const Table& table,
+                                  const std::string& session_id, const VisionResult& vision_result,
+                                  const RecommendationResult& recommendation_result, int processing_time);
+
+    // 提交异步推荐任务，请求移入任务；队列已满时返回false
+    bool submitRecommendationJob(RecommendationRequest&& rec_request,
+                                 const Table& table, const std::string& session_id);
+
+    // 清理已过期的异步任务结果（调用方需持有jobs_mutex_）
+    void purgeExpiredJobsLocked();
     
     // 验证请求参数
-    bool validateRequest(const std::string& image_base64, const std::string& table_number);
+    bool validateRequest(const std::string& image_data, const std::string& table_number);
     
+    // 菜单版本和库存版本对应的强ETag
+    static std::string buildMenuEtag(const MenuSnapshot& snapshot, uint64_t stock_version);
+
+    // If-None-Match是否与etag匹配；匹配时已写好304响应并返回true
+    bool checkNotModified(const httplib::Request& request, httplib::Response& response, const std::string& etag);
+
     // 构建错误响应
     std::string buildErrorResponse(const std::string& message, int code);
     
-    // 构建成功响应
-    std::string buildSuccessResponse(const std::string& message, const std::string& data);
+    // 构建成功响应，data直接写入响应缓冲区
+    std::string buildSuccessResponse(const std::string& message, const rapidjson::Value& data);
+    std::string buildSuccessResponse(const std::string& message, const JsonResponse::DataWriter& write_data);
     
     // 获取当前季节
     std::string getCurrentSeason();
     
     // 获取当前用餐时间
     std::string getCurrentMealTime();
-    
-    // 设置CORS头
-    void setCorsHeaders(httplib::Response& response);
 
 private:
     std::shared_ptr<AiService> ai_service_;
     std::shared_ptr<RestaurantDb> db_;
+    std::shared_ptr<JobExecutor> job_executor_;
+    std::shared_ptr<VisionDedupeCache> vision_dedupe_;
+    std::shared_ptr<RecommendationWriter> rec_writer_;
+    std::shared_ptr<PopularityTracker> popularity_;
+    std::shared_ptr<InventoryManager> inventory_;
+    size_t max_image_size_;
+    PipelineMode default_pipeline_mode_;
+
+    // 各执行模式的耗时分布
+    LatencyHistogram two_stage_latency_;
+    LatencyHistogram combined_latency_;
+
+    // 推荐流程各阶段耗时（导出到/metrics）
+    Histogram& stage_parse_;
+    Histogram& stage_table_lookup_;
+    Histogram& stage_vision_;
+    Histogram& stage_combined_;
+    Histogram& stage_recommend_;
+    Histogram& stage_db_save_;
+
+    // 推荐菜品响应体按菜单版本和库存版本缓存，两者都不变时直接复用
+    std::mutex menu_body_mutex_;
+    uint64_t menu_body_version_;
+    uint64_t menu_body_stock_version_;
+    std::string menu_body_;
+
+    // 异步推荐任务表
+    mutable std::mutex jobs_mutex_;
+    std::condition_variable jobs_cv_;
+    std::unordered_map<std::string, std::shared_ptr<RecommendationJob>> jobs_;
+    int waiting_polls_;          // 正在等待的长轮询数，由jobs_mutex_保护
+    int max_waiting_polls_;      // 由jobs_mutex_保护
+    uint64_t rejected_polls_;    // 由jobs_mutex_保护
 };
 
 } // namespace WisdomRestaurant
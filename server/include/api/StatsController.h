@@ -0,0 +1,27 @@
+#pragma once
+
+#include "httplib.h"
+#include "db/RestaurantDb.h"
+#include "common/JsonResponse.h"
+#include <memory>
+#include <string>
+
+namespace WisdomRestaurant {
+
+// 经营统计接口（数据来自增量维护的订单统计汇总，不扫描orders表）
+class StatsController {
+public:
+    explicit StatsController(std::shared_ptr<RestaurantDb> db);
+
+    // 处理订单统计查询（支持date和days参数）
+    void handleGetOrderStats(const httplib::Request& request, httplib::Response& response);
+
+private:
+    // 写入一组统计字段
+    static void writeCounters(JsonResponse::JsonWriter& writer, const OrderStatsRow& row);
+
+private:
+    std::shared_ptr<RestaurantDb> db_;
+};
+
+} // namespace WisdomRestaurant
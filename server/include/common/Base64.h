@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace WisdomRestaurant {
+namespace Base64 {
+
+// 编码后的长度（含填充）
+inline size_t encodedLength(size_t input_length) {
+    return (input_length + 2) / 3 * 4;
+}
+
+// 编码任意二进制数据
+std::string encode(const char* data, size_t length);
+
+inline std::string encode(const std::string& data) {
+    return encode(data.data(), data.size());
+}
+
+// 将输入编码后追加到out末尾；输入长度不是3的倍数时会写入填充，只能用于最后一段数据
+void encodeAppend(const char* data, size_t length, std::string& out);
+
+// 编码到调用方提供的缓冲区（至少encodedLength(length)字节），返回写入的字节数
+// 分段编码时除最后一段外，每段长度都必须是3的倍数
+size_t encodeInto(const char* data, size_t length, char* out);
+
+// 是否只包含标准base64字符（可直接嵌入JSON字符串而无需转义）
+bool isPlainAlphabet(const std::string& input);
+
+// 解码，输入包含非法字符时返回false
+bool decode(const std::string& input, std::string& out);
+
+} // namespace Base64
+} // namespace WisdomRestaurant
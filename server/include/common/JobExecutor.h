@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace WisdomRestaurant {
+
+// 任务执行器统计信息
+struct JobExecutorStats {
+    size_t worker_count;       // 工作线程数
+    size_t active_workers;     // 正在执行任务的线程数
+    size_t queue_depth;        // 当前排队任务数
+    size_t queue_capacity;     // 队列容量
+    size_t max_queue_depth;    // 历史最大排队数
+    uint64_t submitted;        // 已接收任务数
+    uint64_t rejected;         // 因队列满被拒绝的任务数
+    uint64_t completed;        // 已完成任务数
+};
+
+// 固定线程数、有界队列的后台任务执行器
+class JobExecutor {
+public:
+    JobExecutor(const std::string& name, size_t worker_count, size_t queue_capacity);
+    ~JobExecutor();
+
+    // 提交任务，队列已满或执行器已关闭时返回false
+    bool submit(std::function<void()> job);
+
+    // 停止接收新任务，等待已排队任务执行完毕
+    void shutdown();
+
+    JobExecutorStats getStats() const;
+
+    const std::string& name() const { return name_; }
+
+private:
+    void workerLoop();
+
+private:
+    std::string name_;
+    size_t queue_capacity_;
+    std::vector<std::thread> workers_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> queue_;
+    bool stopping_;
+    size_t max_queue_depth_;
+
+    std::atomic<size_t> active_workers_;
+    std::atomic<uint64_t> submitted_;
+    std::atomic<uint64_t> rejected_;
+    std::atomic<uint64_t> completed_;
+};
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include <functional>
+#include <string>
+
+namespace httplib {
+struct Response;
+}
+
+namespace WisdomRestaurant {
+namespace JsonResponse {
+
+using JsonWriter = rapidjson::Writer<rapidjson::StringBuffer>;
+
+// 直接向Writer写入data的值（对象、数组等），不能在回调中再次构建响应
+using DataWriter = std::function<void(JsonWriter&)>;
+
+// 以下函数生成统一的 {"code":...,"message":...,"data":...} 响应体
+// 信封和data通过同一个Writer一次写入线程内复用的缓冲区，不再先序列化data、解析回来再序列化
+
+// data为空对象
+std::string build(int code, const std::string& message);
+
+// data为已构建好的DOM值
+std::string build(int code, const std::string& message, const rapidjson::Value& data);
+
+// data由回调以SAX方式写入，适合不需要DOM的热点接口
+std::string build(int code, const std::string& message, const DataWriter& write_data);
+
+// 将DOM值序列化为JSON字符串（同样使用线程内复用的缓冲区）
+std::string serialize(const rapidjson::Value& value);
+
+// 写入状态码和JSON响应体
+void send(httplib::Response& response, int status, const std::string& body);
+
+// 设置所有接口共用的CORS头
+void setCorsHeaders(httplib::Response& response);
+
+} // namespace JsonResponse
+} // namespace WisdomRestaurant
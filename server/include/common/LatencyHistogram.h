@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace WisdomRestaurant {
+
+// 延迟分布摘要（毫秒）
+struct LatencySummary {
+    uint64_t count;
+    double mean_ms;
+    double p50_ms;
+    double p90_ms;
+    double p99_ms;
+    double max_ms;
+};
+
+// 无锁延迟直方图
+// 桶边界按10%等比增长，覆盖1ms到约100s，分位数误差不超过10%
+class LatencyHistogram {
+public:
+    static constexpr size_t kBucketCount = 128;
+
+    LatencyHistogram();
+
+    // 记录一次耗时
+    void record(double ms);
+
+    // 计算分位数（q取0~1），没有样本时返回0
+    double percentile(double q) const;
+
+    LatencySummary getSummary() const;
+
+    // 第index个桶的上界（毫秒）
+    static double bucketUpperBound(size_t index);
+
+private:
+    std::array<std::atomic<uint64_t>, kBucketCount> buckets_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_us_;
+    std::atomic<uint64_t> max_us_;
+};
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <array>
+#include <string>
+
+namespace WisdomRestaurant {
+namespace MealPeriod {
+
+// 季节和用餐时段的名称，与推荐提示词中使用的一致
+static constexpr std::array<const char*, 4> kSeasons{{"春季", "夏季", "秋季", "冬季"}};
+static constexpr std::array<const char*, 5> kMealTimes{{"早餐", "午餐", "下午茶", "晚餐", "夜宵"}};
+
+// 月份（1-12）对应的季节在kSeasons中的下标
+int seasonIndex(int month);
+
+// 小时（0-23）对应的用餐时段在kMealTimes中的下标
+int mealTimeIndex(int hour);
+
+// 按名称查找下标，未知名称返回-1
+int findSeason(const std::string& name);
+int findMealTime(const std::string& name);
+
+} // namespace MealPeriod
+} // namespace WisdomRestaurant
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace WisdomRestaurant {
+
+// 指标标签，按给定顺序输出
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+// 每个指标的分片数，线程按注册顺序轮流分配到分片，减少多核写入同一缓存行
+static constexpr size_t kMetricShards = 16;
+
+// 当前线程使用的分片下标
+size_t currentMetricShard();
+
+// 单调递增计数器
+class Counter {
+public:
+    Counter();
+
+    void inc(uint64_t n = 1) {
+        shards_[currentMetricShard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // 合并所有分片
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value;
+    };
+    std::array<Shard, kMetricShards> shards_;
+};
+
+// 可增减的瞬时值
+class Gauge {
+public:
+    Gauge() : value_(0) {}
+
+    void set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+    void add(int64_t delta) { value_.fetch_add(delta, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_;
+};
+
+// 直方图合并后的快照
+struct HistogramSnapshot {
+    std::vector<double> bounds;       // 各桶上界（不含+Inf）
+    std::vector<uint64_t> counts;     // 各桶计数（非累计），最后一个为+Inf桶
+    uint64_t count;
+    double sum;
+};
+
+// 固定桶边界的直方图，每个线程写自己的分片，抓取时合并
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> bounds);
+
+    void observe(double value);
+
+    HistogramSnapshot snapshot() const;
+
+    // 默认的耗时桶（秒），覆盖5ms到60s
+    static const std::vector<double>& defaultLatencyBounds();
+
+private:
+    struct alignas(64) Shard {
+        explicit Shard(size_t bucket_count) : buckets(bucket_count), sum_bits(0) {}
+        std::vector<std::atomic<uint64_t>> buckets;
+        std::atomic<uint64_t> sum_bits;   // double的位模式，CAS累加
+    };
+
+    std::vector<double> bounds_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+// 作用域计时，析构时把耗时（秒）记录到直方图
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        histogram_.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count());
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Histogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Prometheus文本格式输出，同名指标的样本归到同一组HELP/TYPE之下
+class MetricsWriter {
+public:
+    void counter(const std::string& name, const std::string& help, const MetricLabels& labels, double value);
+    void gauge(const std::string& name, const std::string& help, const MetricLabels& labels, double value);
+    void histogram(const std::string& name, const std::string& help, const MetricLabels& labels,
+                   const HistogramSnapshot& snapshot);
+
+    std::string str() const;
+
+private:
+    struct Family {
+        std::string name;
+        std::string help;
+        const char* type;
+        std::string samples;
+    };
+
+    Family& family(const std::string& name, const std::string& help, const char* type);
+
+    std::vector<Family> families_;
+    std::unordered_map<std::string, size_t> index_;
+};
+
+// 指标注册表
+// 注册时加锁并返回长期有效的引用，调用方保存引用后的记录操作全部无锁
+class MetricsRegistry {
+public:
+    using Collector = std::function<void(MetricsWriter&)>;
+
+    static MetricsRegistry& instance();
+
+    // 同名同标签重复注册返回同一个指标
+    Counter& counter(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    Gauge& gauge(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    Histogram& histogram(const std::string& name, const std::string& help, const MetricLabels& labels = {},
+                         const std::vector<double>& bounds = Histogram::defaultLatencyBounds());
+
+    // 抓取时调用的回调，用于导出各模块已有的统计信息
+    void addCollector(Collector collector);
+
+    // 输出全部指标
+    std::string render() const;
+
+private:
+    MetricsRegistry() = default;
+
+    template <typename T>
+    struct Entry {
+        std::string name;
+        std::string help;
+        MetricLabels labels;
+        std::unique_ptr<T> metric;
+    };
+
+    static std::string makeKey(const std::string& name, const MetricLabels& labels);
+
+    mutable std::mutex mutex_;
+    std::deque<Entry<Counter>> counters_;
+    std::deque<Entry<Gauge>> gauges_;
+    std::deque<Entry<Histogram>> histograms_;
+    std::unordered_map<std::string, void*> index_;
+    std::vector<Collector> collectors_;
+};
+
+} // namespace WisdomRestaurant
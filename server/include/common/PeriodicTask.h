@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace WisdomRestaurant {
+
+// 按固定间隔在后台线程执行任务，用于把内存中的变化定期写回数据库
+// 停止时唤醒后台线程并等待其退出，线程退出前会再执行一次任务，停止前的变化不会丢失
+class PeriodicTask {
+public:
+    PeriodicTask(std::chrono::milliseconds interval, std::function<void()> task);
+    ~PeriodicTask();
+
+    // 启动后台线程；已启动或已停止时不做任何事
+    void start();
+
+    // 停止后台线程并执行最后一次任务；未启动时直接在调用线程执行一次，重复调用不做任何事
+    void stop();
+
+private:
+    void loop();
+
+private:
+    std::chrono::milliseconds interval_;
+    std::function<void()> task_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_;
+    std::thread thread_;
+};
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "common/Metrics.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace WisdomRestaurant {
+
+// 请求追踪
+// 每个请求都有trace ID（沿用客户端传入的X-Request-Id，否则自动生成），随响应头返回并转发给大模型接口；
+// 按阶段累计耗时生成Server-Timing响应头，被采样或超过慢请求阈值的请求在追踪结束时写一行span日志
+class RequestTrace {
+public:
+    RequestTrace(std::string id, std::string name, bool sampled);
+    // 最后一个持有者释放时写span日志，异步任务会持有追踪直到任务结束
+    ~RequestTrace();
+
+    RequestTrace(const RequestTrace&) = delete;
+    RequestTrace& operator=(const RequestTrace&) = delete;
+
+    // 开始追踪一个请求；request_id为空或含非法字符时生成新的ID，并按采样率决定是否写span日志
+    static std::shared_ptr<RequestTrace> start(const std::string& request_id, std::string name);
+
+    // 设置span日志的采样率（0~1）
+    static void setSampleRate(double rate);
+
+    // 设置慢请求阈值（毫秒），超过阈值的请求无论是否采样都写span日志，0表示不启用
+    static void setSlowThreshold(double slow_ms);
+
+    // 当前线程正在处理的请求，没有时返回nullptr
+    static RequestTrace* current();
+    static std::shared_ptr<RequestTrace> currentShared();
+
+    // 替换当前线程的追踪上下文，返回之前的上下文
+    static std::shared_ptr<RequestTrace> setCurrent(std::shared_ptr<RequestTrace> trace);
+
+    // 在当前线程上安装追踪上下文，析构时恢复之前的上下文（用于后台任务线程）
+    class Scope {
+    public:
+        explicit Scope(std::shared_ptr<RequestTrace> trace) : previous_(setCurrent(std::move(trace))) {}
+        ~Scope() { setCurrent(std::move(previous_)); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        std::shared_ptr<RequestTrace> previous_;
+    };
+
+    const std::string& id() const { return id_; }
+    bool sampled() const { return sampled_; }
+
+    // 累计一个阶段的耗时，同名阶段合并
+    void addSpan(const char* name, std::chrono::steady_clock::duration elapsed);
+
+    // 记录响应状态码，写入span日志
+    void setStatus(int status);
+
+    // Server-Timing响应头的值，最后一项total为从开始到现在的耗时
+    std::string serverTiming() const;
+
+private:
+    struct Span {
+        const char* name;     // 阶段名均为字符串常量
+        double total_ms;
+        uint32_t count;
+    };
+
+    std::string id_;
+    std::string name_;
+    bool sampled_;              // 是否写span日志
+    std::chrono::steady_clock::time_point start_;
+
+    mutable std::mutex mutex_;  // 异步任务线程和HTTP线程可能同时访问
+    std::vector<Span> spans_;
+    int status_;
+};
+
+// 阶段计时：析构时把耗时写入直方图，并记入当前请求的追踪
+class StageTimer {
+public:
+    StageTimer(const char* stage, Histogram& histogram)
+        : stage_(stage), histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~StageTimer();
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    const char* stage_;
+    Histogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace WisdomRestaurant {
+namespace Sha256 {
+
+using Digest = std::array<uint8_t, 32>;
+
+// 计算SHA-256摘要
+Digest digest(const char* data, size_t length);
+
+// 摘要的小写十六进制表示（64个字符）
+std::string hex(const char* data, size_t length);
+
+inline std::string hex(const std::string& data) {
+    return hex(data.data(), data.size());
+}
+
+} // namespace Sha256
+} // namespace WisdomRestaurant
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace WisdomRestaurant {
+namespace UtcTime {
+
+// 公历日期与1970-01-01以来天数的互相换算，不依赖gmtime/timegm（Windows上没有线程安全版本）
+int64_t daysFromCivil(int64_t year, unsigned month, unsigned day);
+void civilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day);
+
+// 与SQLite的CURRENT_TIMESTAMP相同的UTC格式：YYYY-MM-DD HH:MM:SS
+std::string format(std::chrono::system_clock::time_point time);
+
+// 解析YYYY-MM-DD HH:MM:SS格式的UTC时间
+bool parse(const std::string& text, std::chrono::system_clock::time_point& time);
+
+// 与SQLite的DATE()相同的UTC日期：YYYY-MM-DD
+std::string formatDate(std::chrono::system_clock::time_point time);
+
+// 解析YYYY-MM-DD格式的日期，得到1970-01-01以来的天数
+bool parseDate(const std::string& text, int64_t& days);
+
+// 1970-01-01以来的天数转换为YYYY-MM-DD
+std::string dateFromDays(int64_t days);
+
+} // namespace UtcTime
+} // namespace WisdomRestaurant
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "common/PeriodicTask.h"
+#include "db/RestaurantDb.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace WisdomRestaurant {
+
+// 餐桌环境指标
+enum class EnvironmentMetric { Temperature = 0, LightIntensity, Humidity, NoiseLevel };
+
+static constexpr size_t kEnvironmentMetricCount = 4;
+
+// 指标名（temperature、light_intensity、humidity、noise_level）
+const char* environmentMetricName(EnvironmentMetric metric);
+
+// 解析指标名，未知名称时返回false
+bool parseEnvironmentMetric(const std::string& name, EnvironmentMetric& metric);
+
+// 一次上报的原始数据，缺失的指标为NaN
+struct EnvironmentSample {
+    int64_t timestamp;                                       // Unix秒
+    std::array<double, kEnvironmentMetricCount> values;
+};
+
+// 一个桶内单个指标的汇总
+struct EnvironmentAggregate {
+    uint32_t count = 0;
+    double min = 0.0;
+    double max = 0.0;
+    double sum = 0.0;
+
+    void add(double value);
+    void merge(const EnvironmentAggregate& other);
+};
+
+// 查询结果中的一个点：原始数据时每个样本一个点，汇总数据时每个桶一个点
+struct EnvironmentPoint {
+    int64_t timestamp;                                       // 桶起始时间（Unix秒）
+    std::array<EnvironmentAggregate, kEnvironmentMetricCount> metrics;
+};
+
+// 环境时序配置
+struct EnvironmentSeriesOptions {
+    size_t raw_capacity = 720;                               // 每桌保留的原始样本数（环形缓冲区）
+    std::chrono::milliseconds flush_interval{30000};         // 变化的汇总块每隔这么久写入数据库
+    int max_lateness_seconds = 300;                          // 接受的最大延迟，更早的样本被拒绝
+    std::array<int, 3> retention_days{{7, 90, 730}};         // 1分钟、15分钟、1小时汇总的保留天数，0表示永久
+    size_t max_points = 360;                                 // 自动选择粒度时返回的最大点数
+};
+
+// 环境时序统计信息
+struct EnvironmentSeriesStats {
+    size_t tables;             // 有数据的餐桌数
+    size_t resident_blocks;    // 内存中的汇总块数
+    uint64_t samples;          // 接收的样本数
+    uint64_t rejected;         // 时间戳超出范围被拒绝的样本数
+    uint64_t blocks_written;   // 写入数据库的块数
+    uint64_t bytes_written;    // 写入数据库的块字节数
+    uint64_t flush_failures;   // 写入失败的事务数
+};
+
+// 餐桌环境数据时序存储
+// 每桌最近的原始样本保存在固定大小的环形缓冲区；同时按1分钟、15分钟、1小时三种粒度汇总（min/max/sum/count），
+// 每60个连续桶组成一个块，以列式、差分、变长整数编码后写入environment_rollups。
+// 范围查询按粒度直接读取覆盖该范围的少量块，不扫描原始数据。
+class EnvironmentSeries {
+public:
+    // 汇总粒度（秒），0表示原始样本
+    static constexpr std::array<int, 3> kResolutions{{60, 900, 3600}};
+    static constexpr int kBlockBuckets = 60;
+
+    explicit EnvironmentSeries(std::shared_ptr<RestaurantDb> db,
+                               const EnvironmentSeriesOptions& options = EnvironmentSeriesOptions());
+    ~EnvironmentSeries();
+
+    // 从数据库恢复尚未结束的块并启动后台写入线程
+    bool initialize();
+
+    // 记录一个样本；时间戳早于max_lateness或晚于当前时间1分钟时返回false
+    bool record(int table_id, const EnvironmentSample& sample);
+
+    // 查询[from, to)内的数据；resolution为0时返回原始样本，为-1时按max_points自动选择粒度，
+    // 实际使用的粒度写入resolution
+    std::vector<EnvironmentPoint> query(int table_id, int64_t from, int64_t to, int& resolution) const;
+
+    // 立即写入所有变化的块
+    bool flush();
+
+    // 停止后台线程并写入剩余变化
+    void shutdown();
+
+    EnvironmentSeriesStats getStats() const;
+
+    // 块编解码（公开以便离线工具读取数据库中的块）
+    struct Bucket {
+        uint16_t slot;                                        // 在块内的序号
+        std::array<EnvironmentAggregate, kEnvironmentMetricCount> metrics;
+    };
+    static std::string encodeBlock(const std::vector<Bucket>& buckets);
+    static bool decodeBlock(const std::string& data, std::vector<Bucket>& buckets);
+
+private:
+    struct Block {
+        std::vector<Bucket> buckets;   // 按slot排序
+        bool dirty = false;
+    };
+
+    struct TableSeries {
+        mutable std::mutex mutex;
+        std::vector<EnvironmentSample> raw;   // 环形缓冲区
+        size_t raw_next = 0;
+        std::map<std::pair<int, int64_t>, Block> blocks;   // (粒度, 块起始时间) -> 块
+    };
+
+    TableSeries& tableFor(int table_id);
+    const TableSeries* findTable(int table_id) const;
+
+    // 把样本累加到块中对应的桶
+    static void addToBlock(Block& block, uint16_t slot, const EnvironmentSample& sample);
+
+    // 后台线程每个写入间隔执行一次：写入变化的块，每小时按保留天数清理一次旧块
+    void periodicFlush();
+
+    // 按保留天数删除旧块
+    void pruneExpired();
+
+private:
+    std::shared_ptr<RestaurantDb> db_;
+    EnvironmentSeriesOptions options_;
+
+    mutable std::shared_mutex tables_mutex_;
+    std::unordered_map<int, std::unique_ptr<TableSeries>> tables_;
+
+    std::mutex flush_mutex_;   // 串行化写入
+    std::chrono::steady_clock::time_point last_prune_;
+
+    std::atomic<uint64_t> samples_;
+    std::atomic<uint64_t> rejected_;
+    std::atomic<uint64_t> blocks_written_;
+    std::atomic<uint64_t> bytes_written_;
+    std::atomic<uint64_t> flush_failures_;
+
+    PeriodicTask flusher_;   // 最后声明，析构时最先停止
+};
+
+} // namespace WisdomRestaurant
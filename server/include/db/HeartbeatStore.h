@@ -0,0 +1,110 @@
+#pragma once
+
+#include "common/PeriodicTask.h"
+#include "db/RestaurantDb.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace WisdomRestaurant {
+
+// 心跳状态表配置
+struct HeartbeatStoreOptions {
+    std::chrono::milliseconds flush_interval{5000};   // 变化的心跳每隔这么久批量写入数据库
+    std::chrono::seconds touch_interval{60};          // 设备状态不变时，只刷新心跳时间的写入至少间隔这么久
+    int active_seconds = 300;                         // 这么久内有心跳的客户端视为活跃
+    int expire_seconds = 24 * 3600;                   // 这么久没有心跳的客户端从内存和数据库中删除，0表示不删除
+};
+
+// 心跳状态表统计信息
+struct HeartbeatStoreStats {
+    size_t clients;            // 内存中的客户端数
+    size_t active_clients;     // 活跃客户端数
+    uint64_t heartbeats;       // 收到的心跳数
+    uint64_t rows_written;     // 写入数据库的行数
+    uint64_t flushes;          // 批量写入事务数
+    uint64_t flush_failures;   // 写入失败的事务数
+    uint64_t expired;          // 超时删除的客户端数
+};
+
+// 客户端心跳状态表
+// 心跳按(table_id, client_id)保存在分片的内存表中，活跃客户端查询和超时清理都只读内存；
+// 状态有变化的客户端由后台线程定期在一个事务中写入client_heartbeats，数据库只用于重启后恢复
+class HeartbeatStore {
+public:
+    explicit HeartbeatStore(std::shared_ptr<RestaurantDb> db,
+                            const HeartbeatStoreOptions& options = HeartbeatStoreOptions());
+    ~HeartbeatStore();
+
+    // 从数据库加载已有的心跳状态并启动后台写入线程
+    bool initialize();
+
+    // 记录一次心跳；返回true表示客户端新上线（首次出现或超时后重新出现）
+    bool update(const ClientHeartbeat& heartbeat);
+
+    // 查询单个客户端的最新心跳
+    std::optional<ClientHeartbeat> getClient(int table_id, const std::string& client_id) const;
+
+    // timeout_seconds内有心跳的客户端，按最近心跳时间倒序；timeout_seconds<=0时使用active_seconds
+    std::vector<ClientHeartbeat> getActiveClients(int timeout_seconds = 0) const;
+
+    // 删除超过timeout_seconds没有心跳的客户端，下次写入时同步删除数据库中的行；返回删除数
+    size_t cleanupInactiveClients(int timeout_seconds);
+
+    // 立即写入所有变化
+    bool flush();
+
+    // 停止后台线程并写入剩余变化
+    void shutdown();
+
+    HeartbeatStoreStats getStats() const;
+
+private:
+    struct Entry {
+        ClientHeartbeat heartbeat;
+        std::chrono::system_clock::time_point last_seen;
+        std::chrono::system_clock::time_point persisted_seen;  // 数据库中的心跳时间
+        bool dirty;                                             // 设备状态有未写入的变化
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Entry> entries;
+    };
+
+    static constexpr size_t kShardCount = 16;
+
+    static std::string makeKey(int table_id, const std::string& client_id);
+    Shard& shardFor(const std::string& key);
+    const Shard& shardFor(const std::string& key) const;
+
+    // 后台线程每个写入间隔执行一次：清理长时间无心跳的客户端并写入变化
+    void periodicFlush();
+
+private:
+    std::shared_ptr<RestaurantDb> db_;
+    HeartbeatStoreOptions options_;
+    std::array<Shard, kShardCount> shards_;
+
+    std::mutex flush_mutex_;   // 串行化写入
+    std::mutex mutex_;         // 保护removed_
+    std::vector<std::pair<int, std::string>> removed_;   // 已清理、待从数据库删除的客户端
+
+    std::atomic<uint64_t> heartbeats_;
+    std::atomic<uint64_t> rows_written_;
+    std::atomic<uint64_t> flushes_;
+    std::atomic<uint64_t> flush_failures_;
+    std::atomic<uint64_t> expired_;
+
+    PeriodicTask flusher_;   // 最后声明，析构时最先停止
+};
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace WisdomRestaurant {
+
+// 图片存储配置
+struct ImageBlobStoreOptions {
+    std::string directory = "images";   // 存储目录
+    int retention_days = 30;            // 超过该天数未再出现的图片被删除，0表示不按时间清理
+    uint64_t max_bytes = 1024ull * 1024 * 1024;  // 总大小上限，超出时从最久未出现的图片开始删除，0表示不限
+};
+
+// 图片存储统计信息
+struct ImageBlobStoreStats {
+    uint64_t files;            // 当前文件数
+    uint64_t bytes;            // 当前总字节数
+    uint64_t stored;           // 新写入的图片数
+    uint64_t deduplicated;     // 内容已存在而跳过写入的次数
+    uint64_t pruned;           // 清理删除的图片数
+    uint64_t errors;           // 解码或写文件失败次数
+};
+
+// 按内容寻址的图片存储
+// 图片以解码后的二进制保存为 <directory>/<哈希前两位>/<SHA-256>，相同内容只保存一份；
+// 数据库中只记录哈希。按保留天数和总大小上限清理，重复出现的图片会刷新修改时间
+class ImageBlobStore {
+public:
+    explicit ImageBlobStore(const ImageBlobStoreOptions& options = ImageBlobStoreOptions());
+
+    // 创建存储目录并统计已有文件，然后执行一次清理
+    bool initialize();
+
+    // 保存图片，is_base64时先解码；返回内容的SHA-256十六进制，失败时返回空字符串
+    std::string put(const std::string& data, bool is_base64);
+
+    // 读取图片的二进制内容，不存在时返回false
+    bool get(const std::string& hash, std::string& out) const;
+
+    // 图片文件路径（不检查是否存在）
+    std::string pathFor(const std::string& hash) const;
+
+    // 按保留天数和总大小上限删除图片，返回删除的文件数
+    size_t prune();
+
+    ImageBlobStoreStats getStats() const;
+
+private:
+    // 写入后总大小超限或距上次清理超过一小时时清理
+    void maybePrune();
+
+private:
+    ImageBlobStoreOptions options_;
+
+    mutable std::mutex mutex_;   // 保护以下统计和清理状态
+    uint64_t files_;
+    uint64_t bytes_;
+    uint64_t stored_;
+    uint64_t deduplicated_;
+    uint64_t pruned_;
+    uint64_t errors_;
+    std::chrono::steady_clock::time_point last_prune_;
+    bool pruning_;
+};
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "common/PeriodicTask.h"
+#include "db/RestaurantDb.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace WisdomRestaurant {
+
+// 库存管理配置
+struct InventoryOptions {
+    std::chrono::milliseconds flush_interval{2000};   // 变化的库存每隔这么久批量写回数据库
+    std::chrono::seconds reservation_ttl{900};        // 预留超过这么久未下单自动释放
+};
+
+// 一道菜的实时库存
+struct DishStock {
+    int dish_id;
+    int stock;        // 库存（写回dishes.stock_count的值）
+    int available;    // 可售份数 = 库存 - 未结算的预留
+};
+
+// 预留或下单的结果
+struct InventoryResult {
+    enum class Status { Ok, SoldOut, UnknownDish, InvalidQuantity, UnknownReservation, Failed };
+
+    Status status = Status::Failed;
+    uint64_t reservation_id = 0;    // reserve成功时的预留ID
+    int dish_id = 0;                // 售罄或未知的菜品
+    std::optional<PlacedOrder> order;  // placeOrder成功时的订单
+
+    bool ok() const { return status == Status::Ok; }
+};
+
+// 库存统计信息
+struct InventoryStats {
+    size_t dishes;                  // 跟踪的菜品数
+    size_t sold_out;                // 当前售罄的菜品数
+    size_t reservations;            // 未结算的预留数
+    uint64_t reserved;              // 成功的预留数
+    uint64_t rejected;              // 因库存不足被拒绝的预留数
+    uint64_t committed;             // 已结算（下单成功）的预留数
+    uint64_t released;              // 主动释放的预留数
+    uint64_t expired;               // 超时释放的预留数
+    uint64_t rows_written;          // 写回数据库的行数
+    uint64_t flush_failures;        // 写回失败的事务数
+};
+
+// 菜品库存
+// 每道菜的库存和可售份数是内存中的原子计数，预留用比较并扣减完成，不加锁也不访问数据库；
+// 下单时结算预留，库存的变化由后台线程定期在一个事务中写回dishes.stock_count。
+// 数据库中的库存最多落后一个写回间隔，进程异常退出时最后一个间隔内的扣减会丢失
+class InventoryManager {
+public:
+    explicit InventoryManager(std::shared_ptr<RestaurantDb> db,
+                              const InventoryOptions& options = InventoryOptions());
+    ~InventoryManager();
+
+    // 从菜单快照加载库存并启动后台写回线程
+    bool initialize();
+
+    // 一道菜的实时库存，菜品不存在时返回空
+    std::optional<DishStock> getStock(int dish_id);
+
+    // 全部菜品的实时库存，按菜品id排序
+    std::vector<DishStock> getAllStocks() const;
+
+    // 是否售罄（可售份数为0）；不跟踪的菜品视为未售罄
+    bool isSoldOut(int dish_id) const;
+
+    // 当前售罄的菜品id，按id排序
+    std::vector<int> getSoldOutDishes() const;
+
+    // 任意菜品库存变化时递增，用于菜单响应的ETag和缓存
+    uint64_t version() const { return version_.load(std::memory_order_acquire); }
+
+    // 有菜品售罄或恢复可售时递增，用于使推荐缓存失效
+    uint64_t soldOutVersion() const { return sold_out_version_.load(std::memory_order_acquire); }
+
+    // 预留(菜品id, 份数)，全部预留成功或全部不预留
+    InventoryResult reserve(const std::vector<std::pair<int, int>>& quantities);
+
+    // 释放预留，份数退回可售
+    bool release(uint64_t reservation_id);
+
+    // 下单：按订单项预留（reservation_id非0时把该预留调整为订单项的份数），订单写入成功后结算，失败时释放
+    InventoryResult placeOrder(const Order& order, const std::vector<OrderItem>& items, uint64_t reservation_id = 0);
+
+    // 覆盖库存，未结算的预留仍然保留
+    bool setStock(int dish_id, int stock);
+
+    // 释放超时的预留，返回释放数
+    size_t expireReservations();
+
+    // 立即写回所有变化
+    bool flush();
+
+    // 停止后台线程并写回剩余变化
+    void shutdown();
+
+    InventoryStats getStats() const;
+
+private:
+    struct Counter {
+        std::atomic<int> stock;
+        std::atomic<int> available;
+        int persisted;              // 数据库中的库存，由flush_mutex_保护
+    };
+
+    // 菜品id -> 计数器；菜单新增菜品时复制整张表后原子替换，已有计数器在新旧表之间共享
+    using CounterTable = std::unordered_map<int, std::shared_ptr<Counter>>;
+
+    struct Reservation {
+        std::vector<std::pair<int, int>> quantities;
+        std::chrono::steady_clock::time_point expires_at;
+    };
+
+    // 查找计数器；菜单中新增的菜品按快照中的库存补建
+    std::shared_ptr<Counter> counterFor(int dish_id);
+
+    // 比较并扣减可售份数，份数不足时不扣减并返回false
+    bool take(Counter& counter, int quantity);
+
+    // 退回可售份数
+    void giveBack(Counter& counter, int quantity);
+
+    // 可售份数从before变为after，跨过售罄边界时递增soldOutVersion
+    void noteAvailability(int before, int after);
+
+    // 预留全部份数，失败时退回已扣减的部分并返回失败原因
+    InventoryResult takeAll(const std::vector<std::pair<int, int>>& quantities);
+
+    // 退回全部份数
+    void giveBackAll(const std::vector<std::pair<int, int>>& quantities);
+
+    // 结算预留：可售份数已扣减，这里扣减库存
+    void commit(const Reservation& reservation);
+
+    // 后台线程每个写回间隔执行一次：释放超时的预留并写回库存
+    void periodicFlush();
+
+private:
+    std::shared_ptr<RestaurantDb> db_;
+    InventoryOptions options_;
+    std::shared_ptr<const CounterTable> counters_;   // 只通过std::atomic_load/atomic_store访问
+    std::mutex counters_mutex_;                      // 串行化计数器表的替换
+    std::atomic<uint64_t> version_;
+    std::atomic<uint64_t> sold_out_version_;
+
+    mutable std::mutex reservations_mutex_;
+    std::unordered_map<uint64_t, Reservation> reservations_;
+    uint64_t next_reservation_;
+
+    std::mutex flush_mutex_;   // 串行化写回
+
+    std::atomic<uint64_t> reserved_;
+    std::atomic<uint64_t> rejected_;
+    std::atomic<uint64_t> committed_;
+    std::atomic<uint64_t> released_;
+    std::atomic<uint64_t> expired_;
+    std::atomic<uint64_t> rows_written_;
+    std::atomic<uint64_t> flush_failures_;
+
+    PeriodicTask flusher_;   // 最后声明，析构时最先停止
+};
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "db/RestaurantDb.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace WisdomRestaurant {
+
+// 一道菜的销量和库存，随每次下单变化，原子更新而不重建快照
+struct DishCounters {
+    std::atomic<int> sales_count{0};
+    std::atomic<int> stock_count{0};
+};
+
+// 不可变的菜单快照，发布后只读，可在任意线程间共享
+// 销量和库存例外：实时值在counters中，dishes里的同名字段只是发布时的值
+struct MenuSnapshot {
+    uint64_t epoch = 0;                                  // 进程启动时间，区分重启前后相同的版本号
+    uint64_t version = 0;
+    std::vector<Dish> dishes;                            // 全部菜品（含已下架），按category_id、dish_name排序
+    std::unique_ptr<DishCounters[]> counters;            // 与dishes按下标对应的实时计数
+    std::unordered_map<int, size_t> by_id;               // id -> dishes下标
+    std::unordered_map<std::string, size_t> by_code;     // dish_code -> dishes下标
+    std::map<int, std::vector<size_t>> by_category;      // 分类 -> 在售菜品，按dish_name排序
+    std::vector<size_t> available;                       // 在售菜品
+    std::vector<size_t> recommended;                     // 在售推荐菜，按发布时的sales_count降序
+    std::vector<size_t> signature;                       // 在售招牌菜，按发布时的sales_count降序
+
+    const Dish* findById(int id) const;
+    const Dish* findByCode(const std::string& code) const;
+
+    int salesCount(size_t index) const { return counters[index].sales_count.load(std::memory_order_relaxed); }
+    int stockCount(size_t index) const { return counters[index].stock_count.load(std::memory_order_relaxed); }
+
+    // 复制一道菜，销量和库存取实时值
+    Dish copy(size_t index) const;
+
+    // 按下标列表复制菜品，销量和库存取实时值
+    std::vector<Dish> collect(const std::vector<size_t>& indexes) const;
+};
+
+// 两个菜单版本之间在售菜品的差异
+struct MenuDelta {
+    bool full = false;                   // 起始版本已不在历史记录中，changed为全部在售菜品
+    std::vector<const Dish*> changed;    // 新增或有变化的在售菜品（指向目标快照）
+    std::vector<int> removed;            // 已删除或下架的菜品id
+};
+
+// 菜单缓存（RCU方式）
+// 读者原子地取得当前快照的shared_ptr，无需加锁；写者复制数据构建新快照后原子替换并递增版本号
+class MenuCache {
+public:
+    MenuCache();
+
+    // 获取当前快照（尚未加载时为空快照）
+    std::shared_ptr<const MenuSnapshot> current() const;
+
+    // 当前菜单版本号
+    uint64_t version() const;
+
+    // 以完整菜品列表发布新快照
+    void publish(std::vector<Dish> dishes);
+
+    // 替换或新增单个菜品后发布新快照
+    void upsert(const Dish& dish);
+
+    // 替换或新增多个菜品后只发布一个新快照
+    void upsert(const std::vector<Dish>& dishes);
+
+    // 只更新已有菜品的销量和库存计数：原子写入当前快照的counters，不复制菜单也不发布新版本，
+    // 下单不会使菜单ETag、增量查询的基线和推荐缓存失效
+    void updateCounters(const std::vector<Dish>& dishes);
+
+    // 计算从since版本到to快照的差异，调用方需保证to在使用结果期间有效
+    MenuDelta diff(uint64_t since, const MenuSnapshot& to) const;
+
+    // 菜单版本变化时回调（在写者线程中调用）
+    void setVersionListener(std::function<void(uint64_t)> listener);
+
+private:
+    // 构建索引
+    static std::shared_ptr<const MenuSnapshot> build(std::vector<Dish> dishes, uint64_t epoch, uint64_t version);
+
+    // 调用方需持有writer_mutex_
+    void publishLocked(std::vector<Dish> dishes);
+
+    // 复制当前快照的全部菜品（含实时计数），作为构建新快照的基础；调用方需持有writer_mutex_
+    std::vector<Dish> copyCurrentLocked() const;
+
+private:
+    uint64_t epoch_;
+    std::shared_ptr<const MenuSnapshot> snapshot_;  // 只通过std::atomic_load/atomic_store访问
+    std::mutex writer_mutex_;
+
+    // 最近发布的快照，用于计算增量
+    mutable std::mutex history_mutex_;
+    std::deque<std::shared_ptr<const MenuSnapshot>> history_;
+    std::function<void(uint64_t)> listener_;
+};
+
+} // namespace WisdomRestaurant
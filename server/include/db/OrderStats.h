@@ -0,0 +1,55 @@
+#pragma once
+
+#include "db/RestaurantDb.h"
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace WisdomRestaurant {
+
+// 订单统计的内存副本（由RestaurantDb持有）
+// 保存最近resident_days天每小时的计数；RestaurantDb在下单、支付状态变化的事务提交后累加增量，
+// 窗口内的日期和小时统计直接从内存读取，窗口外的由调用方查询汇总表
+class OrderStats {
+public:
+    explicit OrderStats(int resident_days = 35);
+
+    // 以汇总表中first_day（1970-01-01以来的天数）及之后的行替换全部内容
+    void load(int64_t first_day, const std::vector<OrderStatsRow>& rows);
+
+    // 累加某个小时的增量；日期早于窗口时忽略
+    void apply(const OrderStatsRow& delta);
+
+    // 日期在窗口内时返回全天统计
+    std::optional<OrderStatsRow> day(int64_t day) const;
+
+    // 日期在窗口内时返回24个小时的统计
+    std::optional<std::vector<OrderStatsRow>> hours(int64_t day) const;
+
+    // 内存中数据完整的第一天
+    int64_t firstDay() const;
+
+    int residentDays() const { return resident_days_; }
+
+private:
+    struct Counters {
+        int64_t order_count = 0;
+        int64_t covers = 0;
+        int64_t paid_count = 0;
+        int64_t revenue_cents = 0;
+    };
+
+    static OrderStatsRow toRow(int64_t day, int hour, const Counters& counters);
+
+private:
+    int resident_days_;
+    mutable std::mutex mutex_;
+    int64_t first_day_;                                   // 早于这一天的数据不在内存中
+    std::map<int64_t, std::array<Counters, 24>> days_;    // 天 -> 每小时计数
+};
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "db/RestaurantDb.h"
+#include "common/MealPeriod.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace WisdomRestaurant {
+
+// 热销统计的时间窗口（按本地自然日，包含今天）
+enum class PopularityWindow { Day = 0, Week, Month, Quarter };
+
+// 窗口名（day、week、month、quarter）
+const char* popularityWindowName(PopularityWindow window);
+
+// 解析窗口名，未知名称时返回false
+bool parsePopularityWindow(const std::string& name, PopularityWindow& window);
+
+// 热销菜品及其在窗口内的销量
+struct PopularDish {
+    int dish_id;
+    uint64_t count;
+};
+
+// 热销统计信息
+struct PopularityStats {
+    uint64_t events;          // 记录的订单项数
+    uint64_t dropped;         // 早于最大窗口被忽略的订单项数
+    size_t tracked;           // 有计数的(切片, 菜品)组合数
+};
+
+// 菜品热销排行
+// 订单项按下单时的本地日期、用餐时段和季节计入(用餐时段, 季节)切片及其"全部"汇总切片；
+// 每个切片每道菜保存最近90天的日销量环形计数，每个窗口维护一个按销量排序的索引，
+// 每次更新O(log N)，取前K名O(K)，日期推进时把移出窗口的那一天从各窗口中扣除
+class PopularityTracker {
+public:
+    static constexpr std::array<int, 4> kWindowDays{{1, 7, 30, 90}};
+    static constexpr int kRingDays = 90;
+
+    PopularityTracker();
+
+    // 从数据库加载最近90天的订单项
+    bool initialize(RestaurantDb& db);
+
+    // 记录一次点菜
+    void record(int dish_id, int quantity, std::chrono::system_clock::time_point time);
+
+    // 取窗口内销量前k的菜品；meal_time/season为-1表示不限，accept为空或返回true的菜品才计入结果
+    std::vector<PopularDish> top(int meal_time, int season, PopularityWindow window, size_t k,
+                                 const std::function<bool(int)>& accept = nullptr);
+
+    PopularityStats getStats() const;
+
+private:
+    static constexpr size_t kMealSlots = MealPeriod::kMealTimes.size() + 1;    // 最后一个表示全部时段
+    static constexpr size_t kSeasonSlots = MealPeriod::kSeasons.size() + 1;    // 最后一个表示全部季节
+    static constexpr size_t kWindowCount = kWindowDays.size();
+
+    struct DishCounter {
+        std::array<uint32_t, kRingDays> days{};         // 下标为 天数 % kRingDays
+        std::array<uint64_t, kWindowCount> sums{};      // 各窗口内的销量
+    };
+
+    // 按销量降序、同销量按菜品id升序
+    struct RankOrder {
+        bool operator()(const std::pair<uint64_t, int>& a, const std::pair<uint64_t, int>& b) const {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        }
+    };
+    using Ranking = std::set<std::pair<uint64_t, int>, RankOrder>;
+
+    struct Slice {
+        std::unordered_map<int, DishCounter> dishes;
+        std::array<Ranking, kWindowCount> rankings;
+    };
+
+    static size_t sliceIndex(size_t meal, size_t season) { return meal * kSeasonSlots + season; }
+
+    // 调整某个窗口的销量并更新排序索引（调用方需持有mutex_）
+    static void adjust(Slice& slice, int dish_id, DishCounter& counter, size_t window, int64_t delta);
+
+    // 日期推进到day，扣除移出各窗口的日销量（调用方需持有mutex_）
+    void advanceLocked(int64_t day);
+
+private:
+    mutable std::mutex mutex_;
+    int64_t current_day_;                                  // 最新的本地日期（1970-01-01以来的天数）
+    std::array<Slice, kMealSlots * kSeasonSlots> slices_;
+    std::atomic<uint64_t> events_;
+    std::atomic<uint64_t> dropped_;
+};
+
+} // namespace WisdomRestaurant
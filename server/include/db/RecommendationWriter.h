@@ -0,0 +1,115 @@
+#pragma once
+
+#include "db/RestaurantDb.h"
+#include "db/ImageBlobStore.h"
+#include "common/Metrics.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace WisdomRestaurant {
+
+// 推荐记录写入队列配置
+struct RecommendationWriterOptions {
+    size_t batch_size = 32;                                  // 攒够这么多条立即写入
+    std::chrono::milliseconds flush_interval{200};           // 最早一条记录最多等待这么久
+    size_t max_queued = 1024;                                // 排队上限，0表示在调用方线程同步写入
+    size_t max_queued_bytes = 64 * 1024 * 1024;              // 排队图片的总字节数上限
+    std::chrono::milliseconds enqueue_timeout{500};          // 队列满时调用方最多等待这么久，超时后同步写入
+};
+
+// 推荐记录写入统计信息
+struct RecommendationWriterStats {
+    size_t queue_depth;        // 当前排队记录数
+    size_t max_queue_depth;    // 历史最大排队数
+    uint64_t enqueued;         // 进入队列的记录数
+    uint64_t written;          // 已写入数据库的记录数
+    uint64_t failed;           // 写入失败的记录数
+    uint64_t batches;          // 批量事务数
+    uint64_t blocked;          // 队列满时调用方等待的次数
+    uint64_t sync_fallbacks;   // 等待超时或已关闭时改为同步写入的次数
+};
+
+// 随推荐记录保存的顾客画面，由写入线程解码并存入图片存储
+struct RecommendationImage {
+    std::string data;
+    bool is_base64 = false;
+};
+
+// 推荐记录后写队列
+// 请求线程只把记录放入队列，后台线程按数量或时间攒批，在一个事务中写入，响应不再等待落盘；
+// 队列满时调用方阻塞等待（背压），关闭时把剩余记录全部写入
+class RecommendationWriter {
+public:
+    // image_store为空时图片以base64保存在记录中
+    RecommendationWriter(std::shared_ptr<RestaurantDb> db, std::shared_ptr<ImageBlobStore> image_store,
+                         const RecommendationWriterOptions& options = RecommendationWriterOptions());
+    ~RecommendationWriter();
+
+    // 放入写入队列；返回false表示最终写入失败（只在同步写入时能得知）
+    bool enqueue(AiRecommendation recommendation, RecommendationImage image = RecommendationImage());
+
+    // 该会话的记录是否还在队列中或正在写入
+    bool isPending(const std::string& session_id) const;
+
+    // 等待当前已排队的记录全部写入
+    void flush();
+
+    // 停止后台线程，写入剩余记录；之后的enqueue直接同步写入
+    void shutdown();
+
+    RecommendationWriterStats getStats() const;
+
+private:
+    struct PendingRecommendation {
+        AiRecommendation record;
+        RecommendationImage image;
+    };
+
+    void writerLoop();
+
+    // 保存图片并在记录中填入哈希（或base64）
+    void attachImage(PendingRecommendation& pending);
+
+    // 在调用方线程写入一条记录
+    bool writeNow(PendingRecommendation pending);
+
+    // 写入一批记录；整批失败时逐条重试，隔离出有问题的记录
+    void writeBatch(std::vector<PendingRecommendation>& batch);
+
+private:
+    std::shared_ptr<RestaurantDb> db_;
+    std::shared_ptr<ImageBlobStore> image_store_;
+    RecommendationWriterOptions options_;
+    Histogram& flush_latency_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;    // 通知后台线程有新记录或需要立即写入
+    std::condition_variable space_cv_;   // 通知等待中的调用方队列有空位或已写完
+    std::deque<PendingRecommendation> queue_;
+    size_t queued_bytes_;                // 排队图片的总字节数
+    std::chrono::steady_clock::time_point oldest_enqueued_at_;  // 队首记录的入队时间
+    std::unordered_set<std::string> pending_sessions_;  // 排队中和正在写入的会话
+    uint64_t enqueued_seq_;              // 已入队的记录序号
+    uint64_t written_seq_;               // 已处理完的记录序号
+    uint64_t flush_requested_seq_;       // flush要求写到的序号
+    bool stopping_;
+    size_t max_queue_depth_;
+    std::thread writer_;
+
+    std::atomic<uint64_t> written_;
+    std::atomic<uint64_t> failed_;
+    std::atomic<uint64_t> batches_;
+    std::atomic<uint64_t> blocked_;
+    std::atomic<uint64_t> sync_fallbacks_;
+};
+
+} // namespace WisdomRestaurant
@@ -1,11 +1,16 @@
 #pragma once
 
 #include <sqlite3.h>
+#include "db/StatementCache.h"
+#include "db/RowMapper.h"
+#include <functional>
 #include <string>
 #include <vector>
 #include <memory>
 #include <optional>
 #include <mutex>
+#include <atomic>
+#include <cstdint>
 
 namespace WisdomRestaurant {
 
@@ -103,12 +108,18 @@ struct OrderItem {
     std::string updated_at;
 };
 
+// placeOrder的结果：写入后的订单和订单项，包含数据库生成的id、订单号和时间
+struct PlacedOrder {
+    Order order;
+    std::vector<OrderItem> items;
+};
+
 struct AiRecommendation {
     int id;
     std::string session_id;
     int table_id;
     std::string user_id;
-    std::string image_base64;
+    std::string image_base64;     // 旧版本直接保存的base64图片，迁移后为空
     std::string vision_result;
     std::string recommendation_result;
     std::string season;
@@ -122,6 +133,7 @@ struct AiRecommendation {
     int processing_time;
     std::string created_at;
     std::string updated_at;
+    std::string image_hash;       // 图片在ImageBlobStore中的SHA-256
 };
 
 struct ClientHeartbeat {
@@ -162,13 +174,164 @@ struct ServiceCall {
     std::string updated_at;
 };
 
+// 环境数据汇总块：一个餐桌在一种汇总粒度下连续60个桶的列式压缩数据（编码见EnvironmentSeries）
+struct EnvironmentRollupBlock {
+    int table_id;
+    int resolution;          // 桶宽（秒）
+    int64_t block_start;     // 块起始时间（Unix秒）
+    int bucket_count;
+    std::string data;        // 压缩后的二进制
+};
+
+// 订单统计：order_stats_hourly的一行（某天的某个小时），或按天汇总的结果（stat_hour为-1）
+struct OrderStatsRow {
+    std::string stat_date;   // UTC日期YYYY-MM-DD，与orders.created_at一致
+    int stat_hour;           // 0-23
+    int64_t order_count;     // 下单数
+    int64_t covers;          // 就餐人数（people_count之和）
+    int64_t paid_count;      // 已支付订单数
+    int64_t revenue_cents;   // 已支付订单的final_amount之和（分），用整数累加避免增减后的浮点误差
+
+    double revenue() const { return static_cast<double>(revenue_cents) / 100.0; }
+    // 客单价：已支付订单的平均金额
+    double averageTicket() const { return paid_count > 0 ? revenue() / static_cast<double>(paid_count) : 0.0; }
+};
+
+// 实体与表列的映射（顺序与建表语句一致）
+template <>
+struct RowMapper<User> {
+    static constexpr auto columns() {
+        return std::make_tuple(&User::id, &User::user_id, &User::nickname, &User::phone, &User::email,
+                               &User::avatar_url, &User::gender, &User::age_grades, &User::body_type,
+                               &User::taste_preference, &User::dietary_restrictions,
+                               &User::created_at, &User::updated_at);
+    }
+};
+
+template <>
+struct RowMapper<Table> {
+    static constexpr auto columns() {
+        return std::make_tuple(&Table::id, &Table::table_number, &Table::table_name, &Table::seat_count,
+                               &Table::table_type, &Table::status, &Table::location, &Table::qr_code,
+                               &Table::created_at, &Table::updated_at);
+    }
+};
+
+template <>
+struct RowMapper<Dish> {
+    static constexpr auto columns() {
+        return std::make_tuple(&Dish::id, &Dish::dish_code, &Dish::dish_name, &Dish::category_id,
+                               &Dish::price, &Dish::original_price, &Dish::description, &Dish::ingredients,
+                               &Dish::nutrition_info, &Dish::taste_tags, &Dish::allergen_info,
+                               &Dish::cooking_time, &Dish::difficulty_level, &Dish::image_url, &Dish::images,
+                               &Dish::is_recommended, &Dish::is_signature, &Dish::is_available,
+                               &Dish::stock_count, &Dish::sales_count, &Dish::rating, &Dish::rating_count,
+                               &Dish::created_at, &Dish::updated_at);
+    }
+};
+
+template <>
+struct RowMapper<Order> {
+    static constexpr auto columns() {
+        return std::make_tuple(&Order::id, &Order::order_no, &Order::table_id, &Order::user_id,
+                               &Order::order_type, &Order::people_count, &Order::total_amount,
+                               &Order::discount_amount, &Order::final_amount, &Order::payment_method,
+                               &Order::payment_status, &Order::order_status, &Order::special_requirements,
+                               &Order::estimated_time, &Order::actual_time, &Order::order_time,
+                               &Order::confirm_time, &Order::complete_time, &Order::created_at, &Order::updated_at);
+    }
+};
+
+template <>
+struct RowMapper<OrderItem> {
+    static constexpr auto columns() {
+        return std::make_tuple(&OrderItem::id, &OrderItem::order_id, &OrderItem::dish_id, &OrderItem::dish_name,
+                               &OrderItem::dish_price, &OrderItem::quantity, &OrderItem::subtotal,
+                               &OrderItem::special_requirements, &OrderItem::item_status,
+                               &OrderItem::created_at, &OrderItem::updated_at);
+    }
+};
+
+template <>
+struct RowMapper<AiRecommendation> {
+    static constexpr auto columns() {
+        return std::make_tuple(&AiRecommendation::id, &AiRecommendation::session_id, &AiRecommendation::table_id,
+                               &AiRecommendation::user_id, &AiRecommendation::image_base64,
+                               &AiRecommendation::vision_result, &AiRecommendation::recommendation_result,
+                               &AiRecommendation::season, &AiRecommendation::meal_time,
+                               &AiRecommendation::people_count, &AiRecommendation::customer_portraits,
+                               &AiRecommendation::recommended_dishes, &AiRecommendation::is_accepted,
+                               &AiRecommendation::feedback_score, &AiRecommendation::feedback_comment,
+                               &AiRecommendation::processing_time, &AiRecommendation::created_at,
+                               &AiRecommendation::updated_at, &AiRecommendation::image_hash);
+    }
+};
+
+template <>
+struct RowMapper<ClientHeartbeat> {
+    static constexpr auto columns() {
+        return std::make_tuple(&ClientHeartbeat::id, &ClientHeartbeat::table_id, &ClientHeartbeat::client_id,
+                               &ClientHeartbeat::temperature, &ClientHeartbeat::light_intensity,
+                               &ClientHeartbeat::humidity, &ClientHeartbeat::noise_level,
+                               &ClientHeartbeat::battery_level, &ClientHeartbeat::signal_strength,
+                               &ClientHeartbeat::device_status, &ClientHeartbeat::last_heartbeat,
+                               &ClientHeartbeat::created_at, &ClientHeartbeat::updated_at);
+    }
+};
+
+template <>
+struct RowMapper<ServiceCall> {
+    static constexpr auto columns() {
+        return std::make_tuple(&ServiceCall::id, &ServiceCall::call_id, &ServiceCall::table_id,
+                               &ServiceCall::client_id, &ServiceCall::user_id, &ServiceCall::call_type,
+                               &ServiceCall::priority, &ServiceCall::description, &ServiceCall::call_status,
+                               &ServiceCall::assigned_staff_id, &ServiceCall::call_time,
+                               &ServiceCall::response_time, &ServiceCall::complete_time,
+                               &ServiceCall::response_duration, &ServiceCall::service_duration,
+                               &ServiceCall::customer_rating, &ServiceCall::customer_feedback,
+                               &ServiceCall::created_at, &ServiceCall::updated_at);
+    }
+};
+
+template <>
+struct RowMapper<EnvironmentRollupBlock> {
+    static constexpr auto columns() {
+        return std::make_tuple(&EnvironmentRollupBlock::table_id, &EnvironmentRollupBlock::resolution,
+                               &EnvironmentRollupBlock::block_start, &EnvironmentRollupBlock::bucket_count,
+                               &EnvironmentRollupBlock::data);
+    }
+};
+
+template <>
+struct RowMapper<OrderStatsRow> {
+    static constexpr auto columns() {
+        return std::make_tuple(&OrderStatsRow::stat_date, &OrderStatsRow::stat_hour, &OrderStatsRow::order_count,
+                               &OrderStatsRow::covers, &OrderStatsRow::paid_count, &OrderStatsRow::revenue_cents);
+    }
+};
+
+class MenuCache;
+class OrderStats;
+struct MenuSnapshot;
+class ImageBlobStore;
+struct MenuDelta;
+
+// 数据库连接选项
+struct DbOptions {
+    bool wal_mode = true;              // 启用WAL日志模式，读写互不阻塞
+    size_t read_pool_size = 4;         // 只读连接数，0表示读写共用一个连接（仅WAL模式下生效）
+    std::string synchronous = "NORMAL"; // PRAGMA synchronous：OFF/NORMAL/FULL/EXTRA
+    int64_t mmap_size = 0;             // PRAGMA mmap_size（字节），0表示不使用内存映射
+    int cache_size = -2000;            // PRAGMA cache_size，负数表示KiB
+};
+
 class RestaurantDb {
 public:
     RestaurantDb();
     ~RestaurantDb();
 
     // 初始化数据库连接
-    bool initialize(const std::string& db_path = "wisdom_restaurant.db");
+    bool initialize(const std::string& db_path = "wisdom_restaurant.db", const DbOptions& options = DbOptions());
 
     // 用户相关操作
     std::optional<User> getUserById(const std::string& user_id);
@@ -189,11 +352,32 @@ public:
     std::vector<Dish> getSignatureDishes();
     std::optional<Dish> getDishById(int dish_id);
     std::optional<Dish> getDishByCode(const std::string& dish_code);
+    // 直接覆盖库存；库存由InventoryManager维护时应调用InventoryManager::setStock，否则会被下次写回覆盖
     bool updateDishStock(int dish_id, int stock_count);
+    // 在一个事务中批量写入库存（dish_id, stock_count），不发布新菜单快照
+    bool saveDishStocks(const std::vector<std::pair<int, int>>& stocks);
+
+    // 菜单快照：菜品查询都由内存快照提供，写操作后发布新快照并递增版本号
+    std::shared_ptr<const MenuSnapshot> getMenuSnapshot() const;
+    uint64_t getMenuVersion() const;
+    // 计算since版本到snapshot之间的菜单差异，since过旧时返回全量
+    MenuDelta getMenuChanges(uint64_t since, const MenuSnapshot& snapshot) const;
+    void setMenuVersionListener(std::function<void(uint64_t)> listener);
+
+    // 从数据库重新加载整个菜单
+    bool reloadMenu();
 
     // 订单相关操作
     std::string createOrder(const Order& order);
     bool addOrderItem(const OrderItem& item);
+    // 在一个事务中写入订单和全部订单项，并扣减库存、累加销量；任一菜品不存在或库存不足时整单回滚
+    // 订单项未填菜名、单价或小计时按菜单补齐，订单未填金额时按订单项合计
+    // deduct_stock为false时不检查和扣减stock_count（库存由InventoryManager预留和写回）
+    // 销量和库存的变化只更新菜单快照中的计数，不发布新的菜单版本
+    std::optional<PlacedOrder> placeOrder(const Order& order, const std::vector<OrderItem>& items,
+                                          bool deduct_stock = true);
+    // 订单项写入成功后回调（在写入线程中调用，需在开始服务前设置）
+    void setOrderItemListener(std::function<void(const OrderItem&)> listener);
     std::optional<Order> getOrderByNo(const std::string& order_no);
     std::vector<OrderItem> getOrderItems(int order_id);
     bool updateOrderStatus(const std::string& order_no, const std::string& status);
@@ -201,15 +385,36 @@ public:
 
     // AI推荐相关操作
     bool saveAiRecommendation(const AiRecommendation& recommendation);
+    // 在一个事务中批量写入，任意一条失败时整批回滚
+    bool saveAiRecommendations(const std::vector<AiRecommendation>& recommendations);
+    // 把旧记录中的base64图片移到图片存储，只保留哈希，返回迁移的记录数
+    size_t migrateImagesToBlobStore(ImageBlobStore& store);
+
+    // 执行VACUUM回收空间；期间阻塞所有写入，耗时与数据库大小成正比
+    bool vacuum();
     std::optional<AiRecommendation> getAiRecommendation(const std::string& session_id);
     bool updateAiRecommendationFeedback(const std::string& session_id, int score, const std::string& comment);
 
-    // 心跳相关操作
+    // 心跳相关操作（运行时的心跳状态由HeartbeatStore在内存中维护，这里只负责落盘和启动时加载）
     bool updateClientHeartbeat(const ClientHeartbeat& heartbeat);
+    // 在一个事务中删除已清理的客户端并写入变化的心跳，任意一条失败时整批回滚
+    bool saveClientHeartbeats(const std::vector<ClientHeartbeat>& heartbeats,
+                              const std::vector<std::pair<int, std::string>>& removed);
     std::optional<ClientHeartbeat> getClientHeartbeat(int table_id, const std::string& client_id);
+    std::vector<ClientHeartbeat> getAllClientHeartbeats();
     std::vector<ClientHeartbeat> getActiveClients();
     bool cleanupInactiveClients(int timeout_seconds);
 
+    // 环境数据汇总块（由EnvironmentSeries读写）
+    // 在一个事务中写入（覆盖）多个块
+    bool saveEnvironmentBlocks(const std::vector<EnvironmentRollupBlock>& blocks);
+    // 读取指定餐桌和粒度下起始时间在[from, to]内的块，按起始时间排序
+    std::vector<EnvironmentRollupBlock> getEnvironmentBlocks(int table_id, int resolution, int64_t from, int64_t to);
+    // 读取指定粒度下起始时间不早于since的所有块（启动时恢复未结束的块）
+    std::vector<EnvironmentRollupBlock> getRecentEnvironmentBlocks(int resolution, int64_t since);
+    // 删除指定粒度下起始时间早于before的块
+    bool pruneEnvironmentBlocks(int resolution, int64_t before);
+
     // 服务呼叫相关操作
     std::string createServiceCall(const ServiceCall& call);
     std::vector<ServiceCall> getPendingServiceCalls();
@@ -219,14 +424,75 @@ public:
     bool completeServiceCall(const std::string& call_id, int rating, const std::string& feedback);
 
     // 统计相关操作
+    // 订单统计由order_stats_hourly汇总表提供：下单和支付状态变化时在同一事务中增量更新，
+    // 最近的数据同时保存在内存中，当天统计不访问数据库
     int getTodayOrderCount();
     double getTodayRevenue();
+    // 指定日期（UTC，YYYY-MM-DD）的全天统计，stat_hour为-1
+    OrderStatsRow getDailyOrderStats(const std::string& date);
+    // [from, to]内每天的统计（包括没有订单的日期），按日期排序
+    std::vector<OrderStatsRow> getDailyOrderStats(const std::string& from, const std::string& to);
+    // 指定日期24个小时的统计
+    std::vector<OrderStatsRow> getHourlyOrderStats(const std::string& date);
+    // 从orders表重建汇总表并重新加载内存中的统计
+    bool rebuildOrderStats();
     std::vector<std::pair<std::string, int>> getPopularDishes(int limit = 10);
     std::vector<std::pair<std::string, double>> getTableUtilization();
 
     // 生成唯一ID（公共方法）
     std::string generateSessionId();
 
+    // 获取预编译语句的执行统计
+    std::vector<StatementStats> getStatementStats();
+
+    // 类型化查询：结果行按RowMapper<T>直接读入实体
+    template <typename T>
+    std::vector<T> queryRows(const std::string& sql, const std::vector<std::string>& params = {}) {
+        std::vector<T> rows;
+        forEachStatementRow(sql, params, [&rows](sqlite3_stmt* stmt) {
+            rows.emplace_back();
+            mapRow(stmt, rows.back());
+            return true;
+        });
+        return rows;
+    }
+
+    template <typename T>
+    std::optional<T> queryOne(const std::string& sql, const std::vector<std::string>& params = {}) {
+        std::optional<T> result;
+        forEachStatementRow(sql, params, [&result](sqlite3_stmt* stmt) {
+            result.emplace();
+            mapRow(stmt, *result);
+            return false;
+        });
+        return result;
+    }
+
+    // 读取第一行第一列，没有结果或为NULL时返回std::nullopt
+    template <typename T>
+    std::optional<T> queryValue(const std::string& sql, const std::vector<std::string>& params = {}) {
+        std::optional<T> result;
+        forEachStatementRow(sql, params, [&result](sqlite3_stmt* stmt) {
+            if (sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+                result.emplace();
+                readColumn(stmt, 0, *result);
+            }
+            return false;
+        });
+        return result;
+    }
+
+    // 逐行回调而不构建完整结果；各行复用同一个对象，visitor返回false时停止
+    // 回调期间持有连接锁，visitor中不能再调用RestaurantDb的方法
+    template <typename T, typename Visitor>
+    bool forEachRow(const std::string& sql, const std::vector<std::string>& params, Visitor&& visitor) {
+        T row{};
+        return forEachStatementRow(sql, params, [&](sqlite3_stmt* stmt) {
+            mapRow(stmt, row);
+            return visitor(static_cast<const T&>(row));
+        });
+    }
+
 private:
     // 生成唯一ID（私有方法）
     std::string generateOrderNo();
@@ -235,18 +501,62 @@ private:
     // 数据库操作辅助方法
     bool executeSQL(const std::string& sql);
     bool executeSQLWithParams(const std::string& sql, const std::vector<std::string>& params);
-    std::vector<std::vector<std::string>> executeQuery(const std::string& sql);
-    std::vector<std::vector<std::string>> executeQueryWithParams(const std::string& sql, const std::vector<std::string>& params);
+    // 在写连接上执行一条语句（调用方需持有db_mutex_）
+    bool stepWithParamsLocked(const std::string& sql, const std::vector<std::string>& params);
+    // 持有db_mutex_在写连接上执行一个事务，body返回false或提交失败时回滚；what用于日志
+    // committed在提交成功后、释放锁之前调用，用于更新与数据库保持一致的内存状态
+    bool runWriteTransaction(const char* what, const std::function<bool()>& body,
+                             const std::function<void()>& committed = nullptr);
+
+    // 把订单统计增量累加到汇总表（调用方需持有db_mutex_并处于事务中）
+    bool applyOrderStatsLocked(const OrderStatsRow& delta);
+
+    // 从汇总表加载内存窗口内的订单统计（调用方需持有db_mutex_）
+    bool loadOrderStatsLocked();
+
+    // 执行查询并对每个结果行回调（读操作走只读连接池），callback返回false时停止
+    bool forEachStatementRow(const std::string& sql, const std::vector<std::string>& params,
+                             const std::function<bool(sqlite3_stmt*)>& callback);
+
+    // 只读连接
+    struct ReadConnection {
+        sqlite3* db = nullptr;
+        std::unique_ptr<StatementCache> statements;
+        std::mutex mutex;
+    };
+
+    // 在指定连接上执行查询（调用方需持有该连接的互斥锁）
+    static bool stepRowsLocked(StatementCache& statements, const std::string& sql,
+                               const std::vector<std::string>& params,
+                               const std::function<bool(sqlite3_stmt*)>& callback);
+
+    // 应用连接级PRAGMA
+    bool applyConnectionPragmas(sqlite3* db, const DbOptions& options);
+
+    // 打开只读连接池
+    bool openReadPool(const std::string& db_path, const DbOptions& options);
+
+    // 选择一个只读连接：优先空闲连接，都忙时轮询等待
+    std::unique_lock<std::mutex> acquireReader(ReadConnection*& reader);
     
     // 创建表结构
     bool createTables();
+
+    // 为旧版本数据库补充新增的列
+    bool migrateSchema();
     
     // 插入示例数据
     void insertSampleData();
     
     // 数据库连接
     sqlite3* db_;
+    std::unique_ptr<StatementCache> statements_;  // 由db_mutex_保护
     std::mutex db_mutex_;
+    std::vector<std::unique_ptr<ReadConnection>> readers_;  // WAL模式下的只读连接池
+    std::atomic<size_t> next_reader_;
+    std::unique_ptr<MenuCache> menu_cache_;
+    std::unique_ptr<OrderStats> order_stats_;
+    std::function<void(const OrderItem&)> order_item_listener_;
     bool initialized_;
 };
 
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <sqlite3.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <utility>
+
+namespace WisdomRestaurant {
+
+// 按列类型直接读取sqlite3结果，不经过字符串中转；NULL读为0或空字符串
+inline void readColumn(sqlite3_stmt* stmt, int column, int& out) {
+    out = sqlite3_column_int(stmt, column);
+}
+
+inline void readColumn(sqlite3_stmt* stmt, int column, int64_t& out) {
+    out = sqlite3_column_int64(stmt, column);
+}
+
+inline void readColumn(sqlite3_stmt* stmt, int column, double& out) {
+    out = sqlite3_column_double(stmt, column);
+}
+
+inline void readColumn(sqlite3_stmt* stmt, int column, bool& out) {
+    out = sqlite3_column_int(stmt, column) != 0;
+}
+
+// 复用out已有的容量，逐行复用同一个对象时不再分配内存
+inline void readColumn(sqlite3_stmt* stmt, int column, std::string& out) {
+    const unsigned char* text = sqlite3_column_text(stmt, column);
+    if (text) {
+        out.assign(reinterpret_cast<const char*>(text), static_cast<size_t>(sqlite3_column_bytes(stmt, column)));
+    } else {
+        out.clear();
+    }
+}
+
+// 行映射：为实体结构特化并提供columns()，按SELECT *的列顺序返回成员指针
+template <typename T>
+struct RowMapper;
+
+template <typename T, typename Columns, size_t... I>
+inline void mapColumns(sqlite3_stmt* stmt, T& row, const Columns& columns, std::index_sequence<I...>) {
+    (readColumn(stmt, static_cast<int>(I), row.*(std::get<I>(columns))), ...);
+}
+
+template <typename T, typename Columns, size_t... I>
+inline bool columnsEqual(const T& a, const T& b, const Columns& columns, std::index_sequence<I...>) {
+    return ((a.*(std::get<I>(columns)) == b.*(std::get<I>(columns))) && ...);
+}
+
+// 按映射的全部列比较两个实体
+template <typename T>
+inline bool rowsEqual(const T& a, const T& b) {
+    constexpr auto columns = RowMapper<T>::columns();
+    return columnsEqual(a, b, columns, std::make_index_sequence<std::tuple_size<decltype(columns)>::value>());
+}
+
+// 将当前结果行读入row
+template <typename T>
+inline void mapRow(sqlite3_stmt* stmt, T& row) {
+    constexpr auto columns = RowMapper<T>::columns();
+    mapColumns(stmt, row, columns, std::make_index_sequence<std::tuple_size<decltype(columns)>::value>());
+}
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <sqlite3.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace WisdomRestaurant {
+
+class Histogram;
+
+// 单条预编译语句的执行统计
+struct StatementStats {
+    std::string sql;
+    uint64_t executions;       // 执行次数
+    double total_ms;           // 累计执行耗时（毫秒，含绑定和读取结果）
+};
+
+// 预编译语句缓存
+// 按SQL文本缓存sqlite3_stmt，避免每次调用都重新解析；非线程安全，由调用方持有连接的互斥锁
+class StatementCache {
+private:
+    struct Entry {
+        sqlite3_stmt* stmt;
+        uint64_t executions;
+        std::chrono::nanoseconds total_time;
+        Histogram* latency;        // 按“操作 表名”归类的耗时直方图，多个连接共用
+    };
+
+public:
+    // 借出的语句，析构时重置语句、清除绑定并累计耗时
+    class Handle {
+    public:
+        Handle(Entry* entry);
+        Handle(Handle&& other) noexcept;
+        Handle& operator=(Handle&&) = delete;
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+        ~Handle();
+
+        sqlite3_stmt* get() const { return entry_ ? entry_->stmt : nullptr; }
+        explicit operator bool() const { return entry_ != nullptr; }
+
+    private:
+        Entry* entry_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    explicit StatementCache(sqlite3* db);
+    ~StatementCache();
+
+    StatementCache(const StatementCache&) = delete;
+    StatementCache& operator=(const StatementCache&) = delete;
+
+    // 获取预编译语句，首次使用时编译；编译失败时返回空Handle
+    Handle acquire(const std::string& sql);
+
+    // 释放所有预编译语句（关闭连接前必须调用）
+    void clear();
+
+    // 按累计耗时降序返回各语句的统计信息
+    std::vector<StatementStats> getStats() const;
+
+    // 指标中使用的语句标签，例如"select dishes"、"insert ai_recommendations"
+    static std::string statementLabel(const std::string& sql);
+
+private:
+    sqlite3* db_;
+    std::unordered_map<std::string, std::unique_ptr<Entry>> entries_;
+};
+
+} // namespace WisdomRestaurant
@@ -4,11 +4,32 @@
 #include "rapidjson/stringbuffer.h"
 #include "loguru.hpp"
 #include "ai/AiService.h"
+#include "ai/RecommendationCache.h"
 #include "db/RestaurantDb.h"
+#include "db/RecommendationWriter.h"
+#include "db/ImageBlobStore.h"
+#include "db/HeartbeatStore.h"
+#include "db/EnvironmentSeries.h"
+#include "db/PopularityTracker.h"
+#include "db/InventoryManager.h"
+#include "db/MenuCache.h"
 #include "api/RecommendationController.h"
+#include "api/AdmissionController.h"
+#include "api/DeviceController.h"
+#include "api/StatsController.h"
+#include "api/OrderController.h"
+#include "common/JobExecutor.h"
+#include "common/JsonResponse.h"
+#include "common/Metrics.h"
+#include "common/RequestTrace.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
 #include <signal.h>
 #include <cstdlib>
 #include <thread>
@@ -20,12 +41,16 @@ using namespace WisdomRestaurant;
 std::unique_ptr<httplib::Server> g_server;
 
 // 信号处理函数
+// 第一次收到信号时停止接收请求，由main等待后台任务并写完排队的推荐记录后退出；再次收到信号时立即退出
 void signalHandler(int signal) {
+    static std::atomic<bool> stopping(false);
+    if (stopping.exchange(true)) {
+        std::_Exit(1);
+    }
     LOG_F(INFO, "收到信号 %d，正在关闭服务器...", signal);
     if (g_server) {
         g_server->stop();
     }
-    exit(0);
 }
 
 // 打印启动信息
@@ -42,65 +67,338 @@ void printStartupInfo() {
     )" << std::endl;
 }
 
-// 设置CORS头
-void setCorsHeaders(httplib::Response& res) {
-    res.set_header("Access-Control-Allow-Origin", "*");
-    res.set_header("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
-    res.set_header("Access-Control-Allow-Headers", "Content-Type, Authorization, X-Requested-With");
-    res.set_header("Access-Control-Allow-Credentials", "true");
-}
-
 // 处理OPTIONS请求
 void handleOptions(const httplib::Request& req, httplib::Response& res) {
     (void)req; // 抑制未使用参数警告
-    setCorsHeaders(res);
+    JsonResponse::setCorsHeaders(res);
     res.status = 200;
 }
 
-// 构建JSON响应
-std::string buildJsonResponse(int code, const std::string& message, const std::string& data = "{}") {
-    rapidjson::Document doc;
-    doc.SetObject();
-    auto& alloc = doc.GetAllocator();
-    
-    doc.AddMember("code", code, alloc);
-    doc.AddMember("message", rapidjson::Value(message.c_str(), alloc), alloc);
-    
-    rapidjson::Document data_doc;
-    data_doc.Parse(data.c_str());
-    doc.AddMember("data", data_doc, alloc);
-    
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    doc.Accept(writer);
-    
-    return buffer.GetString();
+// 构建健康检查响应，只有时间戳会变化，按秒缓存
+std::string buildHealthResponse() {
+    static std::mutex mutex;
+    static std::time_t cached_at = 0;
+    static std::string cached_body;
+
+    std::time_t now = std::time(nullptr);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (now != cached_at) {
+        cached_body = JsonResponse::build(200, "服务器运行正常", [now](JsonResponse::JsonWriter& writer) {
+            writer.StartObject();
+            writer.Key("status");
+            writer.String("healthy");
+            writer.Key("timestamp");
+            writer.Int64(static_cast<int64_t>(now));
+            writer.EndObject();
+        });
+        cached_at = now;
+    }
+    return cached_body;
+}
+
+// 按路由模板归类请求路径，未注册的路径统一归为other，避免指标标签无限增长
+std::string routeLabel(const std::string& path) {
+    static const std::unordered_set<std::string> routes = {
+        "/", "/metrics", "/api/v1/health", "/api/v1/server/stats",
+        "/api/v1/recommendation", "/api/v1/recommendation/stream", "/api/v1/recommendation/history",
+        "/api/v1/recommendation/feedback", "/api/v1/dishes/recommended", "/api/v1/dishes/changes",
+        "/api/v1/dishes/popular",
+        "/api/v1/heartbeat", "/api/v1/environment", "/api/v1/service/call", "/api/v1/service/calls",
+        "/api/v1/service/response", "/api/v1/service/complete", "/api/v1/tables/status", "/api/v1/clients/active",
+        "/api/v1/stats/orders", "/api/v1/orders", "/api/v1/inventory", "/api/v1/inventory/stock",
+        "/api/v1/inventory/reservations", "/api/v1/inventory/reservations/release"
+    };
+    static const std::string session_prefix = "/api/v1/recommendation/AI";
+    if (path.compare(0, session_prefix.size(), session_prefix) == 0) {
+        return "/api/v1/recommendation/{session_id}";
+    }
+    return routes.count(path) ? path : "other";
+}
+
+// 当前线程正在处理的请求的开始时间
+thread_local std::chrono::steady_clock::time_point t_request_start;
+
+// 记录请求耗时和状态码；指标引用按线程缓存，热路径不经过注册表的锁
+void recordHttpRequest(const httplib::Request& req, const httplib::Response& res) {
+    thread_local std::unordered_map<std::string, Histogram*> durations;
+    thread_local std::unordered_map<std::string, Counter*> requests;
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_request_start).count();
+    std::string route = routeLabel(req.path);
+    std::string key = req.method + " " + route;
+
+    auto duration = durations.find(key);
+    if (duration == durations.end()) {
+        duration = durations.emplace(key, &MetricsRegistry::instance().histogram(
+            "wisdom_http_request_duration_seconds", "HTTP request duration by route",
+            {{"method", req.method}, {"route", route}})).first;
+    }
+    duration->second->observe(seconds);
+
+    std::string status = std::to_string(res.status);
+    key += " " + status;
+    auto counter = requests.find(key);
+    if (counter == requests.end()) {
+        counter = requests.emplace(key, &MetricsRegistry::instance().counter(
+            "wisdom_http_requests_total", "HTTP requests by route and status code",
+            {{"method", req.method}, {"route", route}, {"status", status}})).first;
+    }
+    counter->second->inc();
+}
+
+// 把各模块已有的统计信息注册为抓取时的指标
+void registerMetricCollectors(std::shared_ptr<AiService> ai_service, std::shared_ptr<RestaurantDb> db,
+                              std::shared_ptr<JobExecutor> job_executor,
+                              std::shared_ptr<RecommendationController> rec_controller,
+                              std::shared_ptr<AdmissionController> admission,
+                              std::shared_ptr<RecommendationWriter> rec_writer,
+                              std::shared_ptr<ImageBlobStore> image_store,
+                              std::shared_ptr<HeartbeatStore> heartbeat_store,
+                              std::shared_ptr<EnvironmentSeries> environment,
+                              std::shared_ptr<PopularityTracker> popularity,
+                              std::shared_ptr<InventoryManager> inventory) {
+    MetricsRegistry& registry = MetricsRegistry::instance();
+
+    registry.addCollector([admission](MetricsWriter& writer) {
+        AdmissionStats stats = admission->getStats();
+        writer.gauge("wisdom_http_queue_depth", "Connections waiting for an HTTP worker", {},
+                     static_cast<double>(stats.queue_depth));
+        writer.gauge("wisdom_http_workers", "HTTP worker threads", {}, static_cast<double>(stats.workers));
+        const char* connections_help = "HTTP connections by admission result";
+        writer.counter("wisdom_http_connections_total", connections_help, {{"result", "accepted"}},
+                       static_cast<double>(stats.connections_accepted));
+        writer.counter("wisdom_http_connections_total", connections_help, {{"result", "shed"}},
+                       static_cast<double>(stats.connections_shed));
+        writer.counter("wisdom_http_connections_total", connections_help, {{"result", "dropped"}},
+                       static_cast<double>(stats.connections_dropped));
+        for (RequestPriority priority : {RequestPriority::Critical, RequestPriority::Normal, RequestPriority::Bulk}) {
+            size_t i = static_cast<size_t>(priority);
+            MetricLabels labels = {{"priority", requestPriorityName(priority)}};
+            writer.gauge("wisdom_http_inflight_requests", "Requests being processed by priority", labels,
+                         static_cast<double>(stats.inflight[i]));
+            writer.counter("wisdom_http_admitted_total", "Requests admitted by priority", labels,
+                           static_cast<double>(stats.admitted[i]));
+            writer.counter("wisdom_http_shed_total", "Requests rejected with 503 by priority", labels,
+                           static_cast<double>(stats.shed[i]));
+        }
+    });
+
+    registry.addCollector([job_executor](MetricsWriter& writer) {
+        JobExecutorStats stats = job_executor->getStats();
+        MetricLabels labels = {{"executor", job_executor->name()}};
+        writer.gauge("wisdom_job_queue_depth", "Queued background jobs", labels, static_cast<double>(stats.queue_depth));
+        writer.gauge("wisdom_job_active_workers", "Workers running a background job", labels,
+                     static_cast<double>(stats.active_workers));
+        writer.counter("wisdom_job_submitted_total", "Background jobs accepted", labels, static_cast<double>(stats.submitted));
+        writer.counter("wisdom_job_rejected_total", "Background jobs rejected because the queue was full", labels,
+                       static_cast<double>(stats.rejected));
+        writer.counter("wisdom_job_completed_total", "Background jobs finished", labels, static_cast<double>(stats.completed));
+    });
+
+    registry.addCollector([ai_service](MetricsWriter& writer) {
+        RecommendationCacheStats cache = ai_service->getRecommendationCacheStats();
+        const char* cache_help = "Recommendation cache events";
+        writer.counter("wisdom_rec_cache_events_total", cache_help, {{"event", "hit"}}, static_cast<double>(cache.hits));
+        writer.counter("wisdom_rec_cache_events_total", cache_help, {{"event", "miss"}}, static_cast<double>(cache.misses));
+        writer.counter("wisdom_rec_cache_events_total", cache_help, {{"event", "coalesced"}},
+                       static_cast<double>(cache.coalesced));
+        writer.counter("wisdom_rec_cache_events_total", cache_help, {{"event", "eviction"}},
+                       static_cast<double>(cache.evictions));
+        writer.counter("wisdom_rec_cache_events_total", cache_help, {{"event", "expiration"}},
+                       static_cast<double>(cache.expirations));
+        writer.gauge("wisdom_rec_cache_entries", "Recommendation cache entries", {}, static_cast<double>(cache.entries));
+
+        CurlPoolStats pool = ai_service->getCurlPoolStats();
+        writer.counter("wisdom_ai_connections_total", "LLM API requests by connection reuse", {{"connection", "new"}},
+                       static_cast<double>(pool.new_connections));
+        writer.counter("wisdom_ai_connections_total", "LLM API requests by connection reuse", {{"connection", "reused"}},
+                       static_cast<double>(pool.reused_connections));
+        writer.counter("wisdom_ai_handshake_seconds_total", "Time spent in TCP and TLS handshakes", {},
+                       pool.handshake_ms_total / 1000.0);
+        writer.gauge("wisdom_ai_idle_handles", "Idle CURL handles in the pool", {}, static_cast<double>(pool.idle_handles));
+
+        UploadStats upload = ai_service->getUploadStats();
+        writer.counter("wisdom_ai_upload_bytes_total", "Request body bytes sent to the LLM API", {},
+                       static_cast<double>(upload.bytes_sent));
+    });
+
+    registry.addCollector([rec_controller](MetricsWriter& writer) {
+        VisionDedupeStats dedupe = rec_controller->getVisionDedupeStats();
+        const char* dedupe_help = "Camera frame dedupe lookups by result";
+        writer.counter("wisdom_vision_dedupe_total", dedupe_help, {{"result", "hit"}}, static_cast<double>(dedupe.hits));
+        writer.counter("wisdom_vision_dedupe_total", dedupe_help, {{"result", "miss"}}, static_cast<double>(dedupe.misses));
+        writer.counter("wisdom_vision_dedupe_total", dedupe_help, {{"result", "unhashable"}},
+                       static_cast<double>(dedupe.unhashable));
+        writer.counter("wisdom_vision_dedupe_saved_seconds_total", "Vision model time saved by frame dedupe", {},
+                       dedupe.saved_ms_total / 1000.0);
+
+        LongPollStats polls = rec_controller->getLongPollStats();
+        writer.gauge("wisdom_rec_long_polls_waiting", "Recommendation result long-polls waiting", {},
+                     static_cast<double>(polls.waiting));
+        writer.gauge("wisdom_rec_long_polls_max", "Maximum concurrent recommendation result long-polls", {},
+                     static_cast<double>(polls.max_waiting));
+        writer.counter("wisdom_rec_long_polls_rejected_total",
+                       "Long-polls answered immediately because the limit was reached", {},
+                       static_cast<double>(polls.rejected));
+
+        // 两种执行模式的端到端耗时分位数，用于比较two_stage和combined
+        for (PipelineMode mode : {PipelineMode::TwoStage, PipelineMode::Combined}) {
+            LatencySummary latency = rec_controller->getPipelineLatency(mode);
+            const char* latency_help = "Recommendation pipeline latency quantiles by mode";
+            const char* name = pipelineModeName(mode);
+            writer.gauge("wisdom_rec_pipeline_latency_seconds", latency_help, {{"mode", name}, {"quantile", "0.5"}},
+                         latency.p50_ms / 1000.0);
+            writer.gauge("wisdom_rec_pipeline_latency_seconds", latency_help, {{"mode", name}, {"quantile", "0.9"}},
+                         latency.p90_ms / 1000.0);
+            writer.gauge("wisdom_rec_pipeline_latency_seconds", latency_help, {{"mode", name}, {"quantile", "0.99"}},
+                         latency.p99_ms / 1000.0);
+            writer.counter("wisdom_rec_pipeline_runs_total", "Recommendation pipeline runs by mode", {{"mode", name}},
+                           static_cast<double>(latency.count));
+        }
+    });
+
+    if (rec_writer) {
+        registry.addCollector([rec_writer](MetricsWriter& writer) {
+            RecommendationWriterStats stats = rec_writer->getStats();
+            writer.gauge("wisdom_rec_writer_queue_depth", "Recommendation records waiting to be written", {},
+                         static_cast<double>(stats.queue_depth));
+            const char* records_help = "Recommendation records by write result";
+            writer.counter("wisdom_rec_writer_records_total", records_help, {{"result", "written"}},
+                           static_cast<double>(stats.written));
+            writer.counter("wisdom_rec_writer_records_total", records_help, {{"result", "failed"}},
+                           static_cast<double>(stats.failed));
+            writer.counter("wisdom_rec_writer_blocked_total", "Enqueues that waited because the queue was full", {},
+                           static_cast<double>(stats.blocked));
+            writer.counter("wisdom_rec_writer_sync_fallbacks_total",
+                           "Records written on the request thread after the queue stayed full", {},
+                           static_cast<double>(stats.sync_fallbacks));
+        });
+    }
+
+    if (image_store) {
+        registry.addCollector([image_store](MetricsWriter& writer) {
+            ImageBlobStoreStats stats = image_store->getStats();
+            writer.gauge("wisdom_image_store_files", "Images in the blob store", {}, static_cast<double>(stats.files));
+            writer.gauge("wisdom_image_store_bytes", "Total size of the blob store", {}, static_cast<double>(stats.bytes));
+            const char* puts_help = "Image writes by result";
+            writer.counter("wisdom_image_store_puts_total", puts_help, {{"result", "stored"}},
+                           static_cast<double>(stats.stored));
+            writer.counter("wisdom_image_store_puts_total", puts_help, {{"result", "deduplicated"}},
+                           static_cast<double>(stats.deduplicated));
+            writer.counter("wisdom_image_store_puts_total", puts_help, {{"result", "error"}},
+                           static_cast<double>(stats.errors));
+            writer.counter("wisdom_image_store_pruned_total", "Images removed by retention or size cap", {},
+                           static_cast<double>(stats.pruned));
+        });
+    }
+
+    registry.addCollector([heartbeat_store](MetricsWriter& writer) {
+        HeartbeatStoreStats stats = heartbeat_store->getStats();
+        const char* clients_help = "Table clients in the heartbeat state table";
+        writer.gauge("wisdom_heartbeat_clients", clients_help, {{"state", "active"}},
+                     static_cast<double>(stats.active_clients));
+        writer.gauge("wisdom_heartbeat_clients", clients_help, {{"state", "known"}}, static_cast<double>(stats.clients));
+        writer.counter("wisdom_heartbeats_total", "Heartbeats received", {}, static_cast<double>(stats.heartbeats));
+        writer.counter("wisdom_heartbeat_rows_written_total", "Heartbeat rows written to SQLite", {},
+                       static_cast<double>(stats.rows_written));
+        writer.counter("wisdom_heartbeat_flush_failures_total", "Failed heartbeat flush transactions", {},
+                       static_cast<double>(stats.flush_failures));
+    });
+
+    registry.addCollector([environment](MetricsWriter& writer) {
+        EnvironmentSeriesStats stats = environment->getStats();
+        const char* samples_help = "Environment samples by result";
+        writer.counter("wisdom_environment_samples_total", samples_help, {{"result", "accepted"}},
+                       static_cast<double>(stats.samples));
+        writer.counter("wisdom_environment_samples_total", samples_help, {{"result", "rejected"}},
+                       static_cast<double>(stats.rejected));
+        writer.gauge("wisdom_environment_resident_blocks", "Rollup blocks held in memory", {},
+                     static_cast<double>(stats.resident_blocks));
+        writer.counter("wisdom_environment_blocks_written_total", "Rollup blocks written to SQLite", {},
+                       static_cast<double>(stats.blocks_written));
+        writer.counter("wisdom_environment_bytes_written_total", "Encoded rollup bytes written to SQLite", {},
+                       static_cast<double>(stats.bytes_written));
+        writer.counter("wisdom_environment_flush_failures_total", "Failed rollup flush transactions", {},
+                       static_cast<double>(stats.flush_failures));
+    });
+
+    registry.addCollector([popularity](MetricsWriter& writer) {
+        PopularityStats stats = popularity->getStats();
+        const char* events_help = "Order items fed to the popularity tracker by result";
+        writer.counter("wisdom_popularity_events_total", events_help, {{"result", "recorded"}},
+                       static_cast<double>(stats.events));
+        writer.counter("wisdom_popularity_events_total", events_help, {{"result", "dropped"}},
+                       static_cast<double>(stats.dropped));
+        writer.gauge("wisdom_popularity_tracked", "Tracked (slice, dish) counters", {},
+                     static_cast<double>(stats.tracked));
+    });
+
+    registry.addCollector([inventory](MetricsWriter& writer) {
+        InventoryStats stats = inventory->getStats();
+        writer.gauge("wisdom_inventory_dishes", "Dishes with in-memory stock counters", {},
+                     static_cast<double>(stats.dishes));
+        writer.gauge("wisdom_inventory_sold_out", "Dishes currently sold out", {}, static_cast<double>(stats.sold_out));
+        writer.gauge("wisdom_inventory_reservations", "Outstanding stock reservations", {},
+                     static_cast<double>(stats.reservations));
+        const char* reservations_help = "Stock reservations by outcome";
+        writer.counter("wisdom_inventory_reservations_total", reservations_help, {{"result", "reserved"}},
+                       static_cast<double>(stats.reserved));
+        writer.counter("wisdom_inventory_reservations_total", reservations_help, {{"result", "rejected"}},
+                       static_cast<double>(stats.rejected));
+        writer.counter("wisdom_inventory_reservations_total", reservations_help, {{"result", "committed"}},
+                       static_cast<double>(stats.committed));
+        writer.counter("wisdom_inventory_reservations_total", reservations_help, {{"result", "released"}},
+                       static_cast<double>(stats.released));
+        writer.counter("wisdom_inventory_reservations_total", reservations_help, {{"result", "expired"}},
+                       static_cast<double>(stats.expired));
+        writer.counter("wisdom_inventory_rows_written_total", "Stock rows written back to SQLite", {},
+                       static_cast<double>(stats.rows_written));
+        writer.counter("wisdom_inventory_flush_failures_total", "Failed stock write-back transactions", {},
+                       static_cast<double>(stats.flush_failures));
+    });
+
+    registry.addCollector([db](MetricsWriter& writer) {
+        writer.gauge("wisdom_menu_version", "Current menu snapshot version", {}, static_cast<double>(db->getMenuVersion()));
+    });
 }
 
 // 配置路由
 void setupRoutes(httplib::Server& server, 
-                std::shared_ptr<RecommendationController> rec_controller) {
+                std::shared_ptr<RecommendationController> rec_controller,
+                std::shared_ptr<DeviceController> device_controller,
+                std::shared_ptr<StatsController> stats_controller,
+                std::shared_ptr<OrderController> order_controller,
+                std::shared_ptr<AdmissionController> admission) {
     
     LOG_F(INFO, "配置API路由...");
 
     // 健康检查接口
     server.Get("/api/v1/health", [](const httplib::Request& req, httplib::Response& res) {
         (void)req; // 抑制未使用参数警告
-        setCorsHeaders(res);
-        res.set_content(buildJsonResponse(200, "服务器运行正常", 
-            R"({"status":"healthy","timestamp":)" + std::to_string(std::time(nullptr)) + "}"), 
-            "application/json; charset=utf-8");
+        JsonResponse::setCorsHeaders(res);
+        res.set_content(buildHealthResponse(), "application/json; charset=utf-8");
     });
 
     // 智能推荐相关路由
-    server.Post("/api/v1/recommendation", [rec_controller](const httplib::Request& req, httplib::Response& res) {
-        rec_controller->handleRecommendation(req, res);
+    // 推荐接口使用ContentReader边接收边校验图片大小
+    server.Post("/api/v1/recommendation", [rec_controller](const httplib::Request& req, httplib::Response& res,
+                                                           const httplib::ContentReader& content_reader) {
+        rec_controller->handleRecommendation(req, res, content_reader);
+        });
+
+    server.Post("/api/v1/recommendation/stream", [rec_controller](const httplib::Request& req, httplib::Response& res,
+                                                                  const httplib::ContentReader& content_reader) {
+        rec_controller->handleRecommendationStream(req, res, content_reader);
         });
 
     server.Get("/api/v1/recommendation/history", [rec_controller](const httplib::Request& req, httplib::Response& res) {
         rec_controller->handleGetRecommendationHistory(req, res);
         });
 
+    server.Get(R"(/api/v1/recommendation/(AI\d+))", [rec_controller](const httplib::Request& req, httplib::Response& res) {
+        rec_controller->handleGetRecommendationResult(req, res);
+        });
+
     server.Post("/api/v1/recommendation/feedback", [rec_controller](const httplib::Request& req, httplib::Response& res) {
         rec_controller->handleRecommendationFeedback(req, res);
         });
@@ -109,67 +407,143 @@ void setupRoutes(httplib::Server& server,
         rec_controller->handleGetRecommendedDishes(req, res);
         });
 
+    server.Get("/api/v1/dishes/changes", [rec_controller](const httplib::Request& req, httplib::Response& res) {
+        rec_controller->handleGetDishChanges(req, res);
+        });
+
+    server.Get("/api/v1/dishes/popular", [rec_controller](const httplib::Request& req, httplib::Response& res) {
+        rec_controller->handleGetPopularDishes(req, res);
+        });
+
     // 通信协议相关路由
-    server.Post("/api/v1/heartbeat", [](const httplib::Request& req, httplib::Response& res) {
-        (void)req; // 抑制未使用参数警告
-        setCorsHeaders(res);
-        res.set_content(buildJsonResponse(200, "心跳功能正在适配中"), "application/json; charset=utf-8");
+    server.Post("/api/v1/heartbeat", [device_controller](const httplib::Request& req, httplib::Response& res) {
+        device_controller->handleHeartbeat(req, res);
     });
 
-    server.Post("/api/v1/environment", [](const httplib::Request& req, httplib::Response& res) {
-        (void)req; // 抑制未使用参数警告
-        setCorsHeaders(res);
-        res.set_content(buildJsonResponse(200, "环境数据功能正在适配中"), "application/json; charset=utf-8");
+    server.Post("/api/v1/environment", [device_controller](const httplib::Request& req, httplib::Response& res) {
+        device_controller->handleEnvironmentReport(req, res);
+    });
+
+    server.Get("/api/v1/environment", [device_controller](const httplib::Request& req, httplib::Response& res) {
+        device_controller->handleGetEnvironment(req, res);
     });
 
-    server.Post("/api/v1/service/call", [](const httplib::Request& req, httplib::Response& res) {
+    server.Post("/api/v1/service/call", [body = JsonResponse::build(200, "服务呼叫功能正在适配中")](const httplib::Request& req, httplib::Response& res) {
         (void)req; // 抑制未使用参数警告
-        setCorsHeaders(res);
-        res.set_content(buildJsonResponse(200, "服务呼叫功能正在适配中"), "application/json; charset=utf-8");
+        JsonResponse::setCorsHeaders(res);
+        res.set_content(body, "application/json; charset=utf-8");
     });
 
-    server.Get("/api/v1/service/calls", [](const httplib::Request& req, httplib::Response& res) {
+    server.Get("/api/v1/service/calls", [body = JsonResponse::build(200, "服务呼叫列表功能正在适配中")](const httplib::Request& req, httplib::Response& res) {
         (void)req; // 抑制未使用参数警告
-        setCorsHeaders(res);
-        res.set_content(buildJsonResponse(200, "服务呼叫列表功能正在适配中"), "application/json; charset=utf-8");
+        JsonResponse::setCorsHeaders(res);
+        res.set_content(body, "application/json; charset=utf-8");
     });
 
-    server.Post("/api/v1/service/response", [](const httplib::Request& req, httplib::Response& res) {
+    server.Post("/api/v1/service/response", [body = JsonResponse::build(200, "服务响应功能正在适配中")](const httplib::Request& req, httplib::Response& res) {
         (void)req; // 抑制未使用参数警告
-        setCorsHeaders(res);
-        res.set_content(buildJsonResponse(200, "服务响应功能正在适配中"), "application/json; charset=utf-8");
+        JsonResponse::setCorsHeaders(res);
+        res.set_content(body, "application/json; charset=utf-8");
     });
 
-    server.Post("/api/v1/service/complete", [](const httplib::Request& req, httplib::Response& res) {
+    server.Post("/api/v1/service/complete", [body = JsonResponse::build(200, "服务完成功能正在适配中")](const httplib::Request& req, httplib::Response& res) {
         (void)req; // 抑制未使用参数警告
-        setCorsHeaders(res);
-        res.set_content(buildJsonResponse(200, "服务完成功能正在适配中"), "application/json; charset=utf-8");
+        JsonResponse::setCorsHeaders(res);
+        res.set_content(body, "application/json; charset=utf-8");
         });
 
     // 餐桌管理相关路由
-    server.Get("/api/v1/tables/status", [](const httplib::Request& req, httplib::Response& res) {
+    server.Get("/api/v1/tables/status", [body = JsonResponse::build(200, "餐桌状态功能正在适配中")](const httplib::Request& req, httplib::Response& res) {
         (void)req; // 抑制未使用参数警告
-        setCorsHeaders(res);
-        res.set_content(buildJsonResponse(200, "餐桌状态功能正在适配中"), "application/json; charset=utf-8");
+        JsonResponse::setCorsHeaders(res);
+        res.set_content(body, "application/json; charset=utf-8");
     });
 
-    server.Post("/api/v1/tables/status", [](const httplib::Request& req, httplib::Response& res) {
+    server.Post("/api/v1/tables/status", [body = JsonResponse::build(200, "更新餐桌状态功能正在适配中")](const httplib::Request& req, httplib::Response& res) {
         (void)req; // 抑制未使用参数警告
-        setCorsHeaders(res);
-        res.set_content(buildJsonResponse(200, "更新餐桌状态功能正在适配中"), "application/json; charset=utf-8");
+        JsonResponse::setCorsHeaders(res);
+        res.set_content(body, "application/json; charset=utf-8");
     });
 
-    server.Get("/api/v1/clients/active", [](const httplib::Request& req, httplib::Response& res) {
-            (void)req; // 抑制未使用参数警告
-        setCorsHeaders(res);
-        res.set_content(buildJsonResponse(200, "活跃客户端功能正在适配中"), "application/json; charset=utf-8");
+    server.Get("/api/v1/clients/active", [device_controller](const httplib::Request& req, httplib::Response& res) {
+        device_controller->handleGetActiveClients(req, res);
         });
 
-    // 根路径 - 显示API文档
-    server.Get("/", [](const httplib::Request& req, httplib::Response& res) {
-            (void)req; // 抑制未使用参数警告
-        setCorsHeaders(res);
-        std::string html = R"(
+    // 经营统计
+    server.Get("/api/v1/stats/orders", [stats_controller](const httplib::Request& req, httplib::Response& res) {
+        stats_controller->handleGetOrderStats(req, res);
+    });
+
+    // 下单和库存
+    server.Post("/api/v1/orders", [order_controller](const httplib::Request& req, httplib::Response& res) {
+        order_controller->handleCreateOrder(req, res);
+    });
+
+    server.Get("/api/v1/inventory", [order_controller](const httplib::Request& req, httplib::Response& res) {
+        order_controller->handleGetInventory(req, res);
+    });
+
+    server.Post("/api/v1/inventory/stock", [order_controller](const httplib::Request& req, httplib::Response& res) {
+        order_controller->handleSetStock(req, res);
+    });
+
+    server.Post("/api/v1/inventory/reservations", [order_controller](const httplib::Request& req, httplib::Response& res) {
+        order_controller->handleReserve(req, res);
+    });
+
+    server.Post("/api/v1/inventory/reservations/release",
+                [order_controller](const httplib::Request& req, httplib::Response& res) {
+        order_controller->handleRelease(req, res);
+    });
+
+    // Prometheus指标
+    server.Get("/metrics", [](const httplib::Request& req, httplib::Response& res) {
+        (void)req; // 抑制未使用参数警告
+        res.set_content(MetricsRegistry::instance().render(), "text/plain; version=0.0.4; charset=utf-8");
+    });
+
+    // 工作线程池排队和限流统计
+    server.Get("/api/v1/server/stats", [admission](const httplib::Request& req, httplib::Response& res) {
+        (void)req; // 抑制未使用参数警告
+        JsonResponse::setCorsHeaders(res);
+        AdmissionStats stats = admission->getStats();
+        res.set_content(JsonResponse::build(200, "获取服务器状态成功", [&stats](JsonResponse::JsonWriter& writer) {
+            writer.StartObject();
+            writer.Key("workers");
+            writer.Uint64(stats.workers);
+            writer.Key("queue_depth");
+            writer.Uint64(stats.queue_depth);
+            writer.Key("max_queue_depth");
+            writer.Uint64(stats.max_queue_depth);
+            writer.Key("max_queued");
+            writer.Uint64(stats.max_queued);
+            writer.Key("connections_accepted");
+            writer.Uint64(stats.connections_accepted);
+            writer.Key("connections_shed");
+            writer.Uint64(stats.connections_shed);
+            writer.Key("connections_dropped");
+            writer.Uint64(stats.connections_dropped);
+            writer.Key("priorities");
+            writer.StartObject();
+            for (RequestPriority priority : {RequestPriority::Critical, RequestPriority::Normal, RequestPriority::Bulk}) {
+                size_t i = static_cast<size_t>(priority);
+                writer.Key(requestPriorityName(priority));
+                writer.StartObject();
+                writer.Key("inflight");
+                writer.Uint64(stats.inflight[i]);
+                writer.Key("admitted");
+                writer.Uint64(stats.admitted[i]);
+                writer.Key("shed");
+                writer.Uint64(stats.shed[i]);
+                writer.EndObject();
+            }
+            writer.EndObject();
+            writer.EndObject();
+        }), "application/json; charset=utf-8");
+    });
+
+    // 根路径 - 显示API文档（页面内容固定，只构建一次）
+    const std::string index_html = R"(
                 <!DOCTYPE html>
                 <html>
                 <head>
@@ -206,6 +580,14 @@ void setupRoutes(httplib::Server& server,
                             <div class="api-item">
                                 <span class="method">POST</span> <span class="path">/api/v1/recommendation</span>
                 <span class="desc">智能菜品推荐 🔄</span>
+                            </div>
+                            <div class="api-item">
+                                <span class="method">POST</span> <span class="path">/api/v1/recommendation/stream</span>
+                <span class="desc">流式菜品推荐 (SSE) 🔄</span>
+                            </div>
+                            <div class="api-item">
+                                <span class="method">GET</span> <span class="path">/api/v1/recommendation/{session_id}</span>
+                <span class="desc">获取异步推荐结果 🔄</span>
                             </div>
                             <div class="api-item">
                                 <span class="method">GET</span> <span class="path">/api/v1/recommendation/history</span>
@@ -219,15 +601,51 @@ void setupRoutes(httplib::Server& server,
                                 <span class="method">GET</span> <span class="path">/api/v1/dishes/recommended</span>
                 <span class="desc">获取推荐菜品 🔄</span>
                             </div>
+                            <div class="api-item">
+                                <span class="method">GET</span> <span class="path">/api/v1/dishes/changes</span>
+                <span class="desc">菜单增量同步 ✅</span>
+                            </div>
+                            <div class="api-item">
+                                <span class="method">GET</span> <span class="path">/api/v1/dishes/popular</span>
+                <span class="desc">热销菜品排行 ✅</span>
+                            </div>
+                            <div class="api-item">
+                                <span class="method">GET</span> <span class="path">/api/v1/server/stats</span>
+                <span class="desc">服务器负载状态 ✅</span>
+                            </div>
+                            <div class="api-item">
+                                <span class="method">GET</span> <span class="path">/api/v1/stats/orders</span>
+                <span class="desc">订单统计 ✅</span>
+                            </div>
+                            <div class="api-item">
+                                <span class="method">POST</span> <span class="path">/api/v1/orders</span>
+                <span class="desc">下单 ✅</span>
+                            </div>
+                            <div class="api-item">
+                                <span class="method">GET</span> <span class="path">/api/v1/inventory</span>
+                <span class="desc">实时库存 ✅</span>
+                            </div>
+                            <div class="api-item">
+                                <span class="method">POST</span> <span class="path">/api/v1/inventory/reservations</span>
+                <span class="desc">库存预留 ✅</span>
+                            </div>
+                            <div class="api-item">
+                                <span class="method">GET</span> <span class="path">/metrics</span>
+                <span class="desc">Prometheus指标 ✅</span>
+                            </div>
                             
             <h4>📡 通信协议 (适配中)</h4>
                             <div class="api-item">
                                 <span class="method">POST</span> <span class="path">/api/v1/heartbeat</span>
-                <span class="desc">客户端心跳 🔄</span>
+                <span class="desc">客户端心跳 ✅</span>
                             </div>
                             <div class="api-item">
                                 <span class="method">POST</span> <span class="path">/api/v1/environment</span>
-                <span class="desc">环境数据上报 🔄</span>
+                <span class="desc">环境数据上报 ✅</span>
+                            </div>
+                            <div class="api-item">
+                                <span class="method">GET</span> <span class="path">/api/v1/environment</span>
+                <span class="desc">环境数据查询 ✅</span>
                             </div>
                             <div class="api-item">
                                 <span class="method">POST</span> <span class="path">/api/v1/service/call</span>
@@ -249,7 +667,7 @@ void setupRoutes(httplib::Server& server,
                             </div>
                             <div class="api-item">
                                 <span class="method">GET</span> <span class="path">/api/v1/clients/active</span>
-                <span class="desc">获取活跃客户端 🔄</span>
+                <span class="desc">获取活跃客户端 ✅</span>
                             </div>
                         </div>
                         
@@ -273,8 +691,12 @@ void setupRoutes(httplib::Server& server,
                     </script>
                 </body>
                 </html>
-        )";
-        res.set_content(html, "text/html; charset=utf-8");
+    )";
+
+    server.Get("/", [index_html](const httplib::Request& req, httplib::Response& res) {
+            (void)req; // 抑制未使用参数警告
+        JsonResponse::setCorsHeaders(res);
+        res.set_content(index_html, "text/html; charset=utf-8");
         });
 
     // 处理OPTIONS请求
@@ -302,9 +724,13 @@ int main(int argc, char* argv[]) {
         const char* db_path_env = std::getenv("DB_PATH");
         std::string db_path = db_path_env ? db_path_env : "wisdom_restaurant.db";
 
+        const char* max_image_env = std::getenv("MAX_IMAGE_SIZE");
+        size_t max_image_size = max_image_env ? std::strtoull(max_image_env, nullptr, 10) : 10 * 1024 * 1024;
+
         LOG_F(INFO, "服务器配置:");
         LOG_F(INFO, "  端口: %d", port);
         LOG_F(INFO, "  数据库: %s", db_path.c_str());
+        LOG_F(INFO, "  图片大小上限: %zu 字节", max_image_size);
 
         // 初始化AI服务
         LOG_F(INFO, "初始化AI服务...");
@@ -316,22 +742,329 @@ int main(int argc, char* argv[]) {
 
         // 初始化数据库
         LOG_F(INFO, "初始化SQLite数据库连接...");
+        DbOptions db_options;
+        const char* wal_env = std::getenv("DB_WAL_MODE");
+        if (wal_env) {
+            db_options.wal_mode = std::atoi(wal_env) != 0;
+        }
+        const char* read_pool_env = std::getenv("DB_READ_POOL_SIZE");
+        if (read_pool_env) {
+            db_options.read_pool_size = static_cast<size_t>(std::max(std::atoi(read_pool_env), 0));
+        }
+        const char* synchronous_env = std::getenv("DB_SYNCHRONOUS");
+        if (synchronous_env && *synchronous_env) {
+            db_options.synchronous = synchronous_env;
+        }
+        const char* mmap_env = std::getenv("DB_MMAP_SIZE");
+        if (mmap_env) {
+            db_options.mmap_size = std::strtoll(mmap_env, nullptr, 10);
+        }
+        const char* cache_env = std::getenv("DB_CACHE_SIZE");
+        if (cache_env) {
+            db_options.cache_size = std::atoi(cache_env);
+        }
+
         auto db = std::make_shared<RestaurantDb>();
-        if (!db->initialize(db_path)) {
+        if (!db->initialize(db_path, db_options)) {
             LOG_F(ERROR, "数据库初始化失败！");
             return 1;
         }
+        // 订单统计汇总与orders不一致时（如手工修改过订单）可设置ORDER_STATS_REBUILD=1在启动时重建
+        const char* stats_rebuild_env = std::getenv("ORDER_STATS_REBUILD");
+        if (stats_rebuild_env && std::atoi(stats_rebuild_env) != 0 && !db->rebuildOrderStats()) {
+            LOG_F(ERROR, "重建订单统计失败！");
+            return 1;
+        }
+
+        // 顾客画面按内容寻址保存在文件中，IMAGE_STORE_DIR为空时仍以base64保存在数据库
+        const char* image_dir_env = std::getenv("IMAGE_STORE_DIR");
+        std::shared_ptr<ImageBlobStore> image_store;
+        if (!image_dir_env || *image_dir_env) {
+            ImageBlobStoreOptions image_options;
+            if (image_dir_env) {
+                image_options.directory = image_dir_env;
+            }
+            const char* retention_env = std::getenv("IMAGE_RETENTION_DAYS");
+            if (retention_env) {
+                image_options.retention_days = std::max(std::atoi(retention_env), 0);
+            }
+            const char* image_max_env = std::getenv("IMAGE_STORE_MAX_MB");
+            if (image_max_env) {
+                image_options.max_bytes = static_cast<uint64_t>(std::max(std::atoll(image_max_env), 0LL)) * 1024 * 1024;
+            }
+            image_store = std::make_shared<ImageBlobStore>(image_options);
+            if (!image_store->initialize()) {
+                LOG_F(ERROR, "图片存储初始化失败！");
+                return 1;
+            }
+            // 旧版本以base64保存在推荐表中的图片迁移到图片存储；
+            // VACUUM会阻塞启动直到整个数据库重写完，只在显式开启时执行
+            size_t migrated = db->migrateImagesToBlobStore(*image_store);
+            const char* vacuum_env = std::getenv("IMAGE_MIGRATION_VACUUM");
+            if (vacuum_env && std::atoi(vacuum_env) != 0) {
+                db->vacuum();
+            } else if (migrated > 0) {
+                LOG_F(INFO, "迁移腾出的数据库空间可设置IMAGE_MIGRATION_VACUUM=1后重启回收");
+            }
+        }
+
+        // 菜单变更时使旧菜单生成的推荐缓存失效
+        ai_service->setMenuVersion(db->getMenuVersion());
+        db->setMenuVersionListener([ai_service](uint64_t version) {
+            ai_service->setMenuVersion(version);
+        });
+
+        // 库存：内存中的原子计数负责预留和扣减，变化定期批量写回dishes.stock_count
+        InventoryOptions inventory_options;
+        const char* inventory_flush_env = std::getenv("INVENTORY_FLUSH_MS");
+        if (inventory_flush_env && std::atoi(inventory_flush_env) > 0) {
+            inventory_options.flush_interval = std::chrono::milliseconds(std::atoi(inventory_flush_env));
+        }
+        const char* reservation_ttl_env = std::getenv("INVENTORY_RESERVATION_TTL_SECONDS");
+        if (reservation_ttl_env && std::atoi(reservation_ttl_env) > 0) {
+            inventory_options.reservation_ttl = std::chrono::seconds(std::atoi(reservation_ttl_env));
+        }
+        auto inventory = std::make_shared<InventoryManager>(db, inventory_options);
+        inventory->initialize();
+
+        // 热销排行：启动时加载最近的订单项，之后每个新订单项增量更新；推荐提示词附带当前时段的热销菜
+        auto popularity = std::make_shared<PopularityTracker>();
+        popularity->initialize(*db);
+        db->setOrderItemListener([popularity](const OrderItem& item) {
+            popularity->record(item.dish_id, item.quantity, std::chrono::system_clock::now());
+        });
+        ai_service->setPopularDishesProvider([popularity, db, inventory](const std::string& season,
+                                                                         const std::string& meal_time) {
+            auto snapshot = db->getMenuSnapshot();
+            std::vector<std::string> names;
+            for (const auto& entry : popularity->top(MealPeriod::findMealTime(meal_time), MealPeriod::findSeason(season),
+                                                     PopularityWindow::Week, 5, [&snapshot, &inventory](int dish_id) {
+                    const Dish* dish = snapshot->findById(dish_id);
+                    return dish && dish->is_available && !inventory->isSoldOut(dish_id);
+                })) {
+                names.push_back(snapshot->findById(entry.dish_id)->dish_name);
+            }
+            return names;
+        });
+        ai_service->setSoldOutVersionProvider([inventory] { return inventory->soldOutVersion(); });
+
+        // 创建异步推荐任务执行器
+        const char* job_workers_env = std::getenv("REC_JOB_WORKERS");
+        int job_workers = job_workers_env ? std::atoi(job_workers_env) : 4;
+        const char* job_queue_env = std::getenv("REC_JOB_QUEUE_SIZE");
+        int job_queue_size = job_queue_env ? std::atoi(job_queue_env) : 64;
+        LOG_F(INFO, "  推荐任务线程: %d, 队列容量: %d", job_workers, job_queue_size);
+        auto job_executor = std::make_shared<JobExecutor>("recommendation",
+            static_cast<size_t>(std::max(job_workers, 1)), static_cast<size_t>(std::max(job_queue_size, 1)));
+
+        // 推荐记录后写队列，队列容量为0时在请求线程同步写入
+        RecommendationWriterOptions writer_options;
+        const char* writer_batch_env = std::getenv("REC_WRITER_BATCH_SIZE");
+        if (writer_batch_env && std::atoi(writer_batch_env) > 0) {
+            writer_options.batch_size = static_cast<size_t>(std::atoi(writer_batch_env));
+        }
+        const char* writer_flush_env = std::getenv("REC_WRITER_FLUSH_MS");
+        if (writer_flush_env && std::atoi(writer_flush_env) > 0) {
+            writer_options.flush_interval = std::chrono::milliseconds(std::atoi(writer_flush_env));
+        }
+        const char* writer_queue_env = std::getenv("REC_WRITER_QUEUE_SIZE");
+        if (writer_queue_env) {
+            writer_options.max_queued = static_cast<size_t>(std::max(std::atoi(writer_queue_env), 0));
+        }
+        const char* writer_queue_mb_env = std::getenv("REC_WRITER_QUEUE_MB");
+        if (writer_queue_mb_env && std::atoi(writer_queue_mb_env) > 0) {
+            writer_options.max_queued_bytes = static_cast<size_t>(std::atoi(writer_queue_mb_env)) * 1024 * 1024;
+        }
+        auto rec_writer = std::make_shared<RecommendationWriter>(db, image_store, writer_options);
+        LOG_F(INFO, "  推荐记录写入: 每批 %zu 条, 间隔 %lldms, 队列容量 %zu", writer_options.batch_size,
+              static_cast<long long>(writer_options.flush_interval.count()), writer_options.max_queued);
 
         // 创建控制器
         LOG_F(INFO, "创建API控制器...");
-        auto rec_controller = std::make_shared<RecommendationController>(ai_service, db);
+        auto rec_controller = std::make_shared<RecommendationController>(ai_service, db, job_executor);
+        rec_controller->setMaxImageSize(max_image_size);
+        rec_controller->setRecommendationWriter(rec_writer);
+        rec_controller->setPopularityTracker(popularity);
+        rec_controller->setInventory(inventory);
+
+        // 客户端心跳只更新内存中的状态表，变化定期批量写入数据库
+        HeartbeatStoreOptions heartbeat_options;
+        const char* heartbeat_flush_env = std::getenv("HEARTBEAT_FLUSH_MS");
+        if (heartbeat_flush_env && std::atoi(heartbeat_flush_env) > 0) {
+            heartbeat_options.flush_interval = std::chrono::milliseconds(std::atoi(heartbeat_flush_env));
+        }
+        const char* heartbeat_active_env = std::getenv("HEARTBEAT_ACTIVE_SECONDS");
+        if (heartbeat_active_env && std::atoi(heartbeat_active_env) > 0) {
+            heartbeat_options.active_seconds = std::atoi(heartbeat_active_env);
+        }
+        const char* heartbeat_expire_env = std::getenv("HEARTBEAT_EXPIRE_SECONDS");
+        if (heartbeat_expire_env) {
+            heartbeat_options.expire_seconds = std::max(std::atoi(heartbeat_expire_env), 0);
+        }
+        auto heartbeat_store = std::make_shared<HeartbeatStore>(db, heartbeat_options);
+        heartbeat_store->initialize();
+        auto device_controller = std::make_shared<DeviceController>(db, heartbeat_store);
+        auto stats_controller = std::make_shared<StatsController>(db);
+        auto order_controller = std::make_shared<OrderController>(db, inventory);
+
+        // 环境数据时序：原始样本在内存环形缓冲区，1分钟/15分钟/1小时汇总压缩后写入数据库
+        EnvironmentSeriesOptions environment_options;
+        const char* env_raw_env = std::getenv("ENV_RAW_SAMPLES");
+        if (env_raw_env && std::atoi(env_raw_env) > 0) {
+            environment_options.raw_capacity = static_cast<size_t>(std::atoi(env_raw_env));
+        }
+        const char* env_flush_env = std::getenv("ENV_FLUSH_MS");
+        if (env_flush_env && std::atoi(env_flush_env) > 0) {
+            environment_options.flush_interval = std::chrono::milliseconds(std::atoi(env_flush_env));
+        }
+        const char* env_retention_names[] = {"ENV_RETENTION_1M_DAYS", "ENV_RETENTION_15M_DAYS", "ENV_RETENTION_1H_DAYS"};
+        for (size_t i = 0; i < environment_options.retention_days.size(); i++) {
+            const char* retention_env = std::getenv(env_retention_names[i]);
+            if (retention_env) {
+                environment_options.retention_days[i] = std::max(std::atoi(retention_env), 0);
+            }
+        }
+        auto environment = std::make_shared<EnvironmentSeries>(db, environment_options);
+        environment->initialize();
+        device_controller->setEnvironmentSeries(environment);
+        const char* heartbeat_interval_env = std::getenv("HEARTBEAT_INTERVAL_SECONDS");
+        if (heartbeat_interval_env && std::atoi(heartbeat_interval_env) > 0) {
+            device_controller->setHeartbeatInterval(std::atoi(heartbeat_interval_env));
+        }
+
+        // 默认执行模式，请求中的pipeline_mode可覆盖
+        const char* pipeline_mode_env = std::getenv("AI_PIPELINE_MODE");
+        PipelineMode pipeline_mode = PipelineMode::TwoStage;
+        if (pipeline_mode_env && *pipeline_mode_env && !parsePipelineMode(pipeline_mode_env, pipeline_mode)) {
+            LOG_F(WARNING, "未知的AI_PIPELINE_MODE: %s，使用two_stage", pipeline_mode_env);
+        }
+        rec_controller->setDefaultPipelineMode(pipeline_mode);
+        LOG_F(INFO, "  推荐执行模式: %s", pipelineModeName(pipeline_mode));
+
+        // 同桌相似画面复用视觉识别结果，TTL为0时禁用
+        const char* dedupe_ttl_env = std::getenv("VISION_DEDUPE_TTL_SECONDS");
+        int dedupe_ttl = dedupe_ttl_env ? std::atoi(dedupe_ttl_env) : 120;
+        if (dedupe_ttl > 0) {
+            const char* dedupe_distance_env = std::getenv("VISION_DEDUPE_MAX_DISTANCE");
+            int dedupe_distance = dedupe_distance_env ? std::atoi(dedupe_distance_env) : 6;
+            const char* dedupe_per_table_env = std::getenv("VISION_DEDUPE_PER_TABLE");
+            int dedupe_per_table = dedupe_per_table_env ? std::atoi(dedupe_per_table_env) : 4;
+            LOG_F(INFO, "  画面去重: 汉明距离<=%d, TTL %ds, 每桌 %d 帧", dedupe_distance, dedupe_ttl, dedupe_per_table);
+            rec_controller->setVisionDedupeCache(std::make_shared<VisionDedupeCache>(
+                dedupe_distance, std::chrono::seconds(dedupe_ttl), static_cast<size_t>(std::max(dedupe_per_table, 1))));
+        }
+
+        // HTTP工作线程池和准入控制
+        AdmissionOptions admission_options;
+        admission_options.workers = std::max(8u, std::thread::hardware_concurrency() > 0
+                                                     ? std::thread::hardware_concurrency() - 1 : 0u);
+        const char* http_workers_env = std::getenv("HTTP_WORKERS");
+        if (http_workers_env && std::atoi(http_workers_env) > 0) {
+            admission_options.workers = static_cast<size_t>(std::atoi(http_workers_env));
+        }
+        const char* http_max_queued_env = std::getenv("HTTP_MAX_QUEUED");
+        if (http_max_queued_env && std::atoi(http_max_queued_env) > 0) {
+            admission_options.max_queued = static_cast<size_t>(std::atoi(http_max_queued_env));
+        }
+        const char* http_reserved_env = std::getenv("HTTP_RESERVED_WORKERS");
+        if (http_reserved_env) {
+            admission_options.reserved_workers = static_cast<size_t>(std::max(std::atoi(http_reserved_env), 0));
+        }
+        const char* http_bulk_env = std::getenv("HTTP_BULK_MAX_INFLIGHT");
+        if (http_bulk_env) {
+            admission_options.bulk_max_inflight = static_cast<size_t>(std::max(std::atoi(http_bulk_env), 0));
+        }
+        const char* http_retry_after_env = std::getenv("HTTP_RETRY_AFTER_SECONDS");
+        if (http_retry_after_env && std::atoi(http_retry_after_env) > 0) {
+            admission_options.retry_after_seconds = std::atoi(http_retry_after_env);
+        }
+        const char* http_read_timeout_env = std::getenv("HTTP_READ_TIMEOUT_SECONDS");
+        int http_read_timeout = http_read_timeout_env ? std::atoi(http_read_timeout_env) : 15;
+        const char* http_write_timeout_env = std::getenv("HTTP_WRITE_TIMEOUT_SECONDS");
+        int http_write_timeout = http_write_timeout_env ? std::atoi(http_write_timeout_env) : 15;
+        const char* http_keep_alive_env = std::getenv("HTTP_KEEP_ALIVE_SECONDS");
+        int http_keep_alive = http_keep_alive_env ? std::atoi(http_keep_alive_env) : 5;
+
+        auto admission = std::make_shared<AdmissionController>(admission_options);
+        admission->setRoutePriority("", "/api/v1/health", RequestPriority::Critical);
+        admission->setRoutePriority("", "/api/v1/server/stats", RequestPriority::Critical);
+        admission->setRoutePriority("GET", "/metrics", RequestPriority::Critical);
+        admission->setRoutePriority("", "/api/v1/heartbeat", RequestPriority::Critical);
+        admission->setRoutePriority("", "/api/v1/service/", RequestPriority::Critical);
+        admission->setRoutePriority("", "/api/v1/tables/", RequestPriority::Critical);
+        admission->setRoutePriority("POST", "/api/v1/orders", RequestPriority::Critical);
+        admission->setRoutePriority("POST", "/api/v1/recommendation", RequestPriority::Bulk);
+        admission->setRoutePriority("POST", "/api/v1/recommendation/feedback", RequestPriority::Normal);
+        admission->setRoutePriority("GET", "/api/v1/recommendation/AI", RequestPriority::Bulk);
+        LOG_F(INFO, "  HTTP工作线程: %zu, 排队上限: %zu, 保留线程: %zu",
+              admission->options().workers, admission->options().max_queued, admission->options().reserved_workers);
+        LOG_F(INFO, "  HTTP超时: 读 %ds, 写 %ds, keep-alive %ds", http_read_timeout, http_write_timeout, http_keep_alive);
+
+        // 长轮询与摄像头推荐共用Bulk额度，默认至少留一个给推荐请求
+        int max_waiting_polls = static_cast<int>(std::max<size_t>(admission->bulkLimit(), 2) - 1);
+        const char* waiting_polls_env = std::getenv("REC_MAX_WAITING_POLLS");
+        if (waiting_polls_env && *waiting_polls_env) {
+            max_waiting_polls = std::max(std::atoi(waiting_polls_env), 0);
+        }
+        rec_controller->setMaxWaitingPolls(max_waiting_polls);
+        LOG_F(INFO, "  推荐结果长轮询上限: %d", max_waiting_polls);
+
+        // 请求追踪：采样的请求和慢请求写span日志
+        const char* trace_sample_env = std::getenv("TRACE_SAMPLE_RATE");
+        double trace_sample_rate = trace_sample_env ? std::atof(trace_sample_env) : 0.1;
+        const char* trace_slow_env = std::getenv("TRACE_SLOW_MS");
+        int trace_slow_ms = trace_slow_env ? std::atoi(trace_slow_env) : 3000;
+        RequestTrace::setSampleRate(trace_sample_rate);
+        RequestTrace::setSlowThreshold(trace_slow_ms);
+        LOG_F(INFO, "  请求追踪: 采样率 %.3f, 慢请求阈值 %dms", trace_sample_rate, trace_slow_ms);
 
         // 创建HTTP服务器
         LOG_F(INFO, "创建HTTP服务器...");
         g_server = std::make_unique<httplib::Server>();
+        g_server->new_task_queue = [admission] { return admission->newTaskQueue(); };
+        g_server->set_read_timeout(http_read_timeout, 0);
+        g_server->set_write_timeout(http_write_timeout, 0);
+        g_server->set_keep_alive_timeout(http_keep_alive);
+
+        // 路由之前开始追踪并按优先级准入，超出并发额度直接返回503；响应写完后释放额度
+        g_server->set_pre_routing_handler([admission](const httplib::Request& req, httplib::Response& res) {
+            t_request_start = std::chrono::steady_clock::now();
+            RequestTrace::setCurrent(RequestTrace::start(req.get_header_value("X-Request-Id"),
+                                                         req.method + " " + routeLabel(req.path)));
+            if (admission->admit(req, res)) {
+                return httplib::Server::HandlerResponse::Unhandled;
+            }
+            JsonResponse::setCorsHeaders(res);
+            return httplib::Server::HandlerResponse::Handled;
+        });
+        // 响应头写出之前附上trace ID和各阶段耗时；流式响应的耗时由控制器写在chunked尾部
+        g_server->set_post_routing_handler([](const httplib::Request& req, httplib::Response& res) {
+            (void)req; // 抑制未使用参数警告
+            RequestTrace* trace = RequestTrace::current();
+            if (!trace) {
+                return;
+            }
+            res.set_header("X-Request-Id", trace->id());
+            if (!res.has_header("Trailer")) {
+                res.set_header("Server-Timing", trace->serverTiming());
+            }
+        });
+        g_server->set_logger([admission](const httplib::Request& req, const httplib::Response& res) {
+            admission->release();
+            recordHttpRequest(req, res);
+            if (RequestTrace* trace = RequestTrace::current()) {
+                trace->setStatus(res.status);
+            }
+            RequestTrace::setCurrent(nullptr);
+        });
+
+        // 请求体总上限：base64编码的最大图片加上其他字段
+        g_server->set_payload_max_length(max_image_size / 3 * 4 + 64 * 1024);
         
         // 配置路由
-        setupRoutes(*g_server, rec_controller);
+        setupRoutes(*g_server, rec_controller, device_controller, stats_controller, order_controller, admission);
+        registerMetricCollectors(ai_service, db, job_executor, rec_controller, admission, rec_writer, image_store,
+                                 heartbeat_store, environment, popularity, inventory);
 
         // 启动服务器
         LOG_F(INFO, "🚀 启动服务器...");
@@ -346,6 +1079,14 @@ int main(int argc, char* argv[]) {
             return 1;
         }
 
+        // 服务器已停止：等待异步推荐任务结束，再写入排队中的推荐记录、心跳状态、环境数据和库存
+        job_executor->shutdown();
+        rec_writer->shutdown();
+        heartbeat_store->shutdown();
+        environment->shutdown();
+        inventory->shutdown();
+        LOG_F(INFO, "服务器已关闭");
+
     } catch (const std::exception& e) {
         LOG_F(ERROR, "服务器启动失败: %s", e.what());
         return 1;
@@ -1,23 +1,72 @@
 #include "ai/AiService.h"
+#include "ai/RecommendationCache.h"
+#include "common/Base64.h"
+#include "common/Metrics.h"
+#include "common/RequestTrace.h"
 #include <iostream>
+#include <chrono>
 #include <cstdlib>
 #include <sstream>
 
 namespace WisdomRestaurant {
 
+bool parsePipelineMode(const std::string& name, PipelineMode& mode) {
+    if (name == "two_stage") {
+        mode = PipelineMode::TwoStage;
+        return true;
+    }
+    if (name == "combined") {
+        mode = PipelineMode::Combined;
+        return true;
+    }
+    return false;
+}
+
+const char* pipelineModeName(PipelineMode mode) {
+    return mode == PipelineMode::Combined ? "combined" : "two_stage";
+}
+
 AiService::AiService() 
     : vision_model_("qwen3-vl-plus")
     , text_model_("qwen-plus")
     , api_endpoint_("https://dashscope.aliyuncs.com/compatible-mode/v1/chat/completions")
+    , upload_requests_(0)
+    , upload_bytes_sent_(0)
+    , upload_bytes_buffered_(0)
+    , menu_version_(0)
     , initialized_(false) {
 }
 
 AiService::~AiService() {
+    // 连接池必须在curl_global_cleanup之前释放
+    curl_pool_.reset();
     if (initialized_) {
         curl_global_cleanup();
     }
 }
 
+// 记录一次大模型调用的耗时和HTTP状态码，CURL失败时状态码记为curl_error
+static void recordUpstreamCall(CURL* curl, const char* call, CURLcode res,
+                               std::chrono::steady_clock::time_point start_time) {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    MetricsRegistry& registry = MetricsRegistry::instance();
+    registry.histogram("wisdom_ai_upstream_duration_seconds", "Duration of LLM API calls",
+                       {{"call", call}}).observe(seconds);
+
+    std::string code = "curl_error";
+    if (res == CURLE_OK) {
+        long http_code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+        code = std::to_string(http_code);
+    }
+    registry.counter("wisdom_ai_upstream_responses_total", "LLM API responses by HTTP status code",
+                     {{"call", call}, {"code", code}}).inc();
+
+    if (RequestTrace* trace = RequestTrace::current()) {
+        trace->addSpan("upstream", std::chrono::steady_clock::now() - start_time);
+    }
+}
+
 bool AiService::initialize() {
     // 从环境变量获取API密钥
     const char* apiKey = std::getenv("DASHSCOPE_API_KEY");
@@ -27,6 +76,12 @@ bool AiService::initialize() {
     }
     api_key_ = apiKey;
 
+    // 兼容OpenAI接口的其他端点（私有部署的模型网关、测试用的本地模拟服务）
+    const char* endpoint_env = std::getenv("DASHSCOPE_API_ENDPOINT");
+    if (endpoint_env && *endpoint_env) {
+        api_endpoint_ = endpoint_env;
+    }
+
     // 初始化CURL
     CURLcode res = curl_global_init(CURL_GLOBAL_DEFAULT);
     if (res != CURLE_OK) {
@@ -34,12 +89,48 @@ bool AiService::initialize() {
         return false;
     }
 
+    // 创建CURL连接池
+    const char* pool_size_env = std::getenv("AI_CURL_POOL_SIZE");
+    size_t pool_size = pool_size_env ? static_cast<size_t>(std::atoi(pool_size_env)) : 8;
+    curl_pool_ = std::make_unique<CurlHandlePool>(pool_size);
+    if (!curl_pool_->initialize()) {
+        curl_global_cleanup();
+        curl_pool_.reset();
+        return false;
+    }
+
+    // 预建立到大模型端点的连接，避免首个请求承担DNS、TCP和TLS握手
+    const char* warmup_env = std::getenv("AI_CURL_WARMUP");
+    size_t warmup_count = warmup_env ? static_cast<size_t>(std::atoi(warmup_env)) : 2;
+    if (warmup_count > 0) {
+        size_t warmed = curl_pool_->warmup(api_endpoint_, warmup_count);
+        CurlPoolStats stats = curl_pool_->getStats();
+        std::cout << "AI连接预热完成: " << warmed << "/" << warmup_count
+                  << " 个连接，握手耗时 " << stats.handshake_ms_total << "ms" << std::endl;
+    }
+
+    // 推荐结果缓存，容量为0时禁用
+    const char* cache_size_env = std::getenv("REC_CACHE_MAX_ENTRIES");
+    size_t cache_size = cache_size_env ? static_cast<size_t>(std::atoi(cache_size_env)) : 256;
+    const char* cache_ttl_env = std::getenv("REC_CACHE_TTL_SECONDS");
+    int cache_ttl = cache_ttl_env ? std::atoi(cache_ttl_env) : 600;
+    if (cache_size > 0 && cache_ttl > 0) {
+        rec_cache_ = std::make_unique<RecommendationCache>(cache_size, std::chrono::seconds(cache_ttl));
+        std::cout << "推荐结果缓存已启用: " << cache_size << " 条, TTL " << cache_ttl << "s" << std::endl;
+    }
+
     initialized_ = true;
     std::cout << "AI服务初始化成功" << std::endl;
     return true;
 }
 
-VisionResult AiService::analyzeCustomerImage(const std::string& image_base64) {
+VisionResult AiService::analyzeCustomerImage(std::string&& image_base64) {
+    CustomerImage image;
+    image.data = std::move(image_base64);
+    return analyzeCustomerImage(image);
+}
+
+VisionResult AiService::analyzeCustomerImage(const CustomerImage& image) {
     VisionResult result;
     result.success = false;
 
@@ -52,7 +143,7 @@ VisionResult AiService::analyzeCustomerImage(const std::string& image_base64) {
     std::string prompt = buildVisionPrompt();
     
     // 调用视觉大模型
-    std::string response = callLLMAPI(prompt, image_base64);
+    std::string response = callLLMAPI(prompt, image, "vision");
     
     if (response.empty() || response == "No response from AI") {
         result.error_message = "大模型调用失败";
@@ -80,8 +171,27 @@ RecommendationResult AiService::recommendDishes(const VisionResult& vision_resul
         return result;
     }
 
+    // 热销菜品行只取一次，缓存key和提示词使用同一份
+    std::string popular_line = buildPopularDishesLine(season, meal_time);
+    if (!rec_cache_) {
+        return generateRecommendation(vision_result, season, meal_time, popular_line);
+    }
+
+    std::string key = makeCacheKey(vision_result, season, meal_time, popular_line);
+    return rec_cache_->getOrLoad(key, [&]() {
+        return generateRecommendation(vision_result, season, meal_time, popular_line);
+    });
+}
+
+RecommendationResult AiService::generateRecommendation(const VisionResult& vision_result,
+                                                      const std::string& season,
+                                                      const std::string& meal_time,
+                                                      const std::string& popular_line) {
+    RecommendationResult result;
+    result.success = false;
+
     // 构建推荐提示词
-    std::string prompt = buildRecommendationPrompt(vision_result, season, meal_time);
+    std::string prompt = buildRecommendationPrompt(vision_result, season, meal_time, popular_line);
     
     // 调用文本大模型
     std::string response = callTextLLMAPI(prompt);
@@ -96,175 +206,323 @@ RecommendationResult AiService::recommendDishes(const VisionResult& vision_resul
     return result;
 }
 
-std::string AiService::callLLMAPI(const std::string& prompt, const std::string& image_base64) {
-    std::string response;
-    CURL *curl = curl_easy_init();
-    
-    if (!curl) {
-        std::cerr << "CURL初始化失败" << std::endl;
-        return "CURL initialization failed";
+CombinedResult AiService::analyzeAndRecommend(const CustomerImage& image,
+                                              const std::string& season,
+                                              const std::string& meal_time) {
+    CombinedResult result;
+    result.vision.people_num = 0;
+    result.vision.success = false;
+    result.recommendation.success = false;
+
+    if (!initialized_) {
+        result.vision.error_message = "AI服务未初始化";
+        result.recommendation.error_message = result.vision.error_message;
+        return result;
     }
 
-    // 构建请求体
-    std::string body;
-    {
-        rapidjson::Document d;
-        d.SetObject();
-        auto &alloc = d.GetAllocator();
-        
-        d.AddMember("model", rapidjson::Value(vision_model_.c_str(), alloc), alloc);
-        rapidjson::Value messages(rapidjson::kArrayType);
-        
-        {
-            rapidjson::Value usr(rapidjson::kObjectType);
-            usr.AddMember("role", rapidjson::Value("user", alloc), alloc);
-            
-            rapidjson::Value content(rapidjson::kArrayType);
-            
-            // 添加文本内容
-            rapidjson::Value textPart(rapidjson::kObjectType);
-            textPart.AddMember("type", rapidjson::Value("text", alloc), alloc);
-            textPart.AddMember("text", rapidjson::Value(prompt.c_str(), alloc), alloc);
-            content.PushBack(textPart, alloc);
-            
-            // 如果有图片，添加图片内容
-            if (!image_base64.empty()) {
-                rapidjson::Value imagePart(rapidjson::kObjectType);
-                imagePart.AddMember("type", rapidjson::Value("image_url", alloc), alloc);
-                rapidjson::Value imageUrl(rapidjson::kObjectType);
-                std::string imageDataUrl = "data:image/png;base64," + image_base64;
-                imageUrl.AddMember("url", rapidjson::Value(imageDataUrl.c_str(), alloc), alloc);
-                imagePart.AddMember("image_url", imageUrl, alloc);
-                content.PushBack(imagePart, alloc);
+    std::string popular_line = buildPopularDishesLine(season, meal_time);
+    std::string response = callLLMAPI(buildCombinedPrompt(season, meal_time, popular_line), image, "combined");
+    if (response.empty() || response == "No response from AI") {
+        result.vision.error_message = "大模型调用失败";
+        result.recommendation.error_message = result.vision.error_message;
+        return result;
+    }
+
+    result = parseCombinedResult(response);
+
+    // 同样写入推荐缓存，后续相同画像的分阶段请求可直接命中
+    if (rec_cache_ && result.vision.success && result.recommendation.success) {
+        rec_cache_->put(makeCacheKey(result.vision, season, meal_time, popular_line),
+                        result.recommendation);
+    }
+    return result;
+}
+
+RecommendationResult AiService::recommendDishesStream(const VisionResult& vision_result,
+                                                     const std::string& season,
+                                                     const std::string& meal_time,
+                                                     const std::function<bool(const DishRecommendation&)>& on_dish) {
+    RecommendationResult result;
+    result.success = false;
+
+    if (!initialized_) {
+        result.error_message = "AI服务未初始化";
+        return result;
+    }
+
+    if (!vision_result.success) {
+        result.error_message = "客户画像分析失败，无法进行推荐";
+        return result;
+    }
+
+    // 缓存命中时直接逐个回放菜品
+    std::string popular_line = buildPopularDishesLine(season, meal_time);
+    std::string cache_key;
+    if (rec_cache_) {
+        cache_key = makeCacheKey(vision_result, season, meal_time, popular_line);
+        auto cached = rec_cache_->lookup(cache_key);
+        if (cached) {
+            for (const auto& dish : cached->recommendations) {
+                if (!on_dish(dish)) {
+                    break;
+                }
             }
-            
-            usr.AddMember("content", content, alloc);
-            messages.PushBack(usr, alloc);
+            return *cached;
         }
-        
-        d.AddMember("messages", messages, alloc);
-        d.AddMember("max_tokens", 2048, alloc);
-        d.AddMember("temperature", 0.7, alloc);
-        
-        rapidjson::StringBuffer sb;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
-        d.Accept(writer);
-        body.assign(sb.GetString(), sb.GetSize());
     }
 
-    // 设置HTTP头
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    std::string auth = "Authorization: Bearer " + api_key_;
-    headers = curl_slist_append(headers, auth.c_str());
+    std::string prompt = buildRecommendationPrompt(vision_result, season, meal_time, popular_line);
 
-    // 配置CURL选项
-    curl_easy_setopt(curl, CURLOPT_URL, api_endpoint_.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 30000L);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    StreamState state;
+    state.on_dish = &on_dish;
+    UploadBody body(buildTextRequestBody(prompt, true));
+    bool ok = performStreamingRequest(body, state, "recommend_stream");
 
-    // 执行请求
-    CURLcode res = curl_easy_perform(curl);
-    
-    if (res != CURLE_OK) {
-        std::cerr << "CURL请求失败: " << curl_easy_strerror(res) << std::endl;
-        response = "CURL request failed";
+    if (state.aborted) {
+        result.recommendations = std::move(state.dishes);
+        result.error_message = "推荐已被客户端中止";
+        return result;
     }
 
-    // 清理资源
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+    if (!ok) {
+        result.error_message = "推荐服务调用失败";
+        return result;
+    }
 
-    // 解析响应
-    std::string answer;
-    if (!response.empty() && response != "CURL request failed") {
-        rapidjson::Document rd;
-        rd.Parse(response.c_str());
-        
-        if (rd.IsObject() && rd.HasMember("choices") && rd["choices"].IsArray() && rd["choices"].Size() > 0) {
-            const auto &c0 = rd["choices"][0];
-            if (c0.IsObject() && c0.HasMember("message") && c0["message"].IsObject()) {
-                const auto &msg = c0["message"];
-                if (msg.HasMember("content") && msg["content"].IsString()) {
-                    answer = msg["content"].GetString();
+    // 模型未按数组格式逐个输出时，退回到整体解析
+    if (state.dishes.empty()) {
+        if (state.content.empty()) {
+            result.error_message = "推荐服务调用失败";
+            return result;
+        }
+        result = parseRecommendationResult(state.content);
+        if (result.success) {
+            for (const auto& dish : result.recommendations) {
+                if (!on_dish(dish)) {
+                    break;
                 }
             }
+            if (rec_cache_) {
+                rec_cache_->put(cache_key, result);
+            }
         }
+        return result;
     }
 
-    if (answer.empty()) {
-        answer = "No response from AI";
+    result.recommendations = std::move(state.dishes);
+    result.success = true;
+    if (rec_cache_) {
+        rec_cache_->put(cache_key, result);
     }
+    return result;
+}
 
-    return answer;
+std::string AiService::callLLMAPI(const std::string& prompt, const CustomerImage& image, const char* call) {
+    UploadBody body = buildVisionRequestBody(prompt, image);
+    return extractAnswer(performRequest(body, call));
 }
 
-std::string AiService::callTextLLMAPI(const std::string& prompt) {
-    std::string response;
-    CURL *curl = curl_easy_init();
-    
-    if (!curl) {
-        std::cerr << "CURL初始化失败" << std::endl;
-        return "CURL initialization failed";
-    }
+UploadBody AiService::buildVisionRequestBody(const std::string& prompt, const CustomerImage& image) {
+    // 图片位置先写入占位符，序列化后在占位符处切分为前缀和后缀
+    static const char kImagePlaceholder[] = "__WISDOM_IMAGE_DATA__";
 
-    // 构建请求体
-    std::string body;
+    // base64图片直接嵌入JSON，必须确认不含需要转义的字符
+    bool stream_image = !image.empty() && (!image.is_base64 || Base64::isPlainAlphabet(image.data));
+
+    rapidjson::Document d;
+    d.SetObject();
+    auto &alloc = d.GetAllocator();
+    
+    d.AddMember("model", rapidjson::Value(vision_model_.c_str(), alloc), alloc);
+    rapidjson::Value messages(rapidjson::kArrayType);
+    
     {
-        rapidjson::Document d;
-        d.SetObject();
-        auto &alloc = d.GetAllocator();
+        rapidjson::Value usr(rapidjson::kObjectType);
+        usr.AddMember("role", rapidjson::Value("user", alloc), alloc);
         
-        d.AddMember("model", rapidjson::Value(text_model_.c_str(), alloc), alloc);
-        rapidjson::Value messages(rapidjson::kArrayType);
+        rapidjson::Value content(rapidjson::kArrayType);
         
-        {
-            rapidjson::Value usr(rapidjson::kObjectType);
-            usr.AddMember("role", rapidjson::Value("user", alloc), alloc);
-            usr.AddMember("content", rapidjson::Value(prompt.c_str(), alloc), alloc);
-            messages.PushBack(usr, alloc);
-        }
+        // 添加文本内容
+        rapidjson::Value textPart(rapidjson::kObjectType);
+        textPart.AddMember("type", rapidjson::Value("text", alloc), alloc);
+        textPart.AddMember("text", rapidjson::Value(prompt.c_str(), alloc), alloc);
+        content.PushBack(textPart, alloc);
         
-        d.AddMember("messages", messages, alloc);
-        d.AddMember("max_tokens", 2048, alloc);
-        d.AddMember("temperature", 0.8, alloc);
+        // 如果有图片，添加图片内容
+        if (!image.empty()) {
+            rapidjson::Value imagePart(rapidjson::kObjectType);
+            imagePart.AddMember("type", rapidjson::Value("image_url", alloc), alloc);
+            rapidjson::Value imageUrl(rapidjson::kObjectType);
+            std::string imageDataUrl = "data:" + image.mime_type + ";base64,";
+            if (stream_image) {
+                imageDataUrl += kImagePlaceholder;
+            } else {
+                imageDataUrl += image.data;
+            }
+            imageUrl.AddMember("url", rapidjson::Value(imageDataUrl.c_str(), imageDataUrl.size(), alloc), alloc);
+            imagePart.AddMember("image_url", imageUrl, alloc);
+            content.PushBack(imagePart, alloc);
+        }
         
-        rapidjson::StringBuffer sb;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
-        d.Accept(writer);
-        body.assign(sb.GetString(), sb.GetSize());
+        usr.AddMember("content", content, alloc);
+        messages.PushBack(usr, alloc);
+    }
+    
+    d.AddMember("messages", messages, alloc);
+    d.AddMember("max_tokens", 2048, alloc);
+    d.AddMember("temperature", 0.7, alloc);
+    
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+    d.Accept(writer);
+    std::string json(sb.GetString(), sb.GetSize());
+
+    if (!stream_image) {
+        return UploadBody(std::move(json));
+    }
+
+    // 图片在文本提示词之后，从末尾查找占位符
+    size_t pos = json.rfind(kImagePlaceholder);
+    std::string suffix = json.substr(pos + sizeof(kImagePlaceholder) - 1);
+    json.resize(pos);
+    return UploadBody(std::move(json), &image.data, image.is_base64, std::move(suffix));
+}
+
+std::string AiService::callTextLLMAPI(const std::string& prompt) {
+    UploadBody body(buildTextRequestBody(prompt, false));
+    return extractAnswer(performRequest(body, "recommend"));
+}
+
+std::string AiService::buildTextRequestBody(const std::string& prompt, bool stream) {
+    rapidjson::Document d;
+    d.SetObject();
+    auto &alloc = d.GetAllocator();
+    
+    d.AddMember("model", rapidjson::Value(text_model_.c_str(), alloc), alloc);
+    rapidjson::Value messages(rapidjson::kArrayType);
+    
+    {
+        rapidjson::Value usr(rapidjson::kObjectType);
+        usr.AddMember("role", rapidjson::Value("user", alloc), alloc);
+        usr.AddMember("content", rapidjson::Value(prompt.c_str(), alloc), alloc);
+        messages.PushBack(usr, alloc);
     }
+    
+    d.AddMember("messages", messages, alloc);
+    d.AddMember("max_tokens", 2048, alloc);
+    d.AddMember("temperature", 0.8, alloc);
+    if (stream) {
+        d.AddMember("stream", true, alloc);
+    }
+    
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+    d.Accept(writer);
+    return std::string(sb.GetString(), sb.GetSize());
+}
 
-    // 设置HTTP头
+struct curl_slist* AiService::prepareRequest(CURL* curl, UploadBody& body, bool stream) {
+    // 设置HTTP头；禁用Expect: 100-continue，避免大请求体多等待一个往返
     struct curl_slist* headers = nullptr;
     headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers = curl_slist_append(headers, "Expect:");
+    if (stream) {
+        headers = curl_slist_append(headers, "Accept: text/event-stream");
+    }
     std::string auth = "Authorization: Bearer " + api_key_;
     headers = curl_slist_append(headers, auth.c_str());
+    // 透传trace ID，便于和大模型服务端的日志对应
+    if (RequestTrace* trace = RequestTrace::current()) {
+        std::string request_id = "X-Request-Id: " + trace->id();
+        headers = curl_slist_append(headers, request_id.c_str());
+    }
 
-    // 配置CURL选项
+    // 配置CURL选项，请求体通过读回调按块发送
     curl_easy_setopt(curl, CURLOPT_URL, api_endpoint_.c_str());
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, UploadBody::ReadCallback);
+    curl_easy_setopt(curl, CURLOPT_READDATA, &body);
+    curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, UploadBody::SeekCallback);
+    curl_easy_setopt(curl, CURLOPT_SEEKDATA, &body);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(body.size()));
     curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 30000L);
+
+    upload_requests_++;
+    upload_bytes_sent_ += body.size();
+    upload_bytes_buffered_ += body.bufferedBytes();
+    return headers;
+}
+
+std::string AiService::performRequest(UploadBody& body, const char* call) {
+    std::string response;
+    CurlHandlePool::Lease lease = curl_pool_->acquire();
+    CURL* curl = lease.get();
+
+    if (!curl) {
+        std::cerr << "CURL初始化失败" << std::endl;
+        return "CURL initialization failed";
+    }
+
+    struct curl_slist* headers = prepareRequest(curl, body, false);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
 
     // 执行请求
+    auto start_time = std::chrono::steady_clock::now();
     CURLcode res = curl_easy_perform(curl);
+    recordUpstreamCall(curl, call, res, start_time);
     
     if (res != CURLE_OK) {
         std::cerr << "CURL请求失败: " << curl_easy_strerror(res) << std::endl;
         response = "CURL request failed";
+    } else {
+        curl_pool_->recordTransfer(curl);
     }
 
-    // 清理资源
+    // 清理请求头，句柄由lease归还到连接池
+    curl_slist_free_all(headers);
+    return response;
+}
+
+bool AiService::performStreamingRequest(UploadBody& body, StreamState& state, const char* call) {
+    CurlHandlePool::Lease lease = curl_pool_->acquire();
+    CURL* curl = lease.get();
+
+    if (!curl) {
+        std::cerr << "CURL初始化失败" << std::endl;
+        return false;
+    }
+
+    struct curl_slist* headers = prepareRequest(curl, body, true);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, StreamWriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &state);
+
+    auto start_time = std::chrono::steady_clock::now();
+    CURLcode res = curl_easy_perform(curl);
+    if (!state.aborted) {
+        recordUpstreamCall(curl, call, res, start_time);
+    }
     curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
 
-    // 解析响应
+    if (res != CURLE_OK) {
+        // 回调主动中止时CURL返回写入错误，不作为失败记录
+        if (!state.aborted) {
+            std::cerr << "CURL流式请求失败: " << curl_easy_strerror(res) << std::endl;
+        }
+        return false;
+    }
+    curl_pool_->recordTransfer(curl);
+
+    // 处理最后一行没有换行符的数据
+    if (!state.line_buffer.empty()) {
+        handleStreamLine(state.line_buffer, state);
+        state.line_buffer.clear();
+    }
+    return true;
+}
+
+std::string AiService::extractAnswer(const std::string& response) {
     std::string answer;
     if (!response.empty() && response != "CURL request failed") {
         rapidjson::Document rd;
@@ -288,43 +546,141 @@ std::string AiService::callTextLLMAPI(const std::string& prompt) {
     return answer;
 }
 
+UploadStats AiService::getUploadStats() const {
+    UploadStats stats;
+    stats.requests = upload_requests_.load();
+    stats.bytes_sent = upload_bytes_sent_.load();
+    stats.bytes_buffered = upload_bytes_buffered_.load();
+    return stats;
+}
+
+void AiService::setMenuVersion(uint64_t version) {
+    menu_version_.store(version);
+}
+
+RecommendationCacheStats AiService::getRecommendationCacheStats() const {
+    if (!rec_cache_) {
+        return RecommendationCacheStats{};
+    }
+    return rec_cache_->getStats();
+}
+
+CurlPoolStats AiService::getCurlPoolStats() const {
+    if (!curl_pool_) {
+        return CurlPoolStats{};
+    }
+    return curl_pool_->getStats();
+}
+
+void AiService::handleStreamLine(const std::string& line, StreamState& state) {
+    // 只关心 "data:" 行，忽略注释、event和空行
+    if (line.compare(0, 5, "data:") != 0) {
+        return;
+    }
+    size_t pos = 5;
+    while (pos < line.size() && line[pos] == ' ') {
+        pos++;
+    }
+    if (line.compare(pos, std::string::npos, "[DONE]") == 0) {
+        state.finished = true;
+        return;
+    }
+
+    rapidjson::Document chunk;
+    chunk.Parse(line.c_str() + pos, line.size() - pos);
+    if (chunk.HasParseError() || !chunk.IsObject()) {
+        return;
+    }
+
+    if (chunk.HasMember("choices") && chunk["choices"].IsArray() && chunk["choices"].Size() > 0) {
+        const auto& c0 = chunk["choices"][0];
+        if (c0.IsObject() && c0.HasMember("delta") && c0["delta"].IsObject()) {
+            const auto& delta = c0["delta"];
+            if (delta.HasMember("content") && delta["content"].IsString()) {
+                state.content.append(delta["content"].GetString(), delta["content"].GetStringLength());
+                scanStreamContent(state);
+            }
+        }
+    }
+}
+
+void AiService::scanStreamContent(StreamState& state) {
+    const std::string& content = state.content;
+    for (; state.scan_pos < content.size() && !state.aborted; state.scan_pos++) {
+        char c = content[state.scan_pos];
+
+        if (state.in_string) {
+            if (state.escaped) {
+                state.escaped = false;
+            } else if (c == '\\') {
+                state.escaped = true;
+            } else if (c == '"') {
+                state.in_string = false;
+            }
+            continue;
+        }
+
+        if (c == '"') {
+            state.in_string = true;
+        } else if (c == '{' || c == '[') {
+            // 顶层数组中的对象即一道菜品
+            if (c == '{' && state.depth == 1) {
+                state.object_start = state.scan_pos;
+            }
+            state.depth++;
+        } else if (c == '}' || c == ']') {
+            state.depth--;
+            if (c == '}' && state.depth == 1 && state.object_start != std::string::npos) {
+                rapidjson::Document dish_doc;
+                dish_doc.Parse(content.c_str() + state.object_start, state.scan_pos - state.object_start + 1);
+                state.object_start = std::string::npos;
+
+                DishRecommendation dr;
+                if (!dish_doc.HasParseError() && parseDishRecommendation(dish_doc, dr)) {
+                    state.dishes.push_back(dr);
+                    if (state.on_dish && !(*state.on_dish)(dr)) {
+                        state.aborted = true;
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool AiService::parseDishRecommendation(const rapidjson::Value& dish, DishRecommendation& dr) {
+    if (!dish.IsObject()) {
+        return false;
+    }
+    if (dish.HasMember("dish_name") && dish["dish_name"].IsString()) {
+        dr.dish_name = dish["dish_name"].GetString();
+    }
+    if (dish.HasMember("reason") && dish["reason"].IsString()) {
+        dr.reason = dish["reason"].GetString();
+    }
+    if (dish.HasMember("taste_level") && dish["taste_level"].IsString()) {
+        dr.taste_level = dish["taste_level"].GetString();
+    }
+    if (dish.HasMember("nutrition_advice") && dish["nutrition_advice"].IsString()) {
+        dr.nutrition_advice = dish["nutrition_advice"].GetString();
+    }
+    return true;
+}
+
 VisionResult AiService::parseVisionResult(const std::string& response) {
     VisionResult result;
+    result.people_num = 0;
     result.success = false;
 
     try {
         rapidjson::Document doc;
         doc.Parse(response.c_str());
 
-        if (doc.HasParseError()) {
+        if (doc.HasParseError() || !doc.IsObject()) {
             result.error_message = "JSON解析失败";
             return result;
         }
 
-        if (doc.HasMember("people_num") && doc["people_num"].IsString()) {
-            result.people_num = std::stoi(doc["people_num"].GetString());
-        }
-
-        if (doc.HasMember("customer_portrait") && doc["customer_portrait"].IsArray()) {
-            const auto& portraits = doc["customer_portrait"];
-            for (rapidjson::SizeType i = 0; i < portraits.Size(); i++) {
-                const auto& portrait = portraits[i];
-                CustomerPortrait cp;
-                
-                if (portrait.HasMember("age_grades") && portrait["age_grades"].IsString()) {
-                    cp.age_grades = portrait["age_grades"].GetString();
-                }
-                if (portrait.HasMember("gender") && portrait["gender"].IsString()) {
-                    cp.gender = portrait["gender"].GetString();
-                }
-                if (portrait.HasMember("body_type") && portrait["body_type"].IsString()) {
-                    cp.body_type = portrait["body_type"].GetString();
-                }
-                
-                result.customer_portrait.push_back(cp);
-            }
-        }
-
+        parseVisionFields(doc, result);
         result.success = true;
     } catch (const std::exception& e) {
         result.error_message = "解析视觉识别结果时发生异常: " + std::string(e.what());
@@ -333,6 +689,37 @@ VisionResult AiService::parseVisionResult(const std::string& response) {
     return result;
 }
 
+void AiService::parseVisionFields(const rapidjson::Value& doc, VisionResult& result) {
+    if (doc.HasMember("people_num") && doc["people_num"].IsString()) {
+        result.people_num = std::stoi(doc["people_num"].GetString());
+    } else if (doc.HasMember("people_num") && doc["people_num"].IsInt()) {
+        result.people_num = doc["people_num"].GetInt();
+    }
+
+    if (doc.HasMember("customer_portrait") && doc["customer_portrait"].IsArray()) {
+        const auto& portraits = doc["customer_portrait"];
+        for (rapidjson::SizeType i = 0; i < portraits.Size(); i++) {
+            const auto& portrait = portraits[i];
+            if (!portrait.IsObject()) {
+                continue;
+            }
+            CustomerPortrait cp;
+            
+            if (portrait.HasMember("age_grades") && portrait["age_grades"].IsString()) {
+                cp.age_grades = portrait["age_grades"].GetString();
+            }
+            if (portrait.HasMember("gender") && portrait["gender"].IsString()) {
+                cp.gender = portrait["gender"].GetString();
+            }
+            if (portrait.HasMember("body_type") && portrait["body_type"].IsString()) {
+                cp.body_type = portrait["body_type"].GetString();
+            }
+            
+            result.customer_portrait.push_back(cp);
+        }
+    }
+}
+
 RecommendationResult AiService::parseRecommendationResult(const std::string& response) {
     RecommendationResult result;
     result.success = false;
@@ -346,29 +733,23 @@ RecommendationResult AiService::parseRecommendationResult(const std::string& res
             return result;
         }
 
-        if (doc.IsArray()) {
-            for (rapidjson::SizeType i = 0; i < doc.Size(); i++) {
-                const auto& dish = doc[i];
-                DishRecommendation dr;
-                
-                if (dish.HasMember("dish_name") && dish["dish_name"].IsString()) {
-                    dr.dish_name = dish["dish_name"].GetString();
-                }
-                if (dish.HasMember("reason") && dish["reason"].IsString()) {
-                    dr.reason = dish["reason"].GetString();
-                }
-                if (dish.HasMember("taste_level") && dish["taste_level"].IsString()) {
-                    dr.taste_level = dish["taste_level"].GetString();
-                }
-                if (dish.HasMember("nutrition_advice") && dish["nutrition_advice"].IsString()) {
-                    dr.nutrition_advice = dish["nutrition_advice"].GetString();
-                }
-                
+        if (!doc.IsArray()) {
+            result.error_message = "推荐结果不是数组";
+            return result;
+        }
+        for (rapidjson::SizeType i = 0; i < doc.Size(); i++) {
+            DishRecommendation dr;
+            if (parseDishRecommendation(doc[i], dr)) {
                 result.recommendations.push_back(dr);
             }
         }
 
-        result.success = true;
+        // 模型给出空数组时按成功返回（空结果不进入推荐缓存）；有条目但都无法解析时视为失败
+        if (result.recommendations.empty() && doc.Size() > 0) {
+            result.error_message = "推荐结果中没有可用的推荐菜品";
+        } else {
+            result.success = true;
+        }
     } catch (const std::exception& e) {
         result.error_message = "解析推荐结果时发生异常: " + std::string(e.what());
     }
@@ -376,6 +757,49 @@ RecommendationResult AiService::parseRecommendationResult(const std::string& res
     return result;
 }
 
+CombinedResult AiService::parseCombinedResult(const std::string& response) {
+    CombinedResult result;
+    result.vision.people_num = 0;
+    result.vision.success = false;
+    result.recommendation.success = false;
+
+    try {
+        rapidjson::Document doc;
+        doc.Parse(response.c_str());
+
+        if (doc.HasParseError() || !doc.IsObject()) {
+            result.vision.error_message = "JSON解析失败";
+            result.recommendation.error_message = result.vision.error_message;
+            return result;
+        }
+
+        parseVisionFields(doc, result.vision);
+        result.vision.success = true;
+
+        // 推荐部分缺失时只返回画像，由调用方退回到文本模型推荐
+        if (doc.HasMember("recommendations") && doc["recommendations"].IsArray()) {
+            const auto& dishes = doc["recommendations"];
+            for (rapidjson::SizeType i = 0; i < dishes.Size(); i++) {
+                DishRecommendation dr;
+                if (parseDishRecommendation(dishes[i], dr)) {
+                    result.recommendation.recommendations.push_back(dr);
+                }
+            }
+        }
+        if (result.recommendation.recommendations.empty()) {
+            result.recommendation.error_message = "合并结果中没有推荐菜品";
+        } else {
+            result.recommendation.success = true;
+        }
+    } catch (const std::exception& e) {
+        result.vision.success = false;
+        result.vision.error_message = "解析合并结果时发生异常: " + std::string(e.what());
+        result.recommendation.error_message = result.vision.error_message;
+    }
+
+    return result;
+}
+
 std::string AiService::buildVisionPrompt() {
     return R"(获取图像上的人数，性别，年龄，严格按照以下的 json 字符串返回
 json 示例：{"people_num":"1","customer_portrait":[{"age_grades":"青年","gender":"man","body_type":"标准"}]}
@@ -391,7 +815,8 @@ json 示例：{"people_num":"1","customer_portrait":[{"age_grades":"青年","gen
 
 std::string AiService::buildRecommendationPrompt(const VisionResult& vision_result,
                                                const std::string& season,
-                                               const std::string& meal_time) {
+                                               const std::string& meal_time,
+                                               const std::string& popular_line) {
     std::ostringstream oss;
     oss << "你是一个专业的餐厅营养师和美食顾问。\n";
     oss << "顾客信息：\n";
@@ -405,7 +830,8 @@ std::string AiService::buildRecommendationPrompt(const VisionResult& vision_resu
     
     oss << "- 用餐人数：" << vision_result.people_num << "\n";
     oss << "- 当前季节：" << season << "\n";
-    oss << "- 当前时间：" << meal_time << "\n\n";
+    oss << "- 当前时间：" << meal_time << "\n";
+    oss << popular_line << "\n";
     
     oss << "请根据以上信息：\n";
     oss << "1. 推荐3道最适合的招牌菜，并说明推荐理由\n";
@@ -418,6 +844,53 @@ std::string AiService::buildRecommendationPrompt(const VisionResult& vision_resu
     return oss.str();
 }
 
+std::string AiService::makeCacheKey(const VisionResult& vision_result, const std::string& season,
+                                   const std::string& meal_time, const std::string& popular_line) const {
+    uint64_t sold_out_version = sold_out_version_provider_ ? sold_out_version_provider_() : 0;
+    return RecommendationCache::makeKey(vision_result, season, meal_time, menu_version_.load(), sold_out_version,
+                                        popular_line);
+}
+
+std::string AiService::buildPopularDishesLine(const std::string& season, const std::string& meal_time) {
+    if (!popular_dishes_provider_) {
+        return "";
+    }
+    std::vector<std::string> names = popular_dishes_provider_(season, meal_time);
+    if (names.empty()) {
+        return "";
+    }
+    std::string line = "- 近7天该时段热销（可作参考）：";
+    for (size_t i = 0; i < names.size(); i++) {
+        if (i > 0) {
+            line += "、";
+        }
+        line += names[i];
+    }
+    return line + "\n";
+}
+
+std::string AiService::buildCombinedPrompt(const std::string& season, const std::string& meal_time,
+                                           const std::string& popular_line) {
+    std::ostringstream oss;
+    oss << "你是一个专业的餐厅营养师和美食顾问。请先分析图片中的顾客：\n";
+    oss << "1. 统计人数\n";
+    oss << "2. 识别每个人的性别（man/woman）\n";
+    oss << "3. 判断年龄段（儿童/青年/中年/老年）\n";
+    oss << "4. 评估体型（瘦/标准/胖）\n\n";
+
+    oss << "再结合以下信息为顾客推荐菜品：\n";
+    oss << "- 当前季节：" << season << "\n";
+    oss << "- 当前时间：" << meal_time << "\n";
+    oss << popular_line;
+    oss << "推荐3道最适合的招牌菜，说明推荐理由，并给出口味等级（辣度、咸度、甜度）和营养搭配建议。\n\n";
+
+    oss << "严格按照以下的 json 字符串返回\n";
+    oss << R"(示例：{"people_num":"1","customer_portrait":[{"age_grades":"青年","gender":"man","body_type":"标准"}],)"
+        << R"("recommendations":[{"dish_name":"糖醋里脊","reason":"小孩爱吃甜的","taste_level":"微甜","nutrition_advice":"富含蛋白质"}]})";
+
+    return oss.str();
+}
+
 size_t AiService::WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
     size_t totalSize = size * nmemb;
     std::string* response = static_cast<std::string*>(userp);
@@ -425,4 +898,27 @@ size_t AiService::WriteCallback(void* contents, size_t size, size_t nmemb, void*
     return totalSize;
 }
 
+size_t AiService::StreamWriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    size_t totalSize = size * nmemb;
+    StreamState* state = static_cast<StreamState*>(userp);
+    state->line_buffer.append(static_cast<char*>(contents), totalSize);
+
+    // 按行切分SSE数据，不完整的行留到下次回调
+    size_t start = 0;
+    size_t newline;
+    while ((newline = state->line_buffer.find('\n', start)) != std::string::npos) {
+        size_t end = newline;
+        if (end > start && state->line_buffer[end - 1] == '\r') {
+            end--;
+        }
+        handleStreamLine(state->line_buffer.substr(start, end - start), *state);
+        start = newline + 1;
+        if (state->aborted) {
+            return 0;  // 返回0使CURL中止传输
+        }
+    }
+    state->line_buffer.erase(0, start);
+    return totalSize;
+}
+
 } // namespace WisdomRestaurant
@@ -0,0 +1,202 @@
+#include "ai/CurlHandlePool.h"
+#include <algorithm>
+#include <iostream>
+
+namespace WisdomRestaurant {
+
+CurlHandlePool::Lease::Lease(CurlHandlePool* pool, CURL* handle)
+    : pool_(pool), handle_(handle) {
+}
+
+CurlHandlePool::Lease::Lease(Lease&& other) noexcept
+    : pool_(other.pool_), handle_(other.handle_) {
+    other.handle_ = nullptr;
+}
+
+CurlHandlePool::Lease::~Lease() {
+    if (handle_) {
+        pool_->release(handle_);
+    }
+}
+
+CurlHandlePool::CurlHandlePool(size_t max_idle_handles)
+    : max_idle_handles_(max_idle_handles)
+    , share_(nullptr)
+    , hits_(0)
+    , misses_(0)
+    , new_connections_(0)
+    , reused_connections_(0)
+    , handshake_us_total_(0) {
+}
+
+CurlHandlePool::~CurlHandlePool() {
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        for (CURL* handle : idle_handles_) {
+            curl_easy_cleanup(handle);
+        }
+        idle_handles_.clear();
+    }
+    if (share_) {
+        curl_share_cleanup(share_);
+    }
+}
+
+bool CurlHandlePool::initialize() {
+    share_ = curl_share_init();
+    if (!share_) {
+        std::cerr << "CURL共享缓存创建失败" << std::endl;
+        return false;
+    }
+
+    curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, lockCallback);
+    curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, unlockCallback);
+    curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+
+    // DNS缓存和TLS会话在所有句柄间共享
+    // 连接缓存不共享：libcurl不支持多个线程同时通过共享的连接缓存传输，每个句柄保留自己的连接
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    return true;
+}
+
+CurlHandlePool::Lease CurlHandlePool::acquire() {
+    CURL* handle = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        if (!idle_handles_.empty()) {
+            handle = idle_handles_.back();
+            idle_handles_.pop_back();
+        }
+    }
+
+    if (handle) {
+        hits_++;
+    } else {
+        misses_++;
+        handle = curl_easy_init();
+        if (!handle) {
+            return Lease(this, nullptr);
+        }
+    }
+
+    configureHandle(handle);
+    return Lease(this, handle);
+}
+
+void CurlHandlePool::release(CURL* handle) {
+    // reset只清除选项，不会关闭连接和缓存
+    curl_easy_reset(handle);
+
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (idle_handles_.size() < max_idle_handles_) {
+        idle_handles_.push_back(handle);
+        return;
+    }
+    curl_easy_cleanup(handle);
+}
+
+void CurlHandlePool::configureHandle(CURL* handle) {
+    if (share_) {
+        curl_easy_setopt(handle, CURLOPT_SHARE, share_);
+    }
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPIDLE, 60L);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPINTVL, 30L);
+    curl_easy_setopt(handle, CURLOPT_DNS_CACHE_TIMEOUT, 300L);
+}
+
+size_t CurlHandlePool::warmup(const std::string& url, size_t count, std::chrono::milliseconds budget) {
+    // 先把句柄全部借出，保证每次预热都建立独立的连接
+    std::vector<Lease> leases;
+    for (size_t i = 0; i < count; i++) {
+        Lease lease = acquire();
+        if (!lease) {
+            break;
+        }
+        leases.push_back(std::move(lease));
+    }
+
+    // 所有预热共用一个截止时间，启动最多被阻塞budget
+    auto deadline = std::chrono::steady_clock::now() + budget;
+    size_t warmed = 0;
+    for (auto& lease : leases) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            std::cerr << "CURL连接预热超时，剩余句柄不再预热" << std::endl;
+            break;
+        }
+
+        CURL* handle = lease.get();
+        curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(handle, CURLOPT_NOBODY, 1L);
+        curl_easy_setopt(handle, CURLOPT_FRESH_CONNECT, 1L);
+        curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT_MS,
+                         static_cast<long>(std::min(remaining, kWarmupConnectTimeout).count()));
+        curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS, static_cast<long>(remaining.count()));
+
+        // 端点对HEAD请求的状态码无关紧要，只要连接建立成功即可
+        CURLcode res = curl_easy_perform(handle);
+        if (res != CURLE_OK) {
+            // 端点不可达时其余句柄也会失败，直接放弃，由首个请求再建立连接
+            std::cerr << "CURL连接预热失败: " << curl_easy_strerror(res) << std::endl;
+            break;
+        }
+        recordTransfer(handle);
+        warmed++;
+    }
+    return warmed;
+}
+
+void CurlHandlePool::recordTransfer(CURL* handle) {
+    long num_connects = 0;
+    curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &num_connects);
+    if (num_connects == 0) {
+        reused_connections_++;
+        return;
+    }
+
+    new_connections_ += static_cast<uint64_t>(num_connects);
+
+    // 握手耗时 = TLS完成时间（明文连接取TCP连接完成时间）- DNS解析完成时间
+    curl_off_t namelookup_us = 0, connect_us = 0, appconnect_us = 0;
+    curl_easy_getinfo(handle, CURLINFO_NAMELOOKUP_TIME_T, &namelookup_us);
+    curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME_T, &connect_us);
+    curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME_T, &appconnect_us);
+
+    curl_off_t done_us = appconnect_us > 0 ? appconnect_us : connect_us;
+    if (done_us > namelookup_us) {
+        handshake_us_total_ += static_cast<uint64_t>(done_us - namelookup_us);
+    }
+}
+
+CurlPoolStats CurlHandlePool::getStats() const {
+    CurlPoolStats stats;
+    stats.hits = hits_.load();
+    stats.misses = misses_.load();
+    stats.new_connections = new_connections_.load();
+    stats.reused_connections = reused_connections_.load();
+    stats.handshake_ms_total = handshake_us_total_.load() / 1000.0;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        stats.idle_handles = idle_handles_.size();
+    }
+    return stats;
+}
+
+void CurlHandlePool::lockCallback(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr) {
+    (void)handle;
+    (void)access;
+    auto* pool = static_cast<CurlHandlePool*>(userptr);
+    pool->share_mutexes_[data].lock();
+}
+
+void CurlHandlePool::unlockCallback(CURL* handle, curl_lock_data data, void* userptr) {
+    (void)handle;
+    auto* pool = static_cast<CurlHandlePool*>(userptr);
+    pool->share_mutexes_[data].unlock();
+}
+
+} // namespace WisdomRestaurant
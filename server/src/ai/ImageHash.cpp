@@ -0,0 +1,141 @@
+#include "ai/ImageHash.h"
+#include "common/Base64.h"
+#include <algorithm>
+#include <cstdio>
+#include <csetjmp>
+#include <vector>
+
+#ifdef WISDOM_HAVE_JPEG
+#include <jpeglib.h>
+#endif
+
+namespace WisdomRestaurant {
+namespace ImageHash {
+
+static const int kHashWidth = 9;
+static const int kHashHeight = 8;
+
+// 按面积平均把灰度图缩小为9x8，再逐行比较相邻像素
+static uint64_t dHashFromGray(const std::vector<unsigned char>& pixels, int width, int height) {
+    double cells[kHashHeight][kHashWidth];
+    for (int cy = 0; cy < kHashHeight; cy++) {
+        int y0 = cy * height / kHashHeight;
+        int y1 = std::max(y0 + 1, (cy + 1) * height / kHashHeight);
+        for (int cx = 0; cx < kHashWidth; cx++) {
+            int x0 = cx * width / kHashWidth;
+            int x1 = std::max(x0 + 1, (cx + 1) * width / kHashWidth);
+            uint64_t sum = 0;
+            for (int y = y0; y < y1 && y < height; y++) {
+                const unsigned char* row = pixels.data() + static_cast<size_t>(y) * width;
+                for (int x = x0; x < x1 && x < width; x++) {
+                    sum += row[x];
+                }
+            }
+            cells[cy][cx] = static_cast<double>(sum) / ((y1 - y0) * (x1 - x0));
+        }
+    }
+
+    uint64_t hash = 0;
+    for (int cy = 0; cy < kHashHeight; cy++) {
+        for (int cx = 0; cx < kHashWidth - 1; cx++) {
+            hash = (hash << 1) | (cells[cy][cx] < cells[cy][cx + 1] ? 1 : 0);
+        }
+    }
+    return hash;
+}
+
+#ifdef WISDOM_HAVE_JPEG
+struct JpegErrorManager {
+    jpeg_error_mgr base;
+    jmp_buf jump;
+};
+
+static void onJpegError(j_common_ptr cinfo) {
+    JpegErrorManager* err = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+    longjmp(err->jump, 1);
+}
+
+static void onJpegMessage(j_common_ptr) {
+    // 忽略解码警告
+}
+
+// 以1/8比例解码为灰度图：libjpeg只需计算每个8x8块的DC分量，几乎不做IDCT
+static bool decodeJpegGray(const std::string& data, std::vector<unsigned char>& pixels, int& width, int& height) {
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager err;
+    cinfo.err = jpeg_std_error(&err.base);
+    err.base.error_exit = onJpegError;
+    err.base.output_message = onJpegMessage;
+
+    if (setjmp(err.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, reinterpret_cast<const unsigned char*>(data.data()), static_cast<unsigned long>(data.size()));
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    cinfo.out_color_space = JCS_GRAYSCALE;
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = 8;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+    jpeg_start_decompress(&cinfo);
+
+    width = static_cast<int>(cinfo.output_width);
+    height = static_cast<int>(cinfo.output_height);
+    pixels.resize(static_cast<size_t>(width) * height);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = pixels.data() + static_cast<size_t>(cinfo.output_scanline) * width;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return width > 0 && height > 0;
+}
+#endif
+
+bool computeDHash(const CustomerImage& image, uint64_t& hash) {
+#ifdef WISDOM_HAVE_JPEG
+    if (image.empty()) {
+        return false;
+    }
+
+    std::string decoded;
+    const std::string* bytes = &image.data;
+    if (image.is_base64) {
+        if (!Base64::decode(image.data, decoded)) {
+            return false;
+        }
+        bytes = &decoded;
+    }
+
+    // 只处理JPEG（FF D8 FF）
+    if (bytes->size() < 3 || static_cast<unsigned char>((*bytes)[0]) != 0xFF ||
+        static_cast<unsigned char>((*bytes)[1]) != 0xD8 || static_cast<unsigned char>((*bytes)[2]) != 0xFF) {
+        return false;
+    }
+
+    std::vector<unsigned char> pixels;
+    int width = 0;
+    int height = 0;
+    if (!decodeJpegGray(*bytes, pixels, width, height)) {
+        return false;
+    }
+
+    hash = dHashFromGray(pixels, width, height);
+    return true;
+#else
+    (void)image;
+    (void)hash;
+    return false;
+#endif
+}
+
+} // namespace ImageHash
+} // namespace WisdomRestaurant
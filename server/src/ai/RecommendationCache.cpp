@@ -0,0 +1,179 @@
+#include "ai/RecommendationCache.h"
+#include <algorithm>
+#include <cctype>
+
+namespace WisdomRestaurant {
+
+// 去除首尾空白并转为小写，避免大模型输出的细微差异产生不同的key
+static std::string canonicalize(const std::string& value) {
+    size_t begin = 0;
+    size_t end = value.size();
+    while (begin < end && std::isspace(static_cast<unsigned char>(value[begin]))) begin++;
+    while (end > begin && std::isspace(static_cast<unsigned char>(value[end - 1]))) end--;
+
+    std::string out = value.substr(begin, end - begin);
+    std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    return out.empty() ? "-" : out;
+}
+
+RecommendationCache::RecommendationCache(size_t max_entries, std::chrono::seconds ttl)
+    : max_entries_(max_entries)
+    , ttl_(ttl)
+    , hits_(0)
+    , misses_(0)
+    , coalesced_(0)
+    , evictions_(0)
+    , expirations_(0) {
+}
+
+std::string RecommendationCache::makeKey(const VisionResult& vision_result,
+                                         const std::string& season,
+                                         const std::string& meal_time,
+                                         uint64_t menu_version,
+                                         uint64_t sold_out_version,
+                                         const std::string& popular_line) {
+    // 与buildRecommendationPrompt保持一致：只使用第一位顾客的画像
+    std::string key;
+    key.reserve(96);
+    if (!vision_result.customer_portrait.empty()) {
+        const auto& customer = vision_result.customer_portrait[0];
+        key += canonicalize(customer.age_grades) + "|";
+        key += canonicalize(customer.gender) + "|";
+        key += canonicalize(customer.body_type) + "|";
+    } else {
+        key += "-|-|-|";
+    }
+    key += std::to_string(vision_result.people_num) + "|";
+    key += canonicalize(season) + "|";
+    key += canonicalize(meal_time) + "|";
+    key += "v" + std::to_string(menu_version) + "|";
+    key += "s" + std::to_string(sold_out_version) + "|";
+    key += popular_line;
+    return key;
+}
+
+RecommendationResult RecommendationCache::getOrLoad(const std::string& key,
+                                                    const std::function<RecommendationResult()>& loader) {
+    std::promise<RecommendationResult> promise;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto cached = lookupLocked(key);
+        if (cached) {
+            hits_++;
+            return *cached;
+        }
+
+        auto it = in_flight_.find(key);
+        if (it != in_flight_.end()) {
+            // 已有相同请求在调用大模型，等待其结果
+            coalesced_++;
+            std::shared_future<RecommendationResult> pending = it->second;
+            lock.unlock();
+            return pending.get();
+        }
+
+        misses_++;
+        in_flight_[key] = promise.get_future().share();
+    }
+
+    RecommendationResult result;
+    try {
+        result = loader();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        in_flight_.erase(key);
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (result.success && !result.recommendations.empty()) {
+            putLocked(key, result);
+        }
+        in_flight_.erase(key);
+    }
+    promise.set_value(result);
+    return result;
+}
+
+std::optional<RecommendationResult> RecommendationCache::lookup(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto cached = lookupLocked(key);
+    if (cached) {
+        hits_++;
+    }
+    return cached;
+}
+
+void RecommendationCache::put(const std::string& key, const RecommendationResult& result) {
+    if (!result.success || result.recommendations.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    putLocked(key, result);
+}
+
+void RecommendationCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+}
+
+RecommendationCacheStats RecommendationCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RecommendationCacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.coalesced = coalesced_;
+    stats.evictions = evictions_;
+    stats.expirations = expirations_;
+    stats.entries = index_.size();
+    return stats;
+}
+
+std::optional<RecommendationResult> RecommendationCache::lookupLocked(const std::string& key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return std::nullopt;
+    }
+
+    if (std::chrono::steady_clock::now() >= it->second->expires_at) {
+        lru_.erase(it->second);
+        index_.erase(it);
+        expirations_++;
+        return std::nullopt;
+    }
+
+    // 移到LRU链表头部
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->result;
+}
+
+void RecommendationCache::putLocked(const std::string& key, const RecommendationResult& result) {
+    if (max_entries_ == 0) {
+        return;
+    }
+
+    auto expires_at = std::chrono::steady_clock::now() + ttl_;
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        it->second->result = result;
+        it->second->expires_at = expires_at;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+    }
+
+    lru_.push_front(Entry{key, result, expires_at});
+    index_[key] = lru_.begin();
+
+    while (index_.size() > max_entries_) {
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+        evictions_++;
+    }
+}
+
+} // namespace WisdomRestaurant
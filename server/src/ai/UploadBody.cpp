@@ -0,0 +1,121 @@
+#include "ai/UploadBody.h"
+#include "common/Base64.h"
+#include <algorithm>
+#include <cstring>
+
+namespace WisdomRestaurant {
+
+UploadBody::UploadBody(std::string body)
+    : prefix_(std::move(body))
+    , image_(nullptr)
+    , image_is_base64_(true)
+    , position_(0)
+    , image_offset_(0)
+    , pending_size_(0)
+    , pending_offset_(0) {
+}
+
+UploadBody::UploadBody(std::string prefix, const std::string* image, bool image_is_base64, std::string suffix)
+    : prefix_(std::move(prefix))
+    , image_(image)
+    , image_is_base64_(image_is_base64)
+    , suffix_(std::move(suffix))
+    , position_(0)
+    , image_offset_(0)
+    , pending_size_(0)
+    , pending_offset_(0) {
+}
+
+size_t UploadBody::size() const {
+    size_t image_size = 0;
+    if (image_) {
+        image_size = image_is_base64_ ? image_->size() : Base64::encodedLength(image_->size());
+    }
+    return prefix_.size() + image_size + suffix_.size();
+}
+
+size_t UploadBody::read(char* buffer, size_t length) {
+    const size_t image_begin = prefix_.size();
+    const size_t image_end = size() - suffix_.size();
+    size_t written = 0;
+
+    while (written < length) {
+        size_t n = 0;
+        if (position_ < image_begin) {
+            n = std::min(length - written, image_begin - position_);
+            std::memcpy(buffer + written, prefix_.data() + position_, n);
+        } else if (position_ < image_end) {
+            n = readImage(buffer + written, length - written);
+        } else if (position_ < image_end + suffix_.size()) {
+            size_t offset = position_ - image_end;
+            n = std::min(length - written, suffix_.size() - offset);
+            std::memcpy(buffer + written, suffix_.data() + offset, n);
+        }
+
+        if (n == 0) {
+            break;
+        }
+        written += n;
+        position_ += n;
+    }
+    return written;
+}
+
+size_t UploadBody::readImage(char* buffer, size_t length) {
+    if (image_is_base64_) {
+        size_t n = std::min(length, image_->size() - image_offset_);
+        std::memcpy(buffer, image_->data() + image_offset_, n);
+        image_offset_ += n;
+        return n;
+    }
+
+    // 先输出上次没写完的编码结果
+    if (pending_offset_ < pending_size_) {
+        size_t n = std::min(length, pending_size_ - pending_offset_);
+        std::memcpy(buffer, pending_ + pending_offset_, n);
+        pending_offset_ += n;
+        return n;
+    }
+
+    size_t remaining = image_->size() - image_offset_;
+    size_t groups = std::min(length / 4, remaining / 3);
+    if (groups > 0) {
+        size_t n = Base64::encodeInto(image_->data() + image_offset_, groups * 3, buffer);
+        image_offset_ += groups * 3;
+        return n;
+    }
+
+    // 最后不足3字节的数据，或缓冲区剩余不足4字节时，经pending_中转
+    size_t chunk = std::min<size_t>(3, remaining);
+    pending_size_ = Base64::encodeInto(image_->data() + image_offset_, chunk, pending_);
+    pending_offset_ = 0;
+    image_offset_ += chunk;
+
+    size_t n = std::min(length, pending_size_);
+    std::memcpy(buffer, pending_, n);
+    pending_offset_ = n;
+    return n;
+}
+
+void UploadBody::rewind() {
+    position_ = 0;
+    image_offset_ = 0;
+    pending_size_ = 0;
+    pending_offset_ = 0;
+}
+
+size_t UploadBody::ReadCallback(char* buffer, size_t size, size_t nitems, void* userp) {
+    UploadBody* body = static_cast<UploadBody*>(userp);
+    return body->read(buffer, size * nitems);
+}
+
+int UploadBody::SeekCallback(void* userp, curl_off_t offset, int origin) {
+    // 只支持回到开头重新发送
+    if (offset != 0 || origin != SEEK_SET) {
+        return CURL_SEEKFUNC_CANTSEEK;
+    }
+    static_cast<UploadBody*>(userp)->rewind();
+    return CURL_SEEKFUNC_OK;
+}
+
+} // namespace WisdomRestaurant
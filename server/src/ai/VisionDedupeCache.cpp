@@ -0,0 +1,93 @@
+#include "ai/VisionDedupeCache.h"
+#include "ai/ImageHash.h"
+
+namespace WisdomRestaurant {
+
+VisionDedupeCache::VisionDedupeCache(int max_distance, std::chrono::seconds ttl, size_t max_per_table)
+    : max_distance_(max_distance)
+    , ttl_(ttl)
+    , max_per_table_(max_per_table == 0 ? 1 : max_per_table)
+    , lookups_(0)
+    , hits_(0)
+    , misses_(0)
+    , unhashable_(0)
+    , saved_ms_total_(0.0) {
+}
+
+std::optional<VisionResult> VisionDedupeCache::find(const std::string& table_number, uint64_t hash) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lookups_++;
+
+    auto it = tables_.find(table_number);
+    if (it == tables_.end()) {
+        misses_++;
+        return std::nullopt;
+    }
+
+    // 先清理过期条目（队尾最旧）
+    auto now = std::chrono::steady_clock::now();
+    auto& entries = it->second;
+    while (!entries.empty() && entries.back().expires_at <= now) {
+        entries.pop_back();
+    }
+    if (entries.empty()) {
+        tables_.erase(it);
+        misses_++;
+        return std::nullopt;
+    }
+
+    const Entry* best = nullptr;
+    int best_distance = max_distance_ + 1;
+    for (const auto& entry : entries) {
+        int distance = ImageHash::hammingDistance(entry.hash, hash);
+        if (distance < best_distance) {
+            best = &entry;
+            best_distance = distance;
+        }
+    }
+
+    if (!best) {
+        misses_++;
+        return std::nullopt;
+    }
+
+    hits_++;
+    saved_ms_total_ += best->elapsed_ms;
+    return best->result;
+}
+
+void VisionDedupeCache::store(const std::string& table_number, uint64_t hash,
+                              const VisionResult& result, double elapsed_ms) {
+    if (!result.success) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& entries = tables_[table_number];
+    entries.push_front(Entry{hash, result, elapsed_ms, std::chrono::steady_clock::now() + ttl_});
+    while (entries.size() > max_per_table_) {
+        entries.pop_back();
+    }
+}
+
+void VisionDedupeCache::recordUnhashable() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    unhashable_++;
+}
+
+VisionDedupeStats VisionDedupeCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    VisionDedupeStats stats;
+    stats.lookups = lookups_;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.unhashable = unhashable_;
+    stats.saved_ms_total = saved_ms_total_;
+    stats.entries = 0;
+    for (const auto& table : tables_) {
+        stats.entries += table.second.size();
+    }
+    return stats;
+}
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,249 @@
+#include "api/AdmissionController.h"
+#include "common/JsonResponse.h"
+#include "loguru.hpp"
+#include <algorithm>
+
+namespace WisdomRestaurant {
+
+namespace {
+
+// 当前工作线程正在处理的连接和请求状态（httplib每个线程同一时间只处理一个请求）
+struct ConnectionState {
+    AdmissionController* owner = nullptr;
+    bool shed_lane = false;          // 连接是否由快速拒绝通道处理
+    bool holding = false;            // 当前请求是否占用了并发额度
+    RequestPriority priority = RequestPriority::Normal;
+};
+
+thread_local ConnectionState t_connection;
+
+size_t index(RequestPriority priority) {
+    return static_cast<size_t>(priority);
+}
+
+// 计数未达到上限时加一
+bool tryIncrement(std::atomic<size_t>& counter, size_t limit) {
+    size_t current = counter.load();
+    while (current < limit) {
+        if (counter.compare_exchange_weak(current, current + 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+const char* requestPriorityName(RequestPriority priority) {
+    switch (priority) {
+        case RequestPriority::Critical: return "critical";
+        case RequestPriority::Normal: return "normal";
+        case RequestPriority::Bulk: return "bulk";
+    }
+    return "normal";
+}
+
+// httplib连接队列：优先交给工作线程池，池满时交给快速拒绝通道
+class AdmissionController::TaskQueue : public httplib::TaskQueue {
+public:
+    TaskQueue(AdmissionController& owner, std::shared_ptr<JobExecutor> workers, std::shared_ptr<JobExecutor> shed_lane)
+        : owner_(owner), workers_(std::move(workers)), shed_lane_(std::move(shed_lane)) {
+    }
+
+    bool enqueue(std::function<void()> fn) override {
+        // submit失败时会销毁传入的函数，用shared_ptr保留连接以便转交快速拒绝通道
+        auto task = std::make_shared<std::function<void()>>(std::move(fn));
+        AdmissionController* owner = &owner_;
+        if (workers_->submit([owner, task]() { runConnection(owner, *task, false); })) {
+            return true;
+        }
+
+        if (shed_lane_->submit([owner, task]() { runConnection(owner, *task, true); })) {
+            uint64_t shed = ++owner_.connections_shed_;
+            if (shed % 100 == 1) {
+                LOG_F(WARNING, "HTTP连接队列已满(%zu)，新连接进入快速拒绝通道，累计 %llu 个",
+                      owner_.options_.max_queued, static_cast<unsigned long long>(shed));
+            }
+            return true;
+        }
+
+        owner_.connections_dropped_++;
+        return false;
+    }
+
+    void shutdown() override {
+        workers_->shutdown();
+        shed_lane_->shutdown();
+    }
+
+private:
+    static void runConnection(AdmissionController* owner, const std::function<void()>& fn, bool shed_lane) {
+        t_connection.owner = owner;
+        t_connection.shed_lane = shed_lane;
+        t_connection.holding = false;
+        fn();
+        // 响应写出失败时不会调用logger，在连接结束时兜底释放
+        owner->release();
+        t_connection = ConnectionState();
+    }
+
+private:
+    AdmissionController& owner_;
+    std::shared_ptr<JobExecutor> workers_;
+    std::shared_ptr<JobExecutor> shed_lane_;
+};
+
+AdmissionController::AdmissionController(const AdmissionOptions& options)
+    : options_(options)
+    , normal_and_bulk_inflight_(0)
+    , connections_shed_(0)
+    , connections_dropped_(0) {
+    options_.workers = std::max<size_t>(options_.workers, 1);
+    options_.max_queued = std::max<size_t>(options_.max_queued, 1);
+    options_.shed_workers = std::max<size_t>(options_.shed_workers, 1);
+    options_.shed_queue_size = std::max<size_t>(options_.shed_queue_size, 1);
+
+    normal_limit_ = options_.workers > options_.reserved_workers ? options_.workers - options_.reserved_workers : 1;
+    bulk_limit_ = options_.bulk_max_inflight > 0 ? options_.bulk_max_inflight : std::max<size_t>(options_.workers / 2, 1);
+    bulk_limit_ = std::min(bulk_limit_, normal_limit_);
+
+    for (size_t i = 0; i < 3; i++) {
+        inflight_[i] = 0;
+        admitted_[i] = 0;
+        shed_[i] = 0;
+    }
+}
+
+AdmissionController::~AdmissionController() = default;
+
+void AdmissionController::setRoutePriority(const std::string& method, const std::string& path_prefix,
+                                           RequestPriority priority) {
+    routes_.push_back(RouteRule{method, path_prefix, priority});
+}
+
+RequestPriority AdmissionController::classify(const httplib::Request& request) const {
+    if (request.method == "OPTIONS") {
+        return RequestPriority::Critical;
+    }
+
+    const RouteRule* best = nullptr;
+    for (const auto& rule : routes_) {
+        if (!rule.method.empty() && rule.method != request.method) {
+            continue;
+        }
+        if (request.path.compare(0, rule.path_prefix.size(), rule.path_prefix) != 0) {
+            continue;
+        }
+        if (!best || rule.path_prefix.size() > best->path_prefix.size()) {
+            best = &rule;
+        }
+    }
+    return best ? best->priority : RequestPriority::Normal;
+}
+
+httplib::TaskQueue* AdmissionController::newTaskQueue() {
+    auto workers = std::make_shared<JobExecutor>("http", options_.workers, options_.max_queued);
+    auto shed_lane = std::make_shared<JobExecutor>("http-shed", options_.shed_workers, options_.shed_queue_size);
+    {
+        std::lock_guard<std::mutex> lock(lanes_mutex_);
+        workers_ = workers;
+        shed_lane_ = shed_lane;
+    }
+    return new TaskQueue(*this, workers, shed_lane);
+}
+
+bool AdmissionController::admit(const httplib::Request& request, httplib::Response& response) {
+    // 同一连接上一个请求的额度未释放（例如响应写出失败），先归还
+    release();
+
+    // 快速拒绝通道只处理Critical请求
+    RequestPriority priority = classify(request);
+    bool allowed = t_connection.shed_lane && priority != RequestPriority::Critical ? false : tryAcquire(priority);
+    if (!allowed) {
+        reject(priority, response);
+        return false;
+    }
+
+    admitted_[index(priority)]++;
+    t_connection.owner = this;
+    t_connection.holding = true;
+    t_connection.priority = priority;
+    return true;
+}
+
+void AdmissionController::release() {
+    if (!t_connection.holding || t_connection.owner != this) {
+        return;
+    }
+    t_connection.holding = false;
+
+    RequestPriority priority = t_connection.priority;
+    inflight_[index(priority)]--;
+    if (priority != RequestPriority::Critical) {
+        normal_and_bulk_inflight_--;
+    }
+}
+
+bool AdmissionController::tryAcquire(RequestPriority priority) {
+    switch (priority) {
+        case RequestPriority::Critical:
+            inflight_[index(priority)]++;
+            return true;
+        case RequestPriority::Normal:
+            if (!tryIncrement(normal_and_bulk_inflight_, normal_limit_)) {
+                return false;
+            }
+            inflight_[index(priority)]++;
+            return true;
+        case RequestPriority::Bulk:
+            if (!tryIncrement(inflight_[index(priority)], bulk_limit_)) {
+                return false;
+            }
+            if (!tryIncrement(normal_and_bulk_inflight_, normal_limit_)) {
+                inflight_[index(priority)]--;
+                return false;
+            }
+            return true;
+    }
+    return false;
+}
+
+void AdmissionController::reject(RequestPriority priority, httplib::Response& response) {
+    shed_[index(priority)]++;
+    response.status = 503;
+    response.set_header("Retry-After", std::to_string(options_.retry_after_seconds));
+    response.set_header("Connection", "close");
+    response.set_content(JsonResponse::build(503, "服务器繁忙，请稍后重试"), "application/json; charset=utf-8");
+}
+
+AdmissionStats AdmissionController::getStats() const {
+    AdmissionStats stats;
+    stats.workers = options_.workers;
+    stats.max_queued = options_.max_queued;
+    stats.queue_depth = 0;
+    stats.max_queue_depth = 0;
+    stats.connections_accepted = 0;
+
+    std::shared_ptr<JobExecutor> workers;
+    {
+        std::lock_guard<std::mutex> lock(lanes_mutex_);
+        workers = workers_;
+    }
+    if (workers) {
+        JobExecutorStats worker_stats = workers->getStats();
+        stats.queue_depth = worker_stats.queue_depth;
+        stats.max_queue_depth = worker_stats.max_queue_depth;
+        stats.connections_accepted = worker_stats.submitted;
+    }
+    stats.connections_shed = connections_shed_.load();
+    stats.connections_dropped = connections_dropped_.load();
+
+    for (size_t i = 0; i < 3; i++) {
+        stats.inflight[i] = inflight_[i].load();
+        stats.admitted[i] = admitted_[i].load();
+        stats.shed[i] = shed_[i].load();
+    }
+    return stats;
+}
+
+} // namespace WisdomRestaurant
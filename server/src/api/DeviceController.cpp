@@ -0,0 +1,385 @@
+#include "api/DeviceController.h"
+#include "loguru.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+namespace WisdomRestaurant {
+
+// 环境数据单次查询的最长时间范围
+static const int64_t kMaxEnvironmentRangeSeconds = 366LL * 86400;
+
+static int64_t unixNow() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 读取可选的数值字段，类型不对时使用默认值
+static double numberField(const rapidjson::Value& doc, const char* name, double default_value) {
+    auto it = doc.FindMember(name);
+    return it != doc.MemberEnd() && it->value.IsNumber() ? it->value.GetDouble() : default_value;
+}
+
+DeviceController::DeviceController(std::shared_ptr<RestaurantDb> db, std::shared_ptr<HeartbeatStore> heartbeats)
+    : db_(db)
+    , heartbeats_(heartbeats)
+    , heartbeat_interval_(30) {
+}
+
+void DeviceController::handleHeartbeat(const httplib::Request& request, httplib::Response& response) {
+    JsonResponse::setCorsHeaders(response);
+
+    rapidjson::Document doc;
+    doc.Parse(request.body.c_str());
+    if (!doc.IsObject() || !doc.HasMember("client_id") || !doc["client_id"].IsString() ||
+        !doc.HasMember("table_number") || !doc["table_number"].IsString()) {
+        JsonResponse::send(response, 400, JsonResponse::build(400, "请求参数不完整，需要client_id和table_number"));
+        return;
+    }
+
+    std::string client_id = doc["client_id"].GetString();
+    std::string table_number = doc["table_number"].GetString();
+    if (client_id.empty() || client_id.size() > 64) {
+        JsonResponse::send(response, 400, JsonResponse::build(400, "client_id长度应为1~64"));
+        return;
+    }
+    std::optional<int> table_id = resolveTableId(table_number);
+    if (!table_id) {
+        JsonResponse::send(response, 404, JsonResponse::build(404, "餐桌不存在"));
+        return;
+    }
+
+    ClientHeartbeat heartbeat;
+    heartbeat.id = 0;
+    heartbeat.table_id = *table_id;
+    heartbeat.client_id = client_id;
+    heartbeat.temperature = numberField(doc, "temperature", 0.0);
+    heartbeat.light_intensity = numberField(doc, "light_intensity", 0.0);
+    heartbeat.humidity = numberField(doc, "humidity", 0.0);
+    heartbeat.noise_level = numberField(doc, "noise_level", 0.0);
+    heartbeat.battery_level = static_cast<int>(numberField(doc, "battery_level", -1));
+    heartbeat.signal_strength = static_cast<int>(numberField(doc, "signal_strength", 0));
+    auto status = doc.FindMember("device_status");
+    heartbeat.device_status = status != doc.MemberEnd() && status->value.IsString()
+        ? status->value.GetString() : "online";
+
+    if (heartbeats_->update(heartbeat)) {
+        LOG_F(INFO, "客户端上线: %s (餐桌 %s)", client_id.c_str(), table_number.c_str());
+    }
+
+    // 心跳中带的传感器数据同时进入环境时序
+    EnvironmentSample sample;
+    if (environment_ && readEnvironmentSample(doc, unixNow(), sample)) {
+        environment_->record(*table_id, sample);
+    }
+
+    int interval = heartbeat_interval_;
+    JsonResponse::send(response, 200, JsonResponse::build(200, "心跳已接收", [&](JsonResponse::JsonWriter& writer) {
+        writer.StartObject();
+        writer.Key("client_id");
+        writer.String(client_id.c_str(), static_cast<rapidjson::SizeType>(client_id.size()));
+        writer.Key("table_number");
+        writer.String(table_number.c_str(), static_cast<rapidjson::SizeType>(table_number.size()));
+        writer.Key("heartbeat_interval");
+        writer.Int(interval);
+        writer.EndObject();
+    }));
+}
+
+void DeviceController::handleGetActiveClients(const httplib::Request& request, httplib::Response& response) {
+    JsonResponse::setCorsHeaders(response);
+
+    int timeout = 0;
+    if (request.has_param("timeout")) {
+        timeout = std::atoi(request.get_param_value("timeout").c_str());
+    }
+    std::optional<int> table_id;
+    if (request.has_param("table_number")) {
+        table_id = resolveTableId(request.get_param_value("table_number"));
+        if (!table_id) {
+            JsonResponse::send(response, 404, JsonResponse::build(404, "餐桌不存在"));
+            return;
+        }
+    }
+
+    std::vector<ClientHeartbeat> clients = heartbeats_->getActiveClients(timeout);
+    if (table_id) {
+        clients.erase(std::remove_if(clients.begin(), clients.end(), [&table_id](const ClientHeartbeat& client) {
+            return client.table_id != *table_id;
+        }), clients.end());
+    }
+
+    JsonResponse::send(response, 200, JsonResponse::build(200, "获取活跃客户端成功", [&](JsonResponse::JsonWriter& writer) {
+        writer.StartObject();
+        writer.Key("clients");
+        writer.StartArray();
+        for (const auto& client : clients) {
+            std::string table_number = tableNumberOf(client.table_id);
+            writer.StartObject();
+            writer.Key("client_id");
+            writer.String(client.client_id.c_str(), static_cast<rapidjson::SizeType>(client.client_id.size()));
+            writer.Key("table_id");
+            writer.Int(client.table_id);
+            writer.Key("table_number");
+            writer.String(table_number.c_str(), static_cast<rapidjson::SizeType>(table_number.size()));
+            writer.Key("device_status");
+            writer.String(client.device_status.c_str(), static_cast<rapidjson::SizeType>(client.device_status.size()));
+            writer.Key("temperature");
+            writer.Double(client.temperature);
+            writer.Key("light_intensity");
+            writer.Double(client.light_intensity);
+            writer.Key("humidity");
+            writer.Double(client.humidity);
+            writer.Key("noise_level");
+            writer.Double(client.noise_level);
+            writer.Key("battery_level");
+            writer.Int(client.battery_level);
+            writer.Key("signal_strength");
+            writer.Int(client.signal_strength);
+            writer.Key("last_heartbeat");
+            writer.String(client.last_heartbeat.c_str(), static_cast<rapidjson::SizeType>(client.last_heartbeat.size()));
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.Key("total");
+        writer.Uint64(clients.size());
+        writer.EndObject();
+    }));
+}
+
+void DeviceController::handleEnvironmentReport(const httplib::Request& request, httplib::Response& response) {
+    JsonResponse::setCorsHeaders(response);
+    if (!environment_) {
+        JsonResponse::send(response, 503, JsonResponse::build(503, "环境数据功能未启用"));
+        return;
+    }
+
+    rapidjson::Document doc;
+    doc.Parse(request.body.c_str());
+    if (!doc.IsObject() || !doc.HasMember("table_number") || !doc["table_number"].IsString()) {
+        JsonResponse::send(response, 400, JsonResponse::build(400, "请求参数不完整，需要table_number"));
+        return;
+    }
+    std::string table_number = doc["table_number"].GetString();
+    std::optional<int> table_id = resolveTableId(table_number);
+    if (!table_id) {
+        JsonResponse::send(response, 404, JsonResponse::build(404, "餐桌不存在"));
+        return;
+    }
+
+    // 终端可以缓存一段时间的样本后一次上报
+    int64_t now = unixNow();
+    int accepted = 0;
+    int rejected = 0;
+    auto record = [&](const rapidjson::Value& value) {
+        EnvironmentSample sample;
+        if (value.IsObject() && readEnvironmentSample(value, now, sample) && environment_->record(*table_id, sample)) {
+            accepted++;
+        } else {
+            rejected++;
+        }
+    };
+    auto samples = doc.FindMember("samples");
+    if (samples != doc.MemberEnd() && samples->value.IsArray()) {
+        for (const auto& value : samples->value.GetArray()) {
+            record(value);
+        }
+    } else {
+        record(doc);
+    }
+
+    if (accepted == 0) {
+        JsonResponse::send(response, 400, JsonResponse::build(400, "没有有效的环境数据（缺少指标或时间戳超出范围）"));
+        return;
+    }
+    JsonResponse::send(response, 200, JsonResponse::build(200, "环境数据已接收", [&](JsonResponse::JsonWriter& writer) {
+        writer.StartObject();
+        writer.Key("accepted");
+        writer.Int(accepted);
+        writer.Key("rejected");
+        writer.Int(rejected);
+        writer.EndObject();
+    }));
+}
+
+void DeviceController::handleGetEnvironment(const httplib::Request& request, httplib::Response& response) {
+    JsonResponse::setCorsHeaders(response);
+    if (!environment_) {
+        JsonResponse::send(response, 503, JsonResponse::build(503, "环境数据功能未启用"));
+        return;
+    }
+
+    std::string table_number = request.get_param_value("table_number");
+    std::optional<int> table_id = resolveTableId(table_number);
+    if (!table_id) {
+        JsonResponse::send(response, table_number.empty() ? 400 : 404,
+                 JsonResponse::build(table_number.empty() ? 400 : 404, table_number.empty() ? "缺少table_number参数" : "餐桌不存在"));
+        return;
+    }
+
+    // 时间范围：from/to（Unix秒），或最近hours小时（默认1小时）
+    int64_t now = unixNow();
+    int64_t to = request.has_param("to") ? std::atoll(request.get_param_value("to").c_str()) : now + 1;
+    int64_t from;
+    if (request.has_param("from")) {
+        from = std::atoll(request.get_param_value("from").c_str());
+    } else {
+        double hours = 1.0;
+        if (request.has_param("hours")) {
+            // 非数字、NaN/inf或超出范围时直接拒绝，避免转换为int64时溢出
+            const std::string value = request.get_param_value("hours");
+            char* end = nullptr;
+            hours = std::strtod(value.c_str(), &end);
+            if (value.empty() || *end != '\0' || !std::isfinite(hours) || hours <= 0 ||
+                hours * 3600 > kMaxEnvironmentRangeSeconds) {
+                JsonResponse::send(response, 400, JsonResponse::build(400, "hours应为大于0且不超过一年的小时数"));
+                return;
+            }
+        }
+        from = to - static_cast<int64_t>(hours * 3600);
+    }
+    if (from >= to || to - from > kMaxEnvironmentRangeSeconds) {
+        JsonResponse::send(response, 400, JsonResponse::build(400, "时间范围无效（最长一年）"));
+        return;
+    }
+
+    int resolution = -1;
+    std::string resolution_param = request.get_param_value("resolution");
+    if (resolution_param == "raw") {
+        resolution = 0;
+    } else if (resolution_param == "1m") {
+        resolution = 60;
+    } else if (resolution_param == "15m") {
+        resolution = 900;
+    } else if (resolution_param == "1h") {
+        resolution = 3600;
+    } else if (!resolution_param.empty() && resolution_param != "auto") {
+        JsonResponse::send(response, 400, JsonResponse::build(400, "resolution应为auto、raw、1m、15m或1h"));
+        return;
+    }
+
+    // metrics为逗号分隔的指标名，默认全部
+    std::vector<EnvironmentMetric> metrics;
+    std::string metrics_param = request.has_param("metrics") ? request.get_param_value("metrics")
+                                                              : request.get_param_value("metric");
+    for (size_t begin = 0; begin < metrics_param.size();) {
+        size_t end = metrics_param.find(',', begin);
+        if (end == std::string::npos) {
+            end = metrics_param.size();
+        }
+        EnvironmentMetric metric;
+        if (!parseEnvironmentMetric(metrics_param.substr(begin, end - begin), metric)) {
+            JsonResponse::send(response, 400, JsonResponse::build(400, "未知的指标: " + metrics_param.substr(begin, end - begin)));
+            return;
+        }
+        metrics.push_back(metric);
+        begin = end + 1;
+    }
+    if (metrics.empty()) {
+        for (size_t m = 0; m < kEnvironmentMetricCount; m++) {
+            metrics.push_back(static_cast<EnvironmentMetric>(m));
+        }
+    }
+
+    std::vector<EnvironmentPoint> points = environment_->query(*table_id, from, to, resolution);
+
+    JsonResponse::send(response, 200, JsonResponse::build(200, "获取环境数据成功", [&](JsonResponse::JsonWriter& writer) {
+        writer.StartObject();
+        writer.Key("table_number");
+        writer.String(table_number.c_str(), static_cast<rapidjson::SizeType>(table_number.size()));
+        writer.Key("from");
+        writer.Int64(from);
+        writer.Key("to");
+        writer.Int64(to);
+        writer.Key("resolution");
+        writer.Int(resolution);
+        writer.Key("points");
+        writer.StartArray();
+        for (const EnvironmentPoint& point : points) {
+            writer.StartObject();
+            writer.Key("t");
+            writer.Int64(point.timestamp);
+            for (EnvironmentMetric metric : metrics) {
+                const EnvironmentAggregate& aggregate = point.metrics[static_cast<size_t>(metric)];
+                if (aggregate.count == 0) {
+                    continue;
+                }
+                writer.Key(environmentMetricName(metric));
+                writer.StartObject();
+                writer.Key("min");
+                writer.Double(aggregate.min);
+                writer.Key("max");
+                writer.Double(aggregate.max);
+                writer.Key("avg");
+                writer.Double(std::round(aggregate.sum / aggregate.count * 100.0) / 100.0);
+                writer.Key("count");
+                writer.Uint(aggregate.count);
+                writer.EndObject();
+            }
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+    }));
+}
+
+bool DeviceController::readEnvironmentSample(const rapidjson::Value& value, int64_t default_timestamp,
+                                             EnvironmentSample& sample) {
+    sample.timestamp = default_timestamp;
+    auto timestamp = value.FindMember("timestamp");
+    if (timestamp != value.MemberEnd() && timestamp->value.IsInt64()) {
+        sample.timestamp = timestamp->value.GetInt64();
+    }
+
+    bool any = false;
+    for (size_t m = 0; m < kEnvironmentMetricCount; m++) {
+        double field = numberField(value, environmentMetricName(static_cast<EnvironmentMetric>(m)),
+                                   std::numeric_limits<double>::quiet_NaN());
+        sample.values[m] = std::isfinite(field) ? field : std::numeric_limits<double>::quiet_NaN();
+        any = any || std::isfinite(field);
+    }
+    return any;
+}
+
+std::optional<int> DeviceController::resolveTableId(const std::string& table_number) {
+    {
+        std::lock_guard<std::mutex> lock(tables_mutex_);
+        auto it = table_ids_.find(table_number);
+        if (it != table_ids_.end()) {
+            return it->second;
+        }
+    }
+
+    auto table = db_->getTableByNumber(table_number);
+    if (!table) {
+        return std::nullopt;
+    }
+    std::lock_guard<std::mutex> lock(tables_mutex_);
+    table_ids_[table_number] = table->id;
+    table_numbers_[table->id] = table_number;
+    return table->id;
+}
+
+std::string DeviceController::tableNumberOf(int table_id) {
+    {
+        std::lock_guard<std::mutex> lock(tables_mutex_);
+        auto it = table_numbers_.find(table_id);
+        if (it != table_numbers_.end()) {
+            return it->second;
+        }
+    }
+
+    // 重启前上线的客户端还没有经过resolveTableId
+    auto table = db_->getTableById(table_id);
+    if (!table) {
+        return "";
+    }
+    std::lock_guard<std::mutex> lock(tables_mutex_);
+    table_ids_[table->table_number] = table_id;
+    table_numbers_[table_id] = table->table_number;
+    return table->table_number;
+}
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,282 @@
+#include "api/OrderController.h"
+#include <algorithm>
+#include <cstdlib>
+#include <loguru.hpp>
+
+namespace WisdomRestaurant {
+
+// 读取可选的字符串字段
+static std::string stringField(const rapidjson::Value& object, const char* name, const char* fallback = "") {
+    auto it = object.FindMember(name);
+    return it != object.MemberEnd() && it->value.IsString() ? it->value.GetString() : fallback;
+}
+
+// 写入一个订单项
+static void writeOrderItem(JsonResponse::JsonWriter& writer, const OrderItem& item) {
+    writer.StartObject();
+    writer.Key("id");
+    writer.Int(item.id);
+    writer.Key("dish_id");
+    writer.Int(item.dish_id);
+    writer.Key("dish_name");
+    writer.String(item.dish_name.c_str(), static_cast<rapidjson::SizeType>(item.dish_name.size()));
+    writer.Key("dish_price");
+    writer.Double(item.dish_price);
+    writer.Key("quantity");
+    writer.Int(item.quantity);
+    writer.Key("subtotal");
+    writer.Double(item.subtotal);
+    writer.Key("special_requirements");
+    writer.String(item.special_requirements.c_str(), static_cast<rapidjson::SizeType>(item.special_requirements.size()));
+    writer.Key("item_status");
+    writer.String(item.item_status.c_str(), static_cast<rapidjson::SizeType>(item.item_status.size()));
+    writer.EndObject();
+}
+
+OrderController::OrderController(std::shared_ptr<RestaurantDb> db, std::shared_ptr<InventoryManager> inventory)
+    : db_(db), inventory_(inventory) {
+}
+
+void OrderController::handleCreateOrder(const httplib::Request& request, httplib::Response& response) {
+    JsonResponse::setCorsHeaders(response);
+
+    rapidjson::Document doc;
+    doc.Parse(request.body.c_str());
+    if (!doc.IsObject() || !doc.HasMember("table_number") || !doc["table_number"].IsString() ||
+        !doc.HasMember("items") || !doc["items"].IsArray() || doc["items"].Empty()) {
+        JsonResponse::send(response, 400, JsonResponse::build(400, "请求参数不完整，需要table_number和items"));
+        return;
+    }
+    auto table = db_->getTableByNumber(doc["table_number"].GetString());
+    if (!table) {
+        JsonResponse::send(response, 404, JsonResponse::build(404, "餐桌不存在"));
+        return;
+    }
+
+    Order order{};
+    order.table_id = table->id;
+    order.user_id = stringField(doc, "user_id");
+    order.order_type = stringField(doc, "order_type", "dine_in");
+    order.payment_method = stringField(doc, "payment_method", "cash");
+    order.special_requirements = stringField(doc, "special_requirements");
+    order.people_count = doc.HasMember("people_count") && doc["people_count"].IsInt() ? doc["people_count"].GetInt() : 1;
+    order.discount_amount = doc.HasMember("discount_amount") && doc["discount_amount"].IsNumber()
+                          ? doc["discount_amount"].GetDouble() : 0.0;
+    order.estimated_time = 30;
+    uint64_t reservation_id = doc.HasMember("reservation_id") && doc["reservation_id"].IsUint64()
+                            ? doc["reservation_id"].GetUint64() : 0;
+
+    // 菜名、单价和金额由服务端按菜单填写，不信任客户端
+    std::vector<OrderItem> items;
+    for (const auto& value : doc["items"].GetArray()) {
+        if (!value.IsObject() || !value.HasMember("dish_id") || !value["dish_id"].IsInt() ||
+            !value.HasMember("quantity") || !value["quantity"].IsInt() || value["quantity"].GetInt() <= 0) {
+            JsonResponse::send(response, 400, JsonResponse::build(400, "订单项需要dish_id和正整数quantity"));
+            return;
+        }
+        OrderItem item{};
+        item.dish_id = value["dish_id"].GetInt();
+        item.quantity = value["quantity"].GetInt();
+        item.special_requirements = stringField(value, "special_requirements");
+        items.push_back(std::move(item));
+    }
+
+    InventoryResult result = inventory_->placeOrder(order, items, reservation_id);
+    if (!result.ok()) {
+        sendInventoryError(response, result);
+        return;
+    }
+
+    const PlacedOrder& placed = *result.order;
+    JsonResponse::send(response, 200, JsonResponse::build(200, "下单成功", [&](JsonResponse::JsonWriter& writer) {
+        writer.StartObject();
+        writer.Key("id");
+        writer.Int(placed.order.id);
+        writer.Key("order_no");
+        writer.String(placed.order.order_no.c_str(), static_cast<rapidjson::SizeType>(placed.order.order_no.size()));
+        writer.Key("table_number");
+        writer.String(table->table_number.c_str(), static_cast<rapidjson::SizeType>(table->table_number.size()));
+        writer.Key("people_count");
+        writer.Int(placed.order.people_count);
+        writer.Key("total_amount");
+        writer.Double(placed.order.total_amount);
+        writer.Key("discount_amount");
+        writer.Double(placed.order.discount_amount);
+        writer.Key("final_amount");
+        writer.Double(placed.order.final_amount);
+        writer.Key("order_status");
+        writer.String(placed.order.order_status.c_str(), static_cast<rapidjson::SizeType>(placed.order.order_status.size()));
+        writer.Key("created_at");
+        writer.String(placed.order.created_at.c_str(), static_cast<rapidjson::SizeType>(placed.order.created_at.size()));
+        writer.Key("items");
+        writer.StartArray();
+        for (const auto& item : placed.items) {
+            writeOrderItem(writer, item);
+        }
+        writer.EndArray();
+        writer.EndObject();
+    }));
+}
+
+void OrderController::handleGetInventory(const httplib::Request& request, httplib::Response& response) {
+    JsonResponse::setCorsHeaders(response);
+
+    std::vector<DishStock> stocks;
+    if (request.has_param("dish_id")) {
+        auto stock = inventory_->getStock(std::atoi(request.get_param_value("dish_id").c_str()));
+        if (!stock) {
+            JsonResponse::send(response, 404, JsonResponse::build(404, "菜品不存在"));
+            return;
+        }
+        stocks.push_back(*stock);
+    } else {
+        stocks = inventory_->getAllStocks();
+    }
+
+    JsonResponse::send(response, 200, JsonResponse::build(200, "获取库存成功", [&](JsonResponse::JsonWriter& writer) {
+        writer.StartObject();
+        writer.Key("version");
+        writer.Uint64(inventory_->version());
+        writer.Key("dishes");
+        writer.StartArray();
+        for (const auto& stock : stocks) {
+            writer.StartObject();
+            writer.Key("dish_id");
+            writer.Int(stock.dish_id);
+            writer.Key("stock");
+            writer.Int(stock.stock);
+            writer.Key("available");
+            writer.Int(stock.available);
+            writer.Key("sold_out");
+            writer.Bool(stock.available <= 0);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+    }));
+}
+
+void OrderController::handleSetStock(const httplib::Request& request, httplib::Response& response) {
+    JsonResponse::setCorsHeaders(response);
+
+    rapidjson::Document doc;
+    doc.Parse(request.body.c_str());
+    if (!doc.IsObject() || !doc.HasMember("dish_id") || !doc["dish_id"].IsInt() ||
+        !doc.HasMember("stock") || !doc["stock"].IsInt() || doc["stock"].GetInt() < 0) {
+        JsonResponse::send(response, 400, JsonResponse::build(400, "请求参数不完整，需要dish_id和非负整数stock"));
+        return;
+    }
+    int dish_id = doc["dish_id"].GetInt();
+    if (!inventory_->setStock(dish_id, doc["stock"].GetInt())) {
+        JsonResponse::send(response, 404, JsonResponse::build(404, "菜品不存在"));
+        return;
+    }
+    auto stock = inventory_->getStock(dish_id);
+    LOG_F(INFO, "菜品 %d 库存设置为 %d（可售 %d）", dish_id, stock->stock, stock->available);
+    JsonResponse::send(response, 200, JsonResponse::build(200, "库存已更新", [&](JsonResponse::JsonWriter& writer) {
+        writer.StartObject();
+        writer.Key("dish_id");
+        writer.Int(dish_id);
+        writer.Key("stock");
+        writer.Int(stock->stock);
+        writer.Key("available");
+        writer.Int(stock->available);
+        writer.EndObject();
+    }));
+}
+
+void OrderController::handleReserve(const httplib::Request& request, httplib::Response& response) {
+    JsonResponse::setCorsHeaders(response);
+
+    rapidjson::Document doc;
+    doc.Parse(request.body.c_str());
+    std::vector<std::pair<int, int>> quantities;
+    if (!doc.IsObject() || !doc.HasMember("items") || !readQuantities(doc["items"], quantities)) {
+        JsonResponse::send(response, 400, JsonResponse::build(400, "请求参数不完整，需要items（dish_id和正整数quantity）"));
+        return;
+    }
+
+    InventoryResult result = inventory_->reserve(quantities);
+    if (!result.ok()) {
+        sendInventoryError(response, result);
+        return;
+    }
+    JsonResponse::send(response, 200, JsonResponse::build(200, "预留成功", [&](JsonResponse::JsonWriter& writer) {
+        writer.StartObject();
+        writer.Key("reservation_id");
+        writer.Uint64(result.reservation_id);
+        writer.EndObject();
+    }));
+}
+
+void OrderController::handleRelease(const httplib::Request& request, httplib::Response& response) {
+    JsonResponse::setCorsHeaders(response);
+
+    rapidjson::Document doc;
+    doc.Parse(request.body.c_str());
+    if (!doc.IsObject() || !doc.HasMember("reservation_id") || !doc["reservation_id"].IsUint64()) {
+        JsonResponse::send(response, 400, JsonResponse::build(400, "请求参数不完整，需要reservation_id"));
+        return;
+    }
+    if (!inventory_->release(doc["reservation_id"].GetUint64())) {
+        JsonResponse::send(response, 404, JsonResponse::build(404, "预留不存在或已过期"));
+        return;
+    }
+    JsonResponse::send(response, 200, JsonResponse::build(200, "预留已释放"));
+}
+
+bool OrderController::readQuantities(const rapidjson::Value& items, std::vector<std::pair<int, int>>& quantities) {
+    if (!items.IsArray() || items.Empty()) {
+        return false;
+    }
+    for (const auto& value : items.GetArray()) {
+        if (!value.IsObject() || !value.HasMember("dish_id") || !value["dish_id"].IsInt() ||
+            !value.HasMember("quantity") || !value["quantity"].IsInt() || value["quantity"].GetInt() <= 0) {
+            return false;
+        }
+        quantities.emplace_back(value["dish_id"].GetInt(), value["quantity"].GetInt());
+    }
+    return true;
+}
+
+void OrderController::sendInventoryError(httplib::Response& response, const InventoryResult& result) {
+    int status;
+    const char* message;
+    switch (result.status) {
+        case InventoryResult::Status::SoldOut:
+            status = 409;
+            message = "菜品已售罄或库存不足";
+            break;
+        case InventoryResult::Status::UnknownDish:
+            status = 404;
+            message = "菜品不存在";
+            break;
+        case InventoryResult::Status::InvalidQuantity:
+            status = 400;
+            message = "份数必须为正整数";
+            break;
+        case InventoryResult::Status::UnknownReservation:
+            status = 404;
+            message = "预留不存在或已过期";
+            break;
+        default:
+            status = 500;
+            message = "下单失败";
+            break;
+    }
+    if (result.dish_id == 0) {
+        JsonResponse::send(response, status, JsonResponse::build(status, message));
+        return;
+    }
+    auto stock = inventory_->getStock(result.dish_id);
+    JsonResponse::send(response, status, JsonResponse::build(status, message, [&](JsonResponse::JsonWriter& writer) {
+        writer.StartObject();
+        writer.Key("dish_id");
+        writer.Int(result.dish_id);
+        writer.Key("available");
+        writer.Int(stock ? std::max(stock->available, 0) : 0);
+        writer.EndObject();
+    }));
+}
+
+} // namespace WisdomRestaurant
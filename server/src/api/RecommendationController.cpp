@@ -1,172 +1,721 @@
 #include "api/RecommendationController.h"
+#include "ai/ImageHash.h"
+#include "common/Base64.h"
+#include "common/MealPeriod.h"
+#include "db/MenuCache.h"
 #include "loguru.hpp"
 #include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
 #include <chrono>
+#include <cstdlib>
 #include <ctime>
 
 namespace WisdomRestaurant {
 
+// 异步推荐结果的保留时间
+static const std::chrono::minutes kJobResultTtl(10);
+
+// 长轮询的最大等待时间（秒）
+static const int kMaxPollWaitSeconds = 10;
+
+// 解析非负整数查询参数，含非数字字符或超出int范围时返回false
+static bool parseNonNegativeInt(const std::string& text, int& value) {
+    if (text.empty() || text.size() > 9 || !std::all_of(text.begin(), text.end(), ::isdigit)) {
+        return false;
+    }
+    value = std::atoi(text.c_str());
+    return true;
+}
+
+// 解析无符号64位整数，含非数字字符或超出范围时返回false
+static bool parseUnsigned(const std::string& text, uint64_t& value) {
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+// multipart中非图片字段的大小上限
+static const size_t kMaxFormFieldSize = 4096;
+
+// 根据Content-Type或文件头判断图片类型
+static std::string detectImageMimeType(const std::string& content_type, const std::string& data) {
+    if (content_type.compare(0, 6, "image/") == 0) {
+        return content_type.substr(0, content_type.find(';'));
+    }
+    if (data.size() >= 3 && static_cast<unsigned char>(data[0]) == 0xFF &&
+        static_cast<unsigned char>(data[1]) == 0xD8 && static_cast<unsigned char>(data[2]) == 0xFF) {
+        return "image/jpeg";
+    }
+    if (data.size() >= 4 && data.compare(0, 4, "\x89PNG") == 0) {
+        return "image/png";
+    }
+    return "image/jpeg";
+}
+
+// 菜单响应只允许客户端缓存，每次使用前需用ETag重新验证
+static const char* kMenuCacheControl = "private, no-cache";
+
+// 以SAX方式写入快照中第index道菜的各字段（不含外层对象）
+// 销量取快照的实时计数；inventory不为空时stock_count为实时可售份数
+static void writeDishFields(JsonResponse::JsonWriter& writer, const MenuSnapshot& snapshot, size_t index,
+                            InventoryManager* inventory) {
+    const Dish& dish = snapshot.dishes[index];
+    writer.Key("id");
+    writer.Int(dish.id);
+    writer.Key("dish_code");
+    writer.String(dish.dish_code.c_str(), static_cast<rapidjson::SizeType>(dish.dish_code.size()));
+    writer.Key("dish_name");
+    writer.String(dish.dish_name.c_str(), static_cast<rapidjson::SizeType>(dish.dish_name.size()));
+    writer.Key("category_id");
+    writer.Int(dish.category_id);
+    writer.Key("price");
+    writer.Double(dish.price);
+    writer.Key("description");
+    writer.String(dish.description.c_str(), static_cast<rapidjson::SizeType>(dish.description.size()));
+    writer.Key("taste_tags");
+    writer.String(dish.taste_tags.c_str(), static_cast<rapidjson::SizeType>(dish.taste_tags.size()));
+    writer.Key("image_url");
+    writer.String(dish.image_url.c_str(), static_cast<rapidjson::SizeType>(dish.image_url.size()));
+    writer.Key("is_signature");
+    writer.Bool(dish.is_signature);
+    writer.Key("is_recommended");
+    writer.Bool(dish.is_recommended);
+    writer.Key("rating");
+    writer.Double(dish.rating);
+    writer.Key("sales_count");
+    writer.Int(snapshot.salesCount(index));
+    std::optional<DishStock> stock = inventory ? inventory->getStock(dish.id) : std::nullopt;
+    int available = stock ? stock->available : snapshot.stockCount(index);
+    writer.Key("stock_count");
+    writer.Int(std::max(available, 0));
+    writer.Key("sold_out");
+    writer.Bool(available <= 0);
+}
+
+// 以SAX方式写入菜单中的一道菜
+static void writeDish(JsonResponse::JsonWriter& writer, const MenuSnapshot& snapshot, size_t index,
+                      InventoryManager* inventory) {
+    writer.StartObject();
+    writeDishFields(writer, snapshot, index, inventory);
+    writer.EndObject();
+}
+
+// 推荐流程某个阶段的耗时直方图
+static Histogram& stageHistogram(const char* stage) {
+    return MetricsRegistry::instance().histogram("wisdom_recommendation_stage_seconds",
+        "Duration of each recommendation stage (combined = vision and recommendation in one model call)",
+        {{"stage", stage}});
+}
+
 RecommendationController::RecommendationController(std::shared_ptr<AiService> ai_service, 
-                                                 std::shared_ptr<RestaurantDb> db)
-    : ai_service_(ai_service), db_(db) {
+                                                 std::shared_ptr<RestaurantDb> db,
+                                                 std::shared_ptr<JobExecutor> job_executor)
+    : ai_service_(ai_service), db_(db), job_executor_(job_executor)
+    , max_image_size_(10 * 1024 * 1024)
+    , default_pipeline_mode_(PipelineMode::TwoStage)
+    , stage_parse_(stageHistogram("parse"))
+    , stage_table_lookup_(stageHistogram("table_lookup"))
+    , stage_vision_(stageHistogram("vision"))
+    , stage_combined_(stageHistogram("combined"))
+    , stage_recommend_(stageHistogram("recommend"))
+    , stage_db_save_(stageHistogram("db_save"))
+    , menu_body_version_(0)
+    , menu_body_stock_version_(0)
+    , waiting_polls_(0)
+    , max_waiting_polls_(2)
+    , rejected_polls_(0) {
 }
 
 RecommendationController::~RecommendationController() {
+    // 等待后台任务结束，避免任务访问已析构的控制器
+    if (job_executor_) {
+        job_executor_->shutdown();
+    }
 }
 
-void RecommendationController::handleRecommendation(const httplib::Request& request, httplib::Response& response) {
-    setCorsHeaders(response);
+void RecommendationController::handleRecommendation(const httplib::Request& request, httplib::Response& response,
+                                                    const httplib::ContentReader& content_reader) {
+    JsonResponse::setCorsHeaders(response);
 
     try {
-        // 解析请求参数
-        std::string image_base64, table_number, user_id, season, meal_time;
-        if (!parseRecommendationRequest(request.body, image_base64, table_number, 
-                                       user_id, season, meal_time)) {
-            response.status = 400;
-            response.set_content(buildErrorResponse("请求参数解析失败", 400), "application/json; charset=utf-8");
+        RecommendationRequest rec_request;
+        Table table;
+        if (!prepareRecommendation(request, content_reader, response, rec_request, table)) {
             return;
         }
 
-        // 验证请求参数
-        if (!validateRequest(image_base64, table_number)) {
-            response.status = 400;
-            response.set_content(buildErrorResponse("请求参数验证失败：图片或桌号不能为空", 400), "application/json; charset=utf-8");
+        // 生成会话ID
+        std::string session_id = db_->generateSessionId();
+
+        if (rec_request.async && job_executor_) {
+            if (!submitRecommendationJob(std::move(rec_request), table, session_id)) {
+                response.status = 503;
+                response.set_header("Retry-After", "5");
+                response.set_content(buildErrorResponse("推荐任务队列已满，请稍后重试", 503), "application/json; charset=utf-8");
+                return;
+            }
+
+            std::string result_url = "/api/v1/recommendation/" + session_id;
+            response.status = 202;
+            response.set_content(buildSuccessResponse("推荐任务已提交", [&](JsonResponse::JsonWriter& writer) {
+                writer.StartObject();
+                writer.Key("session_id");
+                writer.String(session_id.c_str(), static_cast<rapidjson::SizeType>(session_id.size()));
+                writer.Key("status");
+                writer.String("pending");
+                writer.Key("result_url");
+                writer.String(result_url.c_str(), static_cast<rapidjson::SizeType>(result_url.size()));
+                writer.EndObject();
+            }), "application/json; charset=utf-8");
             return;
         }
 
-        // 获取餐桌信息
-        auto table = db_->getTableByNumber(table_number);
-        if (!table) {
-            response.status = 404;
-            response.set_content(buildErrorResponse("餐桌不存在", 404), "application/json; charset=utf-8");
-            return;
+        RecommendationOutcome outcome = runRecommendation(rec_request, table, session_id);
+        response.status = outcome.status;
+        response.set_content(outcome.body, "application/json; charset=utf-8");
+
+    } catch (const std::exception& e) {
+        LOG_F(ERROR, "处理推荐请求时发生异常: %s", e.what());
+        response.status = 500;
+        response.set_content(buildErrorResponse("服务器内部错误", 500), "application/json; charset=utf-8");
+    }
+}
+
+bool RecommendationController::prepareRecommendation(const httplib::Request& request, const httplib::ContentReader& content_reader,
+                                                     httplib::Response& response, RecommendationRequest& rec_request, Table& table) {
+    // 读取并解析请求参数
+    std::optional<StageTimer> parse_timer;
+    parse_timer.emplace("parse", stage_parse_);
+    int error_status = 400;
+    std::string error_message;
+    if (!readRecommendationRequest(request, content_reader, rec_request, error_status, error_message)) {
+        response.status = error_status;
+        // 超大或Content-Length无效时请求体没有读完，不能复用该连接
+        response.set_header("Connection", "close");
+        response.set_content(buildErrorResponse(error_message, error_status), "application/json; charset=utf-8");
+        return false;
+    }
+    if (request.has_param("async")) {
+        std::string async_param = request.get_param_value("async");
+        rec_request.async = (async_param == "1" || async_param == "true");
+    }
+    if (request.has_param("pipeline_mode")) {
+        rec_request.pipeline_mode = request.get_param_value("pipeline_mode");
+    }
+    rec_request.pipeline = default_pipeline_mode_;
+    if (!rec_request.pipeline_mode.empty() && !parsePipelineMode(rec_request.pipeline_mode, rec_request.pipeline)) {
+        response.status = 400;
+        response.set_content(buildErrorResponse("pipeline_mode只能为two_stage或combined", 400), "application/json; charset=utf-8");
+        return false;
+    }
+
+    // 验证请求参数
+    if (!validateRequest(rec_request.image.data, rec_request.table_number)) {
+        response.status = 400;
+        response.set_content(buildErrorResponse("请求参数验证失败：图片或桌号不能为空", 400), "application/json; charset=utf-8");
+        return false;
+    }
+
+    parse_timer.reset();
+
+    // 获取餐桌信息
+    std::optional<Table> found;
+    {
+        StageTimer timer("table_lookup", stage_table_lookup_);
+        found = db_->getTableByNumber(rec_request.table_number);
+    }
+    if (!found) {
+        response.status = 404;
+        response.set_content(buildErrorResponse("餐桌不存在", 404), "application/json; charset=utf-8");
+        return false;
+    }
+    table = *found;
+
+    // 如果季节或用餐时间为空，使用当前时间推断
+    if (rec_request.season.empty()) {
+        rec_request.season = getCurrentSeason();
+    }
+    if (rec_request.meal_time.empty()) {
+        rec_request.meal_time = getCurrentMealTime();
+    }
+    return true;
+}
+
+VisionResult RecommendationController::analyzeCustomer(const RecommendationRequest& rec_request,
+                                                       RecommendationResult& recommendation) {
+    recommendation.success = false;
+    bool is_combined = rec_request.pipeline == PipelineMode::Combined;
+    StageTimer timer(is_combined ? "combined" : "vision", is_combined ? stage_combined_ : stage_vision_);
+
+    // 合并模式一次请求同时得到画像和推荐
+    auto call_model = [&]() {
+        if (rec_request.pipeline == PipelineMode::Combined) {
+            CombinedResult combined = ai_service_->analyzeAndRecommend(rec_request.image,
+                                                                       rec_request.season, rec_request.meal_time);
+            recommendation = std::move(combined.recommendation);
+            return combined.vision;
         }
+        return ai_service_->analyzeCustomerImage(rec_request.image);
+    };
+
+    if (!vision_dedupe_) {
+        return call_model();
+    }
+
+    uint64_t hash = 0;
+    if (!ImageHash::computeDHash(rec_request.image, hash)) {
+        vision_dedupe_->recordUnhashable();
+        return call_model();
+    }
+
+    auto cached = vision_dedupe_->find(rec_request.table_number, hash);
+    if (cached) {
+        LOG_F(INFO, "餐桌 %s 画面与近期画面相似，复用视觉识别结果", rec_request.table_number.c_str());
+        return *cached;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    VisionResult vision_result = call_model();
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time);
+    vision_dedupe_->store(rec_request.table_number, hash, vision_result, elapsed.count());
+    return vision_result;
+}
 
-        // 如果季节或用餐时间为空，使用当前时间推断
-        if (season.empty()) {
-            season = getCurrentSeason();
+VisionDedupeStats RecommendationController::getVisionDedupeStats() const {
+    if (!vision_dedupe_) {
+        return VisionDedupeStats{};
+    }
+    return vision_dedupe_->getStats();
+}
+
+void RecommendationController::setMaxWaitingPolls(int max_waiting_polls) {
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    max_waiting_polls_ = std::max(max_waiting_polls, 0);
+}
+
+LongPollStats RecommendationController::getLongPollStats() const {
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    return LongPollStats{waiting_polls_, max_waiting_polls_, rejected_polls_};
+}
+
+LatencySummary RecommendationController::getPipelineLatency(PipelineMode mode) const {
+    return mode == PipelineMode::Combined ? combined_latency_.getSummary() : two_stage_latency_.getSummary();
+}
+
+RecommendationOutcome RecommendationController::runRecommendation(const RecommendationRequest& rec_request,
+                                                                  const Table& table, const std::string& session_id) {
+    const std::string& season = rec_request.season;
+    const std::string& meal_time = rec_request.meal_time;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    // 第一阶段：视觉识别（合并模式下同时完成推荐）
+    LOG_F(INFO, "开始视觉识别(%s)...", pipelineModeName(rec_request.pipeline));
+    RecommendationResult recommendation_result;
+    VisionResult vision_result = analyzeCustomer(rec_request, recommendation_result);
+    
+    if (!vision_result.success) {
+        return {500, buildErrorResponse("视觉识别失败：" + vision_result.error_message, 500)};
+    }
+
+    LOG_F(INFO, "视觉识别成功，识别到 %d 人", vision_result.people_num);
+
+    // 第二阶段：智能推荐
+    if (!recommendation_result.success) {
+        LOG_F(INFO, "开始智能推荐...");
+        StageTimer timer("recommend", stage_recommend_);
+        recommendation_result = ai_service_->recommendDishes(vision_result, season, meal_time);
+    }
+    
+    if (!recommendation_result.success) {
+        return {500, buildErrorResponse("智能推荐失败：" + recommendation_result.error_message, 500)};
+    }
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto processing_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+    (rec_request.pipeline == PipelineMode::Combined ? combined_latency_ : two_stage_latency_)
+        .record(std::chrono::duration<double, std::milli>(end_time - start_time).count());
+
+    LOG_F(INFO, "智能推荐成功，推荐了 %zu 道菜品", recommendation_result.recommendations.size());
+
+    // 保存推荐记录到数据库
+    saveRecommendationRecord(rec_request, table, session_id, vision_result,
+                             recommendation_result, static_cast<int>(processing_time));
+
+    // 构建响应数据
+    return {200, buildSuccessResponse("推荐成功", [&](JsonResponse::JsonWriter& writer) {
+        writer.StartObject();
+        writer.Key("session_id");
+        writer.String(session_id.c_str(), static_cast<rapidjson::SizeType>(session_id.size()));
+        writer.Key("table_number");
+        writer.String(rec_request.table_number.c_str(), static_cast<rapidjson::SizeType>(rec_request.table_number.size()));
+        writer.Key("people_count");
+        writer.Int(vision_result.people_num);
+        writer.Key("season");
+        writer.String(season.c_str(), static_cast<rapidjson::SizeType>(season.size()));
+        writer.Key("meal_time");
+        writer.String(meal_time.c_str(), static_cast<rapidjson::SizeType>(meal_time.size()));
+        writer.Key("processing_time");
+        writer.Int(static_cast<int>(processing_time));
+
+        writer.Key("recommendations");
+        writer.StartArray();
+        for (const auto& rec : recommendation_result.recommendations) {
+            writer.StartObject();
+            writer.Key("dish_name");
+            writer.String(rec.dish_name.c_str(), static_cast<rapidjson::SizeType>(rec.dish_name.size()));
+            writer.Key("reason");
+            writer.String(rec.reason.c_str(), static_cast<rapidjson::SizeType>(rec.reason.size()));
+            writer.Key("confidence");
+            writer.Double(0.8); // 暂时使用固定值
+            writer.EndObject();
         }
-        if (meal_time.empty()) {
-            meal_time = getCurrentMealTime();
+        writer.EndArray();
+        writer.EndObject();
+    })};
+}
+
+void RecommendationController::saveRecommendationRecord(const RecommendationRequest& rec_request, const Table& table,
+                                                        const std::string& session_id, const VisionResult& vision_result,
+                                                        const RecommendationResult& recommendation_result, int processing_time) {
+    StageTimer timer("db_save", stage_db_save_);
+    AiRecommendation ai_recommendation;
+    ai_recommendation.session_id = session_id;
+    ai_recommendation.table_id = table.id;
+    ai_recommendation.user_id = rec_request.user_id;
+    ai_recommendation.season = rec_request.season;
+    ai_recommendation.meal_time = rec_request.meal_time;
+    ai_recommendation.people_count = vision_result.people_num;
+    ai_recommendation.processing_time = processing_time;
+
+    // 将结果序列化为JSON字符串
+    rapidjson::Document vision_doc;
+    vision_doc.SetObject();
+    auto& alloc = vision_doc.GetAllocator();
+    
+    vision_doc.AddMember("success", vision_result.success, alloc);
+    vision_doc.AddMember("people_num", vision_result.people_num, alloc);
+    // 将customer_portrait向量序列化为JSON字符串
+    rapidjson::Value customer_portrait_array(rapidjson::kArrayType);
+    for (const auto& portrait : vision_result.customer_portrait) {
+        rapidjson::Value portrait_obj(rapidjson::kObjectType);
+        portrait_obj.AddMember("age_grades", rapidjson::Value(portrait.age_grades.c_str(), alloc), alloc);
+        portrait_obj.AddMember("gender", rapidjson::Value(portrait.gender.c_str(), alloc), alloc);
+        portrait_obj.AddMember("body_type", rapidjson::Value(portrait.body_type.c_str(), alloc), alloc);
+        customer_portrait_array.PushBack(portrait_obj, alloc);
+    }
+    vision_doc.AddMember("customer_portrait", customer_portrait_array, alloc);
+    vision_doc.AddMember("error_message", rapidjson::Value(vision_result.error_message.c_str(), alloc), alloc);
+
+    ai_recommendation.vision_result = JsonResponse::serialize(vision_doc);
+
+    rapidjson::Document rec_doc;
+    rec_doc.SetObject();
+    auto& rec_alloc = rec_doc.GetAllocator();
+    rec_doc.AddMember("success", recommendation_result.success, rec_alloc);
+    rapidjson::Value recommendations(rapidjson::kArrayType);
+    for (const auto& rec : recommendation_result.recommendations) {
+        rapidjson::Value rec_obj(rapidjson::kObjectType);
+        rec_obj.AddMember("dish_name", rapidjson::Value(rec.dish_name.c_str(), rec_alloc), rec_alloc);
+        rec_obj.AddMember("reason", rapidjson::Value(rec.reason.c_str(), rec_alloc), rec_alloc);
+        rec_obj.AddMember("confidence", 0.8, rec_alloc); // 暂时使用固定值
+        recommendations.PushBack(rec_obj, rec_alloc);
+    }
+    rec_doc.AddMember("recommendations", recommendations, rec_alloc);
+    rec_doc.AddMember("error_message", rapidjson::Value(recommendation_result.error_message.c_str(), rec_alloc), rec_alloc);
+
+    ai_recommendation.recommendation_result = JsonResponse::serialize(rec_doc);
+
+    // 有写入队列时交给后台批量写入，图片由写入线程存入图片存储，响应不等待落盘
+    if (rec_writer_) {
+        rec_writer_->enqueue(std::move(ai_recommendation),
+                             RecommendationImage{rec_request.image.data, rec_request.image.is_base64});
+        return;
+    }
+    // 推荐表以base64保存图片，二进制上传在这里编码
+    ai_recommendation.image_base64 = rec_request.image.is_base64
+        ? rec_request.image.data
+        : Base64::encode(rec_request.image.data);
+    if (!db_->saveAiRecommendation(ai_recommendation)) {
+        LOG_F(WARNING, "保存AI推荐记录失败");
+    }
+}
+
+bool RecommendationController::submitRecommendationJob(RecommendationRequest&& rec_request,
+                                                       const Table& table, const std::string& session_id) {
+    auto job = std::make_shared<RecommendationJob>();
+    job->session_id = session_id;
+
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex_);
+        purgeExpiredJobsLocked();
+        jobs_[session_id] = job;
+    }
+
+    // 任务持有请求的追踪，span日志在任务结束后写出；请求（含图片）移入任务，不复制
+    bool submitted = job_executor_->submit([this, job, rec_request = std::move(rec_request), table,
+                                            trace = RequestTrace::currentShared()]() {
+        RequestTrace::Scope trace_scope(trace);
+        {
+            std::lock_guard<std::mutex> lock(jobs_mutex_);
+            job->state = RecommendationJob::State::Running;
         }
 
-        auto start_time = std::chrono::high_resolution_clock::now();
+        RecommendationOutcome outcome;
+        try {
+            outcome = runRecommendation(rec_request, table, job->session_id);
+        } catch (const std::exception& e) {
+            LOG_F(ERROR, "异步推荐任务 %s 执行异常: %s", job->session_id.c_str(), e.what());
+            outcome = {500, buildErrorResponse("服务器内部错误", 500)};
+        }
 
-        // 第一阶段：视觉识别
-        LOG_F(INFO, "开始视觉识别...");
-        VisionResult vision_result = ai_service_->analyzeCustomerImage(image_base64);
-        
-        if (!vision_result.success) {
-            response.status = 500;
-            response.set_content(buildErrorResponse("视觉识别失败：" + vision_result.error_message, 500), "application/json; charset=utf-8");
-            return;
+        {
+            std::lock_guard<std::mutex> lock(jobs_mutex_);
+            job->outcome = std::move(outcome);
+            job->state = RecommendationJob::State::Done;
+            job->finished_at = std::chrono::steady_clock::now();
         }
+        jobs_cv_.notify_all();
+    });
 
-        LOG_F(INFO, "视觉识别成功，识别到 %d 人", vision_result.people_num);
+    if (!submitted) {
+        std::lock_guard<std::mutex> lock(jobs_mutex_);
+        jobs_.erase(session_id);
+    }
+    return submitted;
+}
 
-        // 第二阶段：智能推荐
-        LOG_F(INFO, "开始智能推荐...");
-        RecommendationResult recommendation_result = ai_service_->recommendDishes(vision_result, season, meal_time);
-        
-        if (!recommendation_result.success) {
-            response.status = 500;
-            response.set_content(buildErrorResponse("智能推荐失败：" + recommendation_result.error_message, 500), "application/json; charset=utf-8");
-            return;
+void RecommendationController::purgeExpiredJobsLocked() {
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = jobs_.begin(); it != jobs_.end();) {
+        const auto& job = it->second;
+        if (job->state == RecommendationJob::State::Done && now - job->finished_at > kJobResultTtl) {
+            it = jobs_.erase(it);
+        } else {
+            ++it;
         }
+    }
+}
+
+// 序列化一条SSE事件
+static std::string buildSseEvent(const char* event, const rapidjson::Value& data) {
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    data.Accept(writer);
 
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto processing_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+    std::string frame;
+    frame.reserve(buffer.GetSize() + 32);
+    frame.append("event: ").append(event).append("\n");
+    frame.append("data: ").append(buffer.GetString(), buffer.GetSize()).append("\n\n");
+    return frame;
+}
 
-        LOG_F(INFO, "智能推荐成功，推荐了 %zu 道菜品", recommendation_result.recommendations.size());
+void RecommendationController::handleRecommendationStream(const httplib::Request& request, httplib::Response& response,
+                                                          const httplib::ContentReader& content_reader) {
+    JsonResponse::setCorsHeaders(response);
+
+    try {
+        RecommendationRequest rec_request;
+        Table table;
+        if (!prepareRecommendation(request, content_reader, response, rec_request, table)) {
+            return;
+        }
 
-        // 生成会话ID
         std::string session_id = db_->generateSessionId();
 
-        // 保存推荐记录到数据库
-        AiRecommendation ai_recommendation;
-        ai_recommendation.session_id = session_id;
-        ai_recommendation.table_id = table->id;
-        ai_recommendation.user_id = user_id;
-        ai_recommendation.image_base64 = image_base64;
-        ai_recommendation.season = season;
-        ai_recommendation.meal_time = meal_time;
-        ai_recommendation.people_count = vision_result.people_num;
-        ai_recommendation.processing_time = static_cast<int>(processing_time);
-
-        // 将结果序列化为JSON字符串
-        rapidjson::Document vision_doc;
-        vision_doc.SetObject();
-        auto& alloc = vision_doc.GetAllocator();
-        
-        vision_doc.AddMember("success", vision_result.success, alloc);
-        vision_doc.AddMember("people_num", vision_result.people_num, alloc);
-        // 将customer_portrait向量序列化为JSON字符串
-        rapidjson::Value customer_portrait_array(rapidjson::kArrayType);
-        for (const auto& portrait : vision_result.customer_portrait) {
-            rapidjson::Value portrait_obj(rapidjson::kObjectType);
-            portrait_obj.AddMember("age_grades", rapidjson::Value(portrait.age_grades.c_str(), alloc), alloc);
-            portrait_obj.AddMember("gender", rapidjson::Value(portrait.gender.c_str(), alloc), alloc);
-            portrait_obj.AddMember("body_type", rapidjson::Value(portrait.body_type.c_str(), alloc), alloc);
-            customer_portrait_array.PushBack(portrait_obj, alloc);
-        }
-        vision_doc.AddMember("customer_portrait", customer_portrait_array, alloc);
-        vision_doc.AddMember("error_message", rapidjson::Value(vision_result.error_message.c_str(), alloc), alloc);
-
-        rapidjson::StringBuffer vision_buffer;
-        rapidjson::Writer<rapidjson::StringBuffer> vision_writer(vision_buffer);
-        vision_doc.Accept(vision_writer);
-        ai_recommendation.vision_result = vision_buffer.GetString();
-
-        rapidjson::Document rec_doc;
-        rec_doc.SetObject();
-        rec_doc.AddMember("success", recommendation_result.success, alloc);
-        rec_doc.AddMember("recommendations", rapidjson::Value(rapidjson::kArrayType), alloc);
-        for (const auto& rec : recommendation_result.recommendations) {
-            rapidjson::Value rec_obj(rapidjson::kObjectType);
-            rec_obj.AddMember("dish_name", rapidjson::Value(rec.dish_name.c_str(), alloc), alloc);
-            rec_obj.AddMember("reason", rapidjson::Value(rec.reason.c_str(), alloc), alloc);
-            rec_obj.AddMember("confidence", 0.8, alloc); // 暂时使用固定值
-            rec_doc["recommendations"].PushBack(rec_obj, alloc);
-        }
-        rec_doc.AddMember("error_message", rapidjson::Value(recommendation_result.error_message.c_str(), alloc), alloc);
-
-        rapidjson::StringBuffer rec_buffer;
-        rapidjson::Writer<rapidjson::StringBuffer> rec_writer(rec_buffer);
-        rec_doc.Accept(rec_writer);
-        ai_recommendation.recommendation_result = rec_buffer.GetString();
-
-        // 保存到数据库
-        if (!db_->saveAiRecommendation(ai_recommendation)) {
-            LOG_F(WARNING, "保存AI推荐记录失败");
-        }
-
-        // 构建响应数据
-        rapidjson::Document response_doc;
-        response_doc.SetObject();
-        response_doc.AddMember("session_id", rapidjson::Value(session_id.c_str(), alloc), alloc);
-        response_doc.AddMember("table_number", rapidjson::Value(table_number.c_str(), alloc), alloc);
-        response_doc.AddMember("people_count", vision_result.people_num, alloc);
-        response_doc.AddMember("season", rapidjson::Value(season.c_str(), alloc), alloc);
-        response_doc.AddMember("meal_time", rapidjson::Value(meal_time.c_str(), alloc), alloc);
-        response_doc.AddMember("processing_time", static_cast<int>(processing_time), alloc);
-        response_doc.AddMember("recommendations", rec_doc["recommendations"], alloc);
-
-        rapidjson::StringBuffer response_buffer;
-        rapidjson::Writer<rapidjson::StringBuffer> response_writer(response_buffer);
-        response_doc.Accept(response_writer);
+        // 响应头在推荐开始前就已发出，阶段耗时通过chunked尾部的Server-Timing返回
+        std::shared_ptr<RequestTrace> trace = RequestTrace::currentShared();
+        response.set_header("Cache-Control", "no-cache");
+        response.set_header("X-Accel-Buffering", "no");
+        if (trace) {
+            response.set_header("Trailer", "Server-Timing");
+        }
+        // 请求（含图片）移入共享指针，内容提供者被复制时不复制图片
+        auto shared_request = std::make_shared<const RecommendationRequest>(std::move(rec_request));
+        response.set_chunked_content_provider("text/event-stream; charset=utf-8",
+            [this, shared_request, table, session_id, trace](size_t offset, httplib::DataSink& sink) {
+                (void)offset;
+                const RecommendationRequest& rec_request = *shared_request;
+                RequestTrace::Scope trace_scope(trace);
+                auto finish = [&sink, &trace]() {
+                    if (trace) {
+                        sink.done_with_trailer({{"Server-Timing", trace->serverTiming()}});
+                    } else {
+                        sink.done();
+                    }
+                };
+                auto start_time = std::chrono::high_resolution_clock::now();
 
-        response.status = 200;
-        response.set_content(buildSuccessResponse("推荐成功", response_buffer.GetString()), "application/json; charset=utf-8");
+                auto send_error = [&sink, &finish](int code, const std::string& message) {
+                    rapidjson::Document err;
+                    err.SetObject();
+                    auto& err_alloc = err.GetAllocator();
+                    err.AddMember("code", code, err_alloc);
+                    err.AddMember("message", rapidjson::Value(message.c_str(), err_alloc), err_alloc);
+                    std::string frame = buildSseEvent("error", err);
+                    sink.write(frame.data(), frame.size());
+                    finish();
+                };
+
+                // 第一阶段：视觉识别（合并模式下同时完成推荐）
+                RecommendationResult recommendation_result;
+                VisionResult vision_result = analyzeCustomer(rec_request, recommendation_result);
+                if (!vision_result.success) {
+                    send_error(500, "视觉识别失败：" + vision_result.error_message);
+                    return true;
+                }
+
+                rapidjson::Document vision_event;
+                vision_event.SetObject();
+                auto& alloc = vision_event.GetAllocator();
+                vision_event.AddMember("session_id", rapidjson::Value(session_id.c_str(), alloc), alloc);
+                vision_event.AddMember("people_count", vision_result.people_num, alloc);
+                vision_event.AddMember("season", rapidjson::Value(rec_request.season.c_str(), alloc), alloc);
+                vision_event.AddMember("meal_time", rapidjson::Value(rec_request.meal_time.c_str(), alloc), alloc);
+                std::string frame = buildSseEvent("vision", vision_event);
+                if (!sink.write(frame.data(), frame.size())) {
+                    return false;
+                }
+
+                // 客户端断开后推送失败，之后不再写入任何事件
+                bool disconnected = false;
+                auto send_dish = [&sink, &disconnected](const DishRecommendation& dish) {
+                    rapidjson::Document dish_event;
+                    dish_event.SetObject();
+                    auto& dish_alloc = dish_event.GetAllocator();
+                    dish_event.AddMember("dish_name", rapidjson::Value(dish.dish_name.c_str(), dish_alloc), dish_alloc);
+                    dish_event.AddMember("reason", rapidjson::Value(dish.reason.c_str(), dish_alloc), dish_alloc);
+                    dish_event.AddMember("taste_level", rapidjson::Value(dish.taste_level.c_str(), dish_alloc), dish_alloc);
+                    dish_event.AddMember("nutrition_advice", rapidjson::Value(dish.nutrition_advice.c_str(), dish_alloc), dish_alloc);
+                    dish_event.AddMember("confidence", 0.8, dish_alloc); // 暂时使用固定值
+                    std::string dish_frame = buildSseEvent("dish", dish_event);
+                    disconnected = !sink.write(dish_frame.data(), dish_frame.size());
+                    return !disconnected;
+                };
+
+                if (recommendation_result.success) {
+                    // 合并模式已得到全部菜品，直接逐道推送
+                    for (const auto& dish : recommendation_result.recommendations) {
+                        if (!send_dish(dish)) {
+                            return false;
+                        }
+                    }
+                } else {
+                    // 第二阶段：流式推荐，每解析出一道菜品立即推送
+                    StageTimer timer("recommend", stage_recommend_);
+                    recommendation_result = ai_service_->recommendDishesStream(
+                        vision_result, rec_request.season, rec_request.meal_time, send_dish);
+                }
+                if (disconnected) {
+                    LOG_F(INFO, "客户端已断开，停止流式推荐");
+                    return false;
+                }
+
+                if (!recommendation_result.success) {
+                    send_error(500, "智能推荐失败：" + recommendation_result.error_message);
+                    return true;
+                }
+
+                auto end_time = std::chrono::high_resolution_clock::now();
+                auto processing_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+                (rec_request.pipeline == PipelineMode::Combined ? combined_latency_ : two_stage_latency_)
+                    .record(std::chrono::duration<double, std::milli>(end_time - start_time).count());
+                LOG_F(INFO, "流式推荐完成，推荐了 %zu 道菜品", recommendation_result.recommendations.size());
+
+                saveRecommendationRecord(rec_request, table, session_id, vision_result,
+                                         recommendation_result, static_cast<int>(processing_time));
+
+                rapidjson::Document done_event;
+                done_event.SetObject();
+                auto& done_alloc = done_event.GetAllocator();
+                done_event.AddMember("session_id", rapidjson::Value(session_id.c_str(), done_alloc), done_alloc);
+                done_event.AddMember("total", static_cast<int>(recommendation_result.recommendations.size()), done_alloc);
+                done_event.AddMember("processing_time", static_cast<int>(processing_time), done_alloc);
+                frame = buildSseEvent("done", done_event);
+                sink.write(frame.data(), frame.size());
+                finish();
+                return true;
+            });
 
     } catch (const std::exception& e) {
-        LOG_F(ERROR, "处理推荐请求时发生异常: %s", e.what());
+        LOG_F(ERROR, "处理流式推荐请求时发生异常: %s", e.what());
+        response.status = 500;
+        response.set_content(buildErrorResponse("服务器内部错误", 500), "application/json; charset=utf-8");
+    }
+}
+
+void RecommendationController::handleGetRecommendationResult(const httplib::Request& request, httplib::Response& response) {
+    JsonResponse::setCorsHeaders(response);
+
+    try {
+        std::string session_id = request.matches.size() > 1 ? request.matches[1].str() : "";
+
+        int wait_seconds = 0;
+        if (request.has_param("wait")) {
+            if (!parseNonNegativeInt(request.get_param_value("wait"), wait_seconds)) {
+                response.status = 400;
+                response.set_content(buildErrorResponse("wait必须为非负整数秒数", 400), "application/json; charset=utf-8");
+                return;
+            }
+            wait_seconds = std::min(wait_seconds, kMaxPollWaitSeconds);
+        }
+
+        std::unique_lock<std::mutex> lock(jobs_mutex_);
+        auto it = jobs_.find(session_id);
+        if (it == jobs_.end()) {
+            lock.unlock();
+            response.status = 404;
+            response.set_content(buildErrorResponse("推荐任务不存在或已过期", 404), "application/json; charset=utf-8");
+            return;
+        }
+
+        // 持有任务的引用，等待期间任务表被清理也不影响
+        std::shared_ptr<RecommendationJob> job = it->second;
+        if (wait_seconds > 0 && job->state != RecommendationJob::State::Done) {
+            if (waiting_polls_ < max_waiting_polls_) {
+                waiting_polls_++;
+                jobs_cv_.wait_for(lock, std::chrono::seconds(wait_seconds), [&job] {
+                    return job->state == RecommendationJob::State::Done;
+                });
+                waiting_polls_--;
+            } else {
+                rejected_polls_++;
+                LOG_F(WARNING, "长轮询数已达上限 %d，会话 %s 立即返回", max_waiting_polls_, session_id.c_str());
+            }
+        }
+
+        if (job->state == RecommendationJob::State::Done) {
+            RecommendationOutcome outcome = job->outcome;
+            lock.unlock();
+            response.status = outcome.status;
+            response.set_content(outcome.body, "application/json; charset=utf-8");
+            return;
+        }
+
+        const char* state = job->state == RecommendationJob::State::Running ? "running" : "pending";
+        lock.unlock();
+
+        response.status = 202;
+        response.set_content(buildSuccessResponse("推荐任务处理中", [&](JsonResponse::JsonWriter& writer) {
+            writer.StartObject();
+            writer.Key("session_id");
+            writer.String(session_id.c_str(), static_cast<rapidjson::SizeType>(session_id.size()));
+            writer.Key("status");
+            writer.String(state);
+            writer.EndObject();
+        }), "application/json; charset=utf-8");
+
+    } catch (const std::exception& e) {
+        LOG_F(ERROR, "获取推荐结果时发生异常: %s", e.what());
         response.status = 500;
         response.set_content(buildErrorResponse("服务器内部错误", 500), "application/json; charset=utf-8");
     }
 }
 
 void RecommendationController::handleGetRecommendationHistory(const httplib::Request& request, httplib::Response& response) {
-    setCorsHeaders(response);
+    JsonResponse::setCorsHeaders(response);
     
     try {
         // 获取查询参数
@@ -188,12 +737,8 @@ void RecommendationController::handleGetRecommendationHistory(const httplib::Req
         doc.AddMember("total", 0, alloc);
         doc.AddMember("limit", limit, alloc);
 
-        rapidjson::StringBuffer buffer;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-        doc.Accept(writer);
-
         response.status = 200;
-        response.set_content(buildSuccessResponse("获取推荐历史成功", buffer.GetString()), "application/json; charset=utf-8");
+        response.set_content(buildSuccessResponse("获取推荐历史成功", doc), "application/json; charset=utf-8");
 
     } catch (const std::exception& e) {
         LOG_F(ERROR, "获取推荐历史时发生异常: %s", e.what());
@@ -203,7 +748,7 @@ void RecommendationController::handleGetRecommendationHistory(const httplib::Req
 }
 
 void RecommendationController::handleRecommendationFeedback(const httplib::Request& request, httplib::Response& response) {
-    setCorsHeaders(response);
+    JsonResponse::setCorsHeaders(response);
     
     try {
         rapidjson::Document doc;
@@ -219,10 +764,15 @@ void RecommendationController::handleRecommendationFeedback(const httplib::Reque
         int score = doc["score"].GetInt();
         std::string comment = doc.HasMember("comment") ? doc["comment"].GetString() : "";
 
+        // 推荐记录可能还在写入队列中，先写入再更新
+        if (rec_writer_ && rec_writer_->isPending(session_id)) {
+            rec_writer_->flush();
+        }
+
         // 更新推荐反馈
         if (db_->updateAiRecommendationFeedback(session_id, score, comment)) {
             response.status = 200;
-            response.set_content(buildSuccessResponse("反馈提交成功", "{}"), "application/json; charset=utf-8");
+            response.set_content(buildSuccessResponse("反馈提交成功", rapidjson::Value(rapidjson::kObjectType)), "application/json; charset=utf-8");
         } else {
             response.status = 500;
             response.set_content(buildErrorResponse("反馈提交失败", 500), "application/json; charset=utf-8");
@@ -236,42 +786,56 @@ void RecommendationController::handleRecommendationFeedback(const httplib::Reque
 }
 
 void RecommendationController::handleGetRecommendedDishes(const httplib::Request& request, httplib::Response& response) {
-    (void)request; // 抑制未使用参数警告
-    setCorsHeaders(response);
+    JsonResponse::setCorsHeaders(response);
 
     try {
-        // 获取推荐菜品
-        auto dishes = db_->getRecommendedDishes();
-
-        rapidjson::Document doc;
-        doc.SetObject();
-        auto& alloc = doc.GetAllocator();
+        // 直接读取菜单快照，不复制菜品；库存变化（含售罄）同样改变ETag
+        auto snapshot = db_->getMenuSnapshot();
+        uint64_t stock_version = inventory_ ? inventory_->version() : 0;
+        std::string etag = buildMenuEtag(*snapshot, stock_version);
+        if (checkNotModified(request, response, etag)) {
+            return;
+        }
 
-        rapidjson::Value dishes_array(rapidjson::kArrayType);
-        for (const auto& dish : dishes) {
-            rapidjson::Value dish_obj(rapidjson::kObjectType);
-            dish_obj.AddMember("id", dish.id, alloc);
-            dish_obj.AddMember("dish_code", rapidjson::Value(dish.dish_code.c_str(), alloc), alloc);
-            dish_obj.AddMember("dish_name", rapidjson::Value(dish.dish_name.c_str(), alloc), alloc);
-            dish_obj.AddMember("price", dish.price, alloc);
-            dish_obj.AddMember("description", rapidjson::Value(dish.description.c_str(), alloc), alloc);
-            dish_obj.AddMember("taste_tags", rapidjson::Value(dish.taste_tags.c_str(), alloc), alloc);
-            dish_obj.AddMember("image_url", rapidjson::Value(dish.image_url.c_str(), alloc), alloc);
-            dish_obj.AddMember("is_signature", dish.is_signature, alloc);
-            dish_obj.AddMember("rating", dish.rating, alloc);
-            dish_obj.AddMember("sales_count", dish.sales_count, alloc);
-            dishes_array.PushBack(dish_obj, alloc);
+        std::string body;
+        {
+            std::lock_guard<std::mutex> lock(menu_body_mutex_);
+            if (menu_body_version_ == snapshot->version && menu_body_stock_version_ == stock_version &&
+                !menu_body_.empty()) {
+                body = menu_body_;
+            }
         }
-        
-        doc.AddMember("dishes", dishes_array, alloc);
-        doc.AddMember("total", static_cast<int>(dishes.size()), alloc);
 
-        rapidjson::StringBuffer buffer;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-        doc.Accept(writer);
+        if (body.empty()) {
+            InventoryManager* inventory = inventory_.get();
+            body = buildSuccessResponse("获取推荐菜品成功", [&snapshot, inventory](JsonResponse::JsonWriter& writer) {
+                writer.StartObject();
+                writer.Key("dishes");
+                writer.StartArray();
+                for (size_t index : snapshot->recommended) {
+                    writeDish(writer, *snapshot, index, inventory);
+                }
+                writer.EndArray();
+                writer.Key("total");
+                writer.Int(static_cast<int>(snapshot->recommended.size()));
+                writer.Key("menu_version");
+                writer.Uint64(snapshot->version);
+                writer.EndObject();
+            });
+
+            std::lock_guard<std::mutex> lock(menu_body_mutex_);
+            if (snapshot->version > menu_body_version_ ||
+                (snapshot->version == menu_body_version_ && stock_version >= menu_body_stock_version_)) {
+                menu_body_version_ = snapshot->version;
+                menu_body_stock_version_ = stock_version;
+                menu_body_ = body;
+            }
+        }
 
         response.status = 200;
-        response.set_content(buildSuccessResponse("获取推荐菜品成功", buffer.GetString()), "application/json; charset=utf-8");
+        response.set_header("ETag", etag);
+        response.set_header("Cache-Control", kMenuCacheControl);
+        response.set_content(body, "application/json; charset=utf-8");
 
     } catch (const std::exception& e) {
         LOG_F(ERROR, "获取推荐菜品时发生异常: %s", e.what());
@@ -280,9 +844,303 @@ void RecommendationController::handleGetRecommendedDishes(const httplib::Request
     }
 }
 
-bool RecommendationController::parseRecommendationRequest(const std::string& body, std::string& image_base64, 
-                                                           std::string& table_number, std::string& user_id, 
-                                                           std::string& season, std::string& meal_time) {
+void RecommendationController::handleGetDishChanges(const httplib::Request& request, httplib::Response& response) {
+    JsonResponse::setCorsHeaders(response);
+
+    try {
+        uint64_t since = 0;
+        if (request.has_param("since")) {
+            if (!parseUnsigned(request.get_param_value("since"), since)) {
+                response.status = 400;
+                response.set_content(buildErrorResponse("since必须为非负整数", 400), "application/json; charset=utf-8");
+                return;
+            }
+        }
+
+        auto snapshot = db_->getMenuSnapshot();
+        std::string etag = buildMenuEtag(*snapshot, inventory_ ? inventory_->version() : 0);
+        if (checkNotModified(request, response, etag)) {
+            return;
+        }
+
+        // 客户端的版本来自服务重启之前时版本号不可比较，直接全量同步
+        bool epoch_mismatch = request.has_param("epoch") &&
+                              request.get_param_value("epoch") != std::to_string(snapshot->epoch);
+        MenuDelta delta = db_->getMenuChanges(epoch_mismatch ? 0 : since, *snapshot);
+        if (epoch_mismatch) {
+            delta.full = true;
+        }
+
+        response.status = 200;
+        response.set_header("ETag", etag);
+        response.set_header("Cache-Control", kMenuCacheControl);
+        response.set_content(buildSuccessResponse("获取菜单变更成功", [&](JsonResponse::JsonWriter& writer) {
+            writer.StartObject();
+            writer.Key("epoch");
+            writer.Uint64(snapshot->epoch);
+            writer.Key("since");
+            writer.Uint64(since);
+            writer.Key("version");
+            writer.Uint64(snapshot->version);
+            writer.Key("full");
+            writer.Bool(delta.full);
+            writer.Key("changed");
+            writer.StartArray();
+            for (const Dish* dish : delta.changed) {
+                writeDish(writer, *snapshot, static_cast<size_t>(dish - snapshot->dishes.data()), inventory_.get());
+            }
+            writer.EndArray();
+            writer.Key("removed");
+            writer.StartArray();
+            for (int id : delta.removed) {
+                writer.Int(id);
+            }
+            writer.EndArray();
+            // 售罄不改变菜单版本，每次返回当前的全部售罄菜品
+            writer.Key("sold_out");
+            writer.StartArray();
+            if (inventory_) {
+                for (int id : inventory_->getSoldOutDishes()) {
+                    writer.Int(id);
+                }
+            }
+            writer.EndArray();
+            writer.EndObject();
+        }), "application/json; charset=utf-8");
+
+    } catch (const std::exception& e) {
+        LOG_F(ERROR, "获取菜单变更时发生异常: %s", e.what());
+        response.status = 500;
+        response.set_content(buildErrorResponse("服务器内部错误", 500), "application/json; charset=utf-8");
+    }
+}
+
+void RecommendationController::handleGetPopularDishes(const httplib::Request& request, httplib::Response& response) {
+    JsonResponse::setCorsHeaders(response);
+    if (!popularity_) {
+        response.status = 503;
+        response.set_content(buildErrorResponse("热销统计未启用", 503), "application/json; charset=utf-8");
+        return;
+    }
+
+    // window默认week；meal_time和season不传表示不限，传current表示当前时段/季节
+    PopularityWindow window = PopularityWindow::Week;
+    if (request.has_param("window") && !parsePopularityWindow(request.get_param_value("window"), window)) {
+        response.status = 400;
+        response.set_content(buildErrorResponse("window应为day、week、month或quarter", 400),
+                             "application/json; charset=utf-8");
+        return;
+    }
+    std::string meal_time = request.has_param("meal_time") ? request.get_param_value("meal_time") : "";
+    std::string season = request.has_param("season") ? request.get_param_value("season") : "";
+    if (meal_time == "current") {
+        meal_time = getCurrentMealTime();
+    }
+    if (season == "current") {
+        season = getCurrentSeason();
+    }
+    int meal_index = meal_time.empty() ? -1 : MealPeriod::findMealTime(meal_time);
+    int season_index = season.empty() ? -1 : MealPeriod::findSeason(season);
+    if ((!meal_time.empty() && meal_index < 0) || (!season.empty() && season_index < 0)) {
+        response.status = 400;
+        response.set_content(buildErrorResponse("无法识别的meal_time或season", 400), "application/json; charset=utf-8");
+        return;
+    }
+    int limit = request.has_param("limit") ? std::atoi(request.get_param_value("limit").c_str()) : 10;
+    limit = std::max(1, std::min(limit, 50));
+
+    // 只返回仍在售且未售罄的菜品
+    auto snapshot = db_->getMenuSnapshot();
+    InventoryManager* inventory = inventory_.get();
+    std::vector<PopularDish> popular = popularity_->top(meal_index, season_index, window, static_cast<size_t>(limit),
+        [&snapshot, inventory](int dish_id) {
+            const Dish* dish = snapshot->findById(dish_id);
+            return dish && dish->is_available && !(inventory && inventory->isSoldOut(dish_id));
+        });
+
+    response.status = 200;
+    response.set_content(buildSuccessResponse("获取热销菜品成功", [&](JsonResponse::JsonWriter& writer) {
+        writer.StartObject();
+        writer.Key("window");
+        writer.String(popularityWindowName(window));
+        writer.Key("meal_time");
+        writer.String(meal_time.c_str(), static_cast<rapidjson::SizeType>(meal_time.size()));
+        writer.Key("season");
+        writer.String(season.c_str(), static_cast<rapidjson::SizeType>(season.size()));
+        writer.Key("dishes");
+        writer.StartArray();
+        for (const auto& entry : popular) {
+            writer.StartObject();
+            writeDishFields(writer, *snapshot, snapshot->by_id.at(entry.dish_id), inventory);
+            writer.Key("window_sales");
+            writer.Uint64(entry.count);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.Key("total");
+        writer.Uint64(popular.size());
+        writer.EndObject();
+    }), "application/json; charset=utf-8");
+}
+
+std::string RecommendationController::buildMenuEtag(const MenuSnapshot& snapshot, uint64_t stock_version) {
+    return "\"menu-" + std::to_string(snapshot.epoch) + "-" + std::to_string(snapshot.version) + "-" +
+           std::to_string(stock_version) + "\"";
+}
+
+bool RecommendationController::checkNotModified(const httplib::Request& request, httplib::Response& response,
+                                                const std::string& etag) {
+    if (!request.has_header("If-None-Match")) {
+        return false;
+    }
+
+    // If-None-Match可能是逗号分隔的多个ETag或*，比较时忽略弱校验前缀W/
+    const std::string header = request.get_header_value("If-None-Match");
+    bool matched = false;
+    size_t pos = 0;
+    while (pos <= header.size() && !matched) {
+        size_t comma = header.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = header.size();
+        }
+        size_t begin = header.find_first_not_of(" \t", pos);
+        size_t end = header.find_last_not_of(" \t", comma - 1);
+        if (begin != std::string::npos && begin < comma && end != std::string::npos && end >= begin) {
+            std::string candidate = header.substr(begin, end - begin + 1);
+            if (candidate.compare(0, 2, "W/") == 0) {
+                candidate.erase(0, 2);
+            }
+            matched = candidate == "*" || candidate == etag;
+        }
+        pos = comma + 1;
+    }
+
+    if (!matched) {
+        return false;
+    }
+    response.status = 304;
+    response.set_header("ETag", etag);
+    response.set_header("Cache-Control", kMenuCacheControl);
+    return true;
+}
+
+bool RecommendationController::readRecommendationRequest(const httplib::Request& request,
+                                                         const httplib::ContentReader& content_reader,
+                                                         RecommendationRequest& rec_request,
+                                                         int& error_status, std::string& error_message) {
+    // JSON请求中图片为base64，体积约为原图的4/3
+    const size_t max_json_body = max_image_size_ / 3 * 4 + 64 * 1024;
+    std::string content_type = request.get_header_value("Content-Type");
+    bool is_json = !request.is_multipart_form_data() &&
+                   content_type.find("image/") == std::string::npos &&
+                   content_type.find("application/octet-stream") == std::string::npos;
+    size_t body_limit = is_json ? max_json_body : max_image_size_;
+
+    // 有Content-Length时在读取请求体之前就拒绝超大请求
+    if (request.has_header("Content-Length")) {
+        uint64_t content_length = 0;
+        if (!parseUnsigned(request.get_header_value("Content-Length"), content_length)) {
+            error_status = 400;
+            error_message = "Content-Length无效";
+            return false;
+        }
+        if (content_length > body_limit + kMaxFormFieldSize * 4) {
+            error_status = 413;
+            error_message = "图片过大，超出上传限制";
+            return false;
+        }
+    }
+
+    bool too_large = false;
+
+    if (request.is_multipart_form_data()) {
+        // multipart/form-data：image字段为图片，其余为文本参数
+        std::string current_field;
+        std::string current_content_type;
+        std::unordered_map<std::string, std::string> fields;
+
+        bool ok = content_reader(
+            [&](const httplib::MultipartFormData& part) {
+                current_field = part.name;
+                current_content_type = part.content_type;
+                return true;
+            },
+            [&](const char* data, size_t length) {
+                if (current_field == "image") {
+                    if (rec_request.image.data.size() + length > max_image_size_) {
+                        too_large = true;
+                        return false;
+                    }
+                    rec_request.image.data.append(data, length);
+                    return true;
+                }
+                std::string& value = fields[current_field];
+                if (value.size() + length > kMaxFormFieldSize) {
+                    too_large = true;
+                    return false;
+                }
+                value.append(data, length);
+                return true;
+            });
+
+        if (!ok) {
+            error_status = too_large ? 413 : 400;
+            error_message = too_large ? "图片过大，超出上传限制" : "请求参数解析失败";
+            return false;
+        }
+
+        rec_request.image.is_base64 = false;
+        rec_request.image.mime_type = detectImageMimeType(current_content_type, rec_request.image.data);
+        rec_request.table_number = fields["table_number"];
+        rec_request.user_id = fields["user_id"];
+        rec_request.season = fields["season"];
+        rec_request.meal_time = fields["meal_time"];
+        rec_request.async = (fields["async"] == "1" || fields["async"] == "true");
+        rec_request.pipeline_mode = fields["pipeline_mode"];
+        return true;
+    }
+
+    std::string body;
+    bool ok = content_reader([&](const char* data, size_t length) {
+        if (body.size() + length > body_limit) {
+            too_large = true;
+            return false;
+        }
+        body.append(data, length);
+        return true;
+    });
+    if (!ok) {
+        error_status = too_large ? 413 : 400;
+        error_message = too_large ? "图片过大，超出上传限制" : "请求参数解析失败";
+        return false;
+    }
+
+    if (!is_json) {
+        // 图片直传：桌号等参数来自请求头或查询参数
+        rec_request.image.data = std::move(body);
+        rec_request.image.is_base64 = false;
+        rec_request.image.mime_type = detectImageMimeType(content_type, rec_request.image.data);
+
+        auto header_or_param = [&request](const char* header, const char* param) {
+            std::string value = request.get_header_value(header);
+            return value.empty() ? request.get_param_value(param) : value;
+        };
+        rec_request.table_number = header_or_param("X-Table-Number", "table_number");
+        rec_request.user_id = header_or_param("X-User-Id", "user_id");
+        rec_request.season = request.get_param_value("season");
+        rec_request.meal_time = request.get_param_value("meal_time");
+        return true;
+    }
+
+    if (!parseRecommendationRequest(body, rec_request)) {
+        error_status = 400;
+        error_message = "请求参数解析失败";
+        return false;
+    }
+    return true;
+}
+
+bool RecommendationController::parseRecommendationRequest(const std::string& body, RecommendationRequest& rec_request) {
     try {
         rapidjson::Document doc;
         doc.Parse(body.c_str());
@@ -292,23 +1150,33 @@ bool RecommendationController::parseRecommendationRequest(const std::string& bod
         }
 
         if (doc.HasMember("image_base64") && doc["image_base64"].IsString()) {
-            image_base64 = doc["image_base64"].GetString();
+            const auto& image = doc["image_base64"];
+            rec_request.image.data.assign(image.GetString(), image.GetStringLength());
+            rec_request.image.is_base64 = true;
         }
         
         if (doc.HasMember("table_number") && doc["table_number"].IsString()) {
-            table_number = doc["table_number"].GetString();
+            rec_request.table_number = doc["table_number"].GetString();
         }
         
         if (doc.HasMember("user_id") && doc["user_id"].IsString()) {
-            user_id = doc["user_id"].GetString();
+            rec_request.user_id = doc["user_id"].GetString();
         }
         
         if (doc.HasMember("season") && doc["season"].IsString()) {
-            season = doc["season"].GetString();
+            rec_request.season = doc["season"].GetString();
         }
         
         if (doc.HasMember("meal_time") && doc["meal_time"].IsString()) {
-            meal_time = doc["meal_time"].GetString();
+            rec_request.meal_time = doc["meal_time"].GetString();
+        }
+
+        if (doc.HasMember("async") && doc["async"].IsBool()) {
+            rec_request.async = doc["async"].GetBool();
+        }
+
+        if (doc.HasMember("pipeline_mode") && doc["pipeline_mode"].IsString()) {
+            rec_request.pipeline_mode = doc["pipeline_mode"].GetString();
         }
 
         return true;
@@ -318,43 +1186,21 @@ bool RecommendationController::parseRecommendationRequest(const std::string& bod
     }
 }
 
-bool RecommendationController::validateRequest(const std::string& image_base64, const std::string& table_number) {
-    return !image_base64.empty() && !table_number.empty();
+bool RecommendationController::validateRequest(const std::string& image_data, const std::string& table_number) {
+    return !image_data.empty() && !table_number.empty();
 }
 
 std::string RecommendationController::buildErrorResponse(const std::string& message, int code) {
-    rapidjson::Document doc;
-    doc.SetObject();
-    auto& alloc = doc.GetAllocator();
-
-    doc.AddMember("code", code, alloc);
-    doc.AddMember("message", rapidjson::Value(message.c_str(), alloc), alloc);
-    doc.AddMember("data", rapidjson::Value(rapidjson::kObjectType), alloc);
-
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    doc.Accept(writer);
-
-    return buffer.GetString();
+    return JsonResponse::build(code, message);
 }
 
-std::string RecommendationController::buildSuccessResponse(const std::string& message, const std::string& data) {
-    rapidjson::Document doc;
-    doc.SetObject();
-    auto& alloc = doc.GetAllocator();
-
-    doc.AddMember("code", 200, alloc);
-    doc.AddMember("message", rapidjson::Value(message.c_str(), alloc), alloc);
-    
-        rapidjson::Document data_doc;
-        data_doc.Parse(data.c_str());
-            doc.AddMember("data", data_doc, alloc);
-
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    doc.Accept(writer);
+std::string RecommendationController::buildSuccessResponse(const std::string& message, const rapidjson::Value& data) {
+    return JsonResponse::build(200, message, data);
+}
 
-    return buffer.GetString();
+std::string RecommendationController::buildSuccessResponse(const std::string& message,
+                                                           const JsonResponse::DataWriter& write_data) {
+    return JsonResponse::build(200, message, write_data);
 }
 
 std::string RecommendationController::getCurrentSeason() {
@@ -363,10 +1209,7 @@ std::string RecommendationController::getCurrentSeason() {
     auto tm = *std::localtime(&time_t);
     
     int month = tm.tm_mon + 1; // tm_mon is 0-based
-    if (month >= 3 && month <= 5) return "春季";
-    if (month >= 6 && month <= 8) return "夏季";
-    if (month >= 9 && month <= 11) return "秋季";
-        return "冬季";
+    return MealPeriod::kSeasons[static_cast<size_t>(MealPeriod::seasonIndex(month))];
 }
 
 std::string RecommendationController::getCurrentMealTime() {
@@ -374,19 +1217,7 @@ std::string RecommendationController::getCurrentMealTime() {
     auto time_t = std::chrono::system_clock::to_time_t(now);
     auto tm = *std::localtime(&time_t);
     
-    int hour = tm.tm_hour;
-    if (hour >= 6 && hour < 10) return "早餐";
-    if (hour >= 10 && hour < 14) return "午餐";
-    if (hour >= 14 && hour < 17) return "下午茶";
-    if (hour >= 17 && hour < 21) return "晚餐";
-        return "夜宵";
-    }
-
-void RecommendationController::setCorsHeaders(httplib::Response& response) {
-    response.set_header("Access-Control-Allow-Origin", "*");
-    response.set_header("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
-    response.set_header("Access-Control-Allow-Headers", "Content-Type, Authorization, X-Requested-With");
-    response.set_header("Access-Control-Allow-Credentials", "true");
+    return MealPeriod::kMealTimes[static_cast<size_t>(MealPeriod::mealTimeIndex(tm.tm_hour))];
 }
 
 } // namespace WisdomRestaurant
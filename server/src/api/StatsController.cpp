@@ -0,0 +1,87 @@
+#include "api/StatsController.h"
+#include "common/UtcTime.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+namespace WisdomRestaurant {
+
+// 一次最多返回的天数
+static constexpr int kMaxStatsDays = 366;
+
+StatsController::StatsController(std::shared_ptr<RestaurantDb> db)
+    : db_(db) {
+}
+
+void StatsController::handleGetOrderStats(const httplib::Request& request, httplib::Response& response) {
+    JsonResponse::setCorsHeaders(response);
+
+    // 日期按UTC，与orders.created_at一致；默认今天
+    int64_t day;
+    if (request.has_param("date")) {
+        if (!UtcTime::parseDate(request.get_param_value("date"), day)) {
+            JsonResponse::send(response, 400, JsonResponse::build(400, "date格式应为YYYY-MM-DD"));
+            return;
+        }
+    } else {
+        UtcTime::parseDate(UtcTime::formatDate(std::chrono::system_clock::now()), day);
+    }
+    int days = 7;
+    if (request.has_param("days")) {
+        days = std::atoi(request.get_param_value("days").c_str());
+        if (days < 1 || days > kMaxStatsDays) {
+            JsonResponse::send(response, 400, JsonResponse::build(400, "days应在1到366之间"));
+            return;
+        }
+    }
+
+    std::string date = UtcTime::dateFromDays(day);
+    std::vector<OrderStatsRow> daily = db_->getDailyOrderStats(UtcTime::dateFromDays(day - days + 1), date);
+    std::vector<OrderStatsRow> hourly = db_->getHourlyOrderStats(date);
+
+    JsonResponse::send(response, 200, JsonResponse::build(200, "获取订单统计成功", [&](JsonResponse::JsonWriter& writer) {
+        writer.StartObject();
+        writer.Key("date");
+        writer.String(date.c_str(), static_cast<rapidjson::SizeType>(date.size()));
+        writer.Key("summary");
+        writer.StartObject();
+        writeCounters(writer, daily.empty() ? OrderStatsRow{date, -1, 0, 0, 0, 0} : daily.back());
+        writer.EndObject();
+        writer.Key("hours");
+        writer.StartArray();
+        for (const auto& row : hourly) {
+            writer.StartObject();
+            writer.Key("hour");
+            writer.Int(row.stat_hour);
+            writeCounters(writer, row);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.Key("days");
+        writer.StartArray();
+        for (const auto& row : daily) {
+            writer.StartObject();
+            writer.Key("date");
+            writer.String(row.stat_date.c_str(), static_cast<rapidjson::SizeType>(row.stat_date.size()));
+            writeCounters(writer, row);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+    }));
+}
+
+void StatsController::writeCounters(JsonResponse::JsonWriter& writer, const OrderStatsRow& row) {
+    writer.Key("orders");
+    writer.Int64(row.order_count);
+    writer.Key("covers");
+    writer.Int64(row.covers);
+    writer.Key("paid_orders");
+    writer.Int64(row.paid_count);
+    writer.Key("revenue");
+    writer.Double(row.revenue());
+    writer.Key("average_ticket");
+    writer.Double(std::round(row.averageTicket() * 100.0) / 100.0);
+}
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,106 @@
+#include "common/Base64.h"
+
+namespace WisdomRestaurant {
+namespace Base64 {
+
+static const char kEncodeTable[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// 解码表，-1表示非法字符，-2表示填充字符
+static int decodeValue(unsigned char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+' || c == '-') return 62;
+    if (c == '/' || c == '_') return 63;
+    if (c == '=') return -2;
+    return -1;
+}
+
+std::string encode(const char* data, size_t length) {
+    std::string out;
+    out.reserve(encodedLength(length));
+    encodeAppend(data, length, out);
+    return out;
+}
+
+void encodeAppend(const char* data, size_t length, std::string& out) {
+    size_t offset = out.size();
+    out.resize(offset + encodedLength(length));
+    encodeInto(data, length, &out[offset]);
+}
+
+size_t encodeInto(const char* data, size_t length, char* out) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(data);
+    char* p = out;
+    size_t i = 0;
+    for (; i + 3 <= length; i += 3) {
+        unsigned int triple = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        *p++ = kEncodeTable[(triple >> 18) & 0x3F];
+        *p++ = kEncodeTable[(triple >> 12) & 0x3F];
+        *p++ = kEncodeTable[(triple >> 6) & 0x3F];
+        *p++ = kEncodeTable[triple & 0x3F];
+    }
+
+    size_t remaining = length - i;
+    if (remaining == 1) {
+        unsigned int triple = in[i] << 16;
+        *p++ = kEncodeTable[(triple >> 18) & 0x3F];
+        *p++ = kEncodeTable[(triple >> 12) & 0x3F];
+        *p++ = '=';
+        *p++ = '=';
+    } else if (remaining == 2) {
+        unsigned int triple = (in[i] << 16) | (in[i + 1] << 8);
+        *p++ = kEncodeTable[(triple >> 18) & 0x3F];
+        *p++ = kEncodeTable[(triple >> 12) & 0x3F];
+        *p++ = kEncodeTable[(triple >> 6) & 0x3F];
+        *p++ = '=';
+    }
+    return static_cast<size_t>(p - out);
+}
+
+bool isPlainAlphabet(const std::string& input) {
+    for (unsigned char c : input) {
+        if (!((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+              c == '+' || c == '/' || c == '=')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool decode(const std::string& input, std::string& out) {
+    out.clear();
+    out.reserve(input.size() / 4 * 3);
+
+    unsigned int buffer = 0;
+    int bits = 0;
+    bool padding = false;
+    for (unsigned char c : input) {
+        // 跳过换行等空白字符
+        if (c == '\n' || c == '\r' || c == ' ' || c == '\t') {
+            continue;
+        }
+        int value = decodeValue(c);
+        if (value == -1) {
+            return false;
+        }
+        if (value == -2) {
+            padding = true;
+            continue;
+        }
+        if (padding) {
+            return false;  // 填充字符之后不应再有数据
+        }
+        buffer = (buffer << 6) | static_cast<unsigned int>(value);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>((buffer >> bits) & 0xFF));
+        }
+    }
+    return true;
+}
+
+} // namespace Base64
+} // namespace WisdomRestaurant
@@ -0,0 +1,106 @@
+#include "common/JobExecutor.h"
+#include <loguru.hpp>
+
+namespace WisdomRestaurant {
+
+JobExecutor::JobExecutor(const std::string& name, size_t worker_count, size_t queue_capacity)
+    : name_(name)
+    , queue_capacity_(queue_capacity)
+    , stopping_(false)
+    , max_queue_depth_(0)
+    , active_workers_(0)
+    , submitted_(0)
+    , rejected_(0)
+    , completed_(0) {
+    if (worker_count == 0) {
+        worker_count = 1;
+    }
+    workers_.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; i++) {
+        workers_.emplace_back(&JobExecutor::workerLoop, this);
+    }
+}
+
+JobExecutor::~JobExecutor() {
+    shutdown();
+}
+
+bool JobExecutor::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || queue_.size() >= queue_capacity_) {
+            rejected_++;
+            return false;
+        }
+        queue_.push_back(std::move(job));
+        if (queue_.size() > max_queue_depth_) {
+            max_queue_depth_ = queue_.size();
+        }
+    }
+    submitted_++;
+    cv_.notify_one();
+    return true;
+}
+
+void JobExecutor::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    cv_.notify_all();
+
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+JobExecutorStats JobExecutor::getStats() const {
+    JobExecutorStats stats;
+    stats.worker_count = workers_.size();
+    stats.active_workers = active_workers_.load();
+    stats.queue_capacity = queue_capacity_;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.queue_depth = queue_.size();
+        stats.max_queue_depth = max_queue_depth_;
+    }
+    stats.submitted = submitted_.load();
+    stats.rejected = rejected_.load();
+    stats.completed = completed_.load();
+    return stats;
+}
+
+void JobExecutor::workerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+
+            // 关闭时仍然把队列中已接收的任务执行完
+            if (queue_.empty()) {
+                return;
+            }
+            job = std::move(queue_.front());
+            queue_.pop_front();
+        }
+
+        active_workers_++;
+        try {
+            job();
+        } catch (const std::exception& e) {
+            LOG_F(ERROR, "[%s] 后台任务执行异常: %s", name_.c_str(), e.what());
+        } catch (...) {
+            LOG_F(ERROR, "[%s] 后台任务执行发生未知异常", name_.c_str());
+        }
+        active_workers_--;
+        completed_++;
+    }
+}
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,70 @@
+#include "common/JsonResponse.h"
+#include "httplib.h"
+
+namespace WisdomRestaurant {
+namespace JsonResponse {
+
+// 每个线程复用一个输出缓冲区，扩容后的内存在后续响应中继续使用
+static rapidjson::StringBuffer& threadBuffer() {
+    thread_local rapidjson::StringBuffer buffer;
+    buffer.Clear();
+    return buffer;
+}
+
+template <typename WriteData>
+static std::string writeEnvelope(int code, const std::string& message, WriteData&& write_data) {
+    rapidjson::StringBuffer& buffer = threadBuffer();
+    JsonWriter writer(buffer);
+
+    writer.StartObject();
+    writer.Key("code");
+    writer.Int(code);
+    writer.Key("message");
+    writer.String(message.c_str(), static_cast<rapidjson::SizeType>(message.size()));
+    writer.Key("data");
+    write_data(writer);
+    writer.EndObject();
+
+    return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+std::string build(int code, const std::string& message) {
+    return writeEnvelope(code, message, [](JsonWriter& writer) {
+        writer.StartObject();
+        writer.EndObject();
+    });
+}
+
+std::string build(int code, const std::string& message, const rapidjson::Value& data) {
+    return writeEnvelope(code, message, [&data](JsonWriter& writer) {
+        data.Accept(writer);
+    });
+}
+
+std::string build(int code, const std::string& message, const DataWriter& write_data) {
+    return writeEnvelope(code, message, write_data);
+}
+
+std::string serialize(const rapidjson::Value& value) {
+    rapidjson::StringBuffer& buffer = threadBuffer();
+    JsonWriter writer(buffer);
+    value.Accept(writer);
+    return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+void send(httplib::Response& response, int status, const std::string& body) {
+    response.status = status;
+    response.set_content(body, "application/json; charset=utf-8");
+}
+
+void setCorsHeaders(httplib::Response& response) {
+    response.set_header("Access-Control-Allow-Origin", "*");
+    response.set_header("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
+    response.set_header("Access-Control-Allow-Headers", "Content-Type, Authorization, X-Requested-With, If-None-Match, X-Request-Id");
+    response.set_header("Access-Control-Expose-Headers", "ETag, X-Request-Id, Server-Timing");
+    response.set_header("Access-Control-Allow-Credentials", "true");
+    response.set_header("Timing-Allow-Origin", "*");
+}
+
+} // namespace JsonResponse
+} // namespace WisdomRestaurant
@@ -0,0 +1,78 @@
+#include "common/LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+
+namespace WisdomRestaurant {
+
+static const double kGrowth = 1.1;
+
+LatencyHistogram::LatencyHistogram()
+    : count_(0)
+    , sum_us_(0)
+    , max_us_(0) {
+    for (auto& bucket : buckets_) {
+        bucket.store(0);
+    }
+}
+
+double LatencyHistogram::bucketUpperBound(size_t index) {
+    return std::pow(kGrowth, static_cast<double>(index));
+}
+
+void LatencyHistogram::record(double ms) {
+    if (ms < 0) {
+        ms = 0;
+    }
+
+    size_t index = 0;
+    if (ms > 1.0) {
+        index = static_cast<size_t>(std::ceil(std::log(ms) / std::log(kGrowth)));
+        if (index >= kBucketCount) {
+            index = kBucketCount - 1;
+        }
+    }
+    buckets_[index].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t us = static_cast<uint64_t>(ms * 1000.0);
+    sum_us_.fetch_add(us, std::memory_order_relaxed);
+    uint64_t current_max = max_us_.load(std::memory_order_relaxed);
+    while (us > current_max && !max_us_.compare_exchange_weak(current_max, us, std::memory_order_relaxed)) {
+    }
+}
+
+double LatencyHistogram::percentile(double q) const {
+    uint64_t total = count_.load(std::memory_order_relaxed);
+    if (total == 0) {
+        return 0.0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(total)));
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; i++) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // 不超过实际观测到的最大值
+            return std::min(bucketUpperBound(i), max_us_.load(std::memory_order_relaxed) / 1000.0);
+        }
+    }
+    return max_us_.load(std::memory_order_relaxed) / 1000.0;
+}
+
+LatencySummary LatencyHistogram::getSummary() const {
+    LatencySummary summary;
+    summary.count = count_.load(std::memory_order_relaxed);
+    summary.mean_ms = summary.count > 0
+        ? sum_us_.load(std::memory_order_relaxed) / 1000.0 / static_cast<double>(summary.count) : 0.0;
+    summary.p50_ms = percentile(0.50);
+    summary.p90_ms = percentile(0.90);
+    summary.p99_ms = percentile(0.99);
+    summary.max_ms = max_us_.load(std::memory_order_relaxed) / 1000.0;
+    return summary;
+}
+
+} // namespace WisdomRestaurant
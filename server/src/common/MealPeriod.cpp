@@ -0,0 +1,36 @@
+#include "common/MealPeriod.h"
+
+namespace WisdomRestaurant {
+namespace MealPeriod {
+
+int seasonIndex(int month) {
+    if (month >= 3 && month <= 5) return 0;
+    if (month >= 6 && month <= 8) return 1;
+    if (month >= 9 && month <= 11) return 2;
+    return 3;
+}
+
+int mealTimeIndex(int hour) {
+    if (hour >= 6 && hour < 10) return 0;
+    if (hour >= 10 && hour < 14) return 1;
+    if (hour >= 14 && hour < 17) return 2;
+    if (hour >= 17 && hour < 21) return 3;
+    return 4;
+}
+
+int findSeason(const std::string& name) {
+    for (size_t i = 0; i < kSeasons.size(); i++) {
+        if (name == kSeasons[i]) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+int findMealTime(const std::string& name) {
+    for (size_t i = 0; i < kMealTimes.size(); i++) {
+        if (name == kMealTimes[i]) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+} // namespace MealPeriod
+} // namespace WisdomRestaurant
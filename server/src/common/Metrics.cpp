@@ -0,0 +1,284 @@
+#include "common/Metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace WisdomRestaurant {
+
+size_t currentMetricShard() {
+    static std::atomic<size_t> next_shard(0);
+    thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % kMetricShards;
+    return shard;
+}
+
+// 标签值中的反斜杠、双引号和换行需要转义
+static void appendEscaped(std::string& out, const std::string& value) {
+    for (char c : value) {
+        if (c == '\\') {
+            out += "\\\\";
+        } else if (c == '"') {
+            out += "\\\"";
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+}
+
+static void appendLabels(std::string& out, const MetricLabels& labels, const char* extra_name = nullptr,
+                         const std::string& extra_value = std::string()) {
+    if (labels.empty() && !extra_name) {
+        return;
+    }
+    out += '{';
+    bool first = true;
+    for (const auto& label : labels) {
+        if (!first) out += ',';
+        first = false;
+        out += label.first;
+        out += "=\"";
+        appendEscaped(out, label.second);
+        out += '"';
+    }
+    if (extra_name) {
+        if (!first) out += ',';
+        out += extra_name;
+        out += "=\"";
+        out += extra_value;
+        out += '"';
+    }
+    out += '}';
+}
+
+static std::string formatNumber(double value) {
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    char buffer[32];
+    if (value == std::floor(value) && std::fabs(value) < 1e15) {
+        std::snprintf(buffer, sizeof(buffer), "%.0f", value);
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+    }
+    return buffer;
+}
+
+static double bitsToDouble(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint64_t doubleToBits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+Counter::Counter() {
+    for (auto& shard : shards_) {
+        shard.value.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const auto& shard : shards_) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+Histogram::Histogram(std::vector<double> bounds)
+    : bounds_(std::move(bounds)) {
+    std::sort(bounds_.begin(), bounds_.end());
+    shards_.reserve(kMetricShards);
+    for (size_t i = 0; i < kMetricShards; i++) {
+        shards_.push_back(std::make_unique<Shard>(bounds_.size() + 1));
+    }
+}
+
+void Histogram::observe(double value) {
+    size_t bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+    Shard& shard = *shards_[currentMetricShard()];
+    shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    // 同一分片通常只有一个线程写入，CAS基本不会重试
+    uint64_t old_bits = shard.sum_bits.load(std::memory_order_relaxed);
+    while (!shard.sum_bits.compare_exchange_weak(old_bits, doubleToBits(bitsToDouble(old_bits) + value),
+                                                 std::memory_order_relaxed)) {
+    }
+}
+
+HistogramSnapshot Histogram::snapshot() const {
+    HistogramSnapshot snapshot;
+    snapshot.bounds = bounds_;
+    snapshot.counts.assign(bounds_.size() + 1, 0);
+    snapshot.count = 0;
+    snapshot.sum = 0;
+    for (const auto& shard : shards_) {
+        for (size_t i = 0; i < shard->buckets.size(); i++) {
+            snapshot.counts[i] += shard->buckets[i].load(std::memory_order_relaxed);
+        }
+        snapshot.sum += bitsToDouble(shard->sum_bits.load(std::memory_order_relaxed));
+    }
+    // count由桶计数汇总，与+Inf桶保持一致
+    for (uint64_t count : snapshot.counts) {
+        snapshot.count += count;
+    }
+    return snapshot;
+}
+
+const std::vector<double>& Histogram::defaultLatencyBounds() {
+    static const std::vector<double> bounds = {
+        0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2, 3, 5, 8, 12, 20, 30, 60
+    };
+    return bounds;
+}
+
+MetricsWriter::Family& MetricsWriter::family(const std::string& name, const std::string& help, const char* type) {
+    auto it = index_.find(name);
+    if (it != index_.end()) {
+        return families_[it->second];
+    }
+    index_[name] = families_.size();
+    families_.push_back(Family{name, help, type, std::string()});
+    return families_.back();
+}
+
+void MetricsWriter::counter(const std::string& name, const std::string& help, const MetricLabels& labels, double value) {
+    Family& f = family(name, help, "counter");
+    f.samples += name;
+    appendLabels(f.samples, labels);
+    f.samples += ' ';
+    f.samples += formatNumber(value);
+    f.samples += '\n';
+}
+
+void MetricsWriter::gauge(const std::string& name, const std::string& help, const MetricLabels& labels, double value) {
+    Family& f = family(name, help, "gauge");
+    f.samples += name;
+    appendLabels(f.samples, labels);
+    f.samples += ' ';
+    f.samples += formatNumber(value);
+    f.samples += '\n';
+}
+
+void MetricsWriter::histogram(const std::string& name, const std::string& help, const MetricLabels& labels,
+                              const HistogramSnapshot& snapshot) {
+    Family& f = family(name, help, "histogram");
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < snapshot.counts.size(); i++) {
+        cumulative += snapshot.counts[i];
+        std::string le = i < snapshot.bounds.size() ? formatNumber(snapshot.bounds[i]) : "+Inf";
+        f.samples += name;
+        f.samples += "_bucket";
+        appendLabels(f.samples, labels, "le", le);
+        f.samples += ' ';
+        f.samples += std::to_string(cumulative);
+        f.samples += '\n';
+    }
+    f.samples += name;
+    f.samples += "_sum";
+    appendLabels(f.samples, labels);
+    f.samples += ' ';
+    f.samples += formatNumber(snapshot.sum);
+    f.samples += '\n';
+    f.samples += name;
+    f.samples += "_count";
+    appendLabels(f.samples, labels);
+    f.samples += ' ';
+    f.samples += std::to_string(snapshot.count);
+    f.samples += '\n';
+}
+
+std::string MetricsWriter::str() const {
+    std::string out;
+    for (const auto& f : families_) {
+        out += "# HELP " + f.name + " " + f.help + "\n";
+        out += "# TYPE " + f.name + " " + f.type + "\n";
+        out += f.samples;
+    }
+    return out;
+}
+
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+std::string MetricsRegistry::makeKey(const std::string& name, const MetricLabels& labels) {
+    std::string key = name;
+    appendLabels(key, labels);
+    return key;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const MetricLabels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string key = makeKey(name, labels);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        return *static_cast<Counter*>(it->second);
+    }
+    counters_.push_back(Entry<Counter>{name, help, labels, std::make_unique<Counter>()});
+    index_[key] = counters_.back().metric.get();
+    return *counters_.back().metric;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const MetricLabels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string key = makeKey(name, labels);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        return *static_cast<Gauge*>(it->second);
+    }
+    gauges_.push_back(Entry<Gauge>{name, help, labels, std::make_unique<Gauge>()});
+    index_[key] = gauges_.back().metric.get();
+    return *gauges_.back().metric;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, const MetricLabels& labels,
+                                      const std::vector<double>& bounds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string key = makeKey(name, labels);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        return *static_cast<Histogram*>(it->second);
+    }
+    histograms_.push_back(Entry<Histogram>{name, help, labels, std::make_unique<Histogram>(bounds)});
+    index_[key] = histograms_.back().metric.get();
+    return *histograms_.back().metric;
+}
+
+void MetricsRegistry::addCollector(Collector collector) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    collectors_.push_back(std::move(collector));
+}
+
+std::string MetricsRegistry::render() const {
+    MetricsWriter writer;
+    std::vector<Collector> collectors;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& entry : counters_) {
+            writer.counter(entry.name, entry.help, entry.labels, static_cast<double>(entry.metric->value()));
+        }
+        for (const auto& entry : gauges_) {
+            writer.gauge(entry.name, entry.help, entry.labels, static_cast<double>(entry.metric->value()));
+        }
+        for (const auto& entry : histograms_) {
+            writer.histogram(entry.name, entry.help, entry.labels, entry.metric->snapshot());
+        }
+        collectors = collectors_;
+    }
+
+    // 回调可能获取其他模块的锁，不在注册表锁内调用
+    for (const auto& collector : collectors) {
+        collector(writer);
+    }
+    return writer.str();
+}
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,53 @@
+#include "common/PeriodicTask.h"
+
+namespace WisdomRestaurant {
+
+PeriodicTask::PeriodicTask(std::chrono::milliseconds interval, std::function<void()> task)
+    : interval_(interval)
+    , task_(std::move(task))
+    , stopping_(false) {
+}
+
+PeriodicTask::~PeriodicTask() {
+    stop();
+}
+
+void PeriodicTask::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_ || thread_.joinable()) {
+        return;
+    }
+    thread_ = std::thread(&PeriodicTask::loop, this);
+}
+
+void PeriodicTask::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    } else {
+        task_();
+    }
+}
+
+void PeriodicTask::loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait_for(lock, interval_, [this] { return stopping_; });
+        bool last = stopping_;
+        lock.unlock();
+        task_();
+        if (last) {
+            return;
+        }
+        lock.lock();
+    }
+}
+
+} // namespace WisdomRestaurant
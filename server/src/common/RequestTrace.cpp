@@ -0,0 +1,154 @@
+#include "common/RequestTrace.h"
+#include "loguru.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+
+namespace WisdomRestaurant {
+
+static std::atomic<double> g_sample_rate(1.0);
+static std::atomic<double> g_slow_threshold_ms(0.0);
+
+static thread_local std::shared_ptr<RequestTrace> t_current_trace;
+
+// 每个线程一个随机数生成器，生成ID和采样判断都不加锁
+static std::mt19937_64& traceRandom() {
+    thread_local std::mt19937_64 rng([] {
+        std::random_device device;
+        uint64_t seed = (static_cast<uint64_t>(device()) << 32) ^ device();
+        seed ^= std::hash<std::thread::id>()(std::this_thread::get_id());
+        seed ^= static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+        return seed;
+    }());
+    return rng;
+}
+
+// 客户端传入的ID会写进响应头和日志，只接受长度有限的字母、数字和 - _ . :
+static bool isValidRequestId(const std::string& id) {
+    if (id.empty() || id.size() > 64) {
+        return false;
+    }
+    for (char c : id) {
+        bool ok = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                  c == '-' || c == '_' || c == '.' || c == ':';
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+RequestTrace::RequestTrace(std::string id, std::string name, bool sampled)
+    : id_(std::move(id))
+    , name_(std::move(name))
+    , sampled_(sampled)
+    , start_(std::chrono::steady_clock::now())
+    , status_(0) {
+}
+
+RequestTrace::~RequestTrace() {
+    double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+    double slow_ms = g_slow_threshold_ms.load(std::memory_order_relaxed);
+    if (!sampled_ && !(slow_ms > 0.0 && total_ms >= slow_ms)) {
+        return;
+    }
+
+    // 一行紧凑的span日志：trace=ID 请求 status=状态码 total=总耗时 阶段=耗时[/次数]...
+    std::string line = "trace=" + id_ + " " + name_ + " status=" + std::to_string(status_);
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), " total=%.2fms", total_ms);
+    line += buffer;
+    for (const Span& span : spans_) {
+        if (span.count > 1) {
+            std::snprintf(buffer, sizeof(buffer), " %s=%.2fms/%u", span.name, span.total_ms, span.count);
+        } else {
+            std::snprintf(buffer, sizeof(buffer), " %s=%.2fms", span.name, span.total_ms);
+        }
+        line += buffer;
+    }
+    LOG_F(INFO, "%s", line.c_str());
+}
+
+std::shared_ptr<RequestTrace> RequestTrace::start(const std::string& request_id, std::string name) {
+    std::mt19937_64& rng = traceRandom();
+
+    std::string id = request_id;
+    if (!isValidRequestId(id)) {
+        char buffer[17];
+        std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(rng()));
+        id = buffer;
+    }
+
+    double rate = g_sample_rate.load(std::memory_order_relaxed);
+    bool sampled = rate >= 1.0 ||
+                   (rate > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(rng) < rate);
+    return std::make_shared<RequestTrace>(std::move(id), std::move(name), sampled);
+}
+
+void RequestTrace::setSampleRate(double rate) {
+    g_sample_rate.store(rate < 0.0 ? 0.0 : (rate > 1.0 ? 1.0 : rate), std::memory_order_relaxed);
+}
+
+void RequestTrace::setSlowThreshold(double slow_ms) {
+    g_slow_threshold_ms.store(slow_ms < 0.0 ? 0.0 : slow_ms, std::memory_order_relaxed);
+}
+
+RequestTrace* RequestTrace::current() {
+    return t_current_trace.get();
+}
+
+std::shared_ptr<RequestTrace> RequestTrace::currentShared() {
+    return t_current_trace;
+}
+
+std::shared_ptr<RequestTrace> RequestTrace::setCurrent(std::shared_ptr<RequestTrace> trace) {
+    std::shared_ptr<RequestTrace> previous = std::move(t_current_trace);
+    t_current_trace = std::move(trace);
+    return previous;
+}
+
+void RequestTrace::addSpan(const char* name, std::chrono::steady_clock::duration elapsed) {
+    double ms = std::chrono::duration<double, std::milli>(elapsed).count();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Span& span : spans_) {
+        if (span.name == name || std::strcmp(span.name, name) == 0) {
+            span.total_ms += ms;
+            span.count++;
+            return;
+        }
+    }
+    spans_.push_back(Span{name, ms, 1});
+}
+
+void RequestTrace::setStatus(int status) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    status_ = status;
+}
+
+std::string RequestTrace::serverTiming() const {
+    std::string value;
+    char buffer[64];
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const Span& span : spans_) {
+            std::snprintf(buffer, sizeof(buffer), "%s;dur=%.2f, ", span.name, span.total_ms);
+            value += buffer;
+        }
+    }
+    double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+    std::snprintf(buffer, sizeof(buffer), "total;dur=%.2f", total_ms);
+    value += buffer;
+    return value;
+}
+
+StageTimer::~StageTimer() {
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+    histogram_.observe(std::chrono::duration<double>(elapsed).count());
+    if (RequestTrace* trace = RequestTrace::current()) {
+        trace->addSpan(stage_, elapsed);
+    }
+}
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,87 @@
+#include "common/UtcTime.h"
+#include <cstdio>
+
+namespace WisdomRestaurant {
+namespace UtcTime {
+
+// Howard Hinnant的算法
+int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+void civilFromDays(int64_t z, int64_t& y, unsigned& m, unsigned& d) {
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<int64_t>(yoe) + era * 400 + (m <= 2);
+}
+
+// 拆分为天数和当天的秒数，负数时间向下取整
+static void splitSeconds(std::chrono::system_clock::time_point time, int64_t& days, int64_t& rem) {
+    int64_t seconds = std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+    days = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+    rem = seconds - days * 86400;
+}
+
+std::string format(std::chrono::system_clock::time_point time) {
+    int64_t days, rem;
+    splitSeconds(time, days, rem);
+    int64_t year;
+    unsigned month, day;
+    civilFromDays(days, year, month, day);
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%04lld-%02u-%02u %02lld:%02lld:%02lld", static_cast<long long>(year),
+                  month, day, static_cast<long long>(rem / 3600), static_cast<long long>(rem / 60 % 60),
+                  static_cast<long long>(rem % 60));
+    return buffer;
+}
+
+bool parse(const std::string& text, std::chrono::system_clock::time_point& time) {
+    int year, month, day, hour, minute, second;
+    if (std::sscanf(text.c_str(), "%d-%d-%d %d:%d:%d", &year, &month, &day, &hour, &minute, &second) != 6) {
+        return false;
+    }
+    int64_t seconds = daysFromCivil(year, static_cast<unsigned>(month), static_cast<unsigned>(day)) * 86400 +
+                      hour * 3600 + minute * 60 + second;
+    time = std::chrono::system_clock::time_point(std::chrono::seconds(seconds));
+    return true;
+}
+
+std::string formatDate(std::chrono::system_clock::time_point time) {
+    int64_t days, rem;
+    splitSeconds(time, days, rem);
+    return dateFromDays(days);
+}
+
+bool parseDate(const std::string& text, int64_t& days) {
+    int year, month, day;
+    char tail;
+    if (std::sscanf(text.c_str(), "%4d-%2d-%2d%c", &year, &month, &day, &tail) != 3 || month < 1 || month > 12 ||
+        day < 1 || day > 31) {
+        return false;
+    }
+    days = daysFromCivil(year, static_cast<unsigned>(month), static_cast<unsigned>(day));
+    return true;
+}
+
+std::string dateFromDays(int64_t days) {
+    int64_t year;
+    unsigned month, day;
+    civilFromDays(days, year, month, day);
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%04lld-%02u-%02u", static_cast<long long>(year), month, day);
+    return buffer;
+}
+
+} // namespace UtcTime
+} // namespace WisdomRestaurant
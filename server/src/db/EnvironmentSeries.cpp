@@ -0,0 +1,510 @@
+#include "db/EnvironmentSeries.h"
+#include <algorithm>
+#include <cmath>
+#include <loguru.hpp>
+
+namespace WisdomRestaurant {
+
+constexpr std::array<int, 3> EnvironmentSeries::kResolutions;
+constexpr int EnvironmentSeries::kBlockBuckets;
+
+static const char* kMetricNames[kEnvironmentMetricCount] = {"temperature", "light_intensity", "humidity", "noise_level"};
+
+// 块内数值以0.01为单位的定点数保存
+static const double kFixedPointScale = 100.0;
+
+// 块格式版本，格式变化时递增
+static const uint64_t kBlockFormatVersion = 1;
+
+const char* environmentMetricName(EnvironmentMetric metric) {
+    return kMetricNames[static_cast<size_t>(metric)];
+}
+
+bool parseEnvironmentMetric(const std::string& name, EnvironmentMetric& metric) {
+    for (size_t i = 0; i < kEnvironmentMetricCount; i++) {
+        if (name == kMetricNames[i]) {
+            metric = static_cast<EnvironmentMetric>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void EnvironmentAggregate::add(double value) {
+    if (count == 0) {
+        min = value;
+        max = value;
+    } else {
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+    sum += value;
+    count++;
+}
+
+void EnvironmentAggregate::merge(const EnvironmentAggregate& other) {
+    if (other.count == 0) {
+        return;
+    }
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    sum += other.sum;
+    count += other.count;
+}
+
+// ---- 变长整数编码 ----
+
+static void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+static bool getVarint(const std::string& data, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < data.size(); shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(data[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 有符号差值先做zigzag变换，绝对值小的负数也只占一个字节
+static uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+static int64_t toFixed(double value) {
+    return static_cast<int64_t>(std::llround(value * kFixedPointScale));
+}
+
+// 块的列式编码：
+//   版本, 桶数, slot差分列,
+//   每个指标依次为 count列, 以及count>0的桶的 min差分列(zigzag), max-min列, 均值-min列
+// 相邻桶的数值接近，差分后绝大多数只占1~2个字节
+std::string EnvironmentSeries::encodeBlock(const std::vector<Bucket>& buckets) {
+    std::string out;
+    out.reserve(16 + buckets.size() * (1 + kEnvironmentMetricCount * 5));
+    putVarint(out, kBlockFormatVersion);
+    putVarint(out, buckets.size());
+
+    uint16_t previous_slot = 0;
+    for (const Bucket& bucket : buckets) {
+        putVarint(out, static_cast<uint64_t>(bucket.slot - previous_slot));
+        previous_slot = bucket.slot;
+    }
+
+    for (size_t m = 0; m < kEnvironmentMetricCount; m++) {
+        for (const Bucket& bucket : buckets) {
+            putVarint(out, bucket.metrics[m].count);
+        }
+        int64_t previous_min = 0;
+        for (const Bucket& bucket : buckets) {
+            if (bucket.metrics[m].count > 0) {
+                int64_t min = toFixed(bucket.metrics[m].min);
+                putVarint(out, zigzag(min - previous_min));
+                previous_min = min;
+            }
+        }
+        for (const Bucket& bucket : buckets) {
+            const EnvironmentAggregate& aggregate = bucket.metrics[m];
+            if (aggregate.count > 0) {
+                putVarint(out, static_cast<uint64_t>(toFixed(aggregate.max) - toFixed(aggregate.min)));
+            }
+        }
+        for (const Bucket& bucket : buckets) {
+            const EnvironmentAggregate& aggregate = bucket.metrics[m];
+            if (aggregate.count > 0) {
+                // 浮点误差可能使均值略小于最小值
+                int64_t offset = toFixed(aggregate.sum / aggregate.count) - toFixed(aggregate.min);
+                putVarint(out, static_cast<uint64_t>(std::max<int64_t>(offset, 0)));
+            }
+        }
+    }
+    return out;
+}
+
+bool EnvironmentSeries::decodeBlock(const std::string& data, std::vector<Bucket>& buckets) {
+    size_t pos = 0;
+    uint64_t version, count;
+    if (!getVarint(data, pos, version) || version != kBlockFormatVersion ||
+        !getVarint(data, pos, count) || count > static_cast<uint64_t>(kBlockBuckets)) {
+        return false;
+    }
+
+    buckets.assign(static_cast<size_t>(count), Bucket());
+    uint64_t slot = 0;
+    for (Bucket& bucket : buckets) {
+        uint64_t delta;
+        if (!getVarint(data, pos, delta)) {
+            return false;
+        }
+        slot += delta;
+        if (slot >= static_cast<uint64_t>(kBlockBuckets)) {
+            return false;
+        }
+        bucket.slot = static_cast<uint16_t>(slot);
+    }
+
+    for (size_t m = 0; m < kEnvironmentMetricCount; m++) {
+        for (Bucket& bucket : buckets) {
+            uint64_t n;
+            if (!getVarint(data, pos, n)) {
+                return false;
+            }
+            bucket.metrics[m].count = static_cast<uint32_t>(n);
+        }
+        int64_t min = 0;
+        for (Bucket& bucket : buckets) {
+            uint64_t value;
+            if (bucket.metrics[m].count > 0) {
+                if (!getVarint(data, pos, value)) {
+                    return false;
+                }
+                min += unzigzag(value);
+                bucket.metrics[m].min = min / kFixedPointScale;
+            }
+        }
+        for (Bucket& bucket : buckets) {
+            uint64_t value;
+            if (bucket.metrics[m].count > 0) {
+                if (!getVarint(data, pos, value)) {
+                    return false;
+                }
+                bucket.metrics[m].max = bucket.metrics[m].min + static_cast<double>(value) / kFixedPointScale;
+            }
+        }
+        for (Bucket& bucket : buckets) {
+            uint64_t value;
+            EnvironmentAggregate& aggregate = bucket.metrics[m];
+            if (aggregate.count > 0) {
+                if (!getVarint(data, pos, value)) {
+                    return false;
+                }
+                aggregate.sum = (aggregate.min + static_cast<double>(value) / kFixedPointScale) * aggregate.count;
+            }
+        }
+    }
+    return pos == data.size();
+}
+
+// ---- EnvironmentSeries ----
+
+static int64_t blockSpan(int resolution) {
+    return static_cast<int64_t>(resolution) * EnvironmentSeries::kBlockBuckets;
+}
+
+static int64_t unixNow() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+EnvironmentSeries::EnvironmentSeries(std::shared_ptr<RestaurantDb> db, const EnvironmentSeriesOptions& options)
+    : db_(db)
+    , options_(options)
+    , last_prune_()
+    , samples_(0)
+    , rejected_(0)
+    , blocks_written_(0)
+    , bytes_written_(0)
+    , flush_failures_(0)
+    , flusher_(options.flush_interval, [this] { periodicFlush(); }) {
+    if (options_.raw_capacity == 0) {
+        options_.raw_capacity = 1;
+    }
+}
+
+EnvironmentSeries::~EnvironmentSeries() {
+    shutdown();
+}
+
+bool EnvironmentSeries::initialize() {
+    // 恢复重启前尚未结束的块，之后的样本在其上继续累加，不会覆盖已写入的部分
+    int64_t now = unixNow();
+    size_t restored = 0;
+    for (int resolution : kResolutions) {
+        int64_t span = blockSpan(resolution);
+        int64_t since = (now - options_.max_lateness_seconds) / span * span;
+        for (const EnvironmentRollupBlock& row : db_->getRecentEnvironmentBlocks(resolution, since)) {
+            Block block;
+            if (!decodeBlock(row.data, block.buckets)) {
+                LOG_F(WARNING, "环境数据块损坏: 餐桌 %d, 粒度 %ds, 起始 %lld", row.table_id, resolution,
+                      static_cast<long long>(row.block_start));
+                continue;
+            }
+            TableSeries& table = tableFor(row.table_id);
+            std::lock_guard<std::mutex> lock(table.mutex);
+            table.blocks[std::make_pair(resolution, row.block_start)] = std::move(block);
+            restored++;
+        }
+    }
+
+    pruneExpired();
+    flusher_.start();
+    LOG_F(INFO, "环境时序: 恢复 %zu 个未结束的汇总块, 每 %lldms 写入一次", restored,
+          static_cast<long long>(options_.flush_interval.count()));
+    return true;
+}
+
+EnvironmentSeries::TableSeries& EnvironmentSeries::tableFor(int table_id) {
+    {
+        std::shared_lock<std::shared_mutex> lock(tables_mutex_);
+        auto it = tables_.find(table_id);
+        if (it != tables_.end()) {
+            return *it->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(tables_mutex_);
+    std::unique_ptr<TableSeries>& table = tables_[table_id];
+    if (!table) {
+        table = std::make_unique<TableSeries>();
+        table->raw.reserve(options_.raw_capacity);
+    }
+    return *table;
+}
+
+const EnvironmentSeries::TableSeries* EnvironmentSeries::findTable(int table_id) const {
+    std::shared_lock<std::shared_mutex> lock(tables_mutex_);
+    auto it = tables_.find(table_id);
+    return it != tables_.end() ? it->second.get() : nullptr;
+}
+
+void EnvironmentSeries::addToBlock(Block& block, uint16_t slot, const EnvironmentSample& sample) {
+    // 样本基本按时间顺序到达，绝大多数落在最后一个桶或追加新桶
+    std::vector<Bucket>& buckets = block.buckets;
+    auto it = buckets.end();
+    if (buckets.empty() || buckets.back().slot < slot) {
+        it = buckets.insert(buckets.end(), Bucket{slot, {}});
+    } else if (buckets.back().slot == slot) {
+        it = buckets.end() - 1;
+    } else {
+        it = std::lower_bound(buckets.begin(), buckets.end(), slot, [](const Bucket& bucket, uint16_t value) {
+            return bucket.slot < value;
+        });
+        if (it == buckets.end() || it->slot != slot) {
+            it = buckets.insert(it, Bucket{slot, {}});
+        }
+    }
+
+    for (size_t m = 0; m < kEnvironmentMetricCount; m++) {
+        if (!std::isnan(sample.values[m])) {
+            it->metrics[m].add(sample.values[m]);
+        }
+    }
+    block.dirty = true;
+}
+
+bool EnvironmentSeries::record(int table_id, const EnvironmentSample& sample) {
+    int64_t now = unixNow();
+    if (sample.timestamp < now - options_.max_lateness_seconds || sample.timestamp > now + 60) {
+        rejected_++;
+        return false;
+    }
+    samples_++;
+
+    TableSeries& table = tableFor(table_id);
+    std::lock_guard<std::mutex> lock(table.mutex);
+    if (table.raw.size() < options_.raw_capacity) {
+        table.raw.push_back(sample);
+    } else {
+        table.raw[table.raw_next] = sample;
+    }
+    table.raw_next = (table.raw_next + 1) % options_.raw_capacity;
+
+    for (int resolution : kResolutions) {
+        int64_t span = blockSpan(resolution);
+        int64_t start = sample.timestamp / span * span;
+        uint16_t slot = static_cast<uint16_t>((sample.timestamp - start) / resolution);
+        addToBlock(table.blocks[std::make_pair(resolution, start)], slot, sample);
+    }
+    return true;
+}
+
+std::vector<EnvironmentPoint> EnvironmentSeries::query(int table_id, int64_t from, int64_t to, int& resolution) const {
+    std::vector<EnvironmentPoint> points;
+    if (to <= from) {
+        return points;
+    }
+    if (resolution < 0) {
+        resolution = kResolutions.back();
+        for (int candidate : kResolutions) {
+            if (static_cast<size_t>((to - from) / candidate) <= options_.max_points) {
+                resolution = candidate;
+                break;
+            }
+        }
+    }
+    const TableSeries* table = findTable(table_id);
+
+    // 原始样本只在内存中
+    if (resolution == 0) {
+        if (!table) {
+            return points;
+        }
+        {
+            std::lock_guard<std::mutex> lock(table->mutex);
+            for (const EnvironmentSample& sample : table->raw) {
+                if (sample.timestamp >= from && sample.timestamp < to) {
+                    EnvironmentPoint point{sample.timestamp, {}};
+                    for (size_t m = 0; m < kEnvironmentMetricCount; m++) {
+                        if (!std::isnan(sample.values[m])) {
+                            point.metrics[m].add(sample.values[m]);
+                        }
+                    }
+                    points.push_back(point);
+                }
+            }
+        }
+        std::stable_sort(points.begin(), points.end(), [](const EnvironmentPoint& a, const EnvironmentPoint& b) {
+            return a.timestamp < b.timestamp;
+        });
+        return points;
+    }
+
+    // 覆盖查询范围的块：内存中的块最新，其余从数据库读取
+    int64_t span = blockSpan(resolution);
+    int64_t first_block = from / span * span;
+    int64_t last_block = (to - 1) / span * span;
+    std::map<int64_t, std::vector<Bucket>> blocks;
+    if (table) {
+        std::lock_guard<std::mutex> lock(table->mutex);
+        auto it = table->blocks.lower_bound(std::make_pair(resolution, first_block));
+        for (; it != table->blocks.end() && it->first.first == resolution && it->first.second <= last_block; ++it) {
+            blocks[it->first.second] = it->second.buckets;
+        }
+    }
+    for (const EnvironmentRollupBlock& row : db_->getEnvironmentBlocks(table_id, resolution, first_block, last_block)) {
+        if (blocks.count(row.block_start)) {
+            continue;
+        }
+        std::vector<Bucket> buckets;
+        if (decodeBlock(row.data, buckets)) {
+            blocks[row.block_start] = std::move(buckets);
+        }
+    }
+
+    for (const auto& block : blocks) {
+        for (const Bucket& bucket : block.second) {
+            int64_t timestamp = block.first + static_cast<int64_t>(bucket.slot) * resolution;
+            if (timestamp + resolution > from && timestamp < to) {
+                points.push_back(EnvironmentPoint{timestamp, bucket.metrics});
+            }
+        }
+    }
+    return points;
+}
+
+bool EnvironmentSeries::flush() {
+    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+
+    std::vector<std::pair<int, TableSeries*>> tables;
+    {
+        std::shared_lock<std::shared_mutex> lock(tables_mutex_);
+        tables.reserve(tables_.size());
+        for (auto& item : tables_) {
+            tables.emplace_back(item.first, item.second.get());
+        }
+    }
+
+    // 取出变化的块并编码；块在本次写入前再次变化时dirty会被重新置位
+    std::vector<EnvironmentRollupBlock> rows;
+    for (const auto& item : tables) {
+        std::lock_guard<std::mutex> lock(item.second->mutex);
+        for (auto& block : item.second->blocks) {
+            if (!block.second.dirty) {
+                continue;
+            }
+            block.second.dirty = false;
+            rows.push_back(EnvironmentRollupBlock{item.first, block.first.first, block.first.second,
+                                                  static_cast<int>(block.second.buckets.size()),
+                                                  encodeBlock(block.second.buckets)});
+        }
+    }
+
+    bool ok = db_->saveEnvironmentBlocks(rows);
+    if (ok) {
+        blocks_written_ += rows.size();
+        for (const auto& row : rows) {
+            bytes_written_ += row.data.size();
+        }
+    } else {
+        flush_failures_++;
+    }
+
+    // 失败的块重新标记为待写入；已写入且不会再收到样本的块移出内存
+    int64_t now = unixNow();
+    size_t row_index = 0;
+    for (const auto& item : tables) {
+        std::lock_guard<std::mutex> lock(item.second->mutex);
+        for (; !ok && row_index < rows.size() && rows[row_index].table_id == item.first; row_index++) {
+            auto it = item.second->blocks.find(std::make_pair(rows[row_index].resolution, rows[row_index].block_start));
+            if (it != item.second->blocks.end()) {
+                it->second.dirty = true;
+            }
+        }
+        for (auto it = item.second->blocks.begin(); it != item.second->blocks.end();) {
+            int64_t block_end = it->first.second + blockSpan(it->first.first);
+            if (!it->second.dirty && block_end + options_.max_lateness_seconds < now) {
+                it = item.second->blocks.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    return ok;
+}
+
+void EnvironmentSeries::pruneExpired() {
+    int64_t now = unixNow();
+    for (size_t i = 0; i < kResolutions.size(); i++) {
+        if (options_.retention_days[i] > 0) {
+            db_->pruneEnvironmentBlocks(kResolutions[i], now - static_cast<int64_t>(options_.retention_days[i]) * 86400);
+        }
+    }
+    last_prune_ = std::chrono::steady_clock::now();
+}
+
+void EnvironmentSeries::shutdown() {
+    flusher_.stop();
+}
+
+EnvironmentSeriesStats EnvironmentSeries::getStats() const {
+    EnvironmentSeriesStats stats;
+    stats.resident_blocks = 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(tables_mutex_);
+        stats.tables = tables_.size();
+        for (const auto& item : tables_) {
+            std::lock_guard<std::mutex> table_lock(item.second->mutex);
+            stats.resident_blocks += item.second->blocks.size();
+        }
+    }
+    stats.samples = samples_.load();
+    stats.rejected = rejected_.load();
+    stats.blocks_written = blocks_written_.load();
+    stats.bytes_written = bytes_written_.load();
+    stats.flush_failures = flush_failures_.load();
+    return stats;
+}
+
+void EnvironmentSeries::periodicFlush() {
+    flush();
+    if (std::chrono::steady_clock::now() - last_prune_ > std::chrono::hours(1)) {
+        pruneExpired();
+    }
+}
+
+} // namespace WisdomRestaurant
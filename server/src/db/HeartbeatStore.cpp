@@ -0,0 +1,256 @@
+#include "db/HeartbeatStore.h"
+#include "common/UtcTime.h"
+#include <algorithm>
+#include <functional>
+#include <loguru.hpp>
+
+namespace WisdomRestaurant {
+
+// 除心跳时间外的设备状态是否相同
+static bool sameDeviceState(const ClientHeartbeat& a, const ClientHeartbeat& b) {
+    return a.temperature == b.temperature && a.light_intensity == b.light_intensity &&
+           a.humidity == b.humidity && a.noise_level == b.noise_level &&
+           a.battery_level == b.battery_level && a.signal_strength == b.signal_strength &&
+           a.device_status == b.device_status;
+}
+
+HeartbeatStore::HeartbeatStore(std::shared_ptr<RestaurantDb> db, const HeartbeatStoreOptions& options)
+    : db_(db)
+    , options_(options)
+    , heartbeats_(0)
+    , rows_written_(0)
+    , flushes_(0)
+    , flush_failures_(0)
+    , expired_(0)
+    , flusher_(options.flush_interval, [this] { periodicFlush(); }) {
+}
+
+HeartbeatStore::~HeartbeatStore() {
+    shutdown();
+}
+
+std::string HeartbeatStore::makeKey(int table_id, const std::string& client_id) {
+    return std::to_string(table_id) + '\x1f' + client_id;
+}
+
+HeartbeatStore::Shard& HeartbeatStore::shardFor(const std::string& key) {
+    return shards_[std::hash<std::string>()(key) % kShardCount];
+}
+
+const HeartbeatStore::Shard& HeartbeatStore::shardFor(const std::string& key) const {
+    return shards_[std::hash<std::string>()(key) % kShardCount];
+}
+
+bool HeartbeatStore::initialize() {
+    size_t loaded = 0;
+    for (ClientHeartbeat& heartbeat : db_->getAllClientHeartbeats()) {
+        std::chrono::system_clock::time_point last_seen;
+        if (!UtcTime::parse(heartbeat.last_heartbeat, last_seen)) {
+            continue;
+        }
+        std::string key = makeKey(heartbeat.table_id, heartbeat.client_id);
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries[key] = Entry{std::move(heartbeat), last_seen, last_seen, false};
+        loaded++;
+    }
+
+    flusher_.start();
+    LOG_F(INFO, "心跳状态表: 加载 %zu 个客户端, 每 %lldms 写入一次", loaded,
+          static_cast<long long>(options_.flush_interval.count()));
+    return true;
+}
+
+bool HeartbeatStore::update(const ClientHeartbeat& heartbeat) {
+    auto now = std::chrono::system_clock::now();
+    std::string timestamp = UtcTime::format(now);
+    std::string key = makeKey(heartbeat.table_id, heartbeat.client_id);
+    heartbeats_++;
+
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(key);
+    if (it == shard.entries.end()) {
+        Entry entry{heartbeat, now, std::chrono::system_clock::time_point(), true};
+        entry.heartbeat.id = 0;
+        entry.heartbeat.last_heartbeat = timestamp;
+        entry.heartbeat.created_at = timestamp;
+        entry.heartbeat.updated_at = timestamp;
+        shard.entries.emplace(std::move(key), std::move(entry));
+        return true;
+    }
+
+    Entry& entry = it->second;
+    bool reconnected = now - entry.last_seen > std::chrono::seconds(options_.active_seconds);
+    if (!sameDeviceState(entry.heartbeat, heartbeat)) {
+        entry.dirty = true;
+    }
+    // 保留数据库分配的id和首次上线时间
+    int id = entry.heartbeat.id;
+    std::string created_at = std::move(entry.heartbeat.created_at);
+    entry.heartbeat = heartbeat;
+    entry.heartbeat.id = id;
+    entry.heartbeat.created_at = std::move(created_at);
+    entry.heartbeat.last_heartbeat = timestamp;
+    entry.heartbeat.updated_at = timestamp;
+    entry.last_seen = now;
+    return reconnected;
+}
+
+std::optional<ClientHeartbeat> HeartbeatStore::getClient(int table_id, const std::string& client_id) const {
+    std::string key = makeKey(table_id, client_id);
+    const Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(key);
+    if (it == shard.entries.end()) {
+        return std::nullopt;
+    }
+    return it->second.heartbeat;
+}
+
+std::vector<ClientHeartbeat> HeartbeatStore::getActiveClients(int timeout_seconds) const {
+    if (timeout_seconds <= 0) {
+        timeout_seconds = options_.active_seconds;
+    }
+    auto cutoff = std::chrono::system_clock::now() - std::chrono::seconds(timeout_seconds);
+
+    std::vector<std::pair<std::chrono::system_clock::time_point, ClientHeartbeat>> active;
+    for (const Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto& item : shard.entries) {
+            if (item.second.last_seen > cutoff) {
+                active.emplace_back(item.second.last_seen, item.second.heartbeat);
+            }
+        }
+    }
+    std::sort(active.begin(), active.end(), [](const auto& a, const auto& b) {
+        return a.first > b.first;
+    });
+
+    std::vector<ClientHeartbeat> clients;
+    clients.reserve(active.size());
+    for (auto& item : active) {
+        clients.push_back(std::move(item.second));
+    }
+    return clients;
+}
+
+size_t HeartbeatStore::cleanupInactiveClients(int timeout_seconds) {
+    auto cutoff = std::chrono::system_clock::now() - std::chrono::seconds(timeout_seconds);
+    std::vector<std::pair<int, std::string>> removed;
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+            if (it->second.last_seen < cutoff) {
+                removed.emplace_back(it->second.heartbeat.table_id, it->second.heartbeat.client_id);
+                it = shard.entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    if (!removed.empty()) {
+        expired_ += removed.size();
+        std::lock_guard<std::mutex> lock(mutex_);
+        removed_.insert(removed_.end(), removed.begin(), removed.end());
+    }
+    return removed.size();
+}
+
+bool HeartbeatStore::flush() {
+    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+
+    // 取出设备状态有变化、或心跳时间距上次写入超过touch_interval的客户端
+    struct Written {
+        std::string key;
+        std::chrono::system_clock::time_point seen;
+    };
+    std::vector<ClientHeartbeat> rows;
+    std::vector<Written> written;
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto& item : shard.entries) {
+            Entry& entry = item.second;
+            if (!entry.dirty && entry.last_seen - entry.persisted_seen < options_.touch_interval) {
+                continue;
+            }
+            entry.dirty = false;
+            rows.push_back(entry.heartbeat);
+            written.push_back(Written{item.first, entry.last_seen});
+        }
+    }
+
+    std::vector<std::pair<int, std::string>> removed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        removed.swap(removed_);
+    }
+    if (rows.empty() && removed.empty()) {
+        return true;
+    }
+
+    flushes_++;
+    bool ok = db_->saveClientHeartbeats(rows, removed);
+    for (const Written& item : written) {
+        Shard& shard = shardFor(item.key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(item.key);
+        if (it == shard.entries.end()) {
+            continue;
+        }
+        if (ok) {
+            it->second.persisted_seen = std::max(it->second.persisted_seen, item.seen);
+        } else {
+            it->second.dirty = true;
+        }
+    }
+
+    if (ok) {
+        rows_written_ += rows.size();
+    } else {
+        // 失败的变化留到下次重试
+        flush_failures_++;
+        std::lock_guard<std::mutex> lock(mutex_);
+        removed_.insert(removed_.end(), removed.begin(), removed.end());
+    }
+    return ok;
+}
+
+void HeartbeatStore::shutdown() {
+    flusher_.stop();
+}
+
+HeartbeatStoreStats HeartbeatStore::getStats() const {
+    HeartbeatStoreStats stats;
+    stats.clients = 0;
+    stats.active_clients = 0;
+    auto cutoff = std::chrono::system_clock::now() - std::chrono::seconds(options_.active_seconds);
+    for (const Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.clients += shard.entries.size();
+        for (const auto& item : shard.entries) {
+            if (item.second.last_seen > cutoff) {
+                stats.active_clients++;
+            }
+        }
+    }
+    stats.heartbeats = heartbeats_.load();
+    stats.rows_written = rows_written_.load();
+    stats.flushes = flushes_.load();
+    stats.flush_failures = flush_failures_.load();
+    stats.expired = expired_.load();
+    return stats;
+}
+
+void HeartbeatStore::periodicFlush() {
+    if (options_.expire_seconds > 0) {
+        size_t expired = cleanupInactiveClients(options_.expire_seconds);
+        if (expired > 0) {
+            LOG_F(INFO, "清理 %zu 个长时间无心跳的客户端", expired);
+        }
+    }
+    flush();
+}
+
+} // namespace WisdomRestaurant
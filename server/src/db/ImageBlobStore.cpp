@@ -0,0 +1,234 @@
+#include "db/ImageBlobStore.h"
+#include "common/Base64.h"
+#include "common/Sha256.h"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <loguru.hpp>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace WisdomRestaurant {
+
+// 哈希只能是64位小写十六进制，避免拼出存储目录之外的路径
+static bool isValidHash(const std::string& hash) {
+    if (hash.size() != 64) {
+        return false;
+    }
+    return std::all_of(hash.begin(), hash.end(), [](char c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+    });
+}
+
+ImageBlobStore::ImageBlobStore(const ImageBlobStoreOptions& options)
+    : options_(options)
+    , files_(0)
+    , bytes_(0)
+    , stored_(0)
+    , deduplicated_(0)
+    , pruned_(0)
+    , errors_(0)
+    , last_prune_(std::chrono::steady_clock::now())
+    , pruning_(false) {
+}
+
+bool ImageBlobStore::initialize() {
+    std::error_code ec;
+    fs::create_directories(options_.directory, ec);
+    if (ec) {
+        LOG_F(ERROR, "无法创建图片存储目录 %s: %s", options_.directory.c_str(), ec.message().c_str());
+        return false;
+    }
+
+    size_t removed = prune();
+    ImageBlobStoreStats stats = getStats();
+    LOG_F(INFO, "图片存储: %s, %llu 个文件, %.1f MB（清理 %zu 个）", options_.directory.c_str(),
+          static_cast<unsigned long long>(stats.files), stats.bytes / 1024.0 / 1024.0, removed);
+    return true;
+}
+
+std::string ImageBlobStore::pathFor(const std::string& hash) const {
+    return (fs::path(options_.directory) / hash.substr(0, 2) / hash).string();
+}
+
+std::string ImageBlobStore::put(const std::string& data, bool is_base64) {
+    std::string decoded;
+    const std::string* bytes = &data;
+    if (is_base64) {
+        if (!Base64::decode(data, decoded)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            errors_++;
+            return "";
+        }
+        bytes = &decoded;
+    }
+    if (bytes->empty()) {
+        return "";
+    }
+
+    std::string hash = Sha256::hex(*bytes);
+    fs::path path = pathFor(hash);
+    std::error_code ec;
+    if (fs::exists(path, ec)) {
+        // 相同画面再次出现，刷新修改时间以免被按时间清理
+        fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+        std::lock_guard<std::mutex> lock(mutex_);
+        deduplicated_++;
+        return hash;
+    }
+
+    // 先写临时文件再重命名，读者和并发写入者不会看到写了一半的文件
+    static std::atomic<uint64_t> temp_counter(0);
+    fs::create_directories(path.parent_path(), ec);
+    std::string temp_path = path.string() + ".tmp" + std::to_string(temp_counter.fetch_add(1));
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(bytes->data(), static_cast<std::streamsize>(bytes->size()));
+        out.close();
+        if (!out) {
+            fs::remove(temp_path, ec);
+            LOG_F(WARNING, "写入图片失败: %s", temp_path.c_str());
+            std::lock_guard<std::mutex> lock(mutex_);
+            errors_++;
+            return "";
+        }
+    }
+
+    fs::rename(temp_path, path, ec);
+    if (ec) {
+        fs::remove(temp_path, ec);
+        std::lock_guard<std::mutex> lock(mutex_);
+        // 另一个线程同时写入了相同内容
+        if (fs::exists(path, ec)) {
+            deduplicated_++;
+            return hash;
+        }
+        errors_++;
+        return "";
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        files_++;
+        bytes_ += bytes->size();
+        stored_++;
+    }
+    maybePrune();
+    return hash;
+}
+
+bool ImageBlobStore::get(const std::string& hash, std::string& out) const {
+    if (!isValidHash(hash)) {
+        return false;
+    }
+    std::ifstream in(pathFor(hash), std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+size_t ImageBlobStore::prune() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pruning_) {
+            return 0;
+        }
+        pruning_ = true;
+    }
+
+    struct BlobFile {
+        fs::file_time_type modified;
+        fs::path path;
+        uint64_t size;
+    };
+    std::vector<BlobFile> files;
+    uint64_t total_bytes = 0;
+    auto now = fs::file_time_type::clock::now();
+    size_t removed = 0;
+
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(options_.directory, ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec)) {
+            continue;
+        }
+        fs::file_time_type modified = it->last_write_time(ec);
+        uint64_t size = it->file_size(ec);
+        if (ec) {
+            ec.clear();
+            continue;
+        }
+        // 进程退出时遗留的临时文件
+        if (it->path().filename().string().find(".tmp") != std::string::npos) {
+            if (now - modified > std::chrono::hours(1) && fs::remove(it->path(), ec)) {
+                removed++;
+            }
+            continue;
+        }
+        files.push_back(BlobFile{modified, it->path(), size});
+        total_bytes += size;
+    }
+
+    // 从最久未出现的图片开始删除：先删过期的，再删到总大小上限的90%以下，避免每次写入都触发清理
+    std::sort(files.begin(), files.end(), [](const BlobFile& a, const BlobFile& b) {
+        return a.modified < b.modified;
+    });
+    auto cutoff = now - std::chrono::hours(24) * options_.retention_days;
+    uint64_t target_bytes = options_.max_bytes / 10 * 9;
+    size_t kept = files.size();
+    for (const auto& file : files) {
+        bool expired = options_.retention_days > 0 && file.modified < cutoff;
+        bool over_cap = options_.max_bytes > 0 && total_bytes > target_bytes;
+        if (!expired && !over_cap) {
+            break;
+        }
+        if (fs::remove(file.path, ec)) {
+            total_bytes -= file.size;
+            kept--;
+            removed++;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_ = kept;
+    bytes_ = total_bytes;
+    pruned_ += removed;
+    last_prune_ = std::chrono::steady_clock::now();
+    pruning_ = false;
+    return removed;
+}
+
+void ImageBlobStore::maybePrune() {
+    bool needed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool over_cap = options_.max_bytes > 0 && bytes_ > options_.max_bytes;
+        bool retention_due = options_.retention_days > 0 &&
+                             std::chrono::steady_clock::now() - last_prune_ > std::chrono::hours(1);
+        needed = !pruning_ && (over_cap || retention_due);
+    }
+    if (needed) {
+        size_t removed = prune();
+        if (removed > 0) {
+            LOG_F(INFO, "清理图片存储，删除 %zu 个文件", removed);
+        }
+    }
+}
+
+ImageBlobStoreStats ImageBlobStore::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ImageBlobStoreStats stats;
+    stats.files = files_;
+    stats.bytes = bytes_;
+    stats.stored = stored_;
+    stats.deduplicated = deduplicated_;
+    stats.pruned = pruned_;
+    stats.errors = errors_;
+    return stats;
+}
+
+} // namespace WisdomRestaurant
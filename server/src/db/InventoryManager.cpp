@@ -0,0 +1,395 @@
+#include "db/InventoryManager.h"
+#include "db/MenuCache.h"
+#include <algorithm>
+#include <map>
+#include <loguru.hpp>
+
+namespace WisdomRestaurant {
+
+// 按菜品汇总未取消订单项的份数
+static std::vector<std::pair<int, int>> orderQuantities(const std::vector<OrderItem>& items) {
+    std::map<int, int> totals;
+    for (const auto& item : items) {
+        if (item.item_status != "cancelled") {
+            totals[item.dish_id] += item.quantity;
+        }
+    }
+    return std::vector<std::pair<int, int>>(totals.begin(), totals.end());
+}
+
+InventoryManager::InventoryManager(std::shared_ptr<RestaurantDb> db, const InventoryOptions& options)
+    : db_(db)
+    , options_(options)
+    , counters_(std::make_shared<const CounterTable>())
+    , version_(0)
+    , sold_out_version_(0)
+    , next_reservation_(0)
+    , reserved_(0)
+    , rejected_(0)
+    , committed_(0)
+    , released_(0)
+    , expired_(0)
+    , rows_written_(0)
+    , flush_failures_(0)
+    , flusher_(options.flush_interval, [this] { periodicFlush(); }) {
+}
+
+InventoryManager::~InventoryManager() {
+    shutdown();
+}
+
+bool InventoryManager::initialize() {
+    auto snapshot = db_->getMenuSnapshot();
+    auto table = std::make_shared<CounterTable>();
+    for (size_t i = 0; i < snapshot->dishes.size(); i++) {
+        int stock = snapshot->stockCount(i);
+        auto counter = std::make_shared<Counter>();
+        counter->stock.store(stock);
+        counter->available.store(stock);
+        counter->persisted = stock;
+        (*table)[snapshot->dishes[i].id] = std::move(counter);
+    }
+    std::atomic_store(&counters_, std::shared_ptr<const CounterTable>(std::move(table)));
+
+    flusher_.start();
+    LOG_F(INFO, "库存管理: 加载 %zu 道菜, 售罄 %zu 道, 每 %lldms 写回一次, 预留 %llds 后过期",
+          snapshot->dishes.size(), getSoldOutDishes().size(), static_cast<long long>(options_.flush_interval.count()),
+          static_cast<long long>(options_.reservation_ttl.count()));
+    return true;
+}
+
+std::shared_ptr<InventoryManager::Counter> InventoryManager::counterFor(int dish_id) {
+    auto table = std::atomic_load(&counters_);
+    auto it = table->find(dish_id);
+    if (it != table->end()) {
+        return it->second;
+    }
+
+    std::lock_guard<std::mutex> lock(counters_mutex_);
+    table = std::atomic_load(&counters_);
+    it = table->find(dish_id);
+    if (it != table->end()) {
+        return it->second;
+    }
+    auto snapshot = db_->getMenuSnapshot();
+    auto index = snapshot->by_id.find(dish_id);
+    if (index == snapshot->by_id.end()) {
+        return nullptr;
+    }
+    int stock = snapshot->stockCount(index->second);
+    auto counter = std::make_shared<Counter>();
+    counter->stock.store(stock);
+    counter->available.store(stock);
+    counter->persisted = stock;
+    auto copy = std::make_shared<CounterTable>(*table);
+    (*copy)[dish_id] = counter;
+    std::atomic_store(&counters_, std::shared_ptr<const CounterTable>(std::move(copy)));
+    return counter;
+}
+
+bool InventoryManager::take(Counter& counter, int quantity) {
+    int current = counter.available.load(std::memory_order_relaxed);
+    while (current >= quantity) {
+        if (counter.available.compare_exchange_weak(current, current - quantity, std::memory_order_acq_rel,
+                                                    std::memory_order_relaxed)) {
+            noteAvailability(current, current - quantity);
+            version_.fetch_add(1, std::memory_order_release);
+            return true;
+        }
+    }
+    return false;
+}
+
+void InventoryManager::giveBack(Counter& counter, int quantity) {
+    int before = counter.available.fetch_add(quantity, std::memory_order_acq_rel);
+    noteAvailability(before, before + quantity);
+    version_.fetch_add(1, std::memory_order_release);
+}
+
+void InventoryManager::noteAvailability(int before, int after) {
+    if ((before <= 0) != (after <= 0)) {
+        sold_out_version_.fetch_add(1, std::memory_order_release);
+    }
+}
+
+InventoryResult InventoryManager::takeAll(const std::vector<std::pair<int, int>>& quantities) {
+    InventoryResult result;
+    std::vector<std::pair<std::shared_ptr<Counter>, int>> taken;
+    for (const auto& entry : quantities) {
+        std::shared_ptr<Counter> counter = entry.second > 0 ? counterFor(entry.first) : nullptr;
+        if (!counter || !take(*counter, entry.second)) {
+            result.status = entry.second <= 0 ? InventoryResult::Status::InvalidQuantity
+                          : !counter ? InventoryResult::Status::UnknownDish
+                          : InventoryResult::Status::SoldOut;
+            result.dish_id = entry.first;
+            break;
+        }
+        taken.emplace_back(std::move(counter), entry.second);
+    }
+    if (taken.size() != quantities.size()) {
+        for (const auto& entry : taken) {
+            giveBack(*entry.first, entry.second);
+        }
+        if (result.status == InventoryResult::Status::SoldOut) {
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return result;
+    }
+    result.status = InventoryResult::Status::Ok;
+    return result;
+}
+
+void InventoryManager::giveBackAll(const std::vector<std::pair<int, int>>& quantities) {
+    for (const auto& entry : quantities) {
+        if (auto counter = counterFor(entry.first)) {
+            giveBack(*counter, entry.second);
+        }
+    }
+}
+
+void InventoryManager::commit(const Reservation& reservation) {
+    for (const auto& entry : reservation.quantities) {
+        if (auto counter = counterFor(entry.first)) {
+            counter->stock.fetch_sub(entry.second, std::memory_order_acq_rel);
+        }
+    }
+    version_.fetch_add(1, std::memory_order_release);
+    committed_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::optional<DishStock> InventoryManager::getStock(int dish_id) {
+    std::shared_ptr<Counter> counter = counterFor(dish_id);
+    if (!counter) {
+        return std::nullopt;
+    }
+    return DishStock{dish_id, counter->stock.load(std::memory_order_acquire),
+                     counter->available.load(std::memory_order_acquire)};
+}
+
+std::vector<DishStock> InventoryManager::getAllStocks() const {
+    auto table = std::atomic_load(&counters_);
+    std::vector<DishStock> stocks;
+    stocks.reserve(table->size());
+    for (const auto& entry : *table) {
+        stocks.push_back(DishStock{entry.first, entry.second->stock.load(std::memory_order_acquire),
+                                   entry.second->available.load(std::memory_order_acquire)});
+    }
+    std::sort(stocks.begin(), stocks.end(), [](const DishStock& a, const DishStock& b) {
+        return a.dish_id < b.dish_id;
+    });
+    return stocks;
+}
+
+bool InventoryManager::isSoldOut(int dish_id) const {
+    auto table = std::atomic_load(&counters_);
+    auto it = table->find(dish_id);
+    return it != table->end() && it->second->available.load(std::memory_order_acquire) <= 0;
+}
+
+std::vector<int> InventoryManager::getSoldOutDishes() const {
+    auto table = std::atomic_load(&counters_);
+    std::vector<int> dishes;
+    for (const auto& entry : *table) {
+        if (entry.second->available.load(std::memory_order_acquire) <= 0) {
+            dishes.push_back(entry.first);
+        }
+    }
+    std::sort(dishes.begin(), dishes.end());
+    return dishes;
+}
+
+InventoryResult InventoryManager::reserve(const std::vector<std::pair<int, int>>& quantities) {
+    InventoryResult result = takeAll(quantities);
+    if (!result.ok()) {
+        return result;
+    }
+    std::lock_guard<std::mutex> lock(reservations_mutex_);
+    result.reservation_id = ++next_reservation_;
+    reservations_[result.reservation_id] =
+        Reservation{quantities, std::chrono::steady_clock::now() + options_.reservation_ttl};
+    reserved_.fetch_add(1, std::memory_order_relaxed);
+    return result;
+}
+
+bool InventoryManager::release(uint64_t reservation_id) {
+    Reservation reservation;
+    {
+        std::lock_guard<std::mutex> lock(reservations_mutex_);
+        auto it = reservations_.find(reservation_id);
+        if (it == reservations_.end()) {
+            return false;
+        }
+        reservation = std::move(it->second);
+        reservations_.erase(it);
+    }
+    giveBackAll(reservation.quantities);
+    released_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+InventoryResult InventoryManager::placeOrder(const Order& order, const std::vector<OrderItem>& items,
+                                             uint64_t reservation_id) {
+    Reservation reservation{orderQuantities(items), std::chrono::steady_clock::time_point()};
+    InventoryResult result;
+
+    // 取出的预留、比预留多出的份数、少于预留的份数；下单失败时用于恢复预留
+    Reservation held;
+    std::vector<std::pair<int, int>> extra;
+    std::vector<std::pair<int, int>> surplus;
+    if (reservation_id == 0) {
+        result = takeAll(reservation.quantities);
+        if (!result.ok()) {
+            return result;
+        }
+    } else {
+        // 取出预留，只为比预留多出的份数再扣减，少于预留的部分在写入成功后退回
+        {
+            std::lock_guard<std::mutex> lock(reservations_mutex_);
+            auto it = reservations_.find(reservation_id);
+            if (it == reservations_.end()) {
+                result.status = InventoryResult::Status::UnknownReservation;
+                return result;
+            }
+            held = std::move(it->second);
+            reservations_.erase(it);
+        }
+        std::map<int, int> diff;
+        for (const auto& entry : reservation.quantities) {
+            diff[entry.first] += entry.second;
+        }
+        for (const auto& entry : held.quantities) {
+            diff[entry.first] -= entry.second;
+        }
+        for (const auto& entry : diff) {
+            if (entry.second > 0) {
+                extra.push_back(entry);
+            } else if (entry.second < 0) {
+                surplus.emplace_back(entry.first, -entry.second);
+            }
+        }
+        result = takeAll(extra);
+        if (!result.ok()) {
+            // 加点的菜不够时保留原预留，顾客可以修改后重新下单
+            std::lock_guard<std::mutex> lock(reservations_mutex_);
+            reservations_[reservation_id] = std::move(held);
+            return result;
+        }
+    }
+
+    result.order = db_->placeOrder(order, items, false);
+    if (!result.order) {
+        if (reservation_id == 0) {
+            giveBackAll(reservation.quantities);
+        } else {
+            // 退回加点的份数并恢复原预留（仍按原来的过期时间），顾客可以重试
+            giveBackAll(extra);
+            std::lock_guard<std::mutex> lock(reservations_mutex_);
+            reservations_[reservation_id] = std::move(held);
+        }
+        result.status = InventoryResult::Status::Failed;
+        return result;
+    }
+    giveBackAll(surplus);
+    commit(reservation);
+    result.status = InventoryResult::Status::Ok;
+    return result;
+}
+
+bool InventoryManager::setStock(int dish_id, int stock) {
+    std::shared_ptr<Counter> counter = counterFor(dish_id);
+    if (!counter) {
+        return false;
+    }
+    int previous = counter->stock.exchange(stock, std::memory_order_acq_rel);
+    int before = counter->available.fetch_add(stock - previous, std::memory_order_acq_rel);
+    noteAvailability(before, before + stock - previous);
+    version_.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+size_t InventoryManager::expireReservations() {
+    std::vector<Reservation> expired;
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(reservations_mutex_);
+        for (auto it = reservations_.begin(); it != reservations_.end();) {
+            if (it->second.expires_at <= now) {
+                expired.push_back(std::move(it->second));
+                it = reservations_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (const auto& reservation : expired) {
+        giveBackAll(reservation.quantities);
+    }
+    expired_.fetch_add(expired.size(), std::memory_order_relaxed);
+    return expired.size();
+}
+
+bool InventoryManager::flush() {
+    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+    auto table = std::atomic_load(&counters_);
+    std::vector<std::pair<int, int>> stocks;
+    std::vector<Counter*> changed;
+    for (const auto& entry : *table) {
+        int stock = entry.second->stock.load(std::memory_order_acquire);
+        if (stock != entry.second->persisted) {
+            stocks.emplace_back(entry.first, stock);
+            changed.push_back(entry.second.get());
+        }
+    }
+    if (stocks.empty()) {
+        return true;
+    }
+
+    if (!db_->saveDishStocks(stocks)) {
+        flush_failures_.fetch_add(1, std::memory_order_relaxed);
+        LOG_F(ERROR, "写回 %zu 道菜的库存失败，下次重试", stocks.size());
+        return false;
+    }
+    for (size_t i = 0; i < changed.size(); i++) {
+        changed[i]->persisted = stocks[i].second;
+    }
+    rows_written_.fetch_add(stocks.size(), std::memory_order_relaxed);
+    return true;
+}
+
+void InventoryManager::shutdown() {
+    flusher_.stop();
+}
+
+InventoryStats InventoryManager::getStats() const {
+    InventoryStats stats;
+    auto table = std::atomic_load(&counters_);
+    stats.dishes = table->size();
+    stats.sold_out = 0;
+    for (const auto& entry : *table) {
+        if (entry.second->available.load(std::memory_order_acquire) <= 0) {
+            stats.sold_out++;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(reservations_mutex_);
+        stats.reservations = reservations_.size();
+    }
+    stats.reserved = reserved_.load(std::memory_order_relaxed);
+    stats.rejected = rejected_.load(std::memory_order_relaxed);
+    stats.committed = committed_.load(std::memory_order_relaxed);
+    stats.released = released_.load(std::memory_order_relaxed);
+    stats.expired = expired_.load(std::memory_order_relaxed);
+    stats.rows_written = rows_written_.load(std::memory_order_relaxed);
+    stats.flush_failures = flush_failures_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void InventoryManager::periodicFlush() {
+    size_t expired = expireReservations();
+    if (expired > 0) {
+        LOG_F(INFO, "释放 %zu 个超时的库存预留", expired);
+    }
+    flush();
+}
+
+} // namespace WisdomRestaurant
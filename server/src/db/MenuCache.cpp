@@ -0,0 +1,230 @@
+#include "db/MenuCache.h"
+#include <algorithm>
+#include <chrono>
+#include <unordered_set>
+
+namespace WisdomRestaurant {
+
+// 保留的历史快照数，超出范围的增量请求返回全量
+static const size_t kMenuHistorySize = 32;
+
+// 比较两道菜除销量和库存之外的字段：这两个计数随下单变化，不算菜单变化
+static bool sameMenuFields(const Dish& a, const Dish& b) {
+    if (a.sales_count == b.sales_count && a.stock_count == b.stock_count) {
+        return rowsEqual(a, b);
+    }
+    Dish normalized = b;
+    normalized.sales_count = a.sales_count;
+    normalized.stock_count = a.stock_count;
+    return rowsEqual(a, normalized);
+}
+
+const Dish* MenuSnapshot::findById(int id) const {
+    auto it = by_id.find(id);
+    return it == by_id.end() ? nullptr : &dishes[it->second];
+}
+
+const Dish* MenuSnapshot::findByCode(const std::string& code) const {
+    auto it = by_code.find(code);
+    return it == by_code.end() ? nullptr : &dishes[it->second];
+}
+
+Dish MenuSnapshot::copy(size_t index) const {
+    Dish dish = dishes[index];
+    dish.sales_count = salesCount(index);
+    dish.stock_count = stockCount(index);
+    return dish;
+}
+
+std::vector<Dish> MenuSnapshot::collect(const std::vector<size_t>& indexes) const {
+    std::vector<Dish> result;
+    result.reserve(indexes.size());
+    for (size_t index : indexes) {
+        result.push_back(copy(index));
+    }
+    return result;
+}
+
+MenuCache::MenuCache()
+    : epoch_(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::system_clock::now().time_since_epoch()).count()))
+    , snapshot_(build({}, epoch_, 0)) {
+}
+
+std::shared_ptr<const MenuSnapshot> MenuCache::current() const {
+    return std::atomic_load(&snapshot_);
+}
+
+uint64_t MenuCache::version() const {
+    return current()->version;
+}
+
+void MenuCache::publish(std::vector<Dish> dishes) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    publishLocked(std::move(dishes));
+}
+
+void MenuCache::upsert(const Dish& dish) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    auto snapshot = current();
+
+    std::vector<Dish> dishes = copyCurrentLocked();
+    auto it = snapshot->by_id.find(dish.id);
+    if (it != snapshot->by_id.end()) {
+        dishes[it->second] = dish;
+    } else {
+        dishes.push_back(dish);
+    }
+    publishLocked(std::move(dishes));
+}
+
+void MenuCache::upsert(const std::vector<Dish>& changed) {
+    if (changed.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    auto snapshot = current();
+
+    std::vector<Dish> dishes = copyCurrentLocked();
+    for (const auto& dish : changed) {
+        auto it = snapshot->by_id.find(dish.id);
+        if (it != snapshot->by_id.end()) {
+            dishes[it->second] = dish;
+        } else {
+            dishes.push_back(dish);
+        }
+    }
+    publishLocked(std::move(dishes));
+}
+
+void MenuCache::updateCounters(const std::vector<Dish>& changed) {
+    if (changed.empty()) {
+        return;
+    }
+    // 与发布互斥，计数不会写进即将被替换的旧快照；历史中的同一快照共享这些计数
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    auto snapshot = current();
+    for (const auto& dish : changed) {
+        auto it = snapshot->by_id.find(dish.id);
+        if (it != snapshot->by_id.end()) {
+            snapshot->counters[it->second].sales_count.store(dish.sales_count, std::memory_order_relaxed);
+            snapshot->counters[it->second].stock_count.store(dish.stock_count, std::memory_order_relaxed);
+        }
+    }
+}
+
+std::vector<Dish> MenuCache::copyCurrentLocked() const {
+    auto snapshot = current();
+    std::vector<Dish> dishes;
+    dishes.reserve(snapshot->dishes.size());
+    for (size_t i = 0; i < snapshot->dishes.size(); i++) {
+        dishes.push_back(snapshot->copy(i));
+    }
+    return dishes;
+}
+
+void MenuCache::setVersionListener(std::function<void(uint64_t)> listener) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    listener_ = std::move(listener);
+}
+
+void MenuCache::publishLocked(std::vector<Dish> dishes) {
+    uint64_t version = current()->version + 1;
+    auto snapshot = build(std::move(dishes), epoch_, version);
+    {
+        std::lock_guard<std::mutex> lock(history_mutex_);
+        history_.push_back(snapshot);
+        while (history_.size() > kMenuHistorySize) {
+            history_.pop_front();
+        }
+    }
+    std::atomic_store(&snapshot_, snapshot);
+    if (listener_) {
+        listener_(version);
+    }
+}
+
+MenuDelta MenuCache::diff(uint64_t since, const MenuSnapshot& to) const {
+    MenuDelta delta;
+
+    std::shared_ptr<const MenuSnapshot> from;
+    {
+        std::lock_guard<std::mutex> lock(history_mutex_);
+        for (const auto& snapshot : history_) {
+            if (snapshot->version == since) {
+                from = snapshot;
+                break;
+            }
+        }
+    }
+
+    if (!from || since > to.version) {
+        delta.full = true;
+        for (size_t index : to.available) {
+            delta.changed.push_back(&to.dishes[index]);
+        }
+        return delta;
+    }
+
+    std::unordered_set<int> still_available;
+    for (size_t index : to.available) {
+        const Dish& dish = to.dishes[index];
+        still_available.insert(dish.id);
+        const Dish* old_dish = from->findById(dish.id);
+        if (!old_dish || !old_dish->is_available || !sameMenuFields(*old_dish, dish)) {
+            delta.changed.push_back(&dish);
+        }
+    }
+    for (size_t index : from->available) {
+        int id = from->dishes[index].id;
+        if (still_available.count(id) == 0) {
+            delta.removed.push_back(id);
+        }
+    }
+    return delta;
+}
+
+std::shared_ptr<const MenuSnapshot> MenuCache::build(std::vector<Dish> dishes, uint64_t epoch, uint64_t version) {
+    auto snapshot = std::make_shared<MenuSnapshot>();
+    snapshot->epoch = epoch;
+    snapshot->version = version;
+
+    // 与SQL中ORDER BY category_id, dish_name一致（SQLite默认按字节比较）
+    std::stable_sort(dishes.begin(), dishes.end(), [](const Dish& a, const Dish& b) {
+        if (a.category_id != b.category_id) {
+            return a.category_id < b.category_id;
+        }
+        return a.dish_name < b.dish_name;
+    });
+    snapshot->dishes = std::move(dishes);
+    snapshot->counters.reset(new DishCounters[snapshot->dishes.size()]);
+
+    for (size_t i = 0; i < snapshot->dishes.size(); i++) {
+        const Dish& dish = snapshot->dishes[i];
+        snapshot->counters[i].sales_count.store(dish.sales_count, std::memory_order_relaxed);
+        snapshot->counters[i].stock_count.store(dish.stock_count, std::memory_order_relaxed);
+        snapshot->by_id[dish.id] = i;
+        snapshot->by_code[dish.dish_code] = i;
+        if (!dish.is_available) {
+            continue;
+        }
+        snapshot->available.push_back(i);
+        snapshot->by_category[dish.category_id].push_back(i);
+        if (dish.is_recommended) {
+            snapshot->recommended.push_back(i);
+        }
+        if (dish.is_signature) {
+            snapshot->signature.push_back(i);
+        }
+    }
+
+    auto by_sales = [&snapshot](size_t a, size_t b) {
+        return snapshot->dishes[a].sales_count > snapshot->dishes[b].sales_count;
+    };
+    std::stable_sort(snapshot->recommended.begin(), snapshot->recommended.end(), by_sales);
+    std::stable_sort(snapshot->signature.begin(), snapshot->signature.end(), by_sales);
+
+    return snapshot;
+}
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,104 @@
+#include "db/OrderStats.h"
+#include "common/UtcTime.h"
+#include <algorithm>
+#include <limits>
+
+namespace WisdomRestaurant {
+
+OrderStats::OrderStats(int resident_days)
+    : resident_days_(std::max(resident_days, 1))
+    , first_day_(std::numeric_limits<int64_t>::max()) {
+}
+
+void OrderStats::load(int64_t first_day, const std::vector<OrderStatsRow>& rows) {
+    std::map<int64_t, std::array<Counters, 24>> days;
+    for (const auto& row : rows) {
+        int64_t day;
+        if (!UtcTime::parseDate(row.stat_date, day) || day < first_day || row.stat_hour < 0 || row.stat_hour > 23) {
+            continue;
+        }
+        Counters& counters = days[day][static_cast<size_t>(row.stat_hour)];
+        counters.order_count += row.order_count;
+        counters.covers += row.covers;
+        counters.paid_count += row.paid_count;
+        counters.revenue_cents += row.revenue_cents;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    days_ = std::move(days);
+    first_day_ = first_day;
+}
+
+void OrderStats::apply(const OrderStatsRow& delta) {
+    int64_t day;
+    if (!UtcTime::parseDate(delta.stat_date, day) || delta.stat_hour < 0 || delta.stat_hour > 23) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (day < first_day_) {
+        return;
+    }
+    auto it = days_.find(day);
+    if (it == days_.end()) {
+        it = days_.emplace(day, std::array<Counters, 24>{}).first;
+        // 进入新的一天时淘汰窗口外的日期，之后这些日期由汇总表提供
+        int64_t cutoff = days_.rbegin()->first - resident_days_ + 1;
+        if (cutoff > first_day_) {
+            days_.erase(days_.begin(), days_.lower_bound(cutoff));
+            first_day_ = cutoff;
+        }
+        if (day < first_day_) {
+            return;
+        }
+    }
+    Counters& counters = it->second[static_cast<size_t>(delta.stat_hour)];
+    counters.order_count += delta.order_count;
+    counters.covers += delta.covers;
+    counters.paid_count += delta.paid_count;
+    counters.revenue_cents += delta.revenue_cents;
+}
+
+std::optional<OrderStatsRow> OrderStats::day(int64_t day) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (day < first_day_) {
+        return std::nullopt;
+    }
+    Counters total;
+    auto it = days_.find(day);
+    if (it != days_.end()) {
+        for (const auto& counters : it->second) {
+            total.order_count += counters.order_count;
+            total.covers += counters.covers;
+            total.paid_count += counters.paid_count;
+            total.revenue_cents += counters.revenue_cents;
+        }
+    }
+    return toRow(day, -1, total);
+}
+
+std::optional<std::vector<OrderStatsRow>> OrderStats::hours(int64_t day) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (day < first_day_) {
+        return std::nullopt;
+    }
+    std::vector<OrderStatsRow> rows;
+    rows.reserve(24);
+    auto it = days_.find(day);
+    for (int hour = 0; hour < 24; hour++) {
+        rows.push_back(toRow(day, hour, it != days_.end() ? it->second[static_cast<size_t>(hour)] : Counters()));
+    }
+    return rows;
+}
+
+int64_t OrderStats::firstDay() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return first_day_;
+}
+
+OrderStatsRow OrderStats::toRow(int64_t day, int hour, const Counters& counters) {
+    return OrderStatsRow{UtcTime::dateFromDays(day), hour, counters.order_count, counters.covers,
+                         counters.paid_count, counters.revenue_cents};
+}
+
+} // namespace WisdomRestaurant
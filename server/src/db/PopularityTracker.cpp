@@ -0,0 +1,191 @@
+#include "db/PopularityTracker.h"
+#include "common/UtcTime.h"
+#include <algorithm>
+#include <ctime>
+#include <limits>
+#include <loguru.hpp>
+
+namespace WisdomRestaurant {
+
+const char* popularityWindowName(PopularityWindow window) {
+    switch (window) {
+        case PopularityWindow::Day: return "day";
+        case PopularityWindow::Week: return "week";
+        case PopularityWindow::Month: return "month";
+        case PopularityWindow::Quarter: return "quarter";
+    }
+    return "day";
+}
+
+bool parsePopularityWindow(const std::string& name, PopularityWindow& window) {
+    for (PopularityWindow candidate : {PopularityWindow::Day, PopularityWindow::Week,
+                                       PopularityWindow::Month, PopularityWindow::Quarter}) {
+        if (name == popularityWindowName(candidate)) {
+            window = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 本地日期（1970-01-01以来的天数）、月份和小时，与推荐时判断季节和用餐时段的口径一致
+static void localCalendar(std::chrono::system_clock::time_point time, int64_t& day, int& month, int& hour) {
+    std::time_t time_t = std::chrono::system_clock::to_time_t(time);
+    std::tm tm = *std::localtime(&time_t);
+    day = UtcTime::daysFromCivil(tm.tm_year + 1900, static_cast<unsigned>(tm.tm_mon + 1),
+                                 static_cast<unsigned>(tm.tm_mday));
+    month = tm.tm_mon + 1;
+    hour = tm.tm_hour;
+}
+
+PopularityTracker::PopularityTracker()
+    : current_day_(std::numeric_limits<int64_t>::min())
+    , events_(0)
+    , dropped_(0) {
+}
+
+bool PopularityTracker::initialize(RestaurantDb& db) {
+    size_t loaded = 0;
+    std::string sql = R"(SELECT * FROM order_items
+        WHERE created_at >= datetime('now', '-' || ? || ' days') AND item_status != 'cancelled')";
+    bool ok = db.forEachRow<OrderItem>(sql, {std::to_string(kRingDays)}, [&](const OrderItem& item) {
+        std::chrono::system_clock::time_point time;
+        if (UtcTime::parse(item.created_at, time)) {
+            record(item.dish_id, item.quantity, time);
+            loaded++;
+        }
+        return true;
+    });
+    LOG_F(INFO, "热销统计: 加载最近 %d 天的 %zu 个订单项", kRingDays, loaded);
+    return ok;
+}
+
+void PopularityTracker::record(int dish_id, int quantity, std::chrono::system_clock::time_point time) {
+    if (dish_id <= 0 || quantity <= 0) {
+        return;
+    }
+    int64_t day;
+    int month, hour;
+    localCalendar(time, day, month, hour);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (day > current_day_) {
+        advanceLocked(day);
+    }
+    if (day <= current_day_ - kRingDays) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    events_.fetch_add(1, std::memory_order_relaxed);
+
+    size_t meal = static_cast<size_t>(MealPeriod::mealTimeIndex(hour));
+    size_t season = static_cast<size_t>(MealPeriod::seasonIndex(month));
+    size_t slot = static_cast<size_t>(day % kRingDays);
+    for (size_t index : {sliceIndex(meal, season), sliceIndex(meal, kSeasonSlots - 1),
+                         sliceIndex(kMealSlots - 1, season), sliceIndex(kMealSlots - 1, kSeasonSlots - 1)}) {
+        Slice& slice = slices_[index];
+        DishCounter& counter = slice.dishes[dish_id];
+        counter.days[slot] += static_cast<uint32_t>(quantity);
+        // 补录的历史订单项只计入仍覆盖那一天的窗口
+        for (size_t window = 0; window < kWindowCount; window++) {
+            if (day > current_day_ - kWindowDays[window]) {
+                adjust(slice, dish_id, counter, window, quantity);
+            }
+        }
+    }
+}
+
+std::vector<PopularDish> PopularityTracker::top(int meal_time, int season, PopularityWindow window, size_t k,
+                                                const std::function<bool(int)>& accept) {
+    size_t meal = meal_time >= 0 ? static_cast<size_t>(meal_time) : kMealSlots - 1;
+    size_t season_slot = season >= 0 ? static_cast<size_t>(season) : kSeasonSlots - 1;
+    std::vector<PopularDish> result;
+    if (meal >= kMealSlots || season_slot >= kSeasonSlots || k == 0) {
+        return result;
+    }
+
+    // 查询时也推进日期，长时间没有点菜时过期的销量不会留在排行里
+    int64_t today;
+    int month, hour;
+    localCalendar(std::chrono::system_clock::now(), today, month, hour);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (today > current_day_) {
+        advanceLocked(today);
+    }
+    const Ranking& ranking = slices_[sliceIndex(meal, season_slot)].rankings[static_cast<size_t>(window)];
+    for (const auto& entry : ranking) {
+        if (accept && !accept(entry.second)) {
+            continue;
+        }
+        result.push_back(PopularDish{entry.second, entry.first});
+        if (result.size() >= k) {
+            break;
+        }
+    }
+    return result;
+}
+
+PopularityStats PopularityTracker::getStats() const {
+    PopularityStats stats;
+    stats.events = events_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.tracked = 0;
+    for (const auto& slice : slices_) {
+        stats.tracked += slice.dishes.size();
+    }
+    return stats;
+}
+
+void PopularityTracker::adjust(Slice& slice, int dish_id, DishCounter& counter, size_t window, int64_t delta) {
+    uint64_t& sum = counter.sums[window];
+    if (delta == 0) {
+        return;
+    }
+    Ranking& ranking = slice.rankings[window];
+    if (sum > 0) {
+        ranking.erase({sum, dish_id});
+    }
+    sum = static_cast<uint64_t>(static_cast<int64_t>(sum) + delta);
+    if (sum > 0) {
+        ranking.insert({sum, dish_id});
+    }
+}
+
+void PopularityTracker::advanceLocked(int64_t day) {
+    // 首次记录或间隔超过环形缓冲区时直接清空
+    if (current_day_ == std::numeric_limits<int64_t>::min() || day - current_day_ >= kRingDays) {
+        for (auto& slice : slices_) {
+            slice.dishes.clear();
+            for (auto& ranking : slice.rankings) {
+                ranking.clear();
+            }
+        }
+        current_day_ = day;
+        return;
+    }
+
+    for (int64_t next = current_day_ + 1; next <= day; next++) {
+        size_t next_slot = static_cast<size_t>(next % kRingDays);
+        for (auto& slice : slices_) {
+            for (auto it = slice.dishes.begin(); it != slice.dishes.end();) {
+                DishCounter& counter = it->second;
+                // 日期变为next时，next - 窗口天数这一天移出窗口；90天窗口移出的正是即将被覆盖的槽位
+                for (size_t window = 0; window < kWindowCount; window++) {
+                    size_t leaving = static_cast<size_t>((next - kWindowDays[window]) % kRingDays);
+                    adjust(slice, it->first, counter, window, -static_cast<int64_t>(counter.days[leaving]));
+                }
+                counter.days[next_slot] = 0;
+                if (counter.sums[kWindowCount - 1] == 0) {
+                    it = slice.dishes.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+    current_day_ = day;
+}
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,237 @@
+#include "db/RecommendationWriter.h"
+#include "common/Base64.h"
+#include <algorithm>
+#include <loguru.hpp>
+
+namespace WisdomRestaurant {
+
+RecommendationWriter::RecommendationWriter(std::shared_ptr<RestaurantDb> db,
+                                           std::shared_ptr<ImageBlobStore> image_store,
+                                           const RecommendationWriterOptions& options)
+    : db_(db)
+    , image_store_(image_store)
+    , options_(options)
+    , flush_latency_(MetricsRegistry::instance().histogram("wisdom_rec_writer_flush_seconds",
+          "Duration of one batched ai_recommendations transaction", {}))
+    , queued_bytes_(0)
+    , enqueued_seq_(0)
+    , written_seq_(0)
+    , flush_requested_seq_(0)
+    , stopping_(false)
+    , max_queue_depth_(0)
+    , written_(0)
+    , failed_(0)
+    , batches_(0)
+    , blocked_(0)
+    , sync_fallbacks_(0) {
+    if (options_.batch_size == 0) {
+        options_.batch_size = 1;
+    }
+    // 队列容量为0时不启动后台线程，每条记录在调用方线程同步写入
+    if (options_.max_queued == 0) {
+        stopping_ = true;
+        return;
+    }
+    if (options_.max_queued < options_.batch_size) {
+        options_.max_queued = options_.batch_size;
+    }
+    writer_ = std::thread(&RecommendationWriter::writerLoop, this);
+}
+
+RecommendationWriter::~RecommendationWriter() {
+    shutdown();
+}
+
+bool RecommendationWriter::enqueue(AiRecommendation recommendation, RecommendationImage image) {
+    PendingRecommendation pending{std::move(recommendation), std::move(image)};
+    size_t image_bytes = pending.image.data.size();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // 队列为空时总能放入一条，单张超大图片不会一直等待
+        auto has_space = [this, image_bytes] {
+            return queue_.size() < options_.max_queued &&
+                   (queue_.empty() || queued_bytes_ + image_bytes <= options_.max_queued_bytes);
+        };
+        if (!stopping_ && !has_space()) {
+            // 背压：数据库跟不上时让调用方等待，而不是无限堆积
+            blocked_++;
+            space_cv_.wait_for(lock, options_.enqueue_timeout, [this, &has_space] {
+                return stopping_ || has_space();
+            });
+        }
+
+        if (!stopping_ && has_space()) {
+            bool was_empty = queue_.empty();
+            if (was_empty) {
+                oldest_enqueued_at_ = std::chrono::steady_clock::now();
+            }
+            pending_sessions_.insert(pending.record.session_id);
+            queue_.push_back(std::move(pending));
+            queued_bytes_ += image_bytes;
+            enqueued_seq_++;
+            max_queue_depth_ = std::max(max_queue_depth_, queue_.size());
+
+            // 队列从空变为非空时后台线程需要开始计时，攒够一批时需要立即写入
+            if (was_empty || queue_.size() >= options_.batch_size) {
+                work_cv_.notify_one();
+            }
+            return true;
+        }
+    }
+
+    // 等待超时或已关闭：在调用方线程同步写入，保证记录不丢失
+    if (options_.max_queued > 0) {
+        sync_fallbacks_++;
+    }
+    return writeNow(std::move(pending));
+}
+
+void RecommendationWriter::attachImage(PendingRecommendation& pending) {
+    RecommendationImage& image = pending.image;
+    if (image.data.empty()) {
+        return;
+    }
+    if (image_store_) {
+        pending.record.image_hash = image_store_->put(image.data, image.is_base64);
+        if (pending.record.image_hash.empty()) {
+            LOG_F(WARNING, "保存推荐记录 %s 的图片失败", pending.record.session_id.c_str());
+        }
+    } else {
+        pending.record.image_base64 = image.is_base64 ? std::move(image.data) : Base64::encode(image.data);
+    }
+    image.data.clear();
+    image.data.shrink_to_fit();
+}
+
+bool RecommendationWriter::writeNow(PendingRecommendation pending) {
+    attachImage(pending);
+    if (db_->saveAiRecommendation(pending.record)) {
+        written_++;
+        return true;
+    }
+    failed_++;
+    LOG_F(WARNING, "保存AI推荐记录失败: %s", pending.record.session_id.c_str());
+    return false;
+}
+
+bool RecommendationWriter::isPending(const std::string& session_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_sessions_.count(session_id) > 0;
+}
+
+void RecommendationWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t target = enqueued_seq_;
+    if (written_seq_ >= target) {
+        return;
+    }
+    flush_requested_seq_ = std::max(flush_requested_seq_, target);
+    work_cv_.notify_one();
+    space_cv_.wait(lock, [this, target] { return written_seq_ >= target; });
+}
+
+void RecommendationWriter::shutdown() {
+    size_t remaining = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+        stopping_ = true;
+        remaining = queue_.size();
+    }
+    work_cv_.notify_all();
+    space_cv_.notify_all();
+
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+    LOG_F(INFO, "推荐记录写入队列已关闭，退出前写入 %zu 条", remaining);
+}
+
+RecommendationWriterStats RecommendationWriter::getStats() const {
+    RecommendationWriterStats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.queue_depth = queue_.size();
+        stats.max_queue_depth = max_queue_depth_;
+        stats.enqueued = enqueued_seq_;
+    }
+    stats.written = written_.load();
+    stats.failed = failed_.load();
+    stats.batches = batches_.load();
+    stats.blocked = blocked_.load();
+    stats.sync_fallbacks = sync_fallbacks_.load();
+    return stats;
+}
+
+void RecommendationWriter::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        if (queue_.empty()) {
+            if (stopping_) {
+                break;
+            }
+            work_cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            continue;
+        }
+
+        // 等到攒够一批、队首记录等待超过flush_interval、有人调用flush或正在关闭
+        work_cv_.wait_until(lock, oldest_enqueued_at_ + options_.flush_interval, [this] {
+            return stopping_ || queue_.size() >= options_.batch_size || flush_requested_seq_ > written_seq_;
+        });
+
+        size_t count = std::min(queue_.size(), options_.batch_size);
+        std::vector<PendingRecommendation> batch;
+        batch.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            queued_bytes_ -= queue_.front().image.data.size();
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+        // 剩余的记录已经等了一段时间，下一批从现在起重新计时
+        oldest_enqueued_at_ = std::chrono::steady_clock::now();
+
+        lock.unlock();
+        space_cv_.notify_all();
+        writeBatch(batch);
+        lock.lock();
+
+        for (const auto& pending : batch) {
+            pending_sessions_.erase(pending.record.session_id);
+        }
+        written_seq_ += batch.size();
+        space_cv_.notify_all();
+    }
+}
+
+void RecommendationWriter::writeBatch(std::vector<PendingRecommendation>& batch) {
+    // 图片先落到图片存储，事务中只写哈希
+    std::vector<AiRecommendation> records;
+    records.reserve(batch.size());
+    for (auto& pending : batch) {
+        attachImage(pending);
+        records.push_back(std::move(pending.record));
+    }
+
+    {
+        ScopedTimer timer(flush_latency_);
+        batches_++;
+        if (db_->saveAiRecommendations(records)) {
+            written_ += records.size();
+            return;
+        }
+    }
+
+    // 整批已回滚，逐条重试，只丢弃确实写不进去的记录
+    for (const auto& record : records) {
+        if (db_->saveAiRecommendation(record)) {
+            written_++;
+        } else {
+            failed_++;
+            LOG_F(WARNING, "保存AI推荐记录失败: %s", record.session_id.c_str());
+        }
+    }
+}
+
+} // namespace WisdomRestaurant
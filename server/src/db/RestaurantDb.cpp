@@ -1,32 +1,61 @@
 #include "db/RestaurantDb.h"
+#include "db/MenuCache.h"
+#include "db/ImageBlobStore.h"
+#include "db/OrderStats.h"
+#include "common/UtcTime.h"
 #include <iostream>
 #include <sstream>
 #include <chrono>
 #include <random>
 #include <iomanip>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <map>
 #include <loguru.hpp>
 
 namespace WisdomRestaurant {
 
-RestaurantDb::RestaurantDb() : db_(nullptr), initialized_(false) {
+RestaurantDb::RestaurantDb()
+    : db_(nullptr), next_reader_(0), menu_cache_(std::make_unique<MenuCache>()),
+      order_stats_(std::make_unique<OrderStats>()), initialized_(false) {
 }
 
 RestaurantDb::~RestaurantDb() {
+    // 预编译语句必须在关闭连接之前释放
+    for (auto& reader : readers_) {
+        reader->statements.reset();
+        sqlite3_close(reader->db);
+    }
+    readers_.clear();
+    statements_.reset();
     if (db_) {
         sqlite3_close(db_);
     }
 }
 
-bool RestaurantDb::initialize(const std::string& db_path) {
+bool RestaurantDb::initialize(const std::string& db_path, const DbOptions& options) {
     try {
         int rc = sqlite3_open(db_path.c_str(), &db_);
         if (rc != SQLITE_OK) {
             LOG_F(ERROR, "无法打开数据库: %s", sqlite3_errmsg(db_));
             return false;
         }
+        statements_ = std::make_unique<StatementCache>(db_);
 
         // 启用外键约束
         executeSQL("PRAGMA foreign_keys = ON;");
+
+        // 内存数据库每个连接各自独立，不能使用WAL和只读连接池
+        bool in_memory = db_path == ":memory:" || db_path.empty();
+        if (options.wal_mode && !in_memory) {
+            if (!executeSQL("PRAGMA journal_mode = WAL;")) {
+                return false;
+            }
+        }
+        if (!applyConnectionPragmas(db_, options)) {
+            return false;
+        }
         
         // 创建表结构
         if (!createTables()) {
@@ -34,8 +63,29 @@ bool RestaurantDb::initialize(const std::string& db_path) {
             return false;
         }
 
+        // 表结构就绪后再打开只读连接
+        if (options.wal_mode && !in_memory && options.read_pool_size > 0) {
+            if (!openReadPool(db_path, options)) {
+                return false;
+            }
+        }
+
         initialized_ = true;
-        LOG_F(INFO, "SQLite数据库初始化成功: %s", db_path.c_str());
+        if (!reloadMenu()) {
+            LOG_F(ERROR, "加载菜单失败");
+            initialized_ = false;
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(db_mutex_);
+            if (!loadOrderStatsLocked()) {
+                LOG_F(ERROR, "加载订单统计失败");
+                initialized_ = false;
+                return false;
+            }
+        }
+        LOG_F(INFO, "SQLite数据库初始化成功: %s (WAL: %s, 只读连接: %zu)", db_path.c_str(),
+              options.wal_mode && !in_memory ? "on" : "off", readers_.size());
         return true;
     } catch (const std::exception& e) {
         LOG_F(ERROR, "数据库初始化失败: %s", e.what());
@@ -43,6 +93,64 @@ bool RestaurantDb::initialize(const std::string& db_path) {
     }
 }
 
+bool RestaurantDb::applyConnectionPragmas(sqlite3* db, const DbOptions& options) {
+    // synchronous只接受固定取值，避免拼接任意字符串
+    std::string synchronous = options.synchronous;
+    std::transform(synchronous.begin(), synchronous.end(), synchronous.begin(), [](unsigned char c) {
+        return static_cast<char>(std::toupper(c));
+    });
+    if (synchronous != "OFF" && synchronous != "NORMAL" && synchronous != "FULL" && synchronous != "EXTRA") {
+        LOG_F(WARNING, "无效的synchronous参数: %s，使用NORMAL", options.synchronous.c_str());
+        synchronous = "NORMAL";
+    }
+
+    std::string pragmas = "PRAGMA synchronous = " + synchronous + ";"
+                          "PRAGMA cache_size = " + std::to_string(options.cache_size) + ";"
+                          "PRAGMA mmap_size = " + std::to_string(options.mmap_size) + ";"
+                          "PRAGMA busy_timeout = 5000;";
+    char* errMsg = nullptr;
+    if (sqlite3_exec(db, pragmas.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        LOG_F(ERROR, "设置数据库参数失败: %s", errMsg);
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+bool RestaurantDb::openReadPool(const std::string& db_path, const DbOptions& options) {
+    for (size_t i = 0; i < options.read_pool_size; i++) {
+        auto reader = std::make_unique<ReadConnection>();
+        int rc = sqlite3_open_v2(db_path.c_str(), &reader->db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr);
+        if (rc != SQLITE_OK) {
+            LOG_F(ERROR, "无法打开只读连接: %s", sqlite3_errmsg(reader->db));
+            sqlite3_close(reader->db);
+            return false;
+        }
+        if (!applyConnectionPragmas(reader->db, options)) {
+            sqlite3_close(reader->db);
+            return false;
+        }
+        reader->statements = std::make_unique<StatementCache>(reader->db);
+        readers_.push_back(std::move(reader));
+    }
+    return true;
+}
+
+std::unique_lock<std::mutex> RestaurantDb::acquireReader(ReadConnection*& reader) {
+    size_t start = next_reader_.fetch_add(1, std::memory_order_relaxed);
+    for (size_t i = 0; i < readers_.size(); i++) {
+        ReadConnection* candidate = readers_[(start + i) % readers_.size()].get();
+        std::unique_lock<std::mutex> lock(candidate->mutex, std::try_to_lock);
+        if (lock.owns_lock()) {
+            reader = candidate;
+            return lock;
+        }
+    }
+
+    reader = readers_[start % readers_.size()].get();
+    return std::unique_lock<std::mutex>(reader->mutex);
+}
+
 bool RestaurantDb::createTables() {
     std::vector<std::string> create_table_sqls = {
         // 用户表
@@ -145,6 +253,9 @@ bool RestaurantDb::createTables() {
             FOREIGN KEY (order_id) REFERENCES orders(id),
             FOREIGN KEY (dish_id) REFERENCES dishes(id)
         ))",
+
+        // 按订单取订单项（getOrderItems、placeOrder读回）不再扫描全表；旧数据库启动时也会补建
+        "CREATE INDEX IF NOT EXISTS idx_order_items_order ON order_items(order_id)",
         
         // AI推荐表
         R"(CREATE TABLE IF NOT EXISTS ai_recommendations (
@@ -166,6 +277,7 @@ bool RestaurantDb::createTables() {
             processing_time INTEGER,
             created_at DATETIME DEFAULT CURRENT_TIMESTAMP,
             updated_at DATETIME DEFAULT CURRENT_TIMESTAMP,
+            image_hash TEXT,
             FOREIGN KEY (table_id) REFERENCES tables(id)
         ))",
         
@@ -210,7 +322,17 @@ bool RestaurantDb::createTables() {
             created_at DATETIME DEFAULT CURRENT_TIMESTAMP,
             updated_at DATETIME DEFAULT CURRENT_TIMESTAMP,
             FOREIGN KEY (table_id) REFERENCES tables(id)
-        ))"
+        ))",
+
+        // 环境数据汇总表：每行是一个列式压缩的块，按(餐桌, 粒度, 起始时间)直接定位
+        R"(CREATE TABLE IF NOT EXISTS environment_rollups (
+            table_id INTEGER NOT NULL,
+            resolution INTEGER NOT NULL,
+            block_start INTEGER NOT NULL,
+            bucket_count INTEGER NOT NULL,
+            data BLOB NOT NULL,
+            PRIMARY KEY (table_id, resolution, block_start)
+        ) WITHOUT ROWID)"
     };
 
     for (const auto& sql : create_table_sqls) {
@@ -218,12 +340,121 @@ bool RestaurantDb::createTables() {
             return false;
         }
     }
+    if (!migrateSchema()) {
+        return false;
+    }
 
     // 插入一些示例数据
     insertSampleData();
     return true;
 }
 
+// 订单统计汇总表：每天每小时一行，下单和支付状态变化时在同一事务中增量更新
+static const char* kCreateOrderStatsSql = R"(CREATE TABLE IF NOT EXISTS order_stats_hourly (
+        stat_date TEXT NOT NULL,
+        stat_hour INTEGER NOT NULL,
+        order_count INTEGER NOT NULL DEFAULT 0,
+        covers INTEGER NOT NULL DEFAULT 0,
+        paid_count INTEGER NOT NULL DEFAULT 0,
+        revenue_cents INTEGER NOT NULL DEFAULT 0,
+        PRIMARY KEY (stat_date, stat_hour)
+    ) WITHOUT ROWID)";
+
+// 按created_at的UTC日期和小时从orders重新汇总，口径与增量更新一致
+static const char* kRebuildOrderStatsSql = R"(INSERT INTO order_stats_hourly
+        (stat_date, stat_hour, order_count, covers, paid_count, revenue_cents)
+    SELECT DATE(created_at), CAST(strftime('%H', created_at) AS INTEGER), COUNT(*),
+           COALESCE(SUM(people_count), 0), SUM(payment_status = 'paid'),
+           COALESCE(SUM(CASE WHEN payment_status = 'paid' THEN CAST(ROUND(final_amount * 100) AS INTEGER) END), 0)
+    FROM orders WHERE DATE(created_at) IS NOT NULL
+    GROUP BY 1, 2)";
+
+static const char* kApplyOrderStatsSql = R"(INSERT INTO order_stats_hourly
+        (stat_date, stat_hour, order_count, covers, paid_count, revenue_cents) VALUES (?, ?, ?, ?, ?, ?)
+    ON CONFLICT(stat_date, stat_hour) DO UPDATE SET
+        order_count = order_count + excluded.order_count, covers = covers + excluded.covers,
+        paid_count = paid_count + excluded.paid_count, revenue_cents = revenue_cents + excluded.revenue_cents)";
+
+// 由订单的created_at（YYYY-MM-DD HH:MM:SS）确定统计所在的日期和小时
+static bool orderStatsSlot(const std::string& created_at, OrderStatsRow& row) {
+    int64_t day;
+    if (created_at.size() < 13 || !UtcTime::parseDate(created_at.substr(0, 10), day)) {
+        return false;
+    }
+    int hour = std::atoi(created_at.c_str() + 11);
+    if (hour < 0 || hour > 23) {
+        return false;
+    }
+    row.stat_date = created_at.substr(0, 10);
+    row.stat_hour = hour;
+    return true;
+}
+
+static int64_t toCents(double amount) {
+    return static_cast<int64_t>(std::llround(amount * 100.0));
+}
+
+bool RestaurantDb::migrateSchema() {
+    // ALTER TABLE追加的列位于末尾，与新建表的列顺序一致，SELECT *的行映射不受影响
+    bool has_image_hash = false;
+    {
+        std::lock_guard<std::mutex> lock(db_mutex_);
+        stepRowsLocked(*statements_, "PRAGMA table_info(ai_recommendations)", {}, [&](sqlite3_stmt* stmt) {
+            const unsigned char* name = sqlite3_column_text(stmt, 1);
+            if (name && std::string(reinterpret_cast<const char*>(name)) == "image_hash") {
+                has_image_hash = true;
+                return false;
+            }
+            return true;
+        });
+    }
+    if (!has_image_hash && !executeSQL("ALTER TABLE ai_recommendations ADD COLUMN image_hash TEXT")) {
+        return false;
+    }
+    if (!has_image_hash) {
+        LOG_F(INFO, "为ai_recommendations表添加image_hash列");
+    }
+
+    // 订单统计汇总表是后加的，首次建表时从orders回填历史数据
+    bool has_order_stats = false;
+    {
+        std::lock_guard<std::mutex> lock(db_mutex_);
+        stepRowsLocked(*statements_, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'order_stats_hourly'",
+                       {}, [&](sqlite3_stmt*) {
+            has_order_stats = true;
+            return false;
+        });
+    }
+    if (!has_order_stats) {
+        if (!executeSQL(kCreateOrderStatsSql) || !executeSQL(kRebuildOrderStatsSql)) {
+            return false;
+        }
+        LOG_F(INFO, "创建order_stats_hourly汇总表并从orders回填");
+    }
+
+    // 早期建的心跳表可能没有(table_id, client_id)唯一约束，先去掉重复行（保留最新一条）再补唯一索引，
+    // 心跳写入的UPSERT依赖它
+    bool has_client_unique = false;
+    {
+        std::lock_guard<std::mutex> lock(db_mutex_);
+        stepRowsLocked(*statements_, "PRAGMA index_list(client_heartbeats)", {}, [&](sqlite3_stmt* stmt) {
+            if (sqlite3_column_int(stmt, 2) != 0) {
+                has_client_unique = true;
+                return false;
+            }
+            return true;
+        });
+    }
+    if (has_client_unique) {
+        return true;
+    }
+    LOG_F(INFO, "为client_heartbeats表补充(table_id, client_id)唯一索引");
+    return executeSQL(R"(DELETE FROM client_heartbeats WHERE id NOT IN
+            (SELECT MAX(id) FROM client_heartbeats GROUP BY table_id, client_id))") &&
+           executeSQL("CREATE UNIQUE INDEX IF NOT EXISTS idx_client_heartbeats_client "
+                      "ON client_heartbeats(table_id, client_id)");
+}
+
 void RestaurantDb::insertSampleData() {
     // 插入示例餐桌
     executeSQL(R"(INSERT OR IGNORE INTO tables (table_number, table_name, seat_count, table_type, status, location) VALUES 
@@ -275,12 +506,12 @@ std::string RestaurantDb::generateOrderNo() {
     auto time_t = std::chrono::system_clock::to_time_t(now);
     auto tm = *std::localtime(&time_t);
     
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(1000, 9999);
+    // 后4位用从随机值开始递增的序号，同一秒内的前10000个订单号不会重复
+    static std::atomic<unsigned> sequence{std::random_device{}()};
+    unsigned suffix = sequence.fetch_add(1) % 10000;
     
     std::ostringstream oss;
-    oss << "ORD" << std::put_time(&tm, "%Y%m%d%H%M%S") << dis(gen);
+    oss << "ORD" << std::put_time(&tm, "%Y%m%d%H%M%S") << std::setw(4) << std::setfill('0') << suffix;
     return oss.str();
 }
 
@@ -303,26 +534,7 @@ std::optional<User> RestaurantDb::getUserById(const std::string& user_id) {
     if (!initialized_) return std::nullopt;
 
     std::string sql = "SELECT * FROM users WHERE user_id = ?";
-    auto result = executeQueryWithParams(sql, {user_id});
-    
-    if (!result.empty()) {
-        User user;
-        user.id = std::stoi(result[0][0]);
-        user.user_id = result[0][1];
-        user.nickname = result[0][2];
-        user.phone = result[0][3];
-        user.email = result[0][4];
-        user.avatar_url = result[0][5];
-        user.gender = result[0][6];
-        user.age_grades = result[0][7];
-        user.body_type = result[0][8];
-        user.taste_preference = result[0][9];
-        user.dietary_restrictions = result[0][10];
-        user.created_at = result[0][11];
-        user.updated_at = result[0][12];
-        return user;
-    }
-    return std::nullopt;
+    return queryOne<User>(sql, {user_id});
 }
 
 bool RestaurantDb::createUser(const User& user) {
@@ -345,47 +557,14 @@ std::optional<Table> RestaurantDb::getTableByNumber(const std::string& table_num
     if (!initialized_) return std::nullopt;
 
     std::string sql = "SELECT * FROM tables WHERE table_number = ?";
-    auto result = executeQueryWithParams(sql, {table_number});
-    
-    if (!result.empty()) {
-        Table table;
-        table.id = std::stoi(result[0][0]);
-        table.table_number = result[0][1];
-        table.table_name = result[0][2];
-        table.seat_count = std::stoi(result[0][3]);
-        table.table_type = result[0][4];
-        table.status = result[0][5];
-        table.location = result[0][6];
-        table.qr_code = result[0][7];
-        table.created_at = result[0][8];
-        table.updated_at = result[0][9];
-        return table;
-    }
-    return std::nullopt;
+    return queryOne<Table>(sql, {table_number});
 }
 
 std::vector<Table> RestaurantDb::getAllTables() {
-    std::vector<Table> tables;
-    if (!initialized_) return tables;
+    if (!initialized_) return {};
 
     std::string sql = "SELECT * FROM tables ORDER BY table_number";
-    auto result = executeQuery(sql);
-    
-    for (const auto& row : result) {
-        Table table;
-        table.id = std::stoi(row[0]);
-        table.table_number = row[1];
-        table.table_name = row[2];
-        table.seat_count = std::stoi(row[3]);
-        table.table_type = row[4];
-        table.status = row[5];
-        table.location = row[6];
-        table.qr_code = row[7];
-        table.created_at = row[8];
-        table.updated_at = row[9];
-        tables.push_back(table);
-    }
-    return tables;
+    return queryRows<Table>(sql);
 }
 
 bool RestaurantDb::updateTableStatus(int table_id, const std::string& status) {
@@ -397,145 +576,189 @@ bool RestaurantDb::updateTableStatus(int table_id, const std::string& status) {
 
 // 菜品相关操作
 std::vector<Dish> RestaurantDb::getAllDishes() {
-    std::vector<Dish> dishes;
-    if (!initialized_) return dishes;
+    if (!initialized_) return {};
 
-    std::string sql = "SELECT * FROM dishes WHERE is_available = 1 ORDER BY category_id, dish_name";
-    auto result = executeQuery(sql);
-    
-    for (const auto& row : result) {
-        Dish dish;
-        dish.id = std::stoi(row[0]);
-        dish.dish_code = row[1];
-        dish.dish_name = row[2];
-        dish.category_id = std::stoi(row[3]);
-        dish.price = std::stod(row[4]);
-        dish.original_price = std::stod(row[5]);
-        dish.description = row[6];
-        dish.ingredients = row[7];
-        dish.nutrition_info = row[8];
-        dish.taste_tags = row[9];
-        dish.allergen_info = row[10];
-        dish.cooking_time = std::stoi(row[11]);
-        dish.difficulty_level = row[12];
-        dish.image_url = row[13];
-        dish.images = row[14];
-        dish.is_recommended = (row[15] == "1");
-        dish.is_signature = (row[16] == "1");
-        dish.is_available = (row[17] == "1");
-        dish.stock_count = std::stoi(row[18]);
-        dish.sales_count = std::stoi(row[19]);
-        dish.rating = std::stod(row[20]);
-        dish.rating_count = std::stoi(row[21]);
-        dish.created_at = row[22];
-        dish.updated_at = row[23];
-        dishes.push_back(dish);
-    }
-    return dishes;
+    auto snapshot = getMenuSnapshot();
+    return snapshot->collect(snapshot->available);
 }
 
 std::vector<Dish> RestaurantDb::getRecommendedDishes() {
-    std::vector<Dish> dishes;
-    if (!initialized_) return dishes;
+    if (!initialized_) return {};
 
-    std::string sql = "SELECT * FROM dishes WHERE is_recommended = 1 AND is_available = 1 ORDER BY sales_count DESC";
-    auto result = executeQuery(sql);
-    
-    for (const auto& row : result) {
-        Dish dish;
-        dish.id = std::stoi(row[0]);
-        dish.dish_code = row[1];
-        dish.dish_name = row[2];
-        dish.category_id = std::stoi(row[3]);
-        dish.price = std::stod(row[4]);
-        dish.original_price = std::stod(row[5]);
-        dish.description = row[6];
-        dish.ingredients = row[7];
-        dish.nutrition_info = row[8];
-        dish.taste_tags = row[9];
-        dish.allergen_info = row[10];
-        dish.cooking_time = std::stoi(row[11]);
-        dish.difficulty_level = row[12];
-        dish.image_url = row[13];
-        dish.images = row[14];
-        dish.is_recommended = (row[15] == "1");
-        dish.is_signature = (row[16] == "1");
-        dish.is_available = (row[17] == "1");
-        dish.stock_count = std::stoi(row[18]);
-        dish.sales_count = std::stoi(row[19]);
-        dish.rating = std::stod(row[20]);
-        dish.rating_count = std::stoi(row[21]);
-        dish.created_at = row[22];
-        dish.updated_at = row[23];
-        dishes.push_back(dish);
-    }
-    return dishes;
+    auto snapshot = getMenuSnapshot();
+    return snapshot->collect(snapshot->recommended);
 }
 
 // AI推荐相关操作
-bool RestaurantDb::saveAiRecommendation(const AiRecommendation& recommendation) {
-    if (!initialized_) return false;
-
-    std::string sql = R"(INSERT INTO ai_recommendations (session_id, table_id, user_id, image_base64,
+static const char* kInsertAiRecommendationSql = R"(INSERT INTO ai_recommendations (session_id, table_id, user_id, image_base64,
                           vision_result, recommendation_result, season, meal_time,
-                          people_count, customer_portraits, recommended_dishes, processing_time)
-        VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?))";
-    
-    std::vector<std::string> params = {
+                          people_count, customer_portraits, recommended_dishes, processing_time, image_hash)
+        VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?))";
+
+static std::vector<std::string> aiRecommendationParams(const AiRecommendation& recommendation) {
+    return {
         recommendation.session_id, std::to_string(recommendation.table_id), recommendation.user_id, 
         recommendation.image_base64, recommendation.vision_result, recommendation.recommendation_result,
         recommendation.season, recommendation.meal_time, std::to_string(recommendation.people_count),
-        recommendation.customer_portraits, recommendation.recommended_dishes, std::to_string(recommendation.processing_time)
+        recommendation.customer_portraits, recommendation.recommended_dishes, std::to_string(recommendation.processing_time),
+        recommendation.image_hash
     };
-    
-    return executeSQLWithParams(sql, params);
 }
 
-// 心跳相关操作
-bool RestaurantDb::updateClientHeartbeat(const ClientHeartbeat& heartbeat) {
+bool RestaurantDb::saveAiRecommendation(const AiRecommendation& recommendation) {
+    if (!initialized_) return false;
+    return executeSQLWithParams(kInsertAiRecommendationSql, aiRecommendationParams(recommendation));
+}
+
+bool RestaurantDb::saveAiRecommendations(const std::vector<AiRecommendation>& recommendations) {
+    if (!initialized_) return false;
+    if (recommendations.empty()) return true;
+
+    return runWriteTransaction("批量写入AI推荐记录", [&]() {
+        for (const auto& recommendation : recommendations) {
+            if (!stepWithParamsLocked(kInsertAiRecommendationSql, aiRecommendationParams(recommendation))) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+size_t RestaurantDb::migrateImagesToBlobStore(ImageBlobStore& store) {
+    if (!initialized_) return 0;
+
+    // 按id分批迁移，每批在一个事务中更新；解码失败的记录保留原样，用游标跳过
+    const std::string select_sql = "SELECT id, image_base64 FROM ai_recommendations "
+                                   "WHERE id > ? AND image_base64 IS NOT NULL AND image_base64 != '' ORDER BY id LIMIT 64";
+    const std::string update_sql = "UPDATE ai_recommendations SET image_hash = ?, image_base64 = NULL WHERE id = ?";
+    int64_t last_id = 0;
+    size_t migrated = 0;
+    size_t failed = 0;
+
+    while (true) {
+        std::vector<std::pair<int64_t, std::string>> rows;
+        {
+            std::lock_guard<std::mutex> lock(db_mutex_);
+            stepRowsLocked(*statements_, select_sql, {std::to_string(last_id)}, [&rows](sqlite3_stmt* stmt) {
+                const char* image = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+                rows.emplace_back(sqlite3_column_int64(stmt, 0),
+                                  std::string(image ? image : "", sqlite3_column_bytes(stmt, 1)));
+                return true;
+            });
+        }
+        if (rows.empty()) {
+            break;
+        }
+        last_id = rows.back().first;
+
+        // 解码和写文件不持有数据库锁
+        std::vector<std::pair<int64_t, std::string>> hashes;
+        for (const auto& row : rows) {
+            std::string hash = store.put(row.second, true);
+            if (hash.empty()) {
+                failed++;
+            } else {
+                hashes.emplace_back(row.first, std::move(hash));
+            }
+        }
+
+        // 单条更新失败只跳过该记录，整批提交失败时这一批都保留原样
+        size_t updated = 0;
+        size_t update_failed = 0;
+        bool ok = runWriteTransaction("迁移推荐记录图片", [&]() {
+            updated = 0;
+            update_failed = 0;
+            for (const auto& item : hashes) {
+                if (stepWithParamsLocked(update_sql, {item.second, std::to_string(item.first)})) {
+                    updated++;
+                } else {
+                    LOG_F(WARNING, "迁移推荐记录 %lld 的图片失败: %s", static_cast<long long>(item.first), sqlite3_errmsg(db_));
+                    update_failed++;
+                }
+            }
+            return true;
+        });
+        if (ok) {
+            migrated += updated;
+            failed += update_failed;
+        } else {
+            failed += hashes.size();
+        }
+    }
+
+    if (migrated > 0 || failed > 0) {
+        LOG_F(INFO, "已将 %zu 条推荐记录的图片迁移到图片存储，%zu 条无法迁移保留原样", migrated, failed);
+    }
+    return migrated;
+}
+
+bool RestaurantDb::vacuum() {
     if (!initialized_) return false;
+    LOG_F(INFO, "执行VACUUM回收数据库空间...");
+    return executeSQL("VACUUM");
+}
 
-    std::string sql = R"(INSERT OR REPLACE INTO client_heartbeats 
-        (table_id, client_id, temperature, light_intensity, humidity, noise_level, 
+// 心跳相关操作
+// UPSERT保留原行的id和created_at；last_heartbeat为空时取当前时间
+static const char* kUpsertClientHeartbeatSql = R"(INSERT INTO client_heartbeats
+        (table_id, client_id, temperature, light_intensity, humidity, noise_level,
          battery_level, signal_strength, device_status, last_heartbeat, updated_at)
-        VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, CURRENT_TIMESTAMP, CURRENT_TIMESTAMP))";
-    
-    std::vector<std::string> params = {
+        VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, COALESCE(NULLIF(?, ''), CURRENT_TIMESTAMP), CURRENT_TIMESTAMP)
+        ON CONFLICT(table_id, client_id) DO UPDATE SET
+            temperature = excluded.temperature, light_intensity = excluded.light_intensity,
+            humidity = excluded.humidity, noise_level = excluded.noise_level,
+            battery_level = excluded.battery_level, signal_strength = excluded.signal_strength,
+            device_status = excluded.device_status, last_heartbeat = excluded.last_heartbeat,
+            updated_at = CURRENT_TIMESTAMP)";
+
+static std::vector<std::string> clientHeartbeatParams(const ClientHeartbeat& heartbeat) {
+    return {
         std::to_string(heartbeat.table_id), heartbeat.client_id, std::to_string(heartbeat.temperature),
         std::to_string(heartbeat.light_intensity), std::to_string(heartbeat.humidity), std::to_string(heartbeat.noise_level),
-        std::to_string(heartbeat.battery_level), std::to_string(heartbeat.signal_strength), heartbeat.device_status
+        std::to_string(heartbeat.battery_level), std::to_string(heartbeat.signal_strength), heartbeat.device_status,
+        heartbeat.last_heartbeat
     };
-    
-    return executeSQLWithParams(sql, params);
+}
+
+bool RestaurantDb::updateClientHeartbeat(const ClientHeartbeat& heartbeat) {
+    if (!initialized_) return false;
+    return executeSQLWithParams(kUpsertClientHeartbeatSql, clientHeartbeatParams(heartbeat));
+}
+
+bool RestaurantDb::saveClientHeartbeats(const std::vector<ClientHeartbeat>& heartbeats,
+                                        const std::vector<std::pair<int, std::string>>& removed) {
+    if (!initialized_) return false;
+    if (heartbeats.empty() && removed.empty()) return true;
+
+    return runWriteTransaction("批量写入心跳", [&]() {
+        // 先删除再写入，清理后又重新上线的客户端不会被误删
+        for (const auto& client : removed) {
+            if (!stepWithParamsLocked("DELETE FROM client_heartbeats WHERE table_id = ? AND client_id = ?",
+                                      {std::to_string(client.first), client.second})) {
+                return false;
+            }
+        }
+        for (const auto& heartbeat : heartbeats) {
+            if (!stepWithParamsLocked(kUpsertClientHeartbeatSql, clientHeartbeatParams(heartbeat))) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+std::vector<ClientHeartbeat> RestaurantDb::getAllClientHeartbeats() {
+    if (!initialized_) return {};
+    return queryRows<ClientHeartbeat>("SELECT * FROM client_heartbeats");
 }
 
 std::vector<ClientHeartbeat> RestaurantDb::getActiveClients() {
-    std::vector<ClientHeartbeat> clients;
-    if (!initialized_) return clients;
+    if (!initialized_) return {};
 
     std::string sql = R"(SELECT * FROM client_heartbeats 
         WHERE last_heartbeat > datetime('now', '-5 minutes') 
         ORDER BY last_heartbeat DESC)";
-    auto result = executeQuery(sql);
-    
-    for (const auto& row : result) {
-        ClientHeartbeat heartbeat;
-        heartbeat.id = std::stoi(row[0]);
-        heartbeat.table_id = std::stoi(row[1]);
-        heartbeat.client_id = row[2];
-        heartbeat.temperature = std::stod(row[3]);
-        heartbeat.light_intensity = std::stod(row[4]);
-        heartbeat.humidity = std::stod(row[5]);
-        heartbeat.noise_level = std::stod(row[6]);
-        heartbeat.battery_level = std::stoi(row[7]);
-        heartbeat.signal_strength = std::stoi(row[8]);
-        heartbeat.device_status = row[9];
-        heartbeat.last_heartbeat = row[10];
-        heartbeat.created_at = row[11];
-        heartbeat.updated_at = row[12];
-        clients.push_back(heartbeat);
-    }
-    return clients;
+    return queryRows<ClientHeartbeat>(sql);
 }
 
 // 服务呼叫相关操作
@@ -559,225 +782,468 @@ std::string RestaurantDb::createServiceCall(const ServiceCall& call) {
 }
 
 std::vector<ServiceCall> RestaurantDb::getPendingServiceCalls() {
-    std::vector<ServiceCall> calls;
-    if (!initialized_) return calls;
+    if (!initialized_) return {};
 
     std::string sql = "SELECT * FROM service_calls WHERE call_status = 'pending' ORDER BY call_time ASC";
-    auto result = executeQuery(sql);
-    
-    for (const auto& row : result) {
-        ServiceCall call;
-        call.id = std::stoi(row[0]);
-        call.call_id = row[1];
-        call.table_id = std::stoi(row[2]);
-        call.client_id = row[3];
-        call.user_id = row[4];
-        call.call_type = row[5];
-        call.priority = row[6];
-        call.description = row[7];
-        call.call_status = row[8];
-        call.assigned_staff_id = row[9];
-        call.call_time = row[10];
-        call.response_time = row[11];
-        call.complete_time = row[12];
-        call.response_duration = row[13].empty() ? 0 : std::stoi(row[13]);
-        call.service_duration = row[14].empty() ? 0 : std::stoi(row[14]);
-        call.customer_rating = row[15].empty() ? 0 : std::stoi(row[15]);
-        call.customer_feedback = row[16];
-        call.created_at = row[17];
-        call.updated_at = row[18];
-        calls.push_back(call);
-    }
-    return calls;
+    return queryRows<ServiceCall>(sql);
 }
 
 // 辅助方法实现
-std::vector<std::vector<std::string>> RestaurantDb::executeQuery(const std::string& sql) {
+bool RestaurantDb::forEachStatementRow(const std::string& sql, const std::vector<std::string>& params,
+                                       const std::function<bool(sqlite3_stmt*)>& callback) {
+    // WAL模式下读操作走只读连接池，不与写操作争用db_mutex_
+    if (!readers_.empty()) {
+        ReadConnection* reader = nullptr;
+        std::unique_lock<std::mutex> lock = acquireReader(reader);
+        return stepRowsLocked(*reader->statements, sql, params, callback);
+    }
+
     std::lock_guard<std::mutex> lock(db_mutex_);
-    std::vector<std::vector<std::string>> result;
+    return stepRowsLocked(*statements_, sql, params, callback);
+}
+
+bool RestaurantDb::stepRowsLocked(StatementCache& statements, const std::string& sql,
+                                  const std::vector<std::string>& params,
+                                  const std::function<bool(sqlite3_stmt*)>& callback) {
+    StatementCache::Handle stmt = statements.acquire(sql);
+    if (!stmt) {
+        return false;
+    }
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        LOG_F(ERROR, "SQL准备失败: %s", sqlite3_errmsg(db_));
-        return result;
+    // 绑定参数
+    for (size_t i = 0; i < params.size(); i++) {
+        sqlite3_bind_text(stmt.get(), i + 1, params[i].c_str(), -1, SQLITE_STATIC);
     }
     
-    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-        std::vector<std::string> row;
-        int column_count = sqlite3_column_count(stmt);
-        for (int i = 0; i < column_count; i++) {
-            const char* value = (const char*)sqlite3_column_text(stmt, i);
-            row.push_back(value ? value : "");
+    int rc;
+    while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+        if (!callback(stmt.get())) {
+            return true;
         }
-        result.push_back(row);
     }
     
-    sqlite3_finalize(stmt);
-    return result;
+    if (rc != SQLITE_DONE) {
+        LOG_F(ERROR, "SQL执行失败: %s", sqlite3_errmsg(sqlite3_db_handle(stmt.get())));
+        return false;
+    }
+    return true;
 }
 
-std::vector<std::vector<std::string>> RestaurantDb::executeQueryWithParams(const std::string& sql, const std::vector<std::string>& params) {
+bool RestaurantDb::runWriteTransaction(const char* what, const std::function<bool()>& body,
+                                       const std::function<void()>& committed) {
     std::lock_guard<std::mutex> lock(db_mutex_);
-    std::vector<std::vector<std::string>> result;
-    
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        LOG_F(ERROR, "SQL准备失败: %s", sqlite3_errmsg(db_));
-        return result;
+    char* errMsg = nullptr;
+    if (sqlite3_exec(db_, "BEGIN IMMEDIATE", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        LOG_F(ERROR, "开启%s事务失败: %s", what, errMsg);
+        sqlite3_free(errMsg);
+        return false;
     }
-    
-    // 绑定参数
-    for (size_t i = 0; i < params.size(); i++) {
-        sqlite3_bind_text(stmt, i + 1, params[i].c_str(), -1, SQLITE_STATIC);
+    if (!body()) {
+        LOG_F(ERROR, "%s失败: %s, 回滚", what, sqlite3_errmsg(db_));
+        sqlite3_exec(db_, "ROLLBACK", nullptr, nullptr, nullptr);
+        return false;
     }
-    
-    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-        std::vector<std::string> row;
-        int column_count = sqlite3_column_count(stmt);
-        for (int i = 0; i < column_count; i++) {
-            const char* value = (const char*)sqlite3_column_text(stmt, i);
-            row.push_back(value ? value : "");
-        }
-        result.push_back(row);
+    if (sqlite3_exec(db_, "COMMIT", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        LOG_F(ERROR, "提交%s事务失败: %s", what, errMsg);
+        sqlite3_free(errMsg);
+        sqlite3_exec(db_, "ROLLBACK", nullptr, nullptr, nullptr);
+        return false;
     }
-    
-    sqlite3_finalize(stmt);
-    return result;
+    if (committed) {
+        committed();
+    }
+    return true;
 }
 
 bool RestaurantDb::executeSQLWithParams(const std::string& sql, const std::vector<std::string>& params) {
     std::lock_guard<std::mutex> lock(db_mutex_);
-    
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        LOG_F(ERROR, "SQL准备失败: %s", sqlite3_errmsg(db_));
+    return stepWithParamsLocked(sql, params);
+}
+
+bool RestaurantDb::stepWithParamsLocked(const std::string& sql, const std::vector<std::string>& params) {
+    StatementCache::Handle stmt = statements_->acquire(sql);
+    if (!stmt) {
         return false;
     }
     
     // 绑定参数
     for (size_t i = 0; i < params.size(); i++) {
-        sqlite3_bind_text(stmt, i + 1, params[i].c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), i + 1, params[i].c_str(), -1, SQLITE_STATIC);
     }
     
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    
+    int rc = sqlite3_step(stmt.get());
     return rc == SQLITE_DONE;
 }
 
+std::vector<StatementStats> RestaurantDb::getStatementStats() {
+    std::vector<StatementStats> stats;
+    {
+        std::lock_guard<std::mutex> lock(db_mutex_);
+        if (statements_) {
+            stats = statements_->getStats();
+        }
+    }
+
+    // 合并各只读连接上同一条SQL的统计
+    for (auto& reader : readers_) {
+        std::lock_guard<std::mutex> lock(reader->mutex);
+        for (const auto& reader_stats : reader->statements->getStats()) {
+            auto it = std::find_if(stats.begin(), stats.end(), [&](const StatementStats& s) {
+                return s.sql == reader_stats.sql;
+            });
+            if (it == stats.end()) {
+                stats.push_back(reader_stats);
+            } else {
+                it->executions += reader_stats.executions;
+                it->total_ms += reader_stats.total_ms;
+            }
+        }
+    }
+
+    std::sort(stats.begin(), stats.end(), [](const StatementStats& a, const StatementStats& b) {
+        return a.total_ms > b.total_ms;
+    });
+    return stats;
+}
+
 // 其他方法的简化实现
 std::optional<Table> RestaurantDb::getTableById(int table_id) {
     if (!initialized_) return std::nullopt;
     std::string sql = "SELECT * FROM tables WHERE id = ?";
-    auto result = executeQueryWithParams(sql, {std::to_string(table_id)});
-    if (!result.empty()) {
-        Table table;
-        table.id = std::stoi(result[0][0]);
-        table.table_number = result[0][1];
-        table.table_name = result[0][2];
-        table.seat_count = std::stoi(result[0][3]);
-        table.table_type = result[0][4];
-        table.status = result[0][5];
-        table.location = result[0][6];
-        table.qr_code = result[0][7];
-        table.created_at = result[0][8];
-        table.updated_at = result[0][9];
-        return table;
-    }
-    return std::nullopt;
+    return queryOne<Table>(sql, {std::to_string(table_id)});
 }
 
 std::vector<Dish> RestaurantDb::getDishesByCategory(int category_id) {
-    std::vector<Dish> dishes;
-    if (!initialized_) return dishes;
-    std::string sql = "SELECT * FROM dishes WHERE category_id = ? AND is_available = 1 ORDER BY dish_name";
-    auto result = executeQueryWithParams(sql, {std::to_string(category_id)});
-    // 实现类似getAllDishes的逻辑
-    return dishes;
+    if (!initialized_) return {};
+    auto snapshot = getMenuSnapshot();
+    auto it = snapshot->by_category.find(category_id);
+    return it == snapshot->by_category.end() ? std::vector<Dish>() : snapshot->collect(it->second);
 }
 
 std::vector<Dish> RestaurantDb::getSignatureDishes() {
-    std::vector<Dish> dishes;
-    if (!initialized_) return dishes;
-    std::string sql = "SELECT * FROM dishes WHERE is_signature = 1 AND is_available = 1 ORDER BY sales_count DESC";
-    auto result = executeQuery(sql);
-    // 实现类似getAllDishes的逻辑
-    return dishes;
+    if (!initialized_) return {};
+    auto snapshot = getMenuSnapshot();
+    return snapshot->collect(snapshot->signature);
 }
 
 std::optional<Dish> RestaurantDb::getDishById(int dish_id) {
     if (!initialized_) return std::nullopt;
-    std::string sql = "SELECT * FROM dishes WHERE id = ?";
-    auto result = executeQueryWithParams(sql, {std::to_string(dish_id)});
-    // 实现类似getUserById的逻辑
-    return std::nullopt;
+    auto snapshot = getMenuSnapshot();
+    auto it = snapshot->by_id.find(dish_id);
+    return it != snapshot->by_id.end() ? std::optional<Dish>(snapshot->copy(it->second)) : std::nullopt;
 }
 
 std::optional<Dish> RestaurantDb::getDishByCode(const std::string& dish_code) {
     if (!initialized_) return std::nullopt;
-    std::string sql = "SELECT * FROM dishes WHERE dish_code = ?";
-    auto result = executeQueryWithParams(sql, {dish_code});
-    // 实现类似getUserById的逻辑
-    return std::nullopt;
+    auto snapshot = getMenuSnapshot();
+    auto it = snapshot->by_code.find(dish_code);
+    return it != snapshot->by_code.end() ? std::optional<Dish>(snapshot->copy(it->second)) : std::nullopt;
 }
 
 bool RestaurantDb::updateDishStock(int dish_id, int stock_count) {
     if (!initialized_) return false;
     std::string sql = "UPDATE dishes SET stock_count = ?, updated_at = CURRENT_TIMESTAMP WHERE id = ?";
-    return executeSQLWithParams(sql, {std::to_string(stock_count), std::to_string(dish_id)});
+    if (!executeSQLWithParams(sql, {std::to_string(stock_count), std::to_string(dish_id)})) {
+        return false;
+    }
+
+    // 只重新读取这一道菜并发布新快照
+    auto dish = queryOne<Dish>("SELECT * FROM dishes WHERE id = ?", {std::to_string(dish_id)});
+    if (dish) {
+        menu_cache_->upsert(*dish);
+    }
+    return true;
 }
 
-std::string RestaurantDb::createOrder(const Order& order) {
-    if (!initialized_) return "";
-    std::string order_no = generateOrderNo();
-    std::string sql = R"(INSERT INTO orders (order_no, table_id, user_id, order_type, people_count,
+bool RestaurantDb::saveDishStocks(const std::vector<std::pair<int, int>>& stocks) {
+    if (!initialized_) return false;
+    if (stocks.empty()) return true;
+    return runWriteTransaction("写回库存", [&]() {
+        for (const auto& entry : stocks) {
+            if (!stepWithParamsLocked("UPDATE dishes SET stock_count = ?, updated_at = CURRENT_TIMESTAMP WHERE id = ?",
+                                      {std::to_string(entry.second), std::to_string(entry.first)})) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+std::shared_ptr<const MenuSnapshot> RestaurantDb::getMenuSnapshot() const {
+    return menu_cache_->current();
+}
+
+MenuDelta RestaurantDb::getMenuChanges(uint64_t since, const MenuSnapshot& snapshot) const {
+    return menu_cache_->diff(since, snapshot);
+}
+
+uint64_t RestaurantDb::getMenuVersion() const {
+    return menu_cache_->version();
+}
+
+void RestaurantDb::setMenuVersionListener(std::function<void(uint64_t)> listener) {
+    menu_cache_->setVersionListener(std::move(listener));
+}
+
+bool RestaurantDb::reloadMenu() {
+    if (!initialized_) return false;
+    std::vector<Dish> dishes;
+    if (!forEachStatementRow("SELECT * FROM dishes", {}, [&dishes](sqlite3_stmt* stmt) {
+            dishes.emplace_back();
+            mapRow(stmt, dishes.back());
+            return true;
+        })) {
+        return false;
+    }
+    menu_cache_->publish(std::move(dishes));
+    return true;
+}
+
+static const char* kInsertOrderSql = R"(INSERT INTO orders (order_no, table_id, user_id, order_type, people_count,
                           total_amount, discount_amount, final_amount, payment_method,
                           payment_status, order_status, special_requirements, estimated_time)
         VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?))";
-    
-    std::vector<std::string> params = {
+
+static std::vector<std::string> orderParams(const Order& order, const std::string& order_no) {
+    return {
         order_no, std::to_string(order.table_id), order.user_id, order.order_type, std::to_string(order.people_count),
         std::to_string(order.total_amount), std::to_string(order.discount_amount), std::to_string(order.final_amount),
         order.payment_method, order.payment_status, order.order_status, order.special_requirements, std::to_string(order.estimated_time)
     };
-    
-    if (executeSQLWithParams(sql, params)) {
-        return order_no;
+}
+
+// 新订单对统计的增量，日期和小时由created_at确定
+static OrderStatsRow newOrderStatsDelta(const Order& order) {
+    OrderStatsRow delta{"", 0, 1, order.people_count, 0, 0};
+    if (order.payment_status == "paid") {
+        delta.paid_count = 1;
+        delta.revenue_cents = toCents(order.final_amount);
     }
-    return "";
+    return delta;
+}
+
+// 一次INSERT最多写入的订单项行数（8列，远低于SQLite的参数个数上限）
+static constexpr size_t kOrderItemsPerInsert = 16;
+
+// rows行的多行INSERT语句；相同行数的SQL文本相同，可复用语句缓存中的预编译语句
+static const std::string& insertOrderItemsSql(size_t rows) {
+    static const std::vector<std::string> sqls = [] {
+        std::vector<std::string> result(kOrderItemsPerInsert + 1);
+        for (size_t n = 1; n <= kOrderItemsPerInsert; n++) {
+            std::string sql = "INSERT INTO order_items (order_id, dish_id, dish_name, dish_price, quantity, subtotal, "
+                              "special_requirements, item_status) VALUES ";
+            for (size_t i = 0; i < n; i++) {
+                sql += i == 0 ? "(?, ?, ?, ?, ?, ?, ?, ?)" : ", (?, ?, ?, ?, ?, ?, ?, ?)";
+            }
+            result[n] = std::move(sql);
+        }
+        return result;
+    }();
+    return sqls[rows];
+}
+
+static void appendOrderItemParams(const OrderItem& item, std::vector<std::string>& params) {
+    params.push_back(std::to_string(item.order_id));
+    params.push_back(std::to_string(item.dish_id));
+    params.push_back(item.dish_name);
+    params.push_back(std::to_string(item.dish_price));
+    params.push_back(std::to_string(item.quantity));
+    params.push_back(std::to_string(item.subtotal));
+    params.push_back(item.special_requirements);
+    params.push_back(item.item_status);
+}
+
+std::string RestaurantDb::createOrder(const Order& order) {
+    if (!initialized_) return "";
+    std::string order_no = generateOrderNo();
+    std::vector<std::string> params = orderParams(order, order_no);
+    
+    OrderStatsRow delta = newOrderStatsDelta(order);
+    bool has_slot = false;
+    bool ok = runWriteTransaction("下单", [&]() {
+        if (!stepWithParamsLocked(kInsertOrderSql, params)) {
+            return false;
+        }
+        // 统计按订单的created_at归入小时，与DATE(created_at)的口径一致
+        std::string created_at;
+        stepRowsLocked(*statements_, "SELECT created_at FROM orders WHERE id = last_insert_rowid()", {},
+                       [&created_at](sqlite3_stmt* stmt) {
+            readColumn(stmt, 0, created_at);
+            return false;
+        });
+        has_slot = orderStatsSlot(created_at, delta);
+        if (!has_slot) {
+            LOG_F(WARNING, "订单 %s 的created_at无法识别: %s，不计入统计", order_no.c_str(), created_at.c_str());
+            return true;
+        }
+        return applyOrderStatsLocked(delta);
+    }, [&]() {
+        if (has_slot) {
+            order_stats_->apply(delta);
+        }
+    });
+    return ok ? order_no : "";
 }
 
 bool RestaurantDb::addOrderItem(const OrderItem& item) {
     if (!initialized_) return false;
-    std::string sql = R"(INSERT INTO order_items (order_id, dish_id, dish_name, dish_price, quantity, subtotal, special_requirements, item_status)
-        VALUES (?, ?, ?, ?, ?, ?, ?, ?))";
+    std::vector<std::string> params;
+    appendOrderItemParams(item, params);
     
-    std::vector<std::string> params = {
-        std::to_string(item.order_id), std::to_string(item.dish_id), item.dish_name, std::to_string(item.dish_price),
-        std::to_string(item.quantity), std::to_string(item.subtotal), item.special_requirements, item.item_status
-    };
-    
-    return executeSQLWithParams(sql, params);
+    if (!executeSQLWithParams(insertOrderItemsSql(1), params)) {
+        return false;
+    }
+    if (order_item_listener_ && item.item_status != "cancelled") {
+        order_item_listener_(item);
+    }
+    return true;
+}
+
+std::optional<PlacedOrder> RestaurantDb::placeOrder(const Order& order, const std::vector<OrderItem>& items,
+                                                   bool deduct_stock) {
+    if (!initialized_) return std::nullopt;
+    if (items.empty()) {
+        LOG_F(WARNING, "下单失败: 没有订单项");
+        return std::nullopt;
+    }
+
+    // 按菜单补齐订单项，并按菜品汇总需要扣减的份数
+    Order pending = order;
+    std::vector<OrderItem> lines = items;
+    std::map<int, int> quantities;
+    double total = 0.0;
+    auto menu = menu_cache_->current();
+    for (auto& line : lines) {
+        const Dish* dish = menu->findById(line.dish_id);
+        if (!dish || line.quantity <= 0) {
+            LOG_F(WARNING, "下单失败: 菜品 %d 不存在或份数 %d 无效", line.dish_id, line.quantity);
+            return std::nullopt;
+        }
+        if (line.dish_name.empty()) line.dish_name = dish->dish_name;
+        if (line.dish_price <= 0) line.dish_price = dish->price;
+        if (line.subtotal <= 0) line.subtotal = line.dish_price * line.quantity;
+        if (line.item_status.empty()) line.item_status = "pending";
+        if (line.item_status == "cancelled") {
+            continue;
+        }
+        quantities[line.dish_id] += line.quantity;
+        total += line.subtotal;
+    }
+    if (pending.payment_status.empty()) pending.payment_status = "pending";
+    if (pending.order_status.empty()) pending.order_status = "pending";
+    if (pending.total_amount <= 0) pending.total_amount = total;
+    if (pending.final_amount <= 0) pending.final_amount = std::max(0.0, pending.total_amount - pending.discount_amount);
+
+    std::string order_no = generateOrderNo();
+    OrderStatsRow delta = newOrderStatsDelta(pending);
+    bool has_slot = false;
+    PlacedOrder placed;
+    std::vector<Dish> changed_dishes;
+    bool ok = runWriteTransaction("下单", [&]() {
+        if (!stepWithParamsLocked(kInsertOrderSql, orderParams(pending, order_no))) {
+            return false;
+        }
+        int order_id = static_cast<int>(sqlite3_last_insert_rowid(db_));
+
+        // 订单项分块写入，每块一条多行INSERT
+        std::vector<std::string> params;
+        for (size_t begin = 0; begin < lines.size(); begin += kOrderItemsPerInsert) {
+            size_t end = std::min(lines.size(), begin + kOrderItemsPerInsert);
+            params.clear();
+            for (size_t i = begin; i < end; i++) {
+                lines[i].order_id = order_id;
+                appendOrderItemParams(lines[i], params);
+            }
+            if (!stepWithParamsLocked(insertOrderItemsSql(end - begin), params)) {
+                return false;
+            }
+        }
+
+        // 库存不足或菜品已下架时条件不成立，整单回滚
+        changed_dishes.clear();
+        for (const auto& entry : quantities) {
+            std::string quantity = std::to_string(entry.second);
+            std::string dish_id = std::to_string(entry.first);
+            bool updated = deduct_stock
+                ? stepWithParamsLocked(R"(UPDATE dishes SET sales_count = sales_count + ?, stock_count = stock_count - ?,
+                    updated_at = CURRENT_TIMESTAMP WHERE id = ? AND is_available = 1 AND stock_count >= ?)",
+                    {quantity, quantity, dish_id, quantity})
+                : stepWithParamsLocked(R"(UPDATE dishes SET sales_count = sales_count + ?,
+                    updated_at = CURRENT_TIMESTAMP WHERE id = ? AND is_available = 1)", {quantity, dish_id});
+            if (!updated) {
+                return false;
+            }
+            if (sqlite3_changes(db_) == 0) {
+                LOG_F(WARNING, "下单失败: 菜品 %d 已下架或库存不足 %d 份", entry.first, entry.second);
+                return false;
+            }
+            Dish dish{};
+            stepRowsLocked(*statements_, "SELECT * FROM dishes WHERE id = ?", {dish_id}, [&dish](sqlite3_stmt* stmt) {
+                mapRow(stmt, dish);
+                return false;
+            });
+            changed_dishes.push_back(std::move(dish));
+        }
+
+        // 在写连接上读回完整的订单和订单项
+        std::string id = std::to_string(order_id);
+        placed.order = Order{};
+        placed.items.clear();
+        stepRowsLocked(*statements_, "SELECT * FROM orders WHERE id = ?", {id}, [&placed](sqlite3_stmt* stmt) {
+            mapRow(stmt, placed.order);
+            return false;
+        });
+        if (!stepRowsLocked(*statements_, "SELECT * FROM order_items WHERE order_id = ? ORDER BY id", {id},
+                            [&placed](sqlite3_stmt* stmt) {
+            OrderItem item{};
+            mapRow(stmt, item);
+            placed.items.push_back(std::move(item));
+            return true;
+        }) || placed.order.id != order_id || placed.items.size() != lines.size()) {
+            return false;
+        }
+
+        has_slot = orderStatsSlot(placed.order.created_at, delta);
+        if (!has_slot) {
+            LOG_F(WARNING, "订单 %s 的created_at无法识别: %s，不计入统计", order_no.c_str(),
+                  placed.order.created_at.c_str());
+            return true;
+        }
+        return applyOrderStatsLocked(delta);
+    }, [&]() {
+        if (has_slot) {
+            order_stats_->apply(delta);
+        }
+        // 销量和库存只是计数：原子写入当前快照，不复制菜单也不发布新版本
+        menu_cache_->updateCounters(changed_dishes);
+        if (order_item_listener_) {
+            for (const auto& item : placed.items) {
+                if (item.item_status != "cancelled") {
+                    order_item_listener_(item);
+                }
+            }
+        }
+    });
+    if (!ok) {
+        return std::nullopt;
+    }
+    return placed;
+}
+
+void RestaurantDb::setOrderItemListener(std::function<void(const OrderItem&)> listener) {
+    order_item_listener_ = std::move(listener);
 }
 
 std::optional<Order> RestaurantDb::getOrderByNo(const std::string& order_no) {
     if (!initialized_) return std::nullopt;
     std::string sql = "SELECT * FROM orders WHERE order_no = ?";
-    auto result = executeQueryWithParams(sql, {order_no});
-    // 实现类似getUserById的逻辑
-    return std::nullopt;
+    return queryOne<Order>(sql, {order_no});
 }
 
 std::vector<OrderItem> RestaurantDb::getOrderItems(int order_id) {
-    std::vector<OrderItem> items;
-    if (!initialized_) return items;
+    if (!initialized_) return {};
     std::string sql = "SELECT * FROM order_items WHERE order_id = ? ORDER BY id";
-    auto result = executeQueryWithParams(sql, {std::to_string(order_id)});
-    // 实现类似getAllTables的逻辑
-    return items;
+    return queryRows<OrderItem>(sql, {std::to_string(order_id)});
 }
 
 bool RestaurantDb::updateOrderStatus(const std::string& order_no, const std::string& status) {
@@ -789,15 +1255,47 @@ bool RestaurantDb::updateOrderStatus(const std::string& order_no, const std::str
 bool RestaurantDb::updateOrderPaymentStatus(const std::string& order_no, const std::string& payment_status) {
     if (!initialized_) return false;
     std::string sql = "UPDATE orders SET payment_status = ?, updated_at = CURRENT_TIMESTAMP WHERE order_no = ?";
-    return executeSQLWithParams(sql, {payment_status, order_no});
+
+    // 变为已支付时计入当天营业额，从已支付变为其他状态（如退款）时扣除
+    OrderStatsRow delta{"", 0, 0, 0, 0, 0};
+    bool changed = false;
+    return runWriteTransaction("更新支付状态", [&]() {
+        bool found = false;
+        bool was_paid = false;
+        double final_amount = 0.0;
+        std::string created_at;
+        stepRowsLocked(*statements_, "SELECT created_at, payment_status, final_amount FROM orders WHERE order_no = ?",
+                       {order_no}, [&](sqlite3_stmt* stmt) {
+            std::string status;
+            readColumn(stmt, 0, created_at);
+            readColumn(stmt, 1, status);
+            readColumn(stmt, 2, final_amount);
+            was_paid = status == "paid";
+            found = true;
+            return false;
+        });
+        if (!stepWithParamsLocked(sql, {payment_status, order_no})) {
+            return false;
+        }
+        bool now_paid = payment_status == "paid";
+        if (!found || was_paid == now_paid || !orderStatsSlot(created_at, delta)) {
+            return true;
+        }
+        delta.paid_count = now_paid ? 1 : -1;
+        delta.revenue_cents = now_paid ? toCents(final_amount) : -toCents(final_amount);
+        changed = true;
+        return applyOrderStatsLocked(delta);
+    }, [&]() {
+        if (changed) {
+            order_stats_->apply(delta);
+        }
+    });
 }
 
 std::optional<AiRecommendation> RestaurantDb::getAiRecommendation(const std::string& session_id) {
     if (!initialized_) return std::nullopt;
     std::string sql = "SELECT * FROM ai_recommendations WHERE session_id = ?";
-    auto result = executeQueryWithParams(sql, {session_id});
-    // 实现类似getUserById的逻辑
-    return std::nullopt;
+    return queryOne<AiRecommendation>(sql, {session_id});
 }
 
 bool RestaurantDb::updateAiRecommendationFeedback(const std::string& session_id, int score, const std::string& comment) {
@@ -806,12 +1304,59 @@ bool RestaurantDb::updateAiRecommendationFeedback(const std::string& session_id,
     return executeSQLWithParams(sql, {std::to_string(score), comment, session_id});
 }
 
+bool RestaurantDb::saveEnvironmentBlocks(const std::vector<EnvironmentRollupBlock>& blocks) {
+    if (!initialized_) return false;
+    if (blocks.empty()) return true;
+
+    static const char* sql = R"(INSERT OR REPLACE INTO environment_rollups
+        (table_id, resolution, block_start, bucket_count, data) VALUES (?, ?, ?, ?, ?))";
+
+    return runWriteTransaction("写入环境数据", [&]() {
+        for (const auto& block : blocks) {
+            // 块数据是二进制，不能走按文本绑定的stepWithParamsLocked
+            StatementCache::Handle stmt = statements_->acquire(sql);
+            if (!stmt) {
+                return false;
+            }
+            sqlite3_bind_int(stmt.get(), 1, block.table_id);
+            sqlite3_bind_int(stmt.get(), 2, block.resolution);
+            sqlite3_bind_int64(stmt.get(), 3, block.block_start);
+            sqlite3_bind_int(stmt.get(), 4, block.bucket_count);
+            sqlite3_bind_blob(stmt.get(), 5, block.data.data(), static_cast<int>(block.data.size()), SQLITE_STATIC);
+            if (sqlite3_step(stmt.get()) != SQLITE_DONE) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+std::vector<EnvironmentRollupBlock> RestaurantDb::getEnvironmentBlocks(int table_id, int resolution,
+                                                                       int64_t from, int64_t to) {
+    if (!initialized_) return {};
+    std::string sql = R"(SELECT * FROM environment_rollups
+        WHERE table_id = ? AND resolution = ? AND block_start >= ? AND block_start <= ?
+        ORDER BY block_start)";
+    return queryRows<EnvironmentRollupBlock>(sql, {std::to_string(table_id), std::to_string(resolution),
+                                                   std::to_string(from), std::to_string(to)});
+}
+
+std::vector<EnvironmentRollupBlock> RestaurantDb::getRecentEnvironmentBlocks(int resolution, int64_t since) {
+    if (!initialized_) return {};
+    std::string sql = "SELECT * FROM environment_rollups WHERE resolution = ? AND block_start >= ?";
+    return queryRows<EnvironmentRollupBlock>(sql, {std::to_string(resolution), std::to_string(since)});
+}
+
+bool RestaurantDb::pruneEnvironmentBlocks(int resolution, int64_t before) {
+    if (!initialized_) return false;
+    std::string sql = "DELETE FROM environment_rollups WHERE resolution = ? AND block_start < ?";
+    return executeSQLWithParams(sql, {std::to_string(resolution), std::to_string(before)});
+}
+
 std::optional<ClientHeartbeat> RestaurantDb::getClientHeartbeat(int table_id, const std::string& client_id) {
     if (!initialized_) return std::nullopt;
     std::string sql = "SELECT * FROM client_heartbeats WHERE table_id = ? AND client_id = ?";
-    auto result = executeQueryWithParams(sql, {std::to_string(table_id), client_id});
-    // 实现类似getUserById的逻辑
-    return std::nullopt;
+    return queryOne<ClientHeartbeat>(sql, {std::to_string(table_id), client_id});
 }
 
 bool RestaurantDb::cleanupInactiveClients(int timeout_seconds) {
@@ -821,12 +1366,9 @@ bool RestaurantDb::cleanupInactiveClients(int timeout_seconds) {
 }
 
 std::vector<ServiceCall> RestaurantDb::getServiceCallsByTable(int table_id) {
-    std::vector<ServiceCall> calls;
-    if (!initialized_) return calls;
+    if (!initialized_) return {};
     std::string sql = "SELECT * FROM service_calls WHERE table_id = ? ORDER BY call_time DESC LIMIT 10";
-    auto result = executeQueryWithParams(sql, {std::to_string(table_id)});
-    // 实现类似getPendingServiceCalls的逻辑
-    return calls;
+    return queryRows<ServiceCall>(sql, {std::to_string(table_id)});
 }
 
 bool RestaurantDb::updateServiceCallStatus(const std::string& call_id, const std::string& status) {
@@ -871,26 +1413,121 @@ bool RestaurantDb::deleteUser(const std::string& user_id) {
 // 统计相关操作
 int RestaurantDb::getTodayOrderCount() {
     if (!initialized_) return 0;
-    std::string sql = "SELECT COUNT(*) FROM orders WHERE DATE(created_at) = DATE('now')";
-    auto result = executeQuery(sql);
-    return result.empty() ? 0 : std::stoi(result[0][0]);
+    return static_cast<int>(getDailyOrderStats(UtcTime::formatDate(std::chrono::system_clock::now())).order_count);
 }
 
 double RestaurantDb::getTodayRevenue() {
     if (!initialized_) return 0.0;
-    std::string sql = "SELECT SUM(final_amount) FROM orders WHERE DATE(created_at) = DATE('now') AND payment_status = 'paid'";
-    auto result = executeQuery(sql);
-    return result.empty() ? 0.0 : std::stod(result[0][0]);
+    return getDailyOrderStats(UtcTime::formatDate(std::chrono::system_clock::now())).revenue();
+}
+
+OrderStatsRow RestaurantDb::getDailyOrderStats(const std::string& date) {
+    std::vector<OrderStatsRow> days = getDailyOrderStats(date, date);
+    return days.empty() ? OrderStatsRow{date, -1, 0, 0, 0, 0} : days.front();
+}
+
+std::vector<OrderStatsRow> RestaurantDb::getDailyOrderStats(const std::string& from, const std::string& to) {
+    std::vector<OrderStatsRow> days;
+    int64_t from_day, to_day;
+    if (!initialized_ || !UtcTime::parseDate(from, from_day) || !UtcTime::parseDate(to, to_day) || to_day < from_day) {
+        return days;
+    }
+
+    // 内存窗口内的日期直接读内存，更早的部分按主键范围查询汇总表
+    int64_t first_resident = order_stats_->firstDay();
+    std::map<std::string, OrderStatsRow> stored;
+    if (from_day < first_resident) {
+        std::string sql = R"(SELECT stat_date, -1, SUM(order_count), SUM(covers), SUM(paid_count), SUM(revenue_cents)
+            FROM order_stats_hourly WHERE stat_date >= ? AND stat_date <= ? GROUP BY stat_date)";
+        int64_t last = std::min(to_day, first_resident - 1);
+        for (auto& row : queryRows<OrderStatsRow>(sql, {UtcTime::dateFromDays(from_day), UtcTime::dateFromDays(last)})) {
+            stored.emplace(row.stat_date, row);
+        }
+    }
+
+    days.reserve(static_cast<size_t>(to_day - from_day + 1));
+    for (int64_t day = from_day; day <= to_day; day++) {
+        if (std::optional<OrderStatsRow> resident = order_stats_->day(day)) {
+            days.push_back(std::move(*resident));
+            continue;
+        }
+        std::string date = UtcTime::dateFromDays(day);
+        auto it = stored.find(date);
+        days.push_back(it != stored.end() ? it->second : OrderStatsRow{date, -1, 0, 0, 0, 0});
+    }
+    return days;
+}
+
+std::vector<OrderStatsRow> RestaurantDb::getHourlyOrderStats(const std::string& date) {
+    int64_t day;
+    if (!initialized_ || !UtcTime::parseDate(date, day)) return {};
+    if (std::optional<std::vector<OrderStatsRow>> resident = order_stats_->hours(day)) {
+        return std::move(*resident);
+    }
+
+    std::string normalized = UtcTime::dateFromDays(day);
+    std::vector<OrderStatsRow> hours;
+    for (int hour = 0; hour < 24; hour++) {
+        hours.push_back(OrderStatsRow{normalized, hour, 0, 0, 0, 0});
+    }
+    for (const auto& row : queryRows<OrderStatsRow>("SELECT * FROM order_stats_hourly WHERE stat_date = ?", {normalized})) {
+        if (row.stat_hour >= 0 && row.stat_hour < 24) {
+            hours[static_cast<size_t>(row.stat_hour)] = row;
+        }
+    }
+    return hours;
+}
+
+bool RestaurantDb::rebuildOrderStats() {
+    if (!initialized_) return false;
+    bool loaded = false;
+    bool ok = runWriteTransaction("重建订单统计", [this]() {
+        return stepWithParamsLocked("DELETE FROM order_stats_hourly", {}) &&
+               stepWithParamsLocked(kRebuildOrderStatsSql, {});
+    }, [&]() {
+        // 仍持有写锁，重新加载期间不会有新的增量被重复累加
+        loaded = loadOrderStatsLocked();
+    });
+    if (ok) {
+        LOG_F(INFO, "已从orders重建订单统计");
+    }
+    return ok && loaded;
+}
+
+bool RestaurantDb::applyOrderStatsLocked(const OrderStatsRow& delta) {
+    return stepWithParamsLocked(kApplyOrderStatsSql, {
+        delta.stat_date, std::to_string(delta.stat_hour), std::to_string(delta.order_count),
+        std::to_string(delta.covers), std::to_string(delta.paid_count), std::to_string(delta.revenue_cents)
+    });
+}
+
+bool RestaurantDb::loadOrderStatsLocked() {
+    int64_t today;
+    UtcTime::parseDate(UtcTime::formatDate(std::chrono::system_clock::now()), today);
+    int64_t first_day = today - order_stats_->residentDays() + 1;
+    std::vector<OrderStatsRow> rows;
+    bool ok = stepRowsLocked(*statements_, "SELECT * FROM order_stats_hourly WHERE stat_date >= ?",
+                             {UtcTime::dateFromDays(first_day)}, [&rows](sqlite3_stmt* stmt) {
+        rows.emplace_back();
+        mapRow(stmt, rows.back());
+        return true;
+    });
+    if (ok) {
+        order_stats_->load(first_day, rows);
+    }
+    return ok;
 }
 
 std::vector<std::pair<std::string, int>> RestaurantDb::getPopularDishes(int limit) {
     std::vector<std::pair<std::string, int>> popular_dishes;
     if (!initialized_) return popular_dishes;
     std::string sql = "SELECT dish_name, sales_count FROM dishes ORDER BY sales_count DESC LIMIT ?";
-    auto result = executeQueryWithParams(sql, {std::to_string(limit)});
-    for (const auto& row : result) {
-        popular_dishes.push_back({row[0], std::stoi(row[1])});
-    }
+    forEachStatementRow(sql, {std::to_string(limit)}, [&popular_dishes](sqlite3_stmt* stmt) {
+        popular_dishes.emplace_back();
+        readColumn(stmt, 0, popular_dishes.back().first);
+        readColumn(stmt, 1, popular_dishes.back().second);
+        return true;
+    });
     return popular_dishes;
 }
 
@@ -900,10 +1537,12 @@ std::vector<std::pair<std::string, double>> RestaurantDb::getTableUtilization()
     std::string sql = R"(SELECT table_number, 
         CASE WHEN status = 'occupied' THEN 1.0 ELSE 0.0 END as utilization
         FROM tables ORDER BY table_number)";
-    auto result = executeQuery(sql);
-    for (const auto& row : result) {
-        utilization.push_back({row[0], std::stod(row[1])});
-    }
+    forEachStatementRow(sql, {}, [&utilization](sqlite3_stmt* stmt) {
+        utilization.emplace_back();
+        readColumn(stmt, 0, utilization.back().first);
+        readColumn(stmt, 1, utilization.back().second);
+        return true;
+    });
     return utilization;
 }
 
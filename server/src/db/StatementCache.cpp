@@ -0,0 +1,125 @@
+#include "db/StatementCache.h"
+#include "common/Metrics.h"
+#include "common/RequestTrace.h"
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <loguru.hpp>
+
+namespace WisdomRestaurant {
+
+StatementCache::Handle::Handle(Entry* entry)
+    : entry_(entry)
+    , start_(std::chrono::steady_clock::now()) {
+}
+
+StatementCache::Handle::Handle(Handle&& other) noexcept
+    : entry_(other.entry_)
+    , start_(other.start_) {
+    other.entry_ = nullptr;
+}
+
+StatementCache::Handle::~Handle() {
+    if (!entry_) {
+        return;
+    }
+    sqlite3_reset(entry_->stmt);
+    sqlite3_clear_bindings(entry_->stmt);
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+    entry_->executions++;
+    entry_->total_time += elapsed;
+    entry_->latency->observe(std::chrono::duration<double>(elapsed).count());
+    if (RequestTrace* trace = RequestTrace::current()) {
+        trace->addSpan("db", elapsed);
+    }
+}
+
+StatementCache::StatementCache(sqlite3* db)
+    : db_(db) {
+}
+
+StatementCache::~StatementCache() {
+    clear();
+}
+
+StatementCache::Handle StatementCache::acquire(const std::string& sql) {
+    auto it = entries_.find(sql);
+    if (it != entries_.end()) {
+        return Handle(it->second.get());
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v3(db_, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        LOG_F(ERROR, "SQL准备失败: %s", sqlite3_errmsg(db_));
+        sqlite3_finalize(stmt);
+        return Handle(nullptr);
+    }
+
+    Histogram& latency = MetricsRegistry::instance().histogram("wisdom_db_statement_duration_seconds",
+        "Duration of SQLite statements including binding and reading rows",
+        {{"statement", statementLabel(sql)}}, {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 1});
+    auto entry = std::make_unique<Entry>(Entry{stmt, 0, std::chrono::nanoseconds(0), &latency});
+    Entry* raw = entry.get();
+    entries_.emplace(sql, std::move(entry));
+    return Handle(raw);
+}
+
+void StatementCache::clear() {
+    for (auto& item : entries_) {
+        sqlite3_finalize(item.second->stmt);
+    }
+    entries_.clear();
+}
+
+std::vector<StatementStats> StatementCache::getStats() const {
+    std::vector<StatementStats> stats;
+    stats.reserve(entries_.size());
+    for (const auto& item : entries_) {
+        StatementStats s;
+        s.sql = item.first;
+        s.executions = item.second->executions;
+        s.total_ms = std::chrono::duration<double, std::milli>(item.second->total_time).count();
+        stats.push_back(s);
+    }
+    std::sort(stats.begin(), stats.end(), [](const StatementStats& a, const StatementStats& b) {
+        return a.total_ms > b.total_ms;
+    });
+    return stats;
+}
+
+std::string StatementCache::statementLabel(const std::string& sql) {
+    std::istringstream stream(sql);
+    std::vector<std::string> words;
+    std::string word;
+    while (words.size() < 64 && stream >> word) {
+        std::transform(word.begin(), word.end(), word.begin(), [](unsigned char c) {
+            return static_cast<char>(std::tolower(c));
+        });
+        words.push_back(word);
+    }
+    if (words.empty()) {
+        return "unknown";
+    }
+
+    // 取操作后第一个FROM/INTO之后的表名，UPDATE取紧随其后的表名
+    const std::string& op = words[0];
+    const char* table_keyword = op == "insert" || op == "replace" ? "into" : "from";
+    std::string table;
+    if (op == "update" && words.size() > 1) {
+        table = words[1];
+    } else {
+        for (size_t i = 1; i + 1 < words.size(); i++) {
+            if (words[i] == table_keyword) {
+                table = words[i + 1];
+                break;
+            }
+        }
+    }
+    table.erase(std::remove_if(table.begin(), table.end(), [](unsigned char c) {
+        return !(std::isalnum(c) || c == '_');
+    }), table.end());
+    return table.empty() ? op : op + " " + table;
+}
+
+} // namespace WisdomRestaurant
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "httplib.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// 本地模拟的兼容OpenAI接口的chat/completions服务
+// 返回预设的模型输出：stream请求按SSE逐段返回，每段只含几个字符，模拟模型逐字输出
+class FakeLlmServer {
+public:
+    FakeLlmServer() : requests_(0) {
+        server_.Post("/v1/chat/completions", [this](const httplib::Request& request, httplib::Response& response) {
+            requests_++;
+            std::string content = answer();
+            if (request.body.find("\"stream\":true") == std::string::npos) {
+                response.set_content("{\"choices\":[{\"message\":{\"content\":" + quote(content) + "}}]}",
+                                     "application/json");
+                return;
+            }
+            std::string events = sseEvents(content);
+            response.set_chunked_content_provider("text/event-stream",
+                [events](size_t, httplib::DataSink& sink) {
+                    // 按小块写出，SSE行会被拆到不同的块中
+                    for (size_t i = 0; i < events.size(); i += 7) {
+                        sink.write(events.data() + i, std::min<size_t>(7, events.size() - i));
+                    }
+                    sink.done();
+                    return true;
+                });
+        });
+        port_ = server_.bind_to_any_port("127.0.0.1");
+        thread_ = std::thread([this] { server_.listen_after_bind(); });
+        server_.wait_until_ready();
+    }
+
+    ~FakeLlmServer() {
+        server_.stop();
+        thread_.join();
+    }
+
+    std::string endpoint() const {
+        return "http://127.0.0.1:" + std::to_string(port_) + "/v1/chat/completions";
+    }
+
+    // 设置之后请求返回的模型输出
+    void setAnswer(const std::string& content) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        answer_ = content;
+    }
+
+    int requests() const { return requests_.load(); }
+
+private:
+    std::string answer() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return answer_;
+    }
+
+    static std::string quote(const std::string& text) {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        writer.String(text.c_str(), static_cast<rapidjson::SizeType>(text.size()));
+        return std::string(buffer.GetString(), buffer.GetSize());
+    }
+
+    // 每个delta含3个UTF-8字符
+    static std::string sseEvents(const std::string& content) {
+        std::string events;
+        size_t begin = 0;
+        while (begin < content.size()) {
+            size_t end = begin;
+            for (int chars = 0; chars < 3 && end < content.size(); chars++) {
+                end++;
+                while (end < content.size() && (static_cast<unsigned char>(content[end]) & 0xC0) == 0x80) {
+                    end++;
+                }
+            }
+            events += "data: {\"choices\":[{\"delta\":{\"content\":" + quote(content.substr(begin, end - begin)) +
+                      "}}]}\n\n";
+            begin = end;
+        }
+        return events + "data: [DONE]\n\n";
+    }
+
+private:
+    httplib::Server server_;
+    int port_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::string answer_;
+    std::atomic<int> requests_;
+};
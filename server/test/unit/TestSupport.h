@@ -0,0 +1,57 @@
+#pragma once
+
+#include "loguru.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// 单元测试的最小支撑：每个测试文件是一个独立可执行文件，由ctest运行，
+// 任一检查失败时打印位置并以非0退出码结束
+namespace TestSupport {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+// 只输出警告及以上的日志，避免淹没测试结果
+inline void quietLogs() {
+    loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+}
+
+// 测试用的临时文件路径（位于当前工作目录，即构建目录下），同名旧文件及WAL文件先删除
+inline std::string freshPath(const std::string& name) {
+    std::remove(name.c_str());
+    std::remove((name + "-wal").c_str());
+    std::remove((name + "-shm").c_str());
+    return name;
+}
+
+inline int finish() {
+    if (failures() > 0) {
+        std::fprintf(stderr, "%d 项检查失败\n", failures());
+        return 1;
+    }
+    std::printf("全部通过\n");
+    return 0;
+}
+
+} // namespace TestSupport
+
+#define EXPECT_TRUE(cond)                                                              \
+    do {                                                                               \
+        if (!(cond)) {                                                                 \
+            std::fprintf(stderr, "%s:%d: 检查失败: %s\n", __FILE__, __LINE__, #cond);   \
+            TestSupport::failures()++;                                                 \
+        }                                                                              \
+    } while (0)
+
+#define EXPECT_EQ(actual, expected) EXPECT_TRUE((actual) == (expected))
+
+#define RUN_TEST(test)                                    \
+    do {                                                  \
+        int before = TestSupport::failures();             \
+        test();                                           \
+        std::printf("[%s] %s\n",                          \
+                    TestSupport::failures() == before ? "  OK  " : " FAIL ", #test); \
+    } while (0)
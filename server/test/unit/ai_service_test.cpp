@@ -0,0 +1,153 @@
+// AiService对模型输出的解析：流式推荐逐个回调菜品、中止、缓存回放，异常输出不缓存，空数组按成功返回但不缓存
+#include "TestSupport.h"
+#include "FakeLlmServer.h"
+#include "ai/AiService.h"
+#include <cstdlib>
+#include <vector>
+
+using namespace WisdomRestaurant;
+
+// 菜品字符串中带有花括号、方括号和转义引号，扫描时不能把它们当作结构字符
+static const char* kStreamAnswer =
+    "好的，推荐如下：\n```json\n["
+    "{\"dish_name\":\"宫保鸡丁\",\"reason\":\"花生脆{香}，\\\"下饭\\\"\",\"taste_level\":\"微辣\","
+    "\"nutrition_advice\":\"蛋白质[丰富]\"},"
+    "{\"dish_name\":\"清蒸鲈鱼\",\"reason\":\"清淡\",\"taste_level\":\"咸鲜\",\"nutrition_advice\":\"低脂\","
+    "\"extra\":{\"nested\":[1,{\"x\":\"}\"}]}},"
+    "{\"dish_name\":\"蒜蓉西兰花\",\"reason\":\"补充膳食纤维\",\"taste_level\":\"清淡\",\"nutrition_advice\":\"维生素C\"}"
+    "]\n```";
+
+static FakeLlmServer* g_llm = nullptr;
+static AiService* g_ai = nullptr;
+
+static VisionResult makeVision(const std::string& age) {
+    VisionResult vision;
+    vision.people_num = 2;
+    vision.customer_portrait.push_back(CustomerPortrait{age, "man", "标准"});
+    vision.success = true;
+    return vision;
+}
+
+static void testStreamDeliversDishesInOrder() {
+    g_llm->setAnswer(kStreamAnswer);
+    std::vector<std::string> names;
+    RecommendationResult result = g_ai->recommendDishesStream(makeVision("青年"), "夏季", "午餐",
+        [&names](const DishRecommendation& dish) {
+            names.push_back(dish.dish_name);
+            return true;
+        });
+
+    EXPECT_TRUE(result.success);
+    EXPECT_EQ(names.size(), 3u);
+    EXPECT_EQ(result.recommendations.size(), 3u);
+    if (names.size() == 3 && result.recommendations.size() == 3) {
+        EXPECT_EQ(names[0], "宫保鸡丁");
+        EXPECT_EQ(names[1], "清蒸鲈鱼");
+        EXPECT_EQ(names[2], "蒜蓉西兰花");
+        EXPECT_EQ(result.recommendations[0].reason, "花生脆{香}，\"下饭\"");
+        EXPECT_EQ(result.recommendations[0].nutrition_advice, "蛋白质[丰富]");
+    }
+}
+
+static void testStreamAbortStopsAfterCallbackReturnsFalse() {
+    g_llm->setAnswer(kStreamAnswer);
+    int calls = 0;
+    RecommendationResult result = g_ai->recommendDishesStream(makeVision("中年"), "夏季", "午餐",
+        [&calls](const DishRecommendation&) {
+            calls++;
+            return false;
+        });
+
+    EXPECT_EQ(calls, 1);
+    EXPECT_TRUE(!result.success);
+    EXPECT_EQ(result.recommendations.size(), 1u);
+}
+
+static void testStreamReplaysCachedResult() {
+    g_llm->setAnswer(kStreamAnswer);
+    auto run = [] {
+        std::vector<std::string> names;
+        g_ai->recommendDishesStream(makeVision("老年"), "冬季", "晚餐", [&names](const DishRecommendation& dish) {
+            names.push_back(dish.dish_name);
+            return true;
+        });
+        return names;
+    };
+    std::vector<std::string> first = run();
+    int requests = g_llm->requests();
+    std::vector<std::string> second = run();
+
+    EXPECT_EQ(g_llm->requests(), requests);
+    EXPECT_EQ(first.size(), 3u);
+    EXPECT_TRUE(first == second);
+}
+
+static void testStreamParsesBareArray() {
+    // 模型输出没有代码块包裹，直接是JSON数组
+    g_llm->setAnswer("[{\"dish_name\":\"麻婆豆腐\",\"reason\":\"下饭\"}]");
+    std::vector<std::string> names;
+    RecommendationResult result = g_ai->recommendDishesStream(makeVision("儿童"), "秋季", "早餐",
+        [&names](const DishRecommendation& dish) {
+            names.push_back(dish.dish_name);
+            return true;
+        });
+
+    EXPECT_TRUE(result.success);
+    EXPECT_EQ(names.size(), 1u);
+}
+
+static void testMalformedAnswerIsNotCached() {
+    // 模型输出是对象而不是数组：解析失败，且不写入缓存，下一次请求仍然调用上游
+    g_llm->setAnswer("{\"dish_name\":\"麻婆豆腐\"}");
+    int requests = g_llm->requests();
+    RecommendationResult first = g_ai->recommendDishes(makeVision("青年"), "春季", "夜宵");
+    RecommendationResult second = g_ai->recommendDishes(makeVision("青年"), "春季", "夜宵");
+
+    EXPECT_TRUE(!first.success);
+    EXPECT_TRUE(!second.success);
+    EXPECT_EQ(g_llm->requests(), requests + 2);
+}
+
+static void testEmptyArrayIsNotCached() {
+    // 空数组是正常的“没有推荐”，按成功返回，但不写入缓存
+    g_llm->setAnswer("[]");
+    int requests = g_llm->requests();
+    RecommendationResult first = g_ai->recommendDishes(makeVision("中年"), "春季", "夜宵");
+    RecommendationResult second = g_ai->recommendDishes(makeVision("中年"), "春季", "夜宵");
+
+    EXPECT_TRUE(first.success);
+    EXPECT_TRUE(first.recommendations.empty());
+    EXPECT_TRUE(second.success);
+    EXPECT_EQ(g_llm->requests(), requests + 2);
+
+    // 流式接口同样按成功返回
+    RecommendationResult streamed = g_ai->recommendDishesStream(makeVision("中年"), "春季", "夜宵",
+        [](const DishRecommendation&) { return true; });
+    EXPECT_TRUE(streamed.success);
+    EXPECT_TRUE(streamed.recommendations.empty());
+    EXPECT_EQ(g_llm->requests(), requests + 3);
+}
+
+int main() {
+    TestSupport::quietLogs();
+    FakeLlmServer llm;
+    setenv("DASHSCOPE_API_KEY", "test-key", 1);
+    setenv("DASHSCOPE_API_ENDPOINT", llm.endpoint().c_str(), 1);
+    setenv("AI_CURL_WARMUP", "0", 1);
+
+    AiService ai;
+    if (!ai.initialize()) {
+        std::fprintf(stderr, "AiService初始化失败\n");
+        return 1;
+    }
+    g_llm = &llm;
+    g_ai = &ai;
+
+    RUN_TEST(testStreamDeliversDishesInOrder);
+    RUN_TEST(testStreamAbortStopsAfterCallbackReturnsFalse);
+    RUN_TEST(testStreamReplaysCachedResult);
+    RUN_TEST(testStreamParsesBareArray);
+    RUN_TEST(testMalformedAnswerIsNotCached);
+    RUN_TEST(testEmptyArrayIsNotCached);
+    return TestSupport::finish();
+}
@@ -0,0 +1,132 @@
+// EnvironmentSeries：汇总块的编解码、损坏数据的拒绝，以及写入数据库后重新打开仍能查询
+#include "TestSupport.h"
+#include "db/EnvironmentSeries.h"
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+using namespace WisdomRestaurant;
+
+using Bucket = EnvironmentSeries::Bucket;
+
+static bool near(double a, double b) {
+    return std::fabs(a - b) < 0.006;
+}
+
+static EnvironmentAggregate aggregateOf(std::initializer_list<double> values) {
+    EnvironmentAggregate aggregate;
+    for (double value : values) {
+        aggregate.add(value);
+    }
+    return aggregate;
+}
+
+static std::vector<Bucket> sampleBuckets() {
+    std::vector<Bucket> buckets(3);
+    buckets[0].slot = 0;
+    buckets[0].metrics[0] = aggregateOf({22.5, 23.25, 22.75});
+    buckets[0].metrics[1] = aggregateOf({310.0});
+    buckets[0].metrics[3] = aggregateOf({45.5, 61.0});
+    buckets[1].slot = 7;
+    buckets[1].metrics[0] = aggregateOf({-3.5, -1.25});      // 负数走zigzag
+    buckets[1].metrics[2] = aggregateOf({55.0});
+    buckets[2].slot = 59;
+    buckets[2].metrics[0] = aggregateOf({21.0});
+    return buckets;
+}
+
+static void testBlockRoundTrip() {
+    std::vector<Bucket> buckets = sampleBuckets();
+    std::string data = EnvironmentSeries::encodeBlock(buckets);
+
+    std::vector<Bucket> decoded;
+    EXPECT_TRUE(EnvironmentSeries::decodeBlock(data, decoded));
+    EXPECT_EQ(decoded.size(), buckets.size());
+    for (size_t i = 0; i < decoded.size() && i < buckets.size(); i++) {
+        EXPECT_EQ(decoded[i].slot, buckets[i].slot);
+        for (size_t m = 0; m < kEnvironmentMetricCount; m++) {
+            const EnvironmentAggregate& expected = buckets[i].metrics[m];
+            const EnvironmentAggregate& actual = decoded[i].metrics[m];
+            EXPECT_EQ(actual.count, expected.count);
+            if (expected.count > 0) {
+                // 定点两位小数保存，均值还原为sum
+                EXPECT_TRUE(near(actual.min, expected.min));
+                EXPECT_TRUE(near(actual.max, expected.max));
+                EXPECT_TRUE(near(actual.sum / actual.count, expected.sum / expected.count));
+            }
+        }
+    }
+
+    // 紧凑编码：3个桶远小于原始结构
+    EXPECT_TRUE(data.size() < 64);
+}
+
+static void testEmptyBlockRoundTrip() {
+    std::vector<Bucket> decoded(5);
+    EXPECT_TRUE(EnvironmentSeries::decodeBlock(EnvironmentSeries::encodeBlock({}), decoded));
+    EXPECT_TRUE(decoded.empty());
+}
+
+static void testRejectsCorruptBlocks() {
+    std::string data = EnvironmentSeries::encodeBlock(sampleBuckets());
+    std::vector<Bucket> decoded;
+
+    EXPECT_TRUE(!EnvironmentSeries::decodeBlock("", decoded));
+    EXPECT_TRUE(!EnvironmentSeries::decodeBlock(data.substr(0, data.size() - 1), decoded));   // 截断
+    EXPECT_TRUE(!EnvironmentSeries::decodeBlock(data + '\x01', decoded));                     // 多余字节
+
+    std::string bad_version = data;
+    bad_version[0] = static_cast<char>(bad_version[0] + 1);
+    EXPECT_TRUE(!EnvironmentSeries::decodeBlock(bad_version, decoded));
+
+    // 桶序号超出块范围
+    std::vector<Bucket> out_of_range(1);
+    out_of_range[0].slot = EnvironmentSeries::kBlockBuckets;
+    EXPECT_TRUE(!EnvironmentSeries::decodeBlock(EnvironmentSeries::encodeBlock(out_of_range), decoded));
+}
+
+static void testFlushedBlocksSurviveRestart() {
+    std::string path = TestSupport::freshPath("environment_series_test.db");
+    auto db = std::make_shared<RestaurantDb>();
+    EXPECT_TRUE(db->initialize(path));
+
+    int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    int64_t minute = now / 60 * 60;
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    {
+        EnvironmentSeries series(db);
+        EXPECT_TRUE(series.initialize());
+        EXPECT_TRUE(series.record(1, EnvironmentSample{minute, {{20.0, 300.0, 50.0, nan}}}));
+        EXPECT_TRUE(series.record(1, EnvironmentSample{minute + 1, {{22.0, 320.0, 54.0, nan}}}));
+        EXPECT_TRUE(!series.record(1, EnvironmentSample{now - 3600, {{20.0, 0, 0, 0}}}));   // 超过最大延迟
+        EXPECT_TRUE(series.flush());
+        EXPECT_TRUE(series.getStats().blocks_written >= 3);   // 三种粒度各一个块
+        series.shutdown();
+    }
+
+    EnvironmentSeries reopened(db);
+    EXPECT_TRUE(reopened.initialize());
+    int resolution = 60;
+    std::vector<EnvironmentPoint> points = reopened.query(1, minute, minute + 60, resolution);
+    EXPECT_EQ(points.size(), 1u);
+    if (!points.empty()) {
+        const EnvironmentAggregate& temperature = points[0].metrics[0];
+        EXPECT_EQ(points[0].timestamp, minute);
+        EXPECT_EQ(temperature.count, 2u);
+        EXPECT_TRUE(near(temperature.min, 20.0));
+        EXPECT_TRUE(near(temperature.max, 22.0));
+        EXPECT_TRUE(near(temperature.sum, 42.0));
+        EXPECT_EQ(points[0].metrics[3].count, 0u);          // 未上报的指标
+    }
+    reopened.shutdown();
+}
+
+int main() {
+    TestSupport::quietLogs();
+    RUN_TEST(testBlockRoundTrip);
+    RUN_TEST(testEmptyBlockRoundTrip);
+    RUN_TEST(testRejectsCorruptBlocks);
+    RUN_TEST(testFlushedBlocksSurviveRestart);
+    return TestSupport::finish();
+}
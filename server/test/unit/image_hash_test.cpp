@@ -0,0 +1,128 @@
+// 图片差值哈希(dHash)、汉明距离，以及按餐桌的视觉识别去重缓存
+#include "TestSupport.h"
+#include "ai/ImageHash.h"
+#include "ai/VisionDedupeCache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#ifdef WISDOM_HAVE_JPEG
+#include <cstdio>
+#include <jpeglib.h>
+#endif
+
+using namespace WisdomRestaurant;
+
+static void testHammingDistance() {
+    EXPECT_EQ(ImageHash::hammingDistance(0, 0), 0);
+    EXPECT_EQ(ImageHash::hammingDistance(0, ~0ULL), 64);
+    EXPECT_EQ(ImageHash::hammingDistance(0xF0ULL, 0x0FULL), 8);
+    EXPECT_EQ(ImageHash::hammingDistance(1ULL << 63, 1), 2);
+}
+
+#ifdef WISDOM_HAVE_JPEG
+// 生成640x480的JPEG：pattern 0为水平渐变加一块亮区，pattern 1为正余弦纹理；noise为逐像素随机扰动幅度
+static std::string makeJpeg(int pattern, int noise, unsigned seed) {
+    const int width = 640;
+    const int height = 480;
+    std::vector<unsigned char> pixels(width * height * 3);
+    std::srand(seed);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int base = pattern == 0
+                ? (x * 255 / width + (y > 200 && y < 300 && x > 250 && x < 400 ? 80 : 0)) % 256
+                : static_cast<int>(128 + 100 * std::sin(x / 30.0) * std::cos(y / 20.0));
+            for (int c = 0; c < 3; c++) {
+                int value = base + (noise ? std::rand() % (2 * noise + 1) - noise : 0);
+                pixels[(y * width + x) * 3 + c] = static_cast<unsigned char>(std::min(255, std::max(0, value)));
+            }
+        }
+    }
+
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr err;
+    cinfo.err = jpeg_std_error(&err);
+    jpeg_create_compress(&cinfo);
+    unsigned char* out = nullptr;
+    unsigned long size = 0;
+    jpeg_mem_dest(&cinfo, &out, &size);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 80, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = &pixels[cinfo.next_scanline * width * 3];
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    std::string data(reinterpret_cast<char*>(out), size);
+    std::free(out);
+    jpeg_destroy_compress(&cinfo);
+    return data;
+}
+
+static CustomerImage rawImage(const std::string& data) {
+    CustomerImage image;
+    image.data = data;
+    image.is_base64 = false;
+    image.mime_type = "image/jpeg";
+    return image;
+}
+
+static void testSimilarFramesHashClose() {
+    uint64_t clean = 0;
+    uint64_t noisy = 0;
+    uint64_t other = 0;
+    EXPECT_TRUE(ImageHash::computeDHash(rawImage(makeJpeg(0, 0, 1)), clean));
+    EXPECT_TRUE(ImageHash::computeDHash(rawImage(makeJpeg(0, 12, 2)), noisy));
+    EXPECT_TRUE(ImageHash::computeDHash(rawImage(makeJpeg(1, 0, 3)), other));
+
+    // 同一场景加噪声后仍在去重阈值(默认6)以内，不同场景相差很多位
+    EXPECT_TRUE(ImageHash::hammingDistance(clean, noisy) <= 6);
+    EXPECT_TRUE(ImageHash::hammingDistance(clean, other) > 16);
+
+    uint64_t again = 0;
+    EXPECT_TRUE(ImageHash::computeDHash(rawImage(makeJpeg(0, 0, 1)), again));
+    EXPECT_EQ(again, clean);
+}
+
+static void testRejectsNonJpeg() {
+    uint64_t hash = 0;
+    EXPECT_TRUE(!ImageHash::computeDHash(rawImage("\x89PNG\r\n\x1a\n0000"), hash));
+    EXPECT_TRUE(!ImageHash::computeDHash(rawImage(""), hash));
+
+    // 截断的JPEG解码失败时返回false，不崩溃
+    std::string jpeg = makeJpeg(0, 0, 1);
+    EXPECT_TRUE(!ImageHash::computeDHash(rawImage(jpeg.substr(0, 64)), hash));
+}
+#endif
+
+static void testDedupeCacheMatchesWithinDistancePerTable() {
+    VisionDedupeCache cache(6, std::chrono::seconds(60), 4);
+    VisionResult result{};
+    result.success = true;
+    result.people_num = 3;
+
+    const uint64_t hash = 0x0123456789ABCDEFULL;
+    EXPECT_TRUE(!cache.find("T1", hash).has_value());
+    cache.store("T1", hash, result, 1500);
+
+    auto near = cache.find("T1", hash ^ 0x3FULL);          // 相差6位
+    EXPECT_TRUE(near.has_value() && near->people_num == 3);
+    EXPECT_TRUE(!cache.find("T1", hash ^ 0x7FULL).has_value());  // 相差7位
+    EXPECT_TRUE(!cache.find("T2", hash).has_value());       // 其他餐桌不共享
+}
+
+int main() {
+    TestSupport::quietLogs();
+    RUN_TEST(testHammingDistance);
+#ifdef WISDOM_HAVE_JPEG
+    RUN_TEST(testSimilarFramesHashClose);
+    RUN_TEST(testRejectsNonJpeg);
+#endif
+    RUN_TEST(testDedupeCacheMatchesWithinDistancePerTable);
+    return TestSupport::finish();
+}
@@ -0,0 +1,239 @@
+// InventoryManager：并发预留不超卖、整体预留、释放和超时、按预留下单、下单失败保留预留、售罄版本，以及写回数据库
+#include "TestSupport.h"
+#include "db/InventoryManager.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace WisdomRestaurant;
+
+static std::shared_ptr<RestaurantDb> g_db;
+
+static std::shared_ptr<InventoryManager> makeInventory(std::chrono::seconds reservation_ttl = std::chrono::seconds(900)) {
+    InventoryOptions options;
+    options.flush_interval = std::chrono::milliseconds(60000);   // 由测试显式调用flush
+    options.reservation_ttl = reservation_ttl;
+    auto inventory = std::make_shared<InventoryManager>(g_db, options);
+    inventory->initialize();
+    return inventory;
+}
+
+static int availableOf(InventoryManager& inventory, int dish_id) {
+    auto stock = inventory.getStock(dish_id);
+    return stock ? stock->available : -1;
+}
+
+// 数据库中的库存：写回不发布新菜单快照，重新加载菜单后读取
+static int persistedStock(int dish_id) {
+    g_db->reloadMenu();
+    auto dish = g_db->getDishById(dish_id);
+    return dish ? dish->stock_count : -1;
+}
+
+static Order makeOrder() {
+    Order order{};
+    order.table_id = 1;
+    order.order_type = "dine_in";
+    order.payment_method = "cash";
+    order.people_count = 2;
+    return order;
+}
+
+static std::vector<OrderItem> makeItems(std::initializer_list<std::pair<int, int>> quantities) {
+    std::vector<OrderItem> items;
+    for (const auto& entry : quantities) {
+        OrderItem item{};
+        item.dish_id = entry.first;
+        item.quantity = entry.second;
+        items.push_back(item);
+    }
+    return items;
+}
+
+static void testConcurrentReservationsNeverOversell() {
+    g_db->updateDishStock(1, 500);
+    auto inventory = makeInventory();
+
+    std::atomic<int> succeeded(0);
+    std::atomic<int> rejected(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 100; i++) {
+                if (inventory->reserve({{1, 1}}).ok()) {
+                    succeeded++;
+                } else {
+                    rejected++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(succeeded.load(), 500);
+    EXPECT_EQ(rejected.load(), 300);
+    EXPECT_EQ(availableOf(*inventory, 1), 0);
+    EXPECT_TRUE(inventory->isSoldOut(1));
+    EXPECT_EQ(inventory->getStock(1)->stock, 500);   // 预留只扣减可售份数
+    EXPECT_EQ(inventory->getStats().reservations, 500u);
+}
+
+static void testReservationIsAllOrNothing() {
+    g_db->updateDishStock(2, 5);
+    g_db->updateDishStock(3, 1);
+    auto inventory = makeInventory();
+
+    InventoryResult result = inventory->reserve({{2, 3}, {3, 2}});
+    EXPECT_TRUE(result.status == InventoryResult::Status::SoldOut);
+    EXPECT_EQ(result.dish_id, 3);
+    EXPECT_EQ(availableOf(*inventory, 2), 5);        // 已扣减的第一项被退回
+
+    result = inventory->reserve({{2, 1}, {9999, 1}});
+    EXPECT_TRUE(result.status == InventoryResult::Status::UnknownDish);
+    EXPECT_EQ(availableOf(*inventory, 2), 5);
+
+    result = inventory->reserve({{2, 0}});
+    EXPECT_TRUE(result.status == InventoryResult::Status::InvalidQuantity);
+}
+
+static void testReleaseAndExpiry() {
+    g_db->updateDishStock(2, 5);
+    auto inventory = makeInventory(std::chrono::seconds(1));
+
+    InventoryResult first = inventory->reserve({{2, 2}});
+    InventoryResult second = inventory->reserve({{2, 3}});
+    EXPECT_TRUE(first.ok() && second.ok());
+    EXPECT_EQ(availableOf(*inventory, 2), 0);
+
+    EXPECT_TRUE(inventory->release(first.reservation_id));
+    EXPECT_TRUE(!inventory->release(first.reservation_id));
+    EXPECT_EQ(availableOf(*inventory, 2), 2);
+
+    EXPECT_EQ(inventory->expireReservations(), 0u);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    EXPECT_EQ(inventory->expireReservations(), 1u);
+    EXPECT_EQ(availableOf(*inventory, 2), 5);
+    EXPECT_TRUE(!inventory->release(second.reservation_id));
+
+    InventoryStats stats = inventory->getStats();
+    EXPECT_EQ(stats.released, 1u);
+    EXPECT_EQ(stats.expired, 1u);
+    EXPECT_EQ(stats.reservations, 0u);
+}
+
+static void testPlaceOrderSettlesReservation() {
+    g_db->updateDishStock(2, 10);
+    g_db->updateDishStock(3, 10);
+    auto inventory = makeInventory();
+
+    // 预留3份菜品2，下单时改为1份菜品2加2份菜品3：多出的份数再扣减，少于预留的部分退回
+    InventoryResult reserved = inventory->reserve({{2, 3}});
+    InventoryResult placed = inventory->placeOrder(makeOrder(), makeItems({{2, 1}, {3, 2}}), reserved.reservation_id);
+    EXPECT_TRUE(placed.ok());
+    EXPECT_TRUE(placed.order.has_value());
+    EXPECT_EQ(inventory->getStock(2)->stock, 9);
+    EXPECT_EQ(availableOf(*inventory, 2), 9);
+    EXPECT_EQ(inventory->getStock(3)->stock, 8);
+    EXPECT_EQ(inventory->getStats().reservations, 0u);
+
+    // 预留已结算，不能再次使用
+    InventoryResult again = inventory->placeOrder(makeOrder(), makeItems({{2, 1}}), reserved.reservation_id);
+    EXPECT_TRUE(again.status == InventoryResult::Status::UnknownReservation);
+
+    // 加点的菜不够时保留原预留
+    g_db->updateDishStock(4, 1);
+    inventory = makeInventory();
+    InventoryResult held = inventory->reserve({{2, 1}});
+    InventoryResult short_order = inventory->placeOrder(makeOrder(), makeItems({{2, 1}, {4, 2}}), held.reservation_id);
+    EXPECT_TRUE(short_order.status == InventoryResult::Status::SoldOut);
+    EXPECT_EQ(short_order.dish_id, 4);
+    EXPECT_EQ(inventory->getStats().reservations, 1u);
+    EXPECT_TRUE(inventory->release(held.reservation_id));
+}
+
+static void testFailedOrderKeepsReservation() {
+    g_db->updateDishStock(2, 10);
+    g_db->updateDishStock(3, 10);
+    auto inventory = makeInventory();
+
+    // 餐桌不存在时外键约束使下单事务回滚：加点的份数退回，少点的份数不退，原预留保留
+    InventoryResult reserved = inventory->reserve({{2, 3}});
+    Order broken = makeOrder();
+    broken.table_id = 9999;
+    InventoryResult failed = inventory->placeOrder(broken, makeItems({{2, 1}, {3, 2}}), reserved.reservation_id);
+    EXPECT_TRUE(failed.status == InventoryResult::Status::Failed);
+    EXPECT_EQ(availableOf(*inventory, 2), 7);
+    EXPECT_EQ(availableOf(*inventory, 3), 10);
+    EXPECT_EQ(inventory->getStats().reservations, 1u);
+
+    // 修正后用同一预留重新下单
+    InventoryResult placed = inventory->placeOrder(makeOrder(), makeItems({{2, 3}}), reserved.reservation_id);
+    EXPECT_TRUE(placed.ok());
+    EXPECT_EQ(inventory->getStock(2)->stock, 7);
+    EXPECT_EQ(availableOf(*inventory, 2), 7);
+    EXPECT_EQ(inventory->getStats().reservations, 0u);
+
+    // 不带预留的下单失败时退回全部份数
+    InventoryResult direct = inventory->placeOrder(broken, makeItems({{3, 4}}));
+    EXPECT_TRUE(direct.status == InventoryResult::Status::Failed);
+    EXPECT_EQ(availableOf(*inventory, 3), 10);
+}
+
+static void testSoldOutVersionTracksAvailabilityBoundary() {
+    g_db->updateDishStock(5, 2);
+    auto inventory = makeInventory();
+    uint64_t version = inventory->soldOutVersion();
+
+    InventoryResult first = inventory->reserve({{5, 1}});
+    EXPECT_EQ(inventory->soldOutVersion(), version);      // 仍可售
+    InventoryResult second = inventory->reserve({{5, 1}});
+    EXPECT_EQ(inventory->soldOutVersion(), version + 1);  // 售罄
+    EXPECT_TRUE(inventory->getSoldOutDishes() == std::vector<int>({5}));
+
+    inventory->release(second.reservation_id);
+    EXPECT_EQ(inventory->soldOutVersion(), version + 2);  // 恢复可售
+    inventory->release(first.reservation_id);
+    EXPECT_EQ(inventory->soldOutVersion(), version + 2);
+
+    EXPECT_TRUE(inventory->setStock(5, 0));
+    EXPECT_EQ(inventory->soldOutVersion(), version + 3);
+    EXPECT_TRUE(inventory->setStock(5, 0));
+    EXPECT_EQ(inventory->soldOutVersion(), version + 3);
+    EXPECT_TRUE(!inventory->setStock(9999, 1));
+}
+
+static void testFlushWritesStockBack() {
+    g_db->updateDishStock(1, 20);
+    auto inventory = makeInventory();
+
+    EXPECT_TRUE(inventory->placeOrder(makeOrder(), makeItems({{1, 4}})).ok());
+    EXPECT_EQ(persistedStock(1), 20);     // 写回前数据库仍是旧值
+    EXPECT_TRUE(inventory->flush());
+    EXPECT_EQ(persistedStock(1), 16);
+    EXPECT_TRUE(inventory->getStats().rows_written >= 1);
+
+    // 停止时写回剩余变化
+    EXPECT_TRUE(inventory->setStock(1, 7));
+    inventory->shutdown();
+    EXPECT_EQ(persistedStock(1), 7);
+}
+
+int main() {
+    TestSupport::quietLogs();
+    g_db = std::make_shared<RestaurantDb>();
+    if (!g_db->initialize(TestSupport::freshPath("inventory_manager_test.db"))) {
+        std::fprintf(stderr, "数据库初始化失败\n");
+        return 1;
+    }
+
+    RUN_TEST(testConcurrentReservationsNeverOversell);
+    RUN_TEST(testReservationIsAllOrNothing);
+    RUN_TEST(testReleaseAndExpiry);
+    RUN_TEST(testPlaceOrderSettlesReservation);
+    RUN_TEST(testFailedOrderKeepsReservation);
+    RUN_TEST(testSoldOutVersionTracksAvailabilityBoundary);
+    RUN_TEST(testFlushWritesStockBack);
+    return TestSupport::finish();
+}
@@ -0,0 +1,128 @@
+// MenuCache：快照发布与版本号、销量和库存的原子计数、版本之间的增量，以及历史版本淘汰后的全量回退
+#include "TestSupport.h"
+#include "db/MenuCache.h"
+#include <algorithm>
+#include <vector>
+
+using namespace WisdomRestaurant;
+
+static Dish makeDish(int id, const std::string& name, int category_id, bool available = true) {
+    Dish dish{};
+    dish.id = id;
+    dish.dish_code = "D" + std::to_string(id);
+    dish.dish_name = name;
+    dish.category_id = category_id;
+    dish.price = 10.0 + id;
+    dish.is_available = available;
+    return dish;
+}
+
+static std::vector<int> changedIds(const MenuDelta& delta) {
+    std::vector<int> ids;
+    for (const Dish* dish : delta.changed) {
+        ids.push_back(dish->id);
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+static void testPublishBuildsIndexesAndBumpsVersion() {
+    MenuCache cache;
+    std::vector<uint64_t> notified;
+    cache.setVersionListener([&notified](uint64_t version) { notified.push_back(version); });
+    EXPECT_EQ(cache.version(), 0u);
+
+    cache.publish({makeDish(2, "b", 1), makeDish(1, "a", 1), makeDish(3, "c", 2, false)});
+    auto snapshot = cache.current();
+    EXPECT_EQ(snapshot->version, 1u);
+    EXPECT_EQ(snapshot->dishes.size(), 3u);
+    EXPECT_EQ(snapshot->available.size(), 2u);
+    EXPECT_TRUE(snapshot->findByCode("D3") != nullptr);
+    EXPECT_TRUE(snapshot->findById(4) == nullptr);
+    EXPECT_EQ(snapshot->by_category.at(1).size(), 2u);
+    EXPECT_EQ(snapshot->by_category.count(2), 0u);          // 分类索引只含在售菜品
+    EXPECT_EQ(snapshot->dishes[snapshot->by_category.at(1)[0]].dish_name, "a");
+
+    cache.upsert(makeDish(4, "d", 2));
+    EXPECT_EQ(cache.version(), 2u);
+    EXPECT_TRUE(notified == std::vector<uint64_t>({1, 2}));
+    EXPECT_EQ(snapshot->version, 1u);                        // 旧快照不受影响
+}
+
+static void testDiffReportsChangedAndRemoved() {
+    MenuCache cache;
+    cache.publish({makeDish(1, "a", 1), makeDish(2, "b", 1), makeDish(3, "c", 2)});
+    uint64_t since = cache.version();
+
+    Dish renamed = makeDish(1, "a2", 1);
+    Dish off_shelf = makeDish(2, "b", 1, false);
+    cache.upsert(std::vector<Dish>{renamed, off_shelf, makeDish(5, "e", 2)});
+    EXPECT_EQ(cache.version(), since + 1);
+
+    auto to = cache.current();
+    MenuDelta delta = cache.diff(since, *to);
+    EXPECT_TRUE(!delta.full);
+    EXPECT_TRUE(changedIds(delta) == std::vector<int>({1, 5}));
+    EXPECT_TRUE(delta.removed == std::vector<int>({2}));
+
+    MenuDelta none = cache.diff(to->version, *to);
+    EXPECT_TRUE(!none.full);
+    EXPECT_TRUE(none.changed.empty() && none.removed.empty());
+}
+
+static void testCountersUpdateInPlace() {
+    MenuCache cache;
+    cache.publish({makeDish(1, "a", 1), makeDish(2, "b", 1)});
+    auto snapshot = cache.current();
+    uint64_t since = cache.version();
+
+    Dish sold = makeDish(1, "a", 1);
+    sold.sales_count = 7;
+    sold.stock_count = 93;
+    cache.updateCounters({sold});
+    EXPECT_TRUE(cache.current() == snapshot);               // 不替换快照，也不增加版本号
+    EXPECT_EQ(cache.version(), since);
+    size_t index = snapshot->by_id.at(1);
+    EXPECT_EQ(snapshot->salesCount(index), 7);
+    EXPECT_EQ(snapshot->stockCount(index), 93);
+    EXPECT_EQ(snapshot->copy(index).sales_count, 7);
+    EXPECT_EQ(snapshot->collect(snapshot->available)[index].stock_count, 93);
+
+    // 发布新快照时保留其他菜品的实时计数，增量中不把计数变化当作菜品变化
+    cache.upsert(makeDish(2, "b2", 1));
+    auto to = cache.current();
+    EXPECT_EQ(to->salesCount(to->by_id.at(1)), 7);
+    EXPECT_EQ(to->stockCount(to->by_id.at(1)), 93);
+    EXPECT_TRUE(changedIds(cache.diff(since, *to)) == std::vector<int>({2}));
+}
+
+static void testDiffFallsBackToFullWhenHistoryIsGone() {
+    MenuCache cache;
+    cache.publish({makeDish(1, "a", 1), makeDish(2, "b", 1, false)});
+    uint64_t oldest = cache.version();
+
+    // 历史只保留最近32个版本
+    for (int i = 0; i < 32; i++) {
+        cache.upsert(makeDish(1, "a" + std::to_string(i), 1));
+    }
+    auto to = cache.current();
+    MenuDelta delta = cache.diff(oldest, *to);
+    EXPECT_TRUE(delta.full);
+    EXPECT_TRUE(changedIds(delta) == std::vector<int>({1}));
+
+    MenuDelta recent = cache.diff(to->version - 31, *to);
+    EXPECT_TRUE(!recent.full);
+
+    // 客户端持有的版本比服务端新（例如服务端重启），同样返回全量
+    MenuDelta future = cache.diff(to->version + 5, *to);
+    EXPECT_TRUE(future.full);
+}
+
+int main() {
+    TestSupport::quietLogs();
+    RUN_TEST(testPublishBuildsIndexesAndBumpsVersion);
+    RUN_TEST(testDiffReportsChangedAndRemoved);
+    RUN_TEST(testCountersUpdateInPlace);
+    RUN_TEST(testDiffFallsBackToFullWhenHistoryIsGone);
+    return TestSupport::finish();
+}
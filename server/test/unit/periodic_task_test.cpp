@@ -0,0 +1,57 @@
+// PeriodicTask：按间隔执行、停止时立即唤醒并执行最后一次、未启动时停止也执行一次
+#include "TestSupport.h"
+#include "common/PeriodicTask.h"
+#include <atomic>
+#include <thread>
+
+using namespace WisdomRestaurant;
+
+static void testRunsPeriodicallyAndOnceMoreOnStop() {
+    std::atomic<int> runs(0);
+    PeriodicTask task(std::chrono::milliseconds(20), [&runs] { runs++; });
+    task.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    int before_stop = runs.load();
+    EXPECT_TRUE(before_stop >= 2);
+
+    task.stop();
+    EXPECT_EQ(runs.load(), before_stop + 1);
+    task.stop();                                   // 重复停止不再执行
+    task.start();                                  // 停止后不能重新启动
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(runs.load(), before_stop + 1);
+}
+
+static void testStopWakesLongInterval() {
+    std::atomic<int> runs(0);
+    PeriodicTask task(std::chrono::milliseconds(60000), [&runs] { runs++; });
+    task.start();
+
+    auto begin = std::chrono::steady_clock::now();
+    task.stop();
+    EXPECT_TRUE(std::chrono::steady_clock::now() - begin < std::chrono::seconds(5));
+    EXPECT_EQ(runs.load(), 1);
+}
+
+static void testStopWithoutStartRunsInline() {
+    int runs = 0;
+    {
+        PeriodicTask task(std::chrono::milliseconds(10), [&runs] { runs++; });
+        task.stop();
+        EXPECT_EQ(runs, 1);
+    }
+    EXPECT_EQ(runs, 1);                            // 析构时不再执行
+
+    {
+        PeriodicTask task(std::chrono::milliseconds(10), [&runs] { runs++; });
+    }
+    EXPECT_EQ(runs, 2);                            // 析构即停止
+}
+
+int main() {
+    TestSupport::quietLogs();
+    RUN_TEST(testRunsPeriodicallyAndOnceMoreOnStop);
+    RUN_TEST(testStopWakesLongInterval);
+    RUN_TEST(testStopWithoutStartRunsInline);
+    return TestSupport::finish();
+}
@@ -0,0 +1,120 @@
+// RestaurantDb::placeOrder：订单和订单项一次写入，库存不足或菜品不存在时整单回滚，下单不发布新菜单版本
+#include "TestSupport.h"
+#include "db/MenuCache.h"
+#include "db/RestaurantDb.h"
+#include <vector>
+
+using namespace WisdomRestaurant;
+
+static RestaurantDb* g_db = nullptr;
+
+static Order makeOrder() {
+    Order order{};
+    order.table_id = 1;
+    order.user_id = "u1";
+    order.order_type = "dine_in";
+    order.payment_method = "cash";
+    order.people_count = 2;
+    return order;
+}
+
+static OrderItem makeItem(int dish_id, int quantity) {
+    OrderItem item{};
+    item.dish_id = dish_id;
+    item.quantity = quantity;
+    return item;
+}
+
+static int stockOf(RestaurantDb& db, int dish_id) {
+    auto dish = db.getDishById(dish_id);
+    return dish ? dish->stock_count : -1;
+}
+
+static int salesOf(RestaurantDb& db, int dish_id) {
+    auto dish = db.getDishById(dish_id);
+    return dish ? dish->sales_count : -1;
+}
+
+static void testPlacesOrderWithoutBumpingMenuVersion() {
+    RestaurantDb& db = *g_db;
+    EXPECT_TRUE(db.updateDishStock(1, 10));
+    uint64_t version = db.getMenuVersion();
+    auto snapshot = db.getMenuSnapshot();
+    int sales = salesOf(db, 1);
+
+    auto placed = db.placeOrder(makeOrder(), {makeItem(1, 2), makeItem(3, 1)});
+    EXPECT_TRUE(placed.has_value());
+    if (!placed) {
+        return;
+    }
+    EXPECT_TRUE(placed->order.id > 0);
+    EXPECT_TRUE(!placed->order.order_no.empty());
+    EXPECT_EQ(placed->items.size(), 2u);
+    EXPECT_EQ(placed->items[0].order_id, placed->order.id);
+    EXPECT_EQ(placed->items[0].dish_name, "宫保鸡丁");                // 菜名和单价按菜单补齐
+    EXPECT_TRUE(placed->order.total_amount == 28.0 * 2 + 48.0);
+    EXPECT_EQ(db.getOrderItems(placed->order.id).size(), 2u);
+
+    // 销量和库存只原子更新当前快照的计数，不复制快照，菜单版本不变
+    EXPECT_EQ(db.getMenuVersion(), version);
+    EXPECT_TRUE(db.getMenuSnapshot() == snapshot);
+    EXPECT_EQ(salesOf(db, 1), sales + 2);
+    EXPECT_EQ(snapshot->stockCount(snapshot->by_id.at(1)), 8);
+    EXPECT_EQ(stockOf(db, 1), 8);
+    EXPECT_TRUE(db.getMenuChanges(version, *db.getMenuSnapshot()).changed.empty());
+}
+
+static void testRollsBackWhenStockIsShort() {
+    RestaurantDb& db = *g_db;
+    EXPECT_TRUE(db.updateDishStock(2, 5));
+    EXPECT_TRUE(db.updateDishStock(4, 1));
+    uint64_t version = db.getMenuVersion();
+    int orders = db.getTodayOrderCount();
+    int sales = salesOf(db, 2);
+
+    // 第一项可以扣减，第二项库存不足：整单回滚，第一项的库存和销量也不变
+    auto placed = db.placeOrder(makeOrder(), {makeItem(2, 3), makeItem(4, 2)});
+    EXPECT_TRUE(!placed.has_value());
+    EXPECT_EQ(db.getTodayOrderCount(), orders);
+    EXPECT_EQ(stockOf(db, 2), 5);
+    EXPECT_EQ(stockOf(db, 4), 1);
+    EXPECT_EQ(salesOf(db, 2), sales);
+    EXPECT_EQ(db.getMenuVersion(), version);
+}
+
+static void testRollsBackOnUnknownDish() {
+    RestaurantDb& db = *g_db;
+    int orders = db.getTodayOrderCount();
+    int stock = stockOf(db, 5);
+
+    auto placed = db.placeOrder(makeOrder(), {makeItem(5, 1), makeItem(9999, 1)});
+    EXPECT_TRUE(!placed.has_value());
+    EXPECT_EQ(db.getTodayOrderCount(), orders);
+    EXPECT_EQ(stockOf(db, 5), stock);
+}
+
+static void testSkipsStockWhenInventoryManaged() {
+    RestaurantDb& db = *g_db;
+    EXPECT_TRUE(db.updateDishStock(4, 0));
+
+    // 库存由InventoryManager预留时不检查也不扣减stock_count
+    auto placed = db.placeOrder(makeOrder(), {makeItem(4, 2)}, false);
+    EXPECT_TRUE(placed.has_value());
+    EXPECT_EQ(stockOf(db, 4), 0);
+}
+
+int main() {
+    TestSupport::quietLogs();
+    RestaurantDb db;
+    if (!db.initialize(TestSupport::freshPath("place_order_test.db"))) {
+        std::fprintf(stderr, "数据库初始化失败\n");
+        return 1;
+    }
+    g_db = &db;
+
+    RUN_TEST(testPlacesOrderWithoutBumpingMenuVersion);
+    RUN_TEST(testRollsBackWhenStockIsShort);
+    RUN_TEST(testRollsBackOnUnknownDish);
+    RUN_TEST(testSkipsStockWhenInventoryManaged);
+    return TestSupport::finish();
+}
@@ -0,0 +1,93 @@
+// PopularityTracker：日期推进时各窗口扣除移出的日销量、补录历史订单项、排行顺序
+#include "TestSupport.h"
+#include "db/PopularityTracker.h"
+#include <chrono>
+
+using namespace WisdomRestaurant;
+
+static std::chrono::system_clock::time_point daysAgo(int days) {
+    return std::chrono::system_clock::now() - std::chrono::hours(24 * days);
+}
+
+// 全部时段、全部季节切片中某道菜在窗口内的销量，没有上榜时为0
+static uint64_t countOf(PopularityTracker& tracker, PopularityWindow window, int dish_id) {
+    for (const PopularDish& dish : tracker.top(-1, -1, window, 100)) {
+        if (dish.dish_id == dish_id) {
+            return dish.count;
+        }
+    }
+    return 0;
+}
+
+static void testWindowsRollOverAsDaysAdvance() {
+    PopularityTracker tracker;
+    tracker.record(1, 5, daysAgo(40));
+    tracker.record(2, 3, daysAgo(10));
+    tracker.record(3, 2, daysAgo(3));
+    tracker.record(4, 1, daysAgo(0));   // 推进到今天，较早的日销量从较短的窗口中扣除
+
+    EXPECT_EQ(countOf(tracker, PopularityWindow::Day, 4), 1u);
+    EXPECT_EQ(countOf(tracker, PopularityWindow::Day, 3), 0u);
+    EXPECT_EQ(countOf(tracker, PopularityWindow::Week, 3), 2u);
+    EXPECT_EQ(countOf(tracker, PopularityWindow::Week, 2), 0u);
+    EXPECT_EQ(countOf(tracker, PopularityWindow::Month, 2), 3u);
+    EXPECT_EQ(countOf(tracker, PopularityWindow::Month, 1), 0u);
+    EXPECT_EQ(countOf(tracker, PopularityWindow::Quarter, 1), 5u);
+    EXPECT_EQ(tracker.top(-1, -1, PopularityWindow::Quarter, 10).size(), 4u);
+}
+
+static void testBackfilledItemsOnlyCountInCoveringWindows() {
+    PopularityTracker tracker;
+    tracker.record(1, 1, daysAgo(0));
+    // 初始化时从数据库加载的订单项可能晚于今天的订单项到达
+    tracker.record(2, 4, daysAgo(5));
+    tracker.record(2, 6, daysAgo(20));
+    tracker.record(3, 9, daysAgo(120));
+
+    EXPECT_EQ(countOf(tracker, PopularityWindow::Day, 2), 0u);
+    EXPECT_EQ(countOf(tracker, PopularityWindow::Week, 2), 4u);
+    EXPECT_EQ(countOf(tracker, PopularityWindow::Month, 2), 10u);
+    EXPECT_EQ(countOf(tracker, PopularityWindow::Quarter, 3), 0u);
+
+    PopularityStats stats = tracker.getStats();
+    EXPECT_EQ(stats.events, 3u);
+    EXPECT_EQ(stats.dropped, 1u);
+}
+
+static void testRankingOrderAndFilter() {
+    PopularityTracker tracker;
+    tracker.record(7, 2, daysAgo(0));
+    tracker.record(5, 2, daysAgo(0));
+    tracker.record(9, 8, daysAgo(0));
+    tracker.record(5, 1, daysAgo(0));
+
+    std::vector<PopularDish> top = tracker.top(-1, -1, PopularityWindow::Day, 3);
+    EXPECT_EQ(top.size(), 3u);
+    if (top.size() == 3) {
+        EXPECT_EQ(top[0].dish_id, 9);
+        EXPECT_EQ(top[1].dish_id, 5);     // 3份
+        EXPECT_EQ(top[2].dish_id, 7);
+    }
+
+    // 过滤售罄或下架的菜品后仍取满k个
+    std::vector<PopularDish> filtered = tracker.top(-1, -1, PopularityWindow::Day, 2,
+                                                    [](int dish_id) { return dish_id != 9; });
+    EXPECT_EQ(filtered.size(), 2u);
+    if (filtered.size() == 2) {
+        EXPECT_EQ(filtered[0].dish_id, 5);
+        EXPECT_EQ(filtered[1].dish_id, 7);
+    }
+
+    // 同销量按菜品id升序
+    tracker.record(6, 3, daysAgo(0));
+    top = tracker.top(-1, -1, PopularityWindow::Day, 3);
+    EXPECT_TRUE(top.size() == 3 && top[1].dish_id == 5 && top[2].dish_id == 6);
+}
+
+int main() {
+    TestSupport::quietLogs();
+    RUN_TEST(testWindowsRollOverAsDaysAdvance);
+    RUN_TEST(testBackfilledItemsOnlyCountInCoveringWindows);
+    RUN_TEST(testRankingOrderAndFilter);
+    return TestSupport::finish();
+}
@@ -0,0 +1,114 @@
+// RecommendationCache：LRU淘汰、TTL过期、并发未命中合并，以及失败/空结果不缓存
+#include "TestSupport.h"
+#include "ai/RecommendationCache.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace WisdomRestaurant;
+
+static RecommendationResult makeResult(const std::string& dish_name) {
+    RecommendationResult result{};
+    result.success = true;
+    result.recommendations.push_back(DishRecommendation{dish_name, "", "", ""});
+    return result;
+}
+
+static void testEvictsLeastRecentlyUsed() {
+    RecommendationCache cache(2, std::chrono::seconds(600));
+    cache.put("a", makeResult("A"));
+    cache.put("b", makeResult("B"));
+    EXPECT_TRUE(cache.lookup("a").has_value());   // a变为最近使用
+    cache.put("c", makeResult("C"));
+
+    EXPECT_TRUE(cache.lookup("a").has_value());
+    EXPECT_TRUE(!cache.lookup("b").has_value());
+    EXPECT_TRUE(cache.lookup("c").has_value());
+    EXPECT_EQ(cache.getStats().evictions, 1u);
+    EXPECT_EQ(cache.getStats().entries, 2u);
+}
+
+static void testExpiresAfterTtl() {
+    RecommendationCache cache(8, std::chrono::seconds(1));
+    cache.put("a", makeResult("A"));
+    EXPECT_TRUE(cache.lookup("a").has_value());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    EXPECT_TRUE(!cache.lookup("a").has_value());
+    EXPECT_EQ(cache.getStats().expirations, 1u);
+}
+
+static void testCoalescesConcurrentMisses() {
+    RecommendationCache cache(8, std::chrono::seconds(600));
+    std::atomic<int> loads(0);
+    auto loader = [&loads] {
+        loads++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        return makeResult("A");
+    };
+
+    std::vector<std::thread> threads;
+    std::atomic<int> succeeded(0);
+    for (int i = 0; i < 6; i++) {
+        threads.emplace_back([&] {
+            RecommendationResult result = cache.getOrLoad("a", loader);
+            if (result.success && result.recommendations.size() == 1) {
+                succeeded++;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(loads.load(), 1);
+    EXPECT_EQ(succeeded.load(), 6);
+    RecommendationCacheStats stats = cache.getStats();
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.hits + stats.coalesced, 5u);
+}
+
+static void testDoesNotCacheFailedOrEmptyResults() {
+    RecommendationCache cache(8, std::chrono::seconds(600));
+    int loads = 0;
+
+    RecommendationResult failed{};
+    failed.success = false;
+    failed.error_message = "上游超时";
+    cache.getOrLoad("failed", [&] { loads++; return failed; });
+    cache.getOrLoad("failed", [&] { loads++; return failed; });
+    EXPECT_EQ(loads, 2);
+
+    RecommendationResult empty{};
+    empty.success = true;
+    cache.getOrLoad("empty", [&] { loads++; return empty; });
+    cache.getOrLoad("empty", [&] { loads++; return empty; });
+    EXPECT_EQ(loads, 4);
+
+    cache.put("empty", empty);
+    EXPECT_TRUE(!cache.lookup("empty").has_value());
+    EXPECT_EQ(cache.getStats().entries, 0u);
+}
+
+static void testKeyChangesWithMenuSoldOutAndPopularLine() {
+    VisionResult vision{};
+    vision.people_num = 2;
+    vision.customer_portrait.push_back(CustomerPortrait{"青年", "man", "标准"});
+    vision.success = true;
+
+    std::string base = RecommendationCache::makeKey(vision, "夏季", "午餐", 1, 1, "热销：宫保鸡丁");
+    EXPECT_EQ(RecommendationCache::makeKey(vision, " 夏季 ", "午餐", 1, 1, "热销：宫保鸡丁"), base);
+    EXPECT_TRUE(RecommendationCache::makeKey(vision, "夏季", "午餐", 2, 1, "热销：宫保鸡丁") != base);
+    EXPECT_TRUE(RecommendationCache::makeKey(vision, "夏季", "午餐", 1, 2, "热销：宫保鸡丁") != base);
+    EXPECT_TRUE(RecommendationCache::makeKey(vision, "夏季", "午餐", 1, 1, "热销：清蒸鲈鱼") != base);
+}
+
+int main() {
+    TestSupport::quietLogs();
+    RUN_TEST(testEvictsLeastRecentlyUsed);
+    RUN_TEST(testExpiresAfterTtl);
+    RUN_TEST(testCoalescesConcurrentMisses);
+    RUN_TEST(testDoesNotCacheFailedOrEmptyResults);
+    RUN_TEST(testKeyChangesWithMenuSoldOutAndPopularLine);
+    return TestSupport::finish();
+}
@@ -0,0 +1,76 @@
+// UploadBody：按任意大小的块读取时输出与一次性拼接的请求体逐字节相同，rewind后可重新读取
+#include "TestSupport.h"
+#include "ai/UploadBody.h"
+#include "common/Base64.h"
+#include <random>
+
+using namespace WisdomRestaurant;
+
+static std::string readAll(UploadBody& body, size_t chunk) {
+    std::string out;
+    std::string buffer(chunk, '\0');
+    size_t n;
+    while ((n = body.read(&buffer[0], chunk)) > 0) {
+        out.append(buffer, 0, n);
+    }
+    return out;
+}
+
+static void testChunkedReadsMatchConcatenatedBody() {
+    std::mt19937 random(1);
+    int mismatches = 0;
+    // 覆盖图片长度不是3的倍数、读取块小于4字节（base64编码结果需要暂存）等情况
+    for (size_t image_size : {0, 1, 2, 3, 4, 5, 100, 1001, 65537}) {
+        for (size_t chunk : {1, 2, 3, 4, 5, 7, 16, 1000, 70000}) {
+            for (bool is_base64 : {false, true}) {
+                std::string image(image_size, '\0');
+                for (char& c : image) {
+                    c = static_cast<char>(random());
+                }
+                if (is_base64) {
+                    image = Base64::encode(image);
+                }
+                std::string expected = "{\"url\":\"" + (is_base64 ? image : Base64::encode(image)) + "\"}";
+
+                UploadBody body("{\"url\":\"", &image, is_base64, "\"}");
+                if (body.size() != expected.size() || readAll(body, chunk) != expected) {
+                    mismatches++;
+                }
+                body.rewind();
+                if (readAll(body, chunk) != expected) {
+                    mismatches++;
+                }
+            }
+        }
+    }
+    EXPECT_EQ(mismatches, 0);
+}
+
+static void testPlainBodyAndSeek() {
+    UploadBody body("{\"model\":\"qwen\"}");
+    EXPECT_EQ(body.size(), 16u);
+    EXPECT_EQ(body.bufferedBytes(), 16u);
+    EXPECT_EQ(readAll(body, 5), "{\"model\":\"qwen\"}");
+
+    // CURL只会定位到开头
+    EXPECT_EQ(UploadBody::SeekCallback(&body, 0, SEEK_SET), CURL_SEEKFUNC_OK);
+    EXPECT_EQ(readAll(body, 64), "{\"model\":\"qwen\"}");
+    EXPECT_EQ(UploadBody::SeekCallback(&body, 3, SEEK_SET), CURL_SEEKFUNC_CANTSEEK);
+}
+
+static void testImageIsNotCopied() {
+    std::string image(3 * 1024 * 1024, 'x');
+    std::string prefix = "{\"url\":\"data:image/jpeg;base64,";
+    std::string suffix = "\"}";
+    UploadBody body(prefix, &image, false, suffix);
+    EXPECT_EQ(body.size(), prefix.size() + Base64::encodedLength(image.size()) + suffix.size());
+    EXPECT_EQ(body.bufferedBytes(), prefix.size() + suffix.size());
+}
+
+int main() {
+    TestSupport::quietLogs();
+    RUN_TEST(testChunkedReadsMatchConcatenatedBody);
+    RUN_TEST(testPlainBodyAndSeek);
+    RUN_TEST(testImageIsNotCopied);
+    return TestSupport::finish();
+}